@@ -0,0 +1,201 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#ifndef __included_af_xdp_h__
+#define __included_af_xdp_h__
+
+#include <linux/if_xdp.h>
+#include <vppinfra/lock.h>
+
+#define AF_XDP_DEFAULT_RING_SIZE	1024
+#define AF_XDP_MAX_QUEUES		64
+#define AF_XDP_REFILL_BATCH_SZ		32
+
+/* XDP_PACKET_HEADROOM, the kernel puts packet data this far into each
+   umem chunk */
+#define AF_XDP_RX_HEADROOM		256
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+/* One of the four rings shared with the kernel. Producer and consumer
+   are free running, local copies of the index we own are kept so the
+   shared cache line is only written once per batch. */
+typedef struct
+{
+  volatile u32 *producer;
+  volatile u32 *consumer;
+  volatile u32 *flags;
+  void *desc;
+  u32 mask;
+  u32 size;
+  u32 cached_prod;
+  u32 cached_cons;
+  void *map;
+  uword map_size;
+} af_xdp_ring_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  /* rx side, only touched by the thread the queue is assigned to */
+  af_xdp_ring_t rx;
+  af_xdp_ring_t fill;
+
+    CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
+  /* tx side, shared by threads when there are fewer queues than threads */
+  clib_spinlock_t lockp;
+  af_xdp_ring_t tx;
+  af_xdp_ring_t comp;
+  /* buffer index of each tx ring slot, freed on completion */
+  u32 *tx_buffers;
+
+  int fd;
+  u32 clib_file_index;
+  u16 queue_id;
+} af_xdp_queue_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  u32 flags;
+#define AF_XDP_IF_F_ADMIN_UP	(1 << 0)
+#define AF_XDP_IF_F_ZERO_COPY	(1 << 1)
+#define AF_XDP_IF_F_SHARED_UMEM	(1 << 2)
+  u32 per_interface_next_index;
+
+  af_xdp_queue_t *queues;
+
+  /* base of the vlib buffer pool registered as umem */
+  uword umem_start;
+  u8 umem_pool_index;
+
+  u8 *host_if_name;
+  int host_if_index;
+  int xsks_map_fd;
+  int prog_fd;
+  u32 ring_size;
+
+  u32 dev_instance;
+  u32 sw_if_index;
+  u32 hw_if_index;
+} af_xdp_if_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  u32 buffers[VLIB_FRAME_SIZE];
+} af_xdp_per_thread_data_t;
+
+typedef struct
+{
+  af_xdp_if_t *interfaces;
+  af_xdp_per_thread_data_t *per_thread_data;
+} af_xdp_main_t;
+
+extern vnet_device_class_t af_xdp_device_class;
+extern af_xdp_main_t af_xdp_main;
+
+typedef struct
+{
+  u8 *host_if_name;
+  u16 num_rx_queues;
+  u32 ring_size;
+
+  /* return */
+  int rv;
+  u32 sw_if_index;
+  clib_error_t *error;
+} af_xdp_create_if_args_t;
+
+void af_xdp_create_if (vlib_main_t * vm, af_xdp_create_if_args_t * args);
+void af_xdp_delete_if (vlib_main_t * vm, af_xdp_if_t * ad);
+
+/* umem offset of the data area of a vlib buffer, used as fill address */
+static_always_inline u64
+af_xdp_buffer_umem_addr (af_xdp_if_t * ad, vlib_buffer_t * b)
+{
+  return pointer_to_uword (b->data) - ad->umem_start;
+}
+
+/* rx descriptors carry the fill address in the low bits and the offset
+   of the packet data in the chunk in the high bits */
+static_always_inline vlib_buffer_t *
+af_xdp_rx_desc_buffer (af_xdp_if_t * ad, u64 addr)
+{
+  uword base = addr & XSK_UNALIGNED_BUF_ADDR_MASK;
+  return uword_to_pointer (ad->umem_start + base -
+			   STRUCT_OFFSET_OF (vlib_buffer_t, data),
+			   vlib_buffer_t *);
+}
+
+static_always_inline u16
+af_xdp_rx_desc_offset (u64 addr)
+{
+  return addr >> XSK_UNALIGNED_BUF_OFFSET_SHIFT;
+}
+
+/* output.c */
+
+#define foreach_af_xdp_tx_func_error \
+  _(NO_FREE_SLOTS, "no free tx slots")			\
+  _(CHAINED, "chained buffers not supported")		\
+  _(FOREIGN_BUFFER, "buffer not in umem")		\
+  _(SENDTO, "sendto errors")
+
+typedef enum
+{
+#define _(f,s) AF_XDP_TX_ERROR_##f,
+  foreach_af_xdp_tx_func_error
+#undef _
+    AF_XDP_TX_N_ERROR,
+} af_xdp_tx_func_error_t;
+
+uword af_xdp_interface_tx (vlib_main_t * vm, vlib_node_runtime_t * node,
+			   vlib_frame_t * frame);
+
+/* input.c */
+
+typedef struct
+{
+  u32 next_index;
+  u32 hw_if_index;
+  u16 queue_id;
+  struct xdp_desc desc;
+} af_xdp_input_trace_t;
+
+extern vlib_node_registration_t af_xdp_input_node;
+
+/* format.c */
+format_function_t format_af_xdp_input_trace;
+format_function_t format_af_xdp_interface;
+format_function_t format_af_xdp_interface_name;
+
+#endif /* __included_af_xdp_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,158 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#include <vlib/vlib.h>
+#include <vlib/unix/unix.h>
+#include <vnet/ethernet/ethernet.h>
+
+#include <af_xdp/af_xdp.h>
+
+static clib_error_t *
+af_xdp_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			  vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  af_xdp_create_if_args_t args = { 0 };
+  u32 num_rx_queues = 0;
+
+  /* Get a line of input. */
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "host-if %s", &args.host_if_name))
+	;
+      else if (unformat (line_input, "num-rx-queues %u", &num_rx_queues))
+	;
+      else if (unformat (line_input, "ring-size %u", &args.ring_size))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+  unformat_free (line_input);
+
+  if (args.host_if_name == 0)
+    return clib_error_return (0, "please specify host-if");
+
+  args.num_rx_queues = num_rx_queues;
+  af_xdp_create_if (vm, &args);
+
+  vec_free (args.host_if_name);
+
+  if (args.error == 0)
+    vlib_cli_output (vm, "%U\n", format_vnet_sw_if_index_name,
+		     vnet_get_main (), args.sw_if_index);
+
+  return args.error;
+}
+
+/*?
+ * Create a vpp interface on top of a linux interface using AF_XDP
+ * sockets. An XDP program redirecting every rx queue used to a socket
+ * is attached to the linux interface, packets on the other queues still
+ * go to the kernel stack. Rx buffers are vlib buffers handed to the
+ * kernel, so packets are received without a copy in zero-copy capable
+ * drivers and with a single copy otherwise. The interface name is the
+ * linux interface name prefixed with 'xdp-'.
+ *
+ * Each rx queue uses its own socket bound to the same queue number of
+ * the linux interface, and can be placed on any worker. Use
+ * 'set interface rx-mode' to switch a queue to interrupt mode, where it
+ * is woken up through the socket fd.
+ *
+ * @cliexpar
+ * Create an interface on one end of a veth pair:
+ * @cliexcmd{create interface af_xdp host-if vpp1 num-rx-queues 2}
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (af_xdp_create_command, static) = {
+  .path = "create interface af_xdp",
+  .short_help = "create interface af_xdp host-if <ifname> "
+    "[num-rx-queues <n>] [ring-size <n>]",
+  .function = af_xdp_create_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+af_xdp_delete_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			  vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  u32 sw_if_index = ~0;
+  vnet_hw_interface_t *hw;
+  af_xdp_main_t *am = &af_xdp_main;
+  af_xdp_if_t *ad;
+  vnet_main_t *vnm = vnet_get_main ();
+
+  /* Get a line of input. */
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "sw_if_index %d", &sw_if_index))
+	;
+      else if (unformat (line_input, "%U", unformat_vnet_sw_interface,
+			 vnm, &sw_if_index))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+  unformat_free (line_input);
+
+  if (sw_if_index == ~0)
+    return clib_error_return (0,
+			      "please specify interface name or sw_if_index");
+
+  hw = vnet_get_sup_hw_interface (vnm, sw_if_index);
+  if (hw == NULL || af_xdp_device_class.index != hw->dev_class_index)
+    return clib_error_return (0, "not an AF_XDP interface");
+
+  ad = pool_elt_at_index (am->interfaces, hw->dev_instance);
+
+  af_xdp_delete_if (vm, ad);
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (af_xdp_delete_command, static) = {
+  .path = "delete interface af_xdp",
+  .short_help = "delete interface af_xdp "
+    "{<interface> | sw_if_index <sw_idx>}",
+  .function = af_xdp_delete_command_fn,
+};
+/* *INDENT-ON* */
+
+clib_error_t *
+af_xdp_cli_init (vlib_main_t * vm)
+{
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (af_xdp_cli_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,579 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+
+#include <vlib/vlib.h>
+#include <vlib/unix/unix.h>
+#include <vnet/ethernet/ethernet.h>
+#include <vnet/devices/netlink.h>
+
+#include <af_xdp/af_xdp.h>
+
+af_xdp_main_t af_xdp_main;
+
+static int
+af_xdp_bpf (int cmd, union bpf_attr *attr)
+{
+  return syscall (__NR_bpf, cmd, attr, sizeof (*attr));
+}
+
+/*
+ * Redirect each packet to the socket bound to the queue it arrived on,
+ * packets on queues without a socket fall back to the kernel stack:
+ *
+ *   return bpf_redirect_map (&xsks_map, ctx->rx_queue_index, XDP_PASS);
+ *
+ * Hand assembled so we do not depend on libbpf or a bpf compiler.
+ */
+static clib_error_t *
+af_xdp_load_program (af_xdp_if_t * ad)
+{
+  union bpf_attr attr;
+  char log[4096] = { 0 };
+
+  memset (&attr, 0, sizeof (attr));
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof (u32);
+  attr.value_size = sizeof (u32);
+  attr.max_entries = AF_XDP_MAX_QUEUES;
+  if ((ad->xsks_map_fd = af_xdp_bpf (BPF_MAP_CREATE, &attr)) < 0)
+    return clib_error_return_unix (0, "bpf map create");
+
+  /* *INDENT-OFF* */
+  struct bpf_insn prog[] = {
+    { .code = BPF_LDX | BPF_MEM | BPF_W, .dst_reg = BPF_REG_2,
+      .src_reg = BPF_REG_1,
+      .off = STRUCT_OFFSET_OF (struct xdp_md, rx_queue_index) },
+    { .code = BPF_LD | BPF_DW | BPF_IMM, .dst_reg = BPF_REG_1,
+      .src_reg = BPF_PSEUDO_MAP_FD, .imm = ad->xsks_map_fd },
+    { },
+    { .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_3,
+      .imm = XDP_PASS },
+    { .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_redirect_map },
+    { .code = BPF_JMP | BPF_EXIT },
+  };
+  /* *INDENT-ON* */
+
+  memset (&attr, 0, sizeof (attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = pointer_to_uword (prog);
+  attr.insn_cnt = ARRAY_LEN (prog);
+  attr.license = pointer_to_uword ("Apache-2.0");
+  attr.log_buf = pointer_to_uword (log);
+  attr.log_size = sizeof (log);
+  attr.log_level = 1;
+  if ((ad->prog_fd = af_xdp_bpf (BPF_PROG_LOAD, &attr)) < 0)
+    return clib_error_return_unix (0, "bpf program load: %s", log);
+
+  return vnet_netlink_set_link_xdp_fd (ad->host_if_index, ad->prog_fd,
+				       XDP_FLAGS_UPDATE_IF_NOEXIST);
+}
+
+static clib_error_t *
+af_xdp_ring_map (int fd, af_xdp_ring_t * r, struct xdp_ring_offset *off,
+		 u64 pgoff, u32 size, u32 elt_size)
+{
+  r->map_size = off->desc + size * elt_size;
+  r->map = mmap (0, r->map_size, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_POPULATE, fd, pgoff);
+  if (r->map == MAP_FAILED)
+    {
+      r->map = 0;
+      return clib_error_return_unix (0, "mmap ring");
+    }
+
+  r->producer = r->map + off->producer;
+  r->consumer = r->map + off->consumer;
+  r->flags = r->map + off->flags;
+  r->desc = r->map + off->desc;
+  r->size = size;
+  r->mask = size - 1;
+  r->cached_prod = *r->producer;
+  r->cached_cons = *r->consumer;
+  return 0;
+}
+
+static void
+af_xdp_ring_unmap (af_xdp_ring_t * r)
+{
+  if (r->map)
+    munmap (r->map, r->map_size);
+  r->map = 0;
+}
+
+static clib_error_t *
+af_xdp_fd_read_ready (clib_file_t * uf)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 idx = uf->private_data;
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, idx >> 16);
+  u16 qid = idx & 0xffff;
+
+  vnet_device_input_set_interrupt_pending (vnm, ad->hw_if_index, qid);
+  return 0;
+}
+
+/* Open the socket of a queue and size its rings. The first queue
+   registers the buffer pool as umem, the others share it through the
+   socket of the first queue so the pool is pinned and mapped by the
+   kernel once per device. Each socket still has its own fill and
+   completion rings. */
+static clib_error_t *
+af_xdp_queue_socket (vlib_main_t * vm, af_xdp_if_t * ad, af_xdp_queue_t * q,
+		     int shared)
+{
+  vlib_buffer_pool_t *bp = vec_elt_at_index (vm->buffer_main->buffer_pools,
+					     ad->umem_pool_index);
+  struct xdp_umem_reg umem = { 0 };
+  u32 n = ad->ring_size;
+
+  if ((q->fd = socket (AF_XDP, SOCK_RAW, 0)) < 0)
+    return clib_error_return_unix (0, "socket (AF_XDP)");
+
+  if (!shared)
+    {
+      /* the whole buffer pool is the umem, buffers are handed to the
+         kernel as they are, so chunks need not be aligned */
+      umem.addr = bp->start;
+      umem.len = bp->size;
+      umem.chunk_size = VLIB_BUFFER_DEFAULT_FREE_LIST_BYTES;
+      umem.flags = XDP_UMEM_UNALIGNED_CHUNK_FLAG;
+      if (setsockopt (q->fd, SOL_XDP, XDP_UMEM_REG, &umem, sizeof (umem)) <
+	  0)
+	return clib_error_return_unix (0, "register buffer memory as umem");
+    }
+
+#define _(o) \
+  if (setsockopt (q->fd, SOL_XDP, o, &n, sizeof (n)) < 0)	\
+    return clib_error_return_unix (0, "setsockopt (" #o ")");
+  _(XDP_UMEM_FILL_RING);
+  _(XDP_UMEM_COMPLETION_RING);
+  _(XDP_RX_RING);
+  _(XDP_TX_RING);
+#undef _
+
+  return 0;
+}
+
+static clib_error_t *
+af_xdp_queue_init (vlib_main_t * vm, af_xdp_if_t * ad, u16 qid)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  af_xdp_queue_t *q = vec_elt_at_index (ad->queues, qid);
+  struct xdp_mmap_offsets off;
+  struct sockaddr_xdp sxdp = { 0 };
+  union bpf_attr attr;
+  socklen_t optlen;
+  u32 n = ad->ring_size;
+  u32 key = qid;
+  int opt, shared = 0;
+  clib_error_t *error;
+
+  q->queue_id = qid;
+  q->clib_file_index = ~0;
+
+  /* Kernels before 5.10 only share a umem between sockets of the same
+     queue, they refuse fill and completion rings on a socket without
+     one. The queue then registers the pool again. */
+  if (qid > 0 && (ad->flags & AF_XDP_IF_F_SHARED_UMEM))
+    {
+      if ((error = af_xdp_queue_socket (vm, ad, q, 1 /* shared */ )) == 0)
+	shared = 1;
+      else
+	{
+	  clib_error_free (error);
+	  close (q->fd);
+	  q->fd = -1;
+	  ad->flags &= ~AF_XDP_IF_F_SHARED_UMEM;
+	}
+    }
+  if (!shared && (error = af_xdp_queue_socket (vm, ad, q, 0)))
+    return error;
+
+  optlen = sizeof (off);
+  if (getsockopt (q->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0)
+    return clib_error_return_unix (0, "getsockopt (XDP_MMAP_OFFSETS)");
+
+  if ((error = af_xdp_ring_map (q->fd, &q->rx, &off.rx, XDP_PGOFF_RX_RING,
+				n, sizeof (struct xdp_desc))))
+    return error;
+  if ((error = af_xdp_ring_map (q->fd, &q->tx, &off.tx, XDP_PGOFF_TX_RING,
+				n, sizeof (struct xdp_desc))))
+    return error;
+  if ((error = af_xdp_ring_map (q->fd, &q->fill, &off.fr,
+				XDP_UMEM_PGOFF_FILL_RING, n, sizeof (u64))))
+    return error;
+  if ((error = af_xdp_ring_map (q->fd, &q->comp, &off.cr,
+				XDP_UMEM_PGOFF_COMPLETION_RING, n,
+				sizeof (u64))))
+    return error;
+
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_ifindex = ad->host_if_index;
+  sxdp.sxdp_queue_id = qid;
+  if (shared)
+    {
+      /* need-wakeup and the copy mode are taken from the umem owner */
+      sxdp.sxdp_flags = XDP_SHARED_UMEM;
+      sxdp.sxdp_shared_umem_fd = ad->queues[0].fd;
+    }
+  else
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP;
+  if (bind (q->fd, (struct sockaddr *) &sxdp, sizeof (sxdp)) < 0)
+    return clib_error_return_unix (0, "bind to %s queue %u",
+				   ad->host_if_name, qid);
+
+  optlen = sizeof (opt);
+  if (getsockopt (q->fd, SOL_XDP, XDP_OPTIONS, &opt, &optlen) == 0 &&
+      (opt & XDP_OPTIONS_ZEROCOPY))
+    ad->flags |= AF_XDP_IF_F_ZERO_COPY;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.map_fd = ad->xsks_map_fd;
+  attr.key = pointer_to_uword (&key);
+  attr.value = pointer_to_uword (&q->fd);
+  if (af_xdp_bpf (BPF_MAP_UPDATE_ELEM, &attr) < 0)
+    return clib_error_return_unix (0, "bpf map update");
+
+  vec_validate_aligned (q->tx_buffers, n - 1, CLIB_CACHE_LINE_BYTES);
+  if (vec_len (ad->queues) < tm->n_vlib_mains)
+    clib_spinlock_init (&q->lockp);
+
+  return 0;
+}
+
+static void
+af_xdp_queue_free (vlib_main_t * vm, af_xdp_if_t * ad, af_xdp_queue_t * q)
+{
+  u32 n;
+
+  if (q->clib_file_index != ~0)
+    clib_file_del_by_index (&file_main, q->clib_file_index);
+  q->clib_file_index = ~0;
+
+  if (q->fd >= 0)
+    close (q->fd);
+  q->fd = -1;
+
+  /* In copy mode the kernel takes fill entries in order and our rx ring
+     never overflows, so the buffers still owned by the kernel are the
+     ones posted after the last received. Zero-copy drivers recycle
+     chunks out of order, so there we cannot tell and leave them. */
+  if (q->fill.map && q->rx.map && !(ad->flags & AF_XDP_IF_F_ZERO_COPY))
+    for (n = q->rx.cached_cons; n != q->fill.cached_prod; n++)
+      {
+	u64 *fill = q->fill.desc;
+	vlib_buffer_t *b = af_xdp_rx_desc_buffer (ad, fill[n & q->fill.mask]);
+	u32 bi = vlib_get_buffer_index (vm, b);
+	vlib_buffer_free (vm, &bi, 1);
+      }
+
+  /* frames handed to tx and not yet completed */
+  for (n = q->comp.cached_cons; n != q->tx.cached_prod; n++)
+    vlib_buffer_free (vm, q->tx_buffers + (n & q->tx.mask), 1);
+
+  af_xdp_ring_unmap (&q->rx);
+  af_xdp_ring_unmap (&q->tx);
+  af_xdp_ring_unmap (&q->fill);
+  af_xdp_ring_unmap (&q->comp);
+  vec_free (q->tx_buffers);
+  clib_spinlock_free (&q->lockp);
+}
+
+static u32
+af_xdp_eth_flag_change (vnet_main_t * vnm, vnet_hw_interface_t * hi,
+			u32 flags)
+{
+  /* nothing for now */
+  return 0;
+}
+
+void
+af_xdp_delete_if (vlib_main_t * vm, af_xdp_if_t * ad)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  af_xdp_main_t *am = &af_xdp_main;
+  af_xdp_queue_t *q;
+  clib_error_t *error;
+  int i;
+
+  if (ad->hw_if_index != ~0)
+    {
+      vnet_hw_interface_set_flags (vnm, ad->hw_if_index, 0);
+      vec_foreach_index (i, ad->queues)
+	vnet_hw_interface_unassign_rx_thread (vnm, ad->hw_if_index, i);
+      ethernet_delete_interface (vnm, ad->hw_if_index);
+    }
+
+  if (ad->prog_fd >= 0)
+    {
+      error = vnet_netlink_set_link_xdp_fd (ad->host_if_index, -1, 0);
+      if (error)
+	clib_error_report (error);
+      close (ad->prog_fd);
+    }
+
+  vec_foreach (q, ad->queues) af_xdp_queue_free (vm, ad, q);
+  vec_free (ad->queues);
+
+  if (ad->xsks_map_fd >= 0)
+    close (ad->xsks_map_fd);
+
+  vec_free (ad->host_if_name);
+  pool_put (am->interfaces, ad);
+}
+
+void
+af_xdp_create_if (vlib_main_t * vm, af_xdp_create_if_args_t * args)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_sw_interface_t *sw;
+  vnet_hw_interface_t *hw;
+  vlib_buffer_pool_t *bp;
+  af_xdp_if_t *ad;
+  struct ifreq ifr = { 0 };
+  u32 bi;
+  int i, fd;
+
+  /* defaults */
+  args->num_rx_queues = args->num_rx_queues ? args->num_rx_queues : 1;
+  args->ring_size = args->ring_size ? args->ring_size :
+    AF_XDP_DEFAULT_RING_SIZE;
+
+  if (args->num_rx_queues > AF_XDP_MAX_QUEUES ||
+      !is_pow2 (args->ring_size) || args->ring_size < VLIB_FRAME_SIZE)
+    {
+      args->rv = VNET_API_ERROR_INVALID_VALUE;
+      args->error = clib_error_return (0, "up to %u queues and a power of "
+				       "2 ring size of at least %u expected",
+				       AF_XDP_MAX_QUEUES, VLIB_FRAME_SIZE);
+      return;
+    }
+
+  if (vec_len (am->per_thread_data) == 0)
+    vec_validate_aligned (am->per_thread_data, tm->n_vlib_mains - 1,
+			  CLIB_CACHE_LINE_BYTES);
+
+  pool_get (am->interfaces, ad);
+  memset (ad, 0, sizeof (*ad));
+  ad->dev_instance = ad - am->interfaces;
+  ad->hw_if_index = ~0;
+  ad->per_interface_next_index = ~0;
+  ad->xsks_map_fd = ad->prog_fd = -1;
+  ad->ring_size = args->ring_size;
+  ad->host_if_name = format (0, "%v%c", args->host_if_name, 0);
+  vec_validate_aligned (ad->queues, args->num_rx_queues - 1,
+			CLIB_CACHE_LINE_BYTES);
+  for (i = 0; i < vec_len (ad->queues); i++)
+    {
+      ad->queues[i].fd = -1;
+      ad->queues[i].clib_file_index = ~0;
+    }
+
+  if ((ad->host_if_index = if_nametoindex ((char *) ad->host_if_name)) == 0)
+    {
+      args->rv = VNET_API_ERROR_INVALID_INTERFACE;
+      args->error = clib_error_return (0, "unknown interface '%s'",
+				       ad->host_if_name);
+      goto error;
+    }
+
+  /* rx buffers land where the kernel writes, so the umem is the pool our
+     buffers are allocated from */
+  if (vlib_buffer_alloc (vm, &bi, 1) != 1)
+    {
+      args->rv = VNET_API_ERROR_INIT_FAILED;
+      args->error = clib_error_return (0, "buffer alloc failed");
+      goto error;
+    }
+  ad->umem_pool_index = vlib_get_buffer (vm, bi)->buffer_pool_index;
+  vlib_buffer_free (vm, &bi, 1);
+  bp = vec_elt_at_index (vm->buffer_main->buffer_pools, ad->umem_pool_index);
+  ad->umem_start = bp->start;
+  ad->flags |= AF_XDP_IF_F_SHARED_UMEM;
+
+  if ((args->error = af_xdp_load_program (ad)))
+    {
+      args->rv = VNET_API_ERROR_INIT_FAILED;
+      goto error;
+    }
+
+  for (i = 0; i < vec_len (ad->queues); i++)
+    if ((args->error = af_xdp_queue_init (vm, ad, i)))
+      {
+	args->rv = VNET_API_ERROR_INIT_FAILED;
+	goto error;
+      }
+
+  clib_memcpy (ifr.ifr_name, ad->host_if_name,
+	       clib_min (vec_len (ad->host_if_name), IFNAMSIZ - 1));
+  if ((fd = socket (AF_INET, SOCK_DGRAM, 0)) < 0 ||
+      ioctl (fd, SIOCGIFHWADDR, &ifr) < 0)
+    {
+      args->rv = VNET_API_ERROR_INIT_FAILED;
+      args->error = clib_error_return_unix (0, "ioctl (SIOCGIFHWADDR)");
+      if (fd >= 0)
+	close (fd);
+      goto error;
+    }
+  close (fd);
+
+  args->error = ethernet_register_interface (vnm, af_xdp_device_class.index,
+					     ad->dev_instance,
+					     (u8 *) ifr.ifr_hwaddr.sa_data,
+					     &ad->hw_if_index,
+					     af_xdp_eth_flag_change);
+  if (args->error)
+    {
+      args->rv = VNET_API_ERROR_INVALID_REGISTRATION;
+      goto error;
+    }
+
+  sw = vnet_get_hw_sw_interface (vnm, ad->hw_if_index);
+  hw = vnet_get_hw_interface (vnm, ad->hw_if_index);
+  ad->sw_if_index = sw->sw_if_index;
+  vnet_hw_interface_set_input_node (vnm, ad->hw_if_index,
+				    af_xdp_input_node.index);
+  hw->flags |= VNET_HW_INTERFACE_FLAG_SUPPORTS_INT_MODE;
+  for (i = 0; i < vec_len (ad->queues); i++)
+    {
+      vnet_hw_interface_assign_rx_thread (vnm, ad->hw_if_index, i, ~0);
+      vnet_hw_interface_set_rx_mode (vnm, ad->hw_if_index, i,
+				     VNET_HW_INTERFACE_RX_MODE_POLLING);
+    }
+  vnet_hw_interface_set_flags (vnm, ad->hw_if_index,
+			       VNET_HW_INTERFACE_FLAG_LINK_UP);
+  args->sw_if_index = ad->sw_if_index;
+  return;
+
+error:
+  af_xdp_delete_if (vm, ad);
+}
+
+static clib_error_t *
+af_xdp_interface_admin_up_down (vnet_main_t * vnm, u32 hw_if_index,
+				u32 flags)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_hw_interface_t *hw = vnet_get_hw_interface (vnm, hw_if_index);
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, hw->dev_instance);
+
+  if (flags & VNET_SW_INTERFACE_FLAG_ADMIN_UP)
+    ad->flags |= AF_XDP_IF_F_ADMIN_UP;
+  else
+    ad->flags &= ~AF_XDP_IF_F_ADMIN_UP;
+
+  return 0;
+}
+
+/* The socket fd polls readable when its rx ring is not empty, so it is
+   only watched while the queue is in interrupt or adaptive mode. */
+static clib_error_t *
+af_xdp_interface_rx_mode_change (vnet_main_t * vnm, u32 hw_if_index,
+				 u32 qid, vnet_hw_interface_rx_mode mode)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_hw_interface_t *hw = vnet_get_hw_interface (vnm, hw_if_index);
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, hw->dev_instance);
+  af_xdp_queue_t *q = vec_elt_at_index (ad->queues, qid);
+  clib_file_t template = { 0 };
+
+  if (mode == VNET_HW_INTERFACE_RX_MODE_POLLING)
+    {
+      if (q->clib_file_index != ~0)
+	clib_file_del_by_index (&file_main, q->clib_file_index);
+      q->clib_file_index = ~0;
+      return 0;
+    }
+
+  if (q->clib_file_index == ~0)
+    {
+      template.read_function = af_xdp_fd_read_ready;
+      template.file_descriptor = q->fd;
+      template.private_data = (ad->dev_instance << 16) | qid;
+      q->clib_file_index = clib_file_add (&file_main, &template);
+    }
+  return 0;
+}
+
+static void
+af_xdp_set_interface_next_node (vnet_main_t * vnm, u32 hw_if_index,
+				u32 node_index)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_hw_interface_t *hw = vnet_get_hw_interface (vnm, hw_if_index);
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, hw->dev_instance);
+
+  /* Shut off redirection */
+  if (node_index == ~0)
+    {
+      ad->per_interface_next_index = node_index;
+      return;
+    }
+
+  ad->per_interface_next_index =
+    vlib_node_add_next (vlib_get_main (), af_xdp_input_node.index,
+			node_index);
+}
+
+static char *af_xdp_tx_func_error_strings[] = {
+#define _(n,s) s,
+  foreach_af_xdp_tx_func_error
+#undef _
+};
+
+/* *INDENT-OFF* */
+VNET_DEVICE_CLASS (af_xdp_device_class,) =
+{
+  .name = "AF_XDP interface",
+  .format_device_name = format_af_xdp_interface_name,
+  .format_device = format_af_xdp_interface,
+  .tx_function = af_xdp_interface_tx,
+  .tx_function_n_errors = AF_XDP_TX_N_ERROR,
+  .tx_function_error_strings = af_xdp_tx_func_error_strings,
+  .admin_up_down_function = af_xdp_interface_admin_up_down,
+  .rx_mode_change_function = af_xdp_interface_rx_mode_change,
+  .rx_redirect_to_node = af_xdp_set_interface_next_node,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+af_xdp_init (vlib_main_t * vm)
+{
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (af_xdp_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,91 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#include <vlib/vlib.h>
+#include <vlib/unix/unix.h>
+#include <vnet/ethernet/ethernet.h>
+
+#include <af_xdp/af_xdp.h>
+
+u8 *
+format_af_xdp_interface_name (u8 * s, va_list * args)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  u32 dev_instance = va_arg (*args, u32);
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, dev_instance);
+  return format (s, "xdp-%s", ad->host_if_name);
+}
+
+u8 *
+format_af_xdp_interface (u8 * s, va_list * args)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  u32 dev_instance = va_arg (*args, u32);
+  u32 indent = format_get_indent (s);
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, dev_instance);
+  af_xdp_queue_t *q;
+
+  s = format (s, "Linux AF_XDP socket on %s (ifindex %d), %s mode",
+	      ad->host_if_name, ad->host_if_index,
+	      ad->flags & AF_XDP_IF_F_ZERO_COPY ? "zero-copy" : "copy");
+  s = format (s, "\n%Uring size %u, umem buffer pool %u%s",
+	      format_white_space, indent + 2, ad->ring_size,
+	      ad->umem_pool_index,
+	      vec_len (ad->queues) < 2 ? "" :
+	      ad->flags & AF_XDP_IF_F_SHARED_UMEM ? " shared by all queues" :
+	      " registered per queue");
+
+  vec_foreach (q, ad->queues)
+  {
+    s = format (s, "\n%Uqueue %u: fd %d rx %u/%u fill %u/%u "
+		"tx %u/%u completion %u/%u",
+		format_white_space, indent + 2, q->queue_id, q->fd,
+		*q->rx.producer, *q->rx.consumer,
+		*q->fill.producer, *q->fill.consumer,
+		*q->tx.producer, *q->tx.consumer,
+		*q->comp.producer, *q->comp.consumer);
+  }
+  return s;
+}
+
+u8 *
+format_af_xdp_input_trace (u8 * s, va_list * args)
+{
+  vlib_main_t *vm = va_arg (*args, vlib_main_t *);
+  vlib_node_t *node = va_arg (*args, vlib_node_t *);
+  af_xdp_input_trace_t *t = va_arg (*args, af_xdp_input_trace_t *);
+  vnet_main_t *vnm = vnet_get_main ();
+  vnet_hw_interface_t *hi = vnet_get_hw_interface (vnm, t->hw_if_index);
+  u32 indent = format_get_indent (s);
+
+  s = format (s, "af_xdp: %v (%d) queue %u next-node %U",
+	      hi->name, t->hw_if_index, t->queue_id,
+	      format_vlib_next_node_name, vm, node->index, t->next_index);
+  s = format (s, "\n%Udesc addr 0x%llx offset %u len %u",
+	      format_white_space, indent + 2,
+	      t->desc.addr & XSK_UNALIGNED_BUF_ADDR_MASK,
+	      af_xdp_rx_desc_offset (t->desc.addr), t->desc.len);
+  return s;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,235 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#include <sys/socket.h>
+
+#include <vlib/vlib.h>
+#include <vlib/unix/unix.h>
+#include <vnet/ethernet/ethernet.h>
+#include <vnet/devices/devices.h>
+#include <vnet/feature/feature.h>
+
+#include <af_xdp/af_xdp.h>
+
+#define foreach_af_xdp_input_error \
+  _(BUFFER_ALLOC, "buffer alloc error") \
+  _(FILL_WAKEUP, "fill ring wakeup error")
+
+typedef enum
+{
+#define _(f,s) AF_XDP_INPUT_ERROR_##f,
+  foreach_af_xdp_input_error
+#undef _
+    AF_XDP_INPUT_N_ERROR,
+} af_xdp_input_error_t;
+
+static __clib_unused char *af_xdp_input_error_strings[] = {
+#define _(n,s) s,
+  foreach_af_xdp_input_error
+#undef _
+};
+
+static_always_inline void
+af_xdp_input_trace (vlib_main_t * vm, vlib_node_runtime_t * node, u32 next0,
+		    vlib_buffer_t * b0, uword * n_trace, af_xdp_if_t * ad,
+		    u16 qid, struct xdp_desc *d)
+{
+  af_xdp_input_trace_t *tr;
+  vlib_trace_buffer (vm, node, next0, b0,
+		     /* follow_chain */ 0);
+  vlib_set_trace_count (vm, node, --(*n_trace));
+  tr = vlib_add_trace (vm, node, b0, sizeof (*tr));
+  tr->next_index = next0;
+  tr->hw_if_index = ad->hw_if_index;
+  tr->queue_id = qid;
+  tr->desc = *d;
+}
+
+/* Give the kernel fresh buffers for every one received. Buffers are
+   posted in batches so the producer index is written once per batch. */
+static_always_inline void
+af_xdp_device_input_refill (vlib_main_t * vm, vlib_node_runtime_t * node,
+			    af_xdp_if_t * ad, af_xdp_queue_t * q)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  af_xdp_per_thread_data_t *ptd =
+    vec_elt_at_index (am->per_thread_data, vm->thread_index);
+  af_xdp_ring_t *fill = &q->fill;
+  u64 *descs = fill->desc;
+  u32 n_refill, n_alloc, i;
+
+  /* buffers posted and not yet received, the rx ring can hold them all
+     so it never overflows */
+  n_refill = fill->size - (fill->cached_prod - q->rx.cached_cons);
+  if (n_refill < AF_XDP_REFILL_BATCH_SZ)
+    return;
+
+  n_refill = clib_min (n_refill, VLIB_FRAME_SIZE);
+  n_alloc = vlib_buffer_alloc (vm, ptd->buffers, n_refill);
+  if (PREDICT_FALSE (n_alloc == 0))
+    {
+      vlib_error_count (vm, node->node_index,
+			AF_XDP_INPUT_ERROR_BUFFER_ALLOC, 1);
+      return;
+    }
+
+  for (i = 0; i < n_alloc; i++)
+    {
+      vlib_buffer_t *b = vlib_get_buffer (vm, ptd->buffers[i]);
+      descs[(fill->cached_prod + i) & fill->mask] =
+	af_xdp_buffer_umem_addr (ad, b);
+    }
+
+  fill->cached_prod += n_alloc;
+  CLIB_MEMORY_STORE_BARRIER ();
+  *fill->producer = fill->cached_prod;
+
+  /* zero-copy drivers stop taking fill entries once they run dry and
+     want a kick */
+  if (PREDICT_FALSE (*fill->flags & XDP_RING_NEED_WAKEUP))
+    if (recvfrom (q->fd, 0, 0, MSG_DONTWAIT, 0, 0) < 0 &&
+	errno != EAGAIN && errno != EBUSY)
+      vlib_error_count (vm, node->node_index,
+			AF_XDP_INPUT_ERROR_FILL_WAKEUP, 1);
+}
+
+static_always_inline uword
+af_xdp_device_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+			    vlib_frame_t * frame, af_xdp_if_t * ad, u16 qid)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 thread_index = vm->thread_index;
+  af_xdp_queue_t *q = vec_elt_at_index (ad->queues, qid);
+  af_xdp_ring_t *rx = &q->rx;
+  struct xdp_desc *descs = rx->desc;
+  uword n_trace = vlib_get_trace_count (vm, node);
+  u32 next_index = VNET_DEVICE_INPUT_NEXT_ETHERNET_INPUT;
+  u32 n_rx_packets, n_rx_bytes = 0;
+  u32 n_left, n_left_to_next;
+  u32 cons = rx->cached_cons;
+  u32 *to_next;
+
+  n_rx_packets = *rx->producer - cons;
+  if (n_rx_packets == 0)
+    goto refill;
+
+  /* read descriptors only after seeing the producer move */
+  CLIB_MEMORY_BARRIER ();
+  n_rx_packets = clib_min (n_rx_packets, VLIB_FRAME_SIZE);
+  n_left = n_rx_packets;
+
+  if (PREDICT_FALSE (ad->per_interface_next_index != ~0))
+    next_index = ad->per_interface_next_index;
+
+  while (n_left)
+    {
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+      while (n_left && n_left_to_next)
+	{
+	  struct xdp_desc *d = descs + (cons & rx->mask);
+	  vlib_buffer_t *b0 = af_xdp_rx_desc_buffer (ad, d->addr);
+	  u32 bi0 = vlib_get_buffer_index (vm, b0);
+	  u32 next0 = next_index;
+
+	  if (n_left > 2)
+	    {
+	      struct xdp_desc *dn = descs + ((cons + 2) & rx->mask);
+	      vlib_buffer_t *bn = af_xdp_rx_desc_buffer (ad, dn->addr);
+	      vlib_prefetch_buffer_header (bn, STORE);
+	    }
+
+	  b0->current_data = af_xdp_rx_desc_offset (d->addr);
+	  b0->current_length = d->len;
+	  b0->total_length_not_including_first_buffer = 0;
+	  b0->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID;
+	  vnet_buffer (b0)->sw_if_index[VLIB_RX] = ad->sw_if_index;
+	  vnet_buffer (b0)->sw_if_index[VLIB_TX] = (u32) ~ 0;
+	  n_rx_bytes += d->len;
+
+	  VLIB_BUFFER_TRACE_TRAJECTORY_INIT (b0);
+	  if (PREDICT_FALSE (n_trace > 0))
+	    af_xdp_input_trace (vm, node, next0, b0, &n_trace, ad, qid, d);
+
+	  /* redirect if feature path enabled */
+	  vnet_feature_start_device_input_x1 (ad->sw_if_index, &next0, b0);
+
+	  to_next[0] = bi0;
+	  to_next++;
+	  n_left_to_next--;
+	  cons++;
+	  n_left--;
+
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					   n_left_to_next, bi0, next0);
+	}
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  /* descriptors are read, hand the slots back */
+  rx->cached_cons = cons;
+  CLIB_MEMORY_STORE_BARRIER ();
+  *rx->consumer = cons;
+
+  vlib_increment_combined_counter (vnm->interface_main.combined_sw_if_counters
+				   + VNET_INTERFACE_COUNTER_RX, thread_index,
+				   ad->hw_if_index, n_rx_packets, n_rx_bytes);
+  vnet_device_increment_rx_packets (thread_index, n_rx_packets);
+
+refill:
+  af_xdp_device_input_refill (vm, node, ad, q);
+  return n_rx_packets;
+}
+
+uword
+af_xdp_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
+		 vlib_frame_t * frame)
+{
+  u32 n_rx = 0;
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_device_input_runtime_t *rt = (void *) node->runtime_data;
+  vnet_device_and_queue_t *dq;
+
+  foreach_device_and_queue (dq, rt->devices_and_queues)
+  {
+    af_xdp_if_t *ad;
+    ad = vec_elt_at_index (am->interfaces, dq->dev_instance);
+    if (ad->flags & AF_XDP_IF_F_ADMIN_UP)
+      n_rx += af_xdp_device_input_inline (vm, node, frame, ad, dq->queue_id);
+  }
+  return n_rx;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (af_xdp_input_node) = {
+  .function = af_xdp_input_fn,
+  .name = "af-xdp-input",
+  .sibling_of = "device-input",
+  .format_trace = format_af_xdp_input_trace,
+  .type = VLIB_NODE_TYPE_INPUT,
+  .state = VLIB_NODE_STATE_INTERRUPT,
+  .n_errors = AF_XDP_INPUT_N_ERROR,
+  .error_strings = af_xdp_input_error_strings,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,170 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#include <sys/socket.h>
+
+#include <vlib/vlib.h>
+#include <vlib/unix/unix.h>
+#include <vnet/ethernet/ethernet.h>
+#include <vnet/devices/devices.h>
+
+#include <af_xdp/af_xdp.h>
+
+/* Completions come back in the order frames were queued, so buffers are
+   freed from the tx slot after the last one completed. */
+static_always_inline void
+af_xdp_tx_free_completed (vlib_main_t * vm, af_xdp_queue_t * q)
+{
+  af_xdp_ring_t *comp = &q->comp;
+  u32 n_done = *comp->producer - comp->cached_cons;
+  u32 slot, n_free;
+
+  if (n_done == 0)
+    return;
+
+  slot = comp->cached_cons & q->tx.mask;
+  n_free = clib_min (n_done, q->tx.size - slot);
+  vlib_buffer_free (vm, q->tx_buffers + slot, n_free);
+  if (PREDICT_FALSE (n_free < n_done))
+    vlib_buffer_free (vm, q->tx_buffers, n_done - n_free);
+
+  comp->cached_cons += n_done;
+  CLIB_MEMORY_STORE_BARRIER ();
+  *comp->consumer = comp->cached_cons;
+}
+
+/* In copy mode the kernel sends a batch of frames per call and fails
+   with EAGAIN while more are queued, so kick again for as long as it
+   makes progress. */
+static_always_inline void
+af_xdp_tx_kick (vlib_main_t * vm, vlib_node_runtime_t * node,
+		af_xdp_queue_t * q)
+{
+  u32 cons;
+
+  do
+    {
+      cons = *q->tx.consumer;
+      if (sendto (q->fd, 0, 0, MSG_DONTWAIT, 0, 0) >= 0)
+	return;
+    }
+  while (errno == EAGAIN && *q->tx.consumer != cons);
+
+  if (errno != EAGAIN && errno != EBUSY && errno != ENOBUFS &&
+      errno != ENETDOWN)
+    vlib_error_count (vm, node->node_index, AF_XDP_TX_ERROR_SENDTO, 1);
+}
+
+uword
+af_xdp_interface_tx (vlib_main_t * vm, vlib_node_runtime_t * node,
+		     vlib_frame_t * frame)
+{
+  af_xdp_main_t *am = &af_xdp_main;
+  vnet_interface_output_runtime_t *rd = (void *) node->runtime_data;
+  af_xdp_if_t *ad = pool_elt_at_index (am->interfaces, rd->dev_instance);
+  u32 thread_index = vm->thread_index;
+  af_xdp_queue_t *q = vec_elt_at_index (ad->queues,
+					thread_index % vec_len (ad->queues));
+  af_xdp_ring_t *tx = &q->tx;
+  struct xdp_desc *descs = tx->desc;
+  u32 *buffers = vlib_frame_args (frame);
+  u32 n_left = frame->n_vectors;
+  u32 n_free_slots, n_sent = 0;
+  u32 drop[VLIB_FRAME_SIZE], n_drop = 0;
+
+  clib_spinlock_lock_if_init (&q->lockp);
+
+  af_xdp_tx_free_completed (vm, q);
+
+  /* slots are only reused once completed, this also keeps the
+     completion ring from overflowing */
+  n_free_slots = tx->size - (tx->cached_prod - q->comp.cached_cons);
+
+  while (n_left)
+    {
+      u32 bi0 = buffers[0];
+      vlib_buffer_t *b0 = vlib_get_buffer (vm, bi0);
+      struct xdp_desc *d;
+      u32 slot;
+
+      if (n_left > 1)
+	vlib_prefetch_buffer_with_index (vm, buffers[1], LOAD);
+
+      buffers++;
+      n_left--;
+
+      if (PREDICT_FALSE (b0->flags & VLIB_BUFFER_NEXT_PRESENT))
+	{
+	  vlib_error_count (vm, node->node_index, AF_XDP_TX_ERROR_CHAINED, 1);
+	  drop[n_drop++] = bi0;
+	  continue;
+	}
+
+      if (PREDICT_FALSE (b0->buffer_pool_index != ad->umem_pool_index))
+	{
+	  vlib_error_count (vm, node->node_index,
+			    AF_XDP_TX_ERROR_FOREIGN_BUFFER, 1);
+	  drop[n_drop++] = bi0;
+	  continue;
+	}
+
+      if (PREDICT_FALSE (n_sent == n_free_slots))
+	{
+	  vlib_error_count (vm, node->node_index,
+			    AF_XDP_TX_ERROR_NO_FREE_SLOTS, 1);
+	  drop[n_drop++] = bi0;
+	  continue;
+	}
+
+      slot = (tx->cached_prod + n_sent) & tx->mask;
+      d = descs + slot;
+      d->addr = pointer_to_uword (vlib_buffer_get_current (b0)) -
+	ad->umem_start;
+      d->len = b0->current_length;
+      d->options = 0;
+      q->tx_buffers[slot] = bi0;
+      n_sent++;
+    }
+
+  if (n_sent)
+    {
+      tx->cached_prod += n_sent;
+      CLIB_MEMORY_STORE_BARRIER ();
+      *tx->producer = tx->cached_prod;
+
+      /* copy mode only transmits from sendmsg, zero-copy drivers ask
+         for a kick through the ring flags */
+      if (!(ad->flags & AF_XDP_IF_F_ZERO_COPY) ||
+	  (*tx->flags & XDP_RING_NEED_WAKEUP))
+	af_xdp_tx_kick (vm, node, q);
+    }
+
+  clib_spinlock_unlock_if_init (&q->lockp);
+
+  if (PREDICT_FALSE (n_drop))
+    vlib_buffer_free (vm, drop, n_drop);
+
+  return n_sent;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -130,7 +130,8 @@ dpdk_esp_decrypt_node_fn (vlib_main_t * vm,
       while (n_left_from > 0 && n_left_to_next > 0)
 	{
 	  clib_error_t *error;
-	  u32 bi0, sa_index0, seq, iv_size;
+	  u32 bi0, sa_index0, iv_size;
+	  u64 seq;
 	  u8 trunc_size;
 	  vlib_buffer_t *b0;
 	  esp_header_t *esp0;
@@ -203,19 +204,12 @@ dpdk_esp_decrypt_node_fn (vlib_main_t * vm,
 	      last_sa_index = sa_index0;
 	    }
 
+	  seq = esp_replay_seq (sa0, clib_net_to_host_u32 (esp0->seq));
+
 	  /* anti-replay check */
 	  if (sa0->use_anti_replay)
 	    {
-	      int rv = 0;
-
-	      seq = clib_net_to_host_u32 (esp0->seq);
-
-	      if (PREDICT_TRUE(sa0->use_esn))
-		rv = esp_replay_check_esn (sa0, seq);
-	      else
-		rv = esp_replay_check (sa0, seq);
-
-	      if (PREDICT_FALSE (rv))
+	      if (PREDICT_FALSE (esp_replay_check (sa0, seq)))
 		{
 		  clib_warning ("failed anti-replay check");
 		  vlib_node_increment_counter (vm, dpdk_esp_decrypt_node.index,
@@ -295,7 +289,7 @@ dpdk_esp_decrypt_node_fn (vlib_main_t * vm,
 
 	      /* _aad[3] should always be 0 */
               if (PREDICT_FALSE (sa0->use_esn))
-		_aad[2] = clib_host_to_net_u32 (sa0->seq_hi);
+		_aad[2] = clib_host_to_net_u32 (seq >> 32);
 	      else
 		_aad[2] = 0;
             }
@@ -307,8 +301,8 @@ dpdk_esp_decrypt_node_fn (vlib_main_t * vm,
                 {
                   clib_memcpy (priv->icv, digest, trunc_size);
 		  u32 *_digest = (u32 *) digest;
-                  _digest[0] = clib_host_to_net_u32 (sa0->seq_hi);
-		  auth_len += sizeof(sa0->seq_hi);
+                  _digest[0] = clib_host_to_net_u32 (seq >> 32);
+		  auth_len += sizeof(u32);
 
                   digest = priv->icv;
 		  digest_paddr =
@@ -468,12 +462,14 @@ dpdk_esp_decrypt_post_node_fn (vlib_main_t * vm,
 
 	  if (sa0->use_anti_replay)
 	    {
-	      u32 seq;
-	      seq = clib_host_to_net_u32(esp0->seq);
-	      if (PREDICT_TRUE(sa0->use_esn))
-		esp_replay_advance_esn(sa0, seq);
-	      else
-		esp_replay_advance(sa0, seq);
+	      u64 seq;
+	      seq = esp_replay_seq (sa0, clib_host_to_net_u32(esp0->seq));
+	      if (PREDICT_FALSE (esp_replay_advance (sa0, seq)))
+		{
+		  vlib_node_increment_counter (vm, dpdk_esp_decrypt_node.index,
+					       ESP_DECRYPT_ERROR_REPLAY, 1);
+		  goto trace;
+		}
 	    }
 
 	  /* FIXME ip header */
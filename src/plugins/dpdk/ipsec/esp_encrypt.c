@@ -162,6 +162,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 	  struct rte_mbuf *mb0 = 0;
 	  struct rte_crypto_op *op;
 	  u16 res_idx;
+	  u64 seq;
 
 	  bi0 = from[0];
 	  from += 1;
@@ -235,7 +236,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 	      last_sa_index = sa_index0;
 	    }
 
-	  if (PREDICT_FALSE (esp_seq_advance (sa0)))
+	  if (PREDICT_FALSE (esp_seq_advance (sa0, thread_idx, &seq)))
 	    {
 	      clib_warning ("sequence number counter has cycled SPI %u",
 			    sa0->spi);
@@ -259,7 +260,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 
 	  dpdk_gcm_cnt_blk *icb = &priv->cb;
 
-	  crypto_set_icb (icb, sa0->salt, sa0->seq, sa0->seq_hi);
+	  crypto_set_icb (icb, sa0->salt, seq, seq >> 32);
 
 	  is_ipv6 = (ih0->ip4.ip_version_and_header_length & 0xF0) == 0x60;
 
@@ -299,7 +300,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 		    sa0->tunnel_dst_addr.ip4.as_u32;
 		  esp0 = &oh0->esp;
 		  oh0->esp.spi = clib_host_to_net_u32 (sa0->spi);
-		  oh0->esp.seq = clib_host_to_net_u32 (sa0->seq);
+		  oh0->esp.seq = clib_host_to_net_u32 (seq);
 		}
 	      else if (is_ipv6 && sa0->is_tunnel_ip6)	/* ip6inip6 */
 		{
@@ -329,7 +330,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 		    sa0->tunnel_dst_addr.ip6.as_u64[1];
 		  esp0 = &oh6_0->esp;
 		  oh6_0->esp.spi = clib_host_to_net_u32 (sa0->spi);
-		  oh6_0->esp.seq = clib_host_to_net_u32 (sa0->seq);
+		  oh6_0->esp.seq = clib_host_to_net_u32 (seq);
 		}
 	      else		/* unsupported ip4inip6, ip6inip4 */
 		{
@@ -373,7 +374,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 		  esp0 = (esp_header_t *) (((u8 *) oh0) + ip_size);
 		}
 	      esp0->spi = clib_host_to_net_u32 (sa0->spi);
-	      esp0->seq = clib_host_to_net_u32 (sa0->seq);
+	      esp0->seq = clib_host_to_net_u32 (seq);
 	    }
 
 	  ASSERT (is_pow2 (cipher_alg->boundary));
@@ -429,8 +430,8 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 	  else			/* CTR/GCM */
 	    {
 	      u32 *esp_iv = (u32 *) (esp0 + 1);
-	      esp_iv[0] = sa0->seq;
-	      esp_iv[1] = sa0->seq_hi;
+	      esp_iv[0] = seq;
+	      esp_iv[1] = seq >> 32;
 
 	      cipher_off = sizeof (esp_header_t) + iv_size;
 	      cipher_len = pad_payload_len;
@@ -440,11 +441,11 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 	    {
 	      aad = (u32 *) priv->aad;
 	      aad[0] = clib_host_to_net_u32 (sa0->spi);
-	      aad[1] = clib_host_to_net_u32 (sa0->seq);
+	      aad[1] = clib_host_to_net_u32 (seq);
 
 	      /* aad[3] should always be 0 */
 	      if (PREDICT_FALSE (sa0->use_esn))
-		aad[2] = clib_host_to_net_u32 (sa0->seq_hi);
+		aad[2] = clib_host_to_net_u32 (seq >> 32);
 	      else
 		aad[2] = 0;
 	    }
@@ -455,7 +456,7 @@ dpdk_esp_encrypt_node_fn (vlib_main_t * vm,
 	      if (sa0->use_esn)
 		{
 		  u32 *_digest = (u32 *) digest;
-		  _digest[0] = clib_host_to_net_u32 (sa0->seq_hi);
+		  _digest[0] = clib_host_to_net_u32 (seq >> 32);
 		  auth_len += 4;
 		}
 	    }
@@ -122,6 +122,7 @@ u8 *format_kp_main (u8 * s, va_list * args)
     if (h) {
       s = format(s, "core %d\n", thread_index);
       s = format(s, "  timeout: %ds\n", h->timeout);
+      s = format(s, "  buckets: %u\n", kp_hash_nbuckets(h));
       s = format(s, "  usage: %d / %d\n", kp_hash_elts(h, kp_hash_time_now(vlib_get_main())),  kp_hash_size(h));
     }
   }
@@ -418,15 +419,19 @@ finished:
   vec_free(old_table);
 }
 
-int kp_conf(u32 per_cpu_sticky_buckets, u32 flow_timeout)
+int kp_conf(u32 per_cpu_sticky_buckets, u32 per_cpu_sticky_buckets_max,
+            u32 flow_timeout)
 {
   kp_main_t *kpm = &kp_main;
 
-  if (!is_pow2(per_cpu_sticky_buckets))
+  if (!is_pow2(per_cpu_sticky_buckets) ||
+      !is_pow2(per_cpu_sticky_buckets_max) ||
+      per_cpu_sticky_buckets_max < per_cpu_sticky_buckets)
     return VNET_API_ERROR_INVALID_MEMORY_SIZE;
 
   kp_get_writer_lock(); //Not exactly necessary but just a reminder that it exists for my future self
   kpm->per_cpu_sticky_buckets = per_cpu_sticky_buckets;
+  kpm->per_cpu_sticky_buckets_max = per_cpu_sticky_buckets_max;
   kpm->flow_timeout = flow_timeout;
   kp_put_writer_lock();
   return 0;
@@ -945,6 +950,7 @@ kp_init (vlib_main_t * vm)
   kpm->writer_lock = clib_mem_alloc_aligned (CLIB_CACHE_LINE_BYTES,  CLIB_CACHE_LINE_BYTES);
   kpm->writer_lock[0] = 0;
   kpm->per_cpu_sticky_buckets = KP_DEFAULT_PER_CPU_STICKY_BUCKETS;
+  kpm->per_cpu_sticky_buckets_max = KP_DEFAULT_PER_CPU_STICKY_BUCKETS_MAX;
   kpm->flow_timeout = KP_DEFAULT_FLOW_TIMEOUT;
   kpm->dpo_nat4_type = dpo_register_new_type(&kp_vft, kp_dpo_nat4_nodes);
   kpm->dpo_nat6_type = dpo_register_new_type(&kp_vft, kp_dpo_nat6_nodes);
@@ -40,6 +40,7 @@
 #include <kubeproxy/kphash.h>
 
 #define KP_DEFAULT_PER_CPU_STICKY_BUCKETS 1 << 10
+#define KP_DEFAULT_PER_CPU_STICKY_BUCKETS_MAX 1 << 20
 #define KP_DEFAULT_FLOW_TIMEOUT 40
 #define KP_MAPPING_BUCKETS  1024
 #define KP_MAPPING_MEMORY_SIZE  64<<20
@@ -347,6 +348,17 @@ typedef struct {
    */
   kp_hash_t *sticky_ht;
 
+  /**
+   * per_cpu_sticky_buckets the table was last sized for.
+   */
+  u32 sticky_buckets_conf;
+
+  /**
+   * New flows which could not be stored in the table
+   * during the second sticky_full_time.
+   */
+  u32 sticky_full;
+  u32 sticky_full_time;
 } kp_per_cpu_t;
 
 typedef struct {
@@ -385,10 +397,16 @@ typedef struct {
   u32 ip_lookup_next_index[KP_VIP_N_TYPES];
 
   /**
-   * Number of buckets in the per-cpu sticky hash table.
+   * Initial number of buckets in the per-cpu sticky hash table.
    */
   u32 per_cpu_sticky_buckets;
 
+  /**
+   * Size up to which a per-cpu sticky hash table grows when it runs
+   * out of room for new flows.
+   */
+  u32 per_cpu_sticky_buckets_max;
+
   /**
    * Flow timeout in seconds.
    */
@@ -446,9 +464,11 @@ extern vlib_node_registration_t kp_nat4_in2out_node;
 
 /**
  * Fix global kube-proxy parameters.
+ * @param sticky_buckets Initial per-cpu sticky table size
+ * @param sticky_buckets_max Size up to which sticky tables may grow
  * @return 0 on success. VNET_KP_ERR_XXX on error
  */
-int kp_conf(u32 sticky_buckets, u32 flow_timeout);
+int kp_conf(u32 sticky_buckets, u32 sticky_buckets_max, u32 flow_timeout);
 
 int kp_vip_add(ip46_address_t *prefix, u8 plen, kp_vip_type_t type,
 	       u32 new_length, u32 *vip_index,
@@ -464,6 +484,10 @@ int kp_vip_del_pods(u32 vip_index, ip46_address_t *addresses, u32 n);
 
 u32 kp_hash_time_now(vlib_main_t * vm);
 
+kp_hash_t *kp_get_sticky_table(u32 thread_index, u32 time_now);
+kp_hash_t *kp_sticky_table_resize(u32 thread_index, u32 buckets,
+                                  u32 time_now);
+
 void kp_garbage_collection();
 
 int kp_nat4_interface_add_del (u32 sw_if_index, int is_del);
@@ -77,7 +77,10 @@ vl_api_kp_conf_t_handler
   vl_api_kp_conf_reply_t * rmp;
   int rv = 0;
 
+  //The API does not set the maximum, it never gets below the requested size
   rv = kp_conf(mp->sticky_buckets_per_core,
+               clib_max(kpm->per_cpu_sticky_buckets_max,
+                        mp->sticky_buckets_per_core),
                mp->flow_timeout);
 
  REPLY_MACRO (VL_API_KP_CONF_REPLY);
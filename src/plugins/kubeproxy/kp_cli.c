@@ -190,6 +190,7 @@ kp_conf_command_fn (vlib_main_t * vm,
   unformat_input_t _line_input, *line_input = &_line_input;
   u32 per_cpu_sticky_buckets = kpm->per_cpu_sticky_buckets;
   u32 per_cpu_sticky_buckets_log2 = 0;
+  u32 per_cpu_sticky_buckets_max = kpm->per_cpu_sticky_buckets_max;
   u32 flow_timeout = kpm->flow_timeout;
   int ret;
   clib_error_t *error = 0;
@@ -205,7 +206,9 @@ kp_conf_command_fn (vlib_main_t * vm,
       if (per_cpu_sticky_buckets_log2 >= 32)
         return clib_error_return (0, "buckets-log2 value is too high");
       per_cpu_sticky_buckets = 1 << per_cpu_sticky_buckets_log2;
-    } else if (unformat(line_input, "timeout %d", &flow_timeout))
+    } else if (unformat(line_input, "max-buckets %d", &per_cpu_sticky_buckets_max))
+      ;
+    else if (unformat(line_input, "timeout %d", &flow_timeout))
       ;
     else {
       error = clib_error_return (0, "parse error: '%U'",
@@ -216,7 +219,8 @@ kp_conf_command_fn (vlib_main_t * vm,
 
   kp_garbage_collection();
 
-  if ((ret = kp_conf(per_cpu_sticky_buckets, flow_timeout))) {
+  if ((ret = kp_conf(per_cpu_sticky_buckets, per_cpu_sticky_buckets_max,
+                     flow_timeout))) {
     error = clib_error_return (0, "kp_conf error %d", ret);
     goto done;
   }
@@ -230,7 +234,7 @@ done:
 VLIB_CLI_COMMAND (kp_conf_command, static) =
 {
   .path = "kube-proxy conf",
-  .short_help = "kube-proxy conf [buckets <n>] [timeout <s>]",
+  .short_help = "kube-proxy conf [buckets <n>] [max-buckets <n>] [timeout <s>]",
   .function = kp_conf_command_fn,
 };
 
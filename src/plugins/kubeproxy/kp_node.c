@@ -84,32 +84,82 @@ format_kp_nat_trace (u8 * s, va_list * args)
   return s;
 }
 
-kp_hash_t *kp_get_sticky_table(u32 thread_index)
+/**
+ * Rebuild the per-thread session table, which keeps the pod each service
+ * flow was sent to, with the given number of buckets. Live sessions are
+ * rehashed and stay on their pod. Expired sessions, and those that do not
+ * fit in their new bucket, are dropped and give their pod reference back,
+ * so a pod being removed is freed once its last session is gone. Only the
+ * thread owning the table may call this.
+ */
+kp_hash_t *kp_sticky_table_resize(u32 thread_index, u32 buckets,
+                                  u32 time_now)
 {
   kp_main_t *kpm = &kp_main;
-  kp_hash_t *sticky_ht = kpm->per_cpu[thread_index].sticky_ht;
-  //Check if size changed
-  if (PREDICT_FALSE(sticky_ht && (kpm->per_cpu_sticky_buckets != kp_hash_nbuckets(sticky_ht))))
-    {
-      //Dereference everything in there
-      kp_hash_bucket_t *b;
-      u32 i;
-      kp_hash_foreach_entry(sticky_ht, b, i) {
-	vlib_refcount_add(&kpm->pod_refcount, thread_index, b->value[i], -1);
-	vlib_refcount_add(&kpm->pod_refcount, thread_index, 0, 1);
+  kp_hash_t *old = kpm->per_cpu[thread_index].sticky_ht;
+  kp_hash_t *new;
+  kp_hash_bucket_t *b, *nb;
+  u32 i, j;
+
+  new = kp_hash_alloc(buckets, kpm->flow_timeout);
+  if (PREDICT_FALSE(new == NULL))
+    return old;
+
+  if (old) {
+    kp_hash_foreach_entry(old, b, i) {
+      if (!clib_u32_loop_gt(time_now, b->timeout[i])) {
+        nb = &new->buckets[b->hash[i] & new->buckets_mask];
+        for (j = 0; j < KPHASH_ENTRY_PER_BUCKET; j++)
+          if (clib_u32_loop_gt(time_now, nb->timeout[j]))
+            break;
+
+        if (j < KPHASH_ENTRY_PER_BUCKET) {
+          //The POD reference moves along with the entry
+          nb->hash[j] = b->hash[i];
+          nb->timeout[j] = b->timeout[i];
+          nb->vip[j] = b->vip[i];
+          nb->value[j] = b->value[i];
+          continue;
+        }
       }
 
-      kp_hash_free(sticky_ht);
-      sticky_ht = NULL;
+      vlib_refcount_add(&kpm->pod_refcount, thread_index, b->value[i], -1);
+      vlib_refcount_add(&kpm->pod_refcount, thread_index, 0, 1);
     }
-
-  //Create if necessary
-  if (PREDICT_FALSE(sticky_ht == NULL)) {
-    kpm->per_cpu[thread_index].sticky_ht = kp_hash_alloc(kpm->per_cpu_sticky_buckets, kpm->flow_timeout);
-    sticky_ht = kpm->per_cpu[thread_index].sticky_ht;
-    clib_warning("Regenerated sticky table %p", sticky_ht);
+    kp_hash_free(old);
   }
 
+  kpm->per_cpu[thread_index].sticky_ht = new;
+  return new;
+}
+
+kp_hash_t *kp_get_sticky_table(u32 thread_index, u32 time_now)
+{
+  kp_main_t *kpm = &kp_main;
+  kp_per_cpu_t *per_cpu = &kpm->per_cpu[thread_index];
+  kp_hash_t *sticky_ht = per_cpu->sticky_ht;
+  u32 conf = kpm->per_cpu_sticky_buckets;
+
+  //Create the table on first use, resize it when 'kube-proxy conf'
+  //changed the number of buckets
+  if (PREDICT_FALSE(sticky_ht == NULL ||
+                    per_cpu->sticky_buckets_conf != conf))
+    {
+      u32 buckets = conf;
+
+      //A session table which grew because it was full keeps its size when
+      //the configured size goes up. A smaller configured size is applied,
+      //the sessions which do not fit are dropped.
+      if (sticky_ht && conf > per_cpu->sticky_buckets_conf)
+        buckets = clib_max(buckets, kp_hash_nbuckets(sticky_ht));
+
+      if (sticky_ht == NULL || buckets != kp_hash_nbuckets(sticky_ht)) {
+        sticky_ht = kp_sticky_table_resize(thread_index, buckets, time_now);
+        clib_warning("Regenerated sticky table %p", sticky_ht);
+      }
+      per_cpu->sticky_buckets_conf = conf;
+    }
+
   ASSERT(sticky_ht);
 
   //Update timeout
@@ -117,6 +167,34 @@ kp_hash_t *kp_get_sticky_table(u32 thread_index)
   return sticky_ht;
 }
 
+/**
+ * Account the new service flows of a frame that found no free entry in the
+ * session table. Their packets still reached a pod, but the next packets
+ * of such a flow may be sent to another pod of the service. When this
+ * happens to more flows than 1/64th of the buckets within one second the
+ * table is doubled, up to the 'kube-proxy conf max-buckets' limit.
+ */
+static void
+kp_sticky_table_full(u32 thread_index, kp_hash_t *sticky_ht,
+                     u32 n_untracked, u32 time_now)
+{
+  kp_main_t *kpm = &kp_main;
+  kp_per_cpu_t *per_cpu = &kpm->per_cpu[thread_index];
+  u32 nbuckets = kp_hash_nbuckets(sticky_ht);
+
+  if (per_cpu->sticky_full_time != time_now) {
+    per_cpu->sticky_full_time = time_now;
+    per_cpu->sticky_full = 0;
+  }
+  per_cpu->sticky_full += n_untracked;
+
+  if (per_cpu->sticky_full > (nbuckets >> 6) &&
+      nbuckets < kpm->per_cpu_sticky_buckets_max) {
+    kp_sticky_table_resize(thread_index, nbuckets << 1, time_now);
+    per_cpu->sticky_full = 0;
+  }
+}
+
 u64
 kp_node_get_other_ports4(ip4_header_t *ip40)
 {
@@ -169,6 +247,25 @@ kp_node_get_hash(vlib_buffer_t *p, u8 is_input_v4)
   return hash;
 }
 
+/**
+ * Number of packets whose flow hash is computed, and sticky table bucket
+ * prefetched, in one go ahead of their lookup. The buffers of the
+ * following batch are prefetched at the same time.
+ */
+#define KP_NODE_HASH_BATCH 8
+
+static_always_inline void
+kp_node_prefetch_buffers(vlib_main_t *vm, u32 *bi, u32 n)
+{
+  while (n--)
+    {
+      vlib_buffer_t *p = vlib_get_buffer (vm, bi[n]);
+      /* prefetch packet header and data */
+      vlib_prefetch_buffer_header(p, STORE);
+      CLIB_PREFETCH (vlib_buffer_get_current(p), 64, STORE);
+    }
+}
+
 static_always_inline uword
 kp_node_fn (vlib_main_t * vm,
          vlib_node_runtime_t * node, vlib_frame_t * frame,
@@ -179,15 +276,17 @@ kp_node_fn (vlib_main_t * vm,
   u32 n_left_from, *from, next_index, *to_next, n_left_to_next;
   u32 thread_index = vlib_get_thread_index();
   u32 kp_time = kp_hash_time_now(vm);
+  u32 n_untracked = 0;
+  u32 hashes[VLIB_FRAME_SIZE];
+  u32 n_hashed = 0;
 
-  kp_hash_t *sticky_ht = kp_get_sticky_table(thread_index);
+  kp_hash_t *sticky_ht = kp_get_sticky_table(thread_index, kp_time);
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
   next_index = node->cached_next_index;
 
-  u32 nexthash0 = 0;
-  if (PREDICT_TRUE(n_left_from > 0))
-    nexthash0 = kp_node_get_hash(vlib_get_buffer (vm, from[0]), is_input_v4);
+  kp_node_prefetch_buffers(vm, from,
+                           clib_min(n_left_from, KP_NODE_HASH_BATCH));
 
   while (n_left_from > 0)
   {
@@ -200,27 +299,32 @@ kp_node_fn (vlib_main_t * vm,
       u32 podindex0;
       u32 available_index0;
       u8 counter = 0;
-      u32 hash0 = nexthash0;
+      u32 hash0;
+      u32 i0 = frame->n_vectors - n_left_from;
+
+      if (PREDICT_FALSE(i0 == n_hashed))
+	{
+	  //Hash the next batch and prefetch the buckets
+	  u32 j, n = clib_min(n_left_from, KP_NODE_HASH_BATCH);
+	  for (j = 0; j < n; j++)
+	    {
+	      hashes[i0 + j] = kp_node_get_hash(vlib_get_buffer (vm, from[j]),
+						is_input_v4);
+	      kp_hash_prefetch_bucket(sticky_ht, hashes[i0 + j]);
+	    }
+	  n_hashed += n;
+	  kp_node_prefetch_buffers(vm, from + n,
+				   clib_min(n_left_from - n, KP_NODE_HASH_BATCH));
+	}
+      hash0 = hashes[i0];
 
       if (PREDICT_TRUE(n_left_from > 1))
 	{
 	  vlib_buffer_t *p1 = vlib_get_buffer (vm, from[1]);
-	  //Compute next hash and prefetch bucket
-	  nexthash0 = kp_node_get_hash(p1, is_input_v4);
-	  kp_hash_prefetch_bucket(sticky_ht, nexthash0);
 	  //Prefetch for encap, next
 	  CLIB_PREFETCH (vlib_buffer_get_current(p1) - 64, 64, STORE);
 	}
 
-      if (PREDICT_TRUE(n_left_from > 2))
-	{
-	  vlib_buffer_t *p2;
-	  p2 = vlib_get_buffer(vm, from[2]);
-	  /* prefetch packet header and data */
-	  vlib_prefetch_buffer_header(p2, STORE);
-	  CLIB_PREFETCH (vlib_buffer_get_current(p2), 64, STORE);
-	}
-
       pi0 = to_next[0] = from[0];
       from += 1;
       n_left_from -= 1;
@@ -264,6 +368,7 @@ kp_node_fn (vlib_main_t * vm,
 	  //Could not store new entry in the table
 	  podindex0 = vip0->new_flow_table[hash0 & vip0->new_flow_table_mask].pod_index;
 	  counter = KP_VIP_COUNTER_UNTRACKED_PACKET;
+	  n_untracked++;
 	}
 
       vlib_increment_simple_counter(&kpm->vip_counters[counter],
@@ -341,6 +446,9 @@ kp_node_fn (vlib_main_t * vm,
     vlib_put_next_frame (vm, node, next_index, n_left_to_next);
   }
 
+  if (PREDICT_FALSE(n_untracked))
+    kp_sticky_table_full(thread_index, sticky_ht, n_untracked, kp_time);
+
   return frame->n_vectors;
 }
 
@@ -65,7 +65,7 @@ typedef struct {
 } kp_hash_t;
 
 #define kp_hash_nbuckets(h) (((h)->buckets_mask) + 1)
-#define kp_hash_size(h) ((h)->buckets_mask + KPHASH_ENTRY_PER_BUCKET)
+#define kp_hash_size(h) (kp_hash_nbuckets(h) * KPHASH_ENTRY_PER_BUCKET)
 
 #define kp_hash_foreach_bucket(h, bucket) \
   for (bucket = (h)->buckets; \
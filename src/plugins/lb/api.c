@@ -79,9 +79,12 @@ vl_api_lb_conf_t_handler
   vl_api_lb_conf_reply_t * rmp;
   int rv = 0;
 
+  //The API does not set the maximum, it never gets below the requested size
   rv = lb_conf((ip4_address_t *)&mp->ip4_src_address,
                (ip6_address_t *)mp->ip6_src_address,
                mp->sticky_buckets_per_core,
+               clib_max(lbm->per_cpu_sticky_buckets_max,
+                        mp->sticky_buckets_per_core),
                mp->flow_timeout);
 
  REPLY_MACRO (VL_API_LB_CONF_REPLY);
@@ -117,14 +120,20 @@ vl_api_lb_add_del_vip_t_handler
   } else {
     u32 vip_index;
     lb_vip_type_t type;
-    if (ip46_prefix_is_ip4(&prefix, mp->prefix_length)) {
+    u8 is_ip4 = ip46_prefix_is_ip4(&prefix, mp->prefix_length);
+    if (mp->encap == 1) {
+      type = is_ip4?LB_VIP_TYPE_IP4_L2DSR:LB_VIP_TYPE_IP6_L2DSR;
+    } else if (mp->encap == 2) {
+      type = is_ip4?LB_VIP_TYPE_IP4_NAT4:LB_VIP_TYPE_IP6_NAT6;
+    } else if (is_ip4) {
       type = mp->is_gre4?LB_VIP_TYPE_IP4_GRE4:LB_VIP_TYPE_IP4_GRE6;
     } else {
       type = mp->is_gre4?LB_VIP_TYPE_IP6_GRE4:LB_VIP_TYPE_IP6_GRE6;
     }
 
     rv = lb_vip_add(&prefix, mp->prefix_length, type,
-                    mp->new_flows_table_length, &vip_index);
+                    mp->new_flows_table_length, mp->sticky_flows,
+                    &vip_index);
   }
  REPLY_MACRO (VL_API_LB_CONF_REPLY);
 }
@@ -136,8 +145,11 @@ static void *vl_api_lb_add_del_vip_t_print
   s = format (0, "SCRIPT: lb_add_del_vip ");
   s = format (s, "%U ", format_ip46_prefix,
               (ip46_address_t *)mp->ip_prefix, mp->prefix_length, IP46_TYPE_ANY);
-  s = format (s, "%s ", mp->is_gre4?"gre4":"gre6");
+  s = format (s, "%s ", (mp->encap == 1)?"l2dsr":
+                        (mp->encap == 2)?"nat":
+                        mp->is_gre4?"gre4":"gre6");
   s = format (s, "%u ", mp->new_flows_table_length);
+  s = format (s, "%u ", mp->sticky_flows);
   s = format (s, "%s ", mp->is_del?"del":"add");
   FINISH;
 }
@@ -157,7 +169,8 @@ vl_api_lb_add_del_as_t_handler
   if (mp->is_del)
     rv = lb_vip_del_ass(vip_index, (ip46_address_t *)mp->as_address, 1);
   else
-    rv = lb_vip_add_ass(vip_index, (ip46_address_t *)mp->as_address, 1);
+    rv = lb_vip_add_ass(vip_index, (ip46_address_t *)mp->as_address, 1,
+                        LB_DEFAULT_AS_WEIGHT);
 
 done:
  REPLY_MACRO (VL_API_LB_CONF_REPLY);
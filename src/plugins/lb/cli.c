@@ -24,9 +24,11 @@ lb_vip_command_fn (vlib_main_t * vm,
   ip46_address_t prefix;
   u8 plen;
   u32 new_len = 1024;
+  u32 flows = 0;
   u8 del = 0;
   int ret;
   u32 gre4 = 0;
+  u8 l2dsr = 0, nat = 0;
   lb_vip_type_t type;
   clib_error_t *error = 0;
 
@@ -45,10 +47,16 @@ lb_vip_command_fn (vlib_main_t * vm,
       ;
     else if (unformat(line_input, "del"))
       del = 1;
+    else if (unformat(line_input, "flows %d", &flows))
+      ;
     else if (unformat(line_input, "encap gre4"))
       gre4 = 1;
     else if (unformat(line_input, "encap gre6"))
       gre4 = 0;
+    else if (unformat(line_input, "encap l2dsr"))
+      l2dsr = 1;
+    else if (unformat(line_input, "encap nat"))
+      nat = 1;
     else {
       error = clib_error_return (0, "parse error: '%U'",
                                 format_unformat_error, line_input);
@@ -59,15 +67,19 @@ lb_vip_command_fn (vlib_main_t * vm,
 
   if (ip46_prefix_is_ip4(&prefix, plen)) {
     type = (gre4)?LB_VIP_TYPE_IP4_GRE4:LB_VIP_TYPE_IP4_GRE6;
+    type = (l2dsr)?LB_VIP_TYPE_IP4_L2DSR:type;
+    type = (nat)?LB_VIP_TYPE_IP4_NAT4:type;
   } else {
     type = (gre4)?LB_VIP_TYPE_IP6_GRE4:LB_VIP_TYPE_IP6_GRE6;
+    type = (l2dsr)?LB_VIP_TYPE_IP6_L2DSR:type;
+    type = (nat)?LB_VIP_TYPE_IP6_NAT6:type;
   }
 
   lb_garbage_collection();
 
   u32 index;
   if (!del) {
-    if ((ret = lb_vip_add(&prefix, plen, type, new_len, &index))) {
+    if ((ret = lb_vip_add(&prefix, plen, type, new_len, flows, &index))) {
       error = clib_error_return (0, "lb_vip_add error %d", ret);
       goto done;
     } else {
@@ -92,7 +104,8 @@ done:
 VLIB_CLI_COMMAND (lb_vip_command, static) =
 {
   .path = "lb vip",
-  .short_help = "lb vip <prefix> [encap (gre6|gre4)] [new_len <n>] [del]",
+  .short_help = "lb vip <prefix> [encap (gre6|gre4|l2dsr|nat)] [new_len <n>] "
+                "[flows <n>] [del]",
   .function = lb_vip_command_fn,
 };
 
@@ -106,6 +119,8 @@ lb_as_command_fn (vlib_main_t * vm,
   ip46_address_t *as_array = 0;
   u32 vip_index;
   u8 del = 0;
+  u32 weight = ~0;
+  u32 drain = ~0;
   int ret;
   clib_error_t *error = 0;
 
@@ -129,6 +144,15 @@ lb_as_command_fn (vlib_main_t * vm,
       vec_add1(as_array, as_addr);
     } else if (unformat(line_input, "del")) {
       del = 1;
+    } else if (unformat(line_input, "weight %u", &weight)) {
+      if (weight > 0xff) {
+        error = clib_error_return (0, "weight must be at most 255");
+        goto done;
+      }
+    } else if (unformat(line_input, "undrain")) {
+      drain = 0;
+    } else if (unformat(line_input, "drain")) {
+      drain = 1;
     } else {
       error = clib_error_return (0, "parse error: '%U'",
                                  format_unformat_error, line_input);
@@ -149,8 +173,20 @@ lb_as_command_fn (vlib_main_t * vm,
       error = clib_error_return (0, "lb_vip_del_ass error %d", ret);
       goto done;
     }
+  } else if (drain != ~0) {
+    if ((ret = lb_vip_set_ass(vip_index, as_array, vec_len(as_array),
+                              weight, drain))) {
+      error = clib_error_return (0, "lb_vip_set_ass error %d", ret);
+      goto done;
+    }
   } else {
-    if ((ret = lb_vip_add_ass(vip_index, as_array, vec_len(as_array)))) {
+    ret = lb_vip_add_ass(vip_index, as_array, vec_len(as_array),
+                         (weight == ~0)?LB_DEFAULT_AS_WEIGHT:weight);
+    /* Changing the weight of existing ASs */
+    if (ret == VNET_API_ERROR_VALUE_EXIST && weight != ~0)
+      ret = lb_vip_set_ass(vip_index, as_array, vec_len(as_array),
+                           weight, ~0);
+    if (ret) {
       error = clib_error_return (0, "lb_vip_add_ass error %d", ret);
       goto done;
     }
@@ -166,7 +202,8 @@ done:
 VLIB_CLI_COMMAND (lb_as_command, static) =
 {
   .path = "lb as",
-  .short_help = "lb as <vip-prefix> [<address> [<address> [...]]] [del]",
+  .short_help = "lb as <vip-prefix> [<address> [<address> [...]]] "
+                "[weight <n>] [drain|undrain] [del]",
   .function = lb_as_command_fn,
 };
 
@@ -180,6 +217,7 @@ lb_conf_command_fn (vlib_main_t * vm,
   ip6_address_t ip6 = lbm->ip6_src_address;
   u32 per_cpu_sticky_buckets = lbm->per_cpu_sticky_buckets;
   u32 per_cpu_sticky_buckets_log2 = 0;
+  u32 per_cpu_sticky_buckets_max = lbm->per_cpu_sticky_buckets_max;
   u32 flow_timeout = lbm->flow_timeout;
   int ret;
   clib_error_t *error = 0;
@@ -199,7 +237,9 @@ lb_conf_command_fn (vlib_main_t * vm,
       if (per_cpu_sticky_buckets_log2 >= 32)
         return clib_error_return (0, "buckets-log2 value is too high");
       per_cpu_sticky_buckets = 1 << per_cpu_sticky_buckets_log2;
-    } else if (unformat(line_input, "timeout %d", &flow_timeout))
+    } else if (unformat(line_input, "max-buckets %d", &per_cpu_sticky_buckets_max))
+      ;
+    else if (unformat(line_input, "timeout %d", &flow_timeout))
       ;
     else {
       error = clib_error_return (0, "parse error: '%U'",
@@ -210,7 +250,8 @@ lb_conf_command_fn (vlib_main_t * vm,
 
   lb_garbage_collection();
 
-  if ((ret = lb_conf(&ip4, &ip6, per_cpu_sticky_buckets, flow_timeout))) {
+  if ((ret = lb_conf(&ip4, &ip6, per_cpu_sticky_buckets,
+                     per_cpu_sticky_buckets_max, flow_timeout))) {
     error = clib_error_return (0, "lb_conf error %d", ret);
     goto done;
   }
@@ -224,10 +265,69 @@ done:
 VLIB_CLI_COMMAND (lb_conf_command, static) =
 {
   .path = "lb conf",
-  .short_help = "lb conf [ip4-src-address <addr>] [ip6-src-address <addr>] [buckets <n>] [timeout <s>]",
+  .short_help = "lb conf [ip4-src-address <addr>] [ip6-src-address <addr>] [buckets <n>] [max-buckets <n>] [timeout <s>]",
   .function = lb_conf_command_fn,
 };
 
+static clib_error_t *
+lb_set_interface_nat_command_fn (vlib_main_t * vm,
+              unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  vnet_main_t *vnm = vnet_get_main();
+  u32 *sw_if_indexes = 0, *sw_if_index;
+  u32 sw_if_index0;
+  u8 is_ip4 = 1;
+  int is_enable = 1;
+  int ret;
+  clib_error_t *error = 0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+  {
+    if (unformat(line_input, "nat4"))
+      is_ip4 = 1;
+    else if (unformat(line_input, "nat6"))
+      is_ip4 = 0;
+    else if (unformat(line_input, "in %U", unformat_vnet_sw_interface,
+                      vnm, &sw_if_index0))
+      vec_add1(sw_if_indexes, sw_if_index0);
+    else if (unformat(line_input, "del"))
+      is_enable = 0;
+    else {
+      error = clib_error_return (0, "parse error: '%U'",
+                                 format_unformat_error, line_input);
+      goto done;
+    }
+  }
+
+  vec_foreach(sw_if_index, sw_if_indexes) {
+    if ((ret = lb_nat_enable_disable(*sw_if_index, is_ip4, is_enable))) {
+      error = clib_error_return (0, "lb_nat_enable_disable error %d", ret);
+      goto done;
+    }
+  }
+
+done:
+  unformat_free (line_input);
+  vec_free(sw_if_indexes);
+
+  return error;
+}
+
+/*
+ * Translate back the traffic of the ASs of NAT VIPs
+ * received on the given interfaces.
+ */
+VLIB_CLI_COMMAND (lb_set_interface_nat_command, static) =
+{
+  .path = "lb set interface",
+  .short_help = "lb set interface (nat4|nat6) in <intfc> [del]",
+  .function = lb_set_interface_nat_command_fn,
+};
+
 static clib_error_t *
 lb_show_command_fn (vlib_main_t * vm,
               unformat_input_t * input, vlib_cli_command_t * cmd)
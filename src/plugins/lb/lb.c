@@ -48,6 +48,22 @@ const static char* const * const lb_dpo_gre6_nodes[DPO_PROTO_NUM] =
 	[DPO_PROTO_IP6]  = lb_dpo_gre6_ip6,
     };
 
+const static char * const lb_dpo_l2dsr_ip4[] = { "lb4-l2dsr" , NULL };
+const static char * const lb_dpo_l2dsr_ip6[] = { "lb6-l2dsr" , NULL };
+const static char* const * const lb_dpo_l2dsr_nodes[DPO_PROTO_NUM] =
+    {
+	[DPO_PROTO_IP4]  = lb_dpo_l2dsr_ip4,
+	[DPO_PROTO_IP6]  = lb_dpo_l2dsr_ip6,
+    };
+
+const static char * const lb_dpo_nat_ip4[] = { "lb4-nat4" , NULL };
+const static char * const lb_dpo_nat_ip6[] = { "lb6-nat6" , NULL };
+const static char* const * const lb_dpo_nat_nodes[DPO_PROTO_NUM] =
+    {
+	[DPO_PROTO_IP4]  = lb_dpo_nat_ip4,
+	[DPO_PROTO_IP6]  = lb_dpo_nat_ip6,
+    };
+
 u32 lb_hash_time_now(vlib_main_t * vm)
 {
   return (u32) (vlib_time_now(vm) + 10000);
@@ -69,7 +85,9 @@ u8 *format_lb_main (u8 * s, va_list * args)
     if (h) {
       s = format(s, "core %d\n", thread_index);
       s = format(s, "  timeout: %ds\n", h->timeout);
+      s = format(s, "  buckets: %u\n", lb_hash_nbuckets(h));
       s = format(s, "  usage: %d / %d\n", lb_hash_elts(h, lb_hash_time_now(vlib_get_main())),  lb_hash_size(h));
+      s = format(s, "  configured buckets: %u\n", lbm->per_cpu_sticky_buckets_target);
     }
   }
 
@@ -81,6 +99,10 @@ static char *lb_vip_type_strings[] = {
     [LB_VIP_TYPE_IP6_GRE4] = "ip6-gre4",
     [LB_VIP_TYPE_IP4_GRE6] = "ip4-gre6",
     [LB_VIP_TYPE_IP4_GRE4] = "ip4-gre4",
+    [LB_VIP_TYPE_IP6_L2DSR] = "ip6-l2dsr",
+    [LB_VIP_TYPE_IP4_L2DSR] = "ip4-l2dsr",
+    [LB_VIP_TYPE_IP6_NAT6] = "ip6-nat6",
+    [LB_VIP_TYPE_IP4_NAT4] = "ip4-nat4",
 };
 
 u8 *format_lb_vip_type (u8 * s, va_list * args)
@@ -119,9 +141,11 @@ u8 *format_lb_vip (u8 * s, va_list * args)
 u8 *format_lb_as (u8 * s, va_list * args)
 {
   lb_as_t *as = va_arg (*args, lb_as_t *);
-  return format(s, "%U %s", format_ip46_address,
+  return format(s, "%U %s weight %u%s", format_ip46_address,
 		&as->address, IP46_TYPE_ANY,
-		(as->flags & LB_AS_FLAGS_USED)?"used":"removed");
+		(as->flags & LB_AS_FLAGS_USED)?"used":"removed",
+		as->weight,
+		(as->flags & LB_AS_FLAGS_DRAIN)?" draining":"");
 }
 
 u8 *format_lb_vip_detailed (u8 * s, va_list * args)
@@ -140,6 +164,10 @@ u8 *format_lb_vip_detailed (u8 * s, va_list * args)
                   format_white_space, indent,
                   vip->new_flow_table_mask + 1);
 
+  if (vip->sticky_flows)
+    s = format(s, "%U  flows per core:%u\n",
+               format_white_space, indent, vip->sticky_flows);
+
   //Print counters
   s = format(s, "%U  counters:\n",
              format_white_space, indent);
@@ -166,13 +194,15 @@ u8 *format_lb_vip_detailed (u8 * s, va_list * args)
   u32 *as_index;
   pool_foreach(as_index, vip->as_indexes, {
       as = &lbm->ass[*as_index];
-      s = format(s, "%U    %U %d buckets   %d flows  dpo:%u %s\n",
+      s = format(s, "%U    %U %d buckets   %d flows  weight %u  dpo:%u %s%s\n",
                    format_white_space, indent,
                    format_ip46_address, &as->address, IP46_TYPE_ANY,
                    count[as - lbm->ass],
                    vlib_refcount_get(&lbm->as_refcount, as - lbm->ass),
+                   as->weight,
                    as->dpo.dpoi_index,
-                   (as->flags & LB_AS_FLAGS_USED)?"used":" removed");
+                   (as->flags & LB_AS_FLAGS_USED)?"used":" removed",
+                   (as->flags & LB_AS_FLAGS_DRAIN)?" draining":"");
   });
 
   vec_free(count);
@@ -191,6 +221,7 @@ typedef struct {
   u32 as_index;
   u32 last;
   u32 skip;
+  u32 credit;
 } lb_pseudorand_t;
 
 static int lb_pseudorand_compare(void *a, void *b)
@@ -202,6 +233,35 @@ static int lb_pseudorand_compare(void *a, void *b)
   return memcmp(&asa->address, &asb->address, sizeof(asb->address));
 }
 
+/**
+ * Return traffic from a NAT AS is recognized by its source address.
+ * An AS address can therefore only be used by a single NAT VIP, until
+ * the AS is garbage collected.
+ * @return The NAT VIP using the address, or ~0
+ */
+static u32 lb_nat_mapping_find(ip46_address_t *address)
+{
+  lb_main_t *lbm = &lb_main;
+  clib_bihash_kv_16_8_t kv, value;
+
+  kv.key[0] = address->as_u64[0];
+  kv.key[1] = address->as_u64[1];
+  if (clib_bihash_search_16_8(&lbm->nat_mapping, &kv, &value))
+    return ~0;
+  return value.value;
+}
+
+static void lb_as_nat_mapping_add_del(lb_as_t *as, int is_add)
+{
+  lb_main_t *lbm = &lb_main;
+  clib_bihash_kv_16_8_t kv;
+
+  kv.key[0] = as->address.as_u64[0];
+  kv.key[1] = as->address.as_u64[1];
+  kv.value = as->vip_index;
+  clib_bihash_add_del_16_8(&lbm->nat_mapping, &kv, is_add);
+}
+
 static void lb_vip_garbage_collection(lb_vip_t *vip)
 {
   lb_main_t *lbm = &lb_main;
@@ -220,6 +280,9 @@ static void lb_vip_garbage_collection(lb_vip_t *vip)
 	  clib_u32_loop_gt(now, as->last_used + LB_CONCURRENCY_TIMEOUT) && //Not recently used
 	  (vlib_refcount_get(&lbm->as_refcount, as - lbm->ass) == 0))
 	{ //Not referenced
+	  if (lb_vip_is_nat(vip))
+	    lb_as_nat_mapping_add_del(as, 0);
+
 	  fib_entry_child_remove(as->next_hop_fib_entry_index,
 				 as->next_hop_child_index);
 	  fib_table_entry_delete_index(as->next_hop_fib_entry_index,
@@ -257,6 +320,15 @@ void lb_garbage_collection()
   lb_put_writer_lock();
 }
 
+/**
+ * An AS gets new flows when configured with a weight and not draining.
+ */
+static_always_inline int lb_as_takes_new_flows(lb_as_t *as)
+{
+  return (as->flags & (LB_AS_FLAGS_USED | LB_AS_FLAGS_DRAIN)) ==
+      LB_AS_FLAGS_USED && as->weight;
+}
+
 static void lb_vip_update_new_flow_table(lb_vip_t *vip)
 {
   lb_main_t *lbm = &lb_main;
@@ -266,6 +338,7 @@ static void lb_vip_update_new_flow_table(lb_vip_t *vip)
   lb_as_t *as;
   lb_pseudorand_t *pr, *sort_arr = 0;
   u32 count;
+  u32 max_weight = 0;
 
   ASSERT (lbm->writer_lock[0]); //We must have the lock
 
@@ -273,7 +346,7 @@ static void lb_vip_update_new_flow_table(lb_vip_t *vip)
   i = 0;
   pool_foreach(as_index, vip->as_indexes, {
       as = &lbm->ass[*as_index];
-      if (as->flags & LB_AS_FLAGS_USED) { //Not used anymore
+      if (lb_as_takes_new_flows(as)) {
         i = 1;
         goto out; //Not sure 'break' works in this macro-loop
       }
@@ -296,10 +369,11 @@ out:
   i = 0;
   pool_foreach(as_index, vip->as_indexes, {
       as = &lbm->ass[*as_index];
-      if (!(as->flags & LB_AS_FLAGS_USED)) //Not used anymore
+      if (!lb_as_takes_new_flows(as)) //Not used anymore, or draining
         continue;
 
       sort_arr[i].as_index = as - lbm->ass;
+      max_weight = clib_max(max_weight, as->weight);
       i++;
   });
   _vec_len(sort_arr) = i;
@@ -321,6 +395,7 @@ out:
      */
     pr->skip = ((seed & 0xffffffff) | 1) & vip->new_flow_table_mask;
     pr->last = (seed >> 32) & vip->new_flow_table_mask;
+    pr->credit = 0;
   }
 
   //Let's create a new flow table
@@ -328,26 +403,33 @@ out:
   for (i=0; i<vec_len(new_flow_table); i++)
     new_flow_table[i].as_index = ~0;
 
+  /* Each round, every AS earns its weight in credit and takes one
+   * entry of its permutation for each max_weight of credit, so the
+   * entries are shared in proportion to the weights. With equal weights
+   * this is the plain MagLev round robin. */
   u32 done = 0;
   while (1) {
     vec_foreach(pr, sort_arr) {
-      while (1) {
-        u32 last = pr->last;
-        pr->last = (pr->last + pr->skip) & vip->new_flow_table_mask;
-        if (new_flow_table[last].as_index == ~0) {
-          new_flow_table[last].as_index = pr->as_index;
-          break;
+      pr->credit += lbm->ass[pr->as_index].weight;
+      while (pr->credit >= max_weight) {
+        pr->credit -= max_weight;
+        while (1) {
+          u32 last = pr->last;
+          pr->last = (pr->last + pr->skip) & vip->new_flow_table_mask;
+          if (new_flow_table[last].as_index == ~0) {
+            new_flow_table[last].as_index = pr->as_index;
+            break;
+          }
         }
+        done++;
+        if (done == vec_len(new_flow_table))
+          goto finished;
       }
-      done++;
-      if (done == vec_len(new_flow_table))
-        goto finished;
     }
   }
 
-  vec_free(sort_arr);
-
 finished:
+  vec_free(sort_arr);
 
 //Count number of changed entries
   count = 0;
@@ -361,19 +443,49 @@ finished:
   vec_free(old_table);
 }
 
+/**
+ * Sticky tables are sized to remain half full with the flows the VIPs
+ * expect, but are never smaller than per_cpu_sticky_buckets.
+ * Workers pick the new size up when they run, and resize their own table.
+ */
+static void lb_update_sticky_buckets_target(void)
+{
+  lb_main_t *lbm = &lb_main;
+  lb_vip_t *vip;
+  u64 flows = 0;
+  u64 buckets;
+
+  ASSERT (lbm->writer_lock[0]); //We must have the lock
+
+  pool_foreach(vip, lbm->vips, {
+      if (vip->flags & LB_VIP_FLAGS_USED)
+        flows += vip->sticky_flows;
+  });
+
+  buckets = (2 * flows + LBHASH_ENTRY_PER_BUCKET - 1) / LBHASH_ENTRY_PER_BUCKET;
+  buckets = clib_min(buckets, lbm->per_cpu_sticky_buckets_max);
+  buckets = clib_max(buckets, lbm->per_cpu_sticky_buckets);
+  lbm->per_cpu_sticky_buckets_target = 1 << max_log2(buckets);
+}
+
 int lb_conf(ip4_address_t *ip4_address, ip6_address_t *ip6_address,
-           u32 per_cpu_sticky_buckets, u32 flow_timeout)
+           u32 per_cpu_sticky_buckets, u32 per_cpu_sticky_buckets_max,
+           u32 flow_timeout)
 {
   lb_main_t *lbm = &lb_main;
 
-  if (!is_pow2(per_cpu_sticky_buckets))
+  if (!is_pow2(per_cpu_sticky_buckets) ||
+      !is_pow2(per_cpu_sticky_buckets_max) ||
+      per_cpu_sticky_buckets_max < per_cpu_sticky_buckets)
     return VNET_API_ERROR_INVALID_MEMORY_SIZE;
 
   lb_get_writer_lock(); //Not exactly necessary but just a reminder that it exists for my future self
   lbm->ip4_src_address = *ip4_address;
   lbm->ip6_src_address = *ip6_address;
   lbm->per_cpu_sticky_buckets = per_cpu_sticky_buckets;
+  lbm->per_cpu_sticky_buckets_max = per_cpu_sticky_buckets_max;
   lbm->flow_timeout = flow_timeout;
+  lb_update_sticky_buckets_target();
   lb_put_writer_lock();
   return 0;
 }
@@ -424,7 +536,8 @@ static int lb_as_find_index_vip(lb_vip_t *vip, ip46_address_t *address, u32 *as_
   return -1;
 }
 
-int lb_vip_add_ass(u32 vip_index, ip46_address_t *addresses, u32 n)
+int lb_vip_add_ass(u32 vip_index, ip46_address_t *addresses, u32 n,
+                   u8 weight)
 {
   lb_main_t *lbm = &lb_main;
   lb_get_writer_lock();
@@ -434,7 +547,7 @@ int lb_vip_add_ass(u32 vip_index, ip46_address_t *addresses, u32 n)
     return VNET_API_ERROR_NO_SUCH_ENTRY;
   }
 
-  ip46_type_t type = lb_vip_is_gre4(vip)?IP46_TYPE_IP4:IP46_TYPE_IP6;
+  ip46_type_t type = lb_vip_as_is_ip4(vip)?IP46_TYPE_IP4:IP46_TYPE_IP6;
   u32 *to_be_added = 0;
   u32 *to_be_updated = 0;
   u32 i;
@@ -461,6 +574,15 @@ int lb_vip_add_ass(u32 vip_index, ip46_address_t *addresses, u32 n)
       return VNET_API_ERROR_INVALID_ADDRESS_FAMILY;
     }
 
+    if (lb_vip_is_nat(vip) &&
+        lb_nat_mapping_find(&addresses[n]) != ~0) {
+      //Already used by another NAT VIP
+      vec_free(to_be_added);
+      vec_free(to_be_updated);
+      lb_put_writer_lock();
+      return VNET_API_ERROR_ADDRESS_IN_USE;
+    }
+
     if (n) {
       u32 n2 = n;
       while(n2--) //Check for duplicates
@@ -478,6 +600,7 @@ next:
   //Update reused ASs
   vec_foreach(ip, to_be_updated) {
     lbm->ass[*ip].flags = LB_AS_FLAGS_USED;
+    lbm->ass[*ip].weight = weight;
   }
   vec_free(to_be_updated);
 
@@ -488,16 +611,20 @@ next:
     pool_get(lbm->ass, as);
     as->address = addresses[*ip];
     as->flags = LB_AS_FLAGS_USED;
+    as->weight = weight;
     as->vip_index = vip_index;
     pool_get(vip->as_indexes, as_index);
     *as_index = as - lbm->ass;
 
+    if (lb_vip_is_nat(vip))
+      lb_as_nat_mapping_add_del(as, 1);
+
     /*
      * become a child of the FIB entry
      * so we are informed when its forwarding changes
      */
     fib_prefix_t nh = {};
-    if (lb_vip_is_gre4(vip)) {
+    if (lb_vip_as_is_ip4(vip)) {
 	nh.fp_addr.ip4 = as->address.ip4;
 	nh.fp_len = 32;
 	nh.fp_proto = FIB_PROTOCOL_IP4;
@@ -589,6 +716,59 @@ int lb_vip_del_ass(u32 vip_index, ip46_address_t *addresses, u32 n)
   return ret;
 }
 
+int lb_vip_set_ass(u32 vip_index, ip46_address_t *addresses, u32 n,
+                   u32 weight, u32 drain)
+{
+  lb_main_t *lbm = &lb_main;
+  lb_vip_t *vip;
+  u32 *indexes = 0, *ip, i;
+
+  if (weight != ~0 && weight > 0xff)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  lb_get_writer_lock();
+  if (!(vip = lb_vip_get_by_index(vip_index))) {
+    lb_put_writer_lock();
+    return VNET_API_ERROR_NO_SUCH_ENTRY;
+  }
+
+  while (n--) {
+    if (lb_as_find_index_vip(vip, &addresses[n], &i) ||
+        !(lbm->ass[i].flags & LB_AS_FLAGS_USED)) {
+      vec_free(indexes);
+      lb_put_writer_lock();
+      return VNET_API_ERROR_NO_SUCH_ENTRY;
+    }
+    vec_add1(indexes, i);
+  }
+
+  vec_foreach(ip, indexes) {
+    lb_as_t *as = &lbm->ass[*ip];
+    if (weight != ~0)
+      as->weight = weight;
+    if (drain == 1)
+      as->flags |= LB_AS_FLAGS_DRAIN;
+    else if (drain == 0)
+      as->flags &= ~LB_AS_FLAGS_DRAIN;
+  }
+  vec_free(indexes);
+
+  //Established flows stay in the sticky tables, only new flows move
+  lb_vip_update_new_flow_table(vip);
+
+  lb_put_writer_lock();
+  return 0;
+}
+
+static dpo_type_t lb_vip_dpo_type(lb_main_t *lbm, lb_vip_t *vip)
+{
+  if (lb_vip_is_l2dsr(vip))
+    return lbm->dpo_l2dsr_type;
+  if (lb_vip_is_nat(vip))
+    return lbm->dpo_nat_type;
+  return lb_vip_is_gre4(vip)?lbm->dpo_gre4_type:lbm->dpo_gre6_type;
+}
+
 /**
  * Add the VIP adjacency to the ip4 or ip6 fib
  */
@@ -608,8 +788,7 @@ static void lb_vip_add_adjacency(lb_main_t *lbm, lb_vip_t *vip)
       pfx.fp_proto = FIB_PROTOCOL_IP6;
       proto = DPO_PROTO_IP6;
   }
-  dpo_set(&dpo, lb_vip_is_gre4(vip)?lbm->dpo_gre4_type:lbm->dpo_gre6_type,
-      proto, vip - lbm->vips);
+  dpo_set(&dpo, lb_vip_dpo_type(lbm, vip), proto, vip - lbm->vips);
   fib_table_entry_special_dpo_add(0,
 				  &pfx,
 				  FIB_SOURCE_PLUGIN_HI,
@@ -636,7 +815,8 @@ static void lb_vip_del_adjacency(lb_main_t *lbm, lb_vip_t *vip)
   fib_table_entry_special_remove(0, &pfx, FIB_SOURCE_PLUGIN_HI);
 }
 
-int lb_vip_add(ip46_address_t *prefix, u8 plen, lb_vip_type_t type, u32 new_length, u32 *vip_index)
+int lb_vip_add(ip46_address_t *prefix, u8 plen, lb_vip_type_t type, u32 new_length,
+               u32 sticky_flows, u32 *vip_index)
 {
   lb_main_t *lbm = &lb_main;
   lb_vip_t *vip;
@@ -653,10 +833,16 @@ int lb_vip_add(ip46_address_t *prefix, u8 plen, lb_vip_type_t type, u32 new_leng
     return VNET_API_ERROR_INVALID_MEMORY_SIZE;
   }
 
-  if (ip46_prefix_is_ip4(prefix, plen) &&
-      (type != LB_VIP_TYPE_IP4_GRE4) &&
-      (type != LB_VIP_TYPE_IP4_GRE6))
+  if (ip46_prefix_is_ip4(prefix, plen) != lb_vip_type_is_ip4(type)) {
+    lb_put_writer_lock();
     return VNET_API_ERROR_INVALID_ADDRESS_FAMILY;
+  }
+
+  //Return traffic is translated back to the VIP address
+  if (lb_vip_type_is_nat(type) && plen != 128) {
+    lb_put_writer_lock();
+    return VNET_API_ERROR_INVALID_VALUE;
+  }
 
 
   //Allocate
@@ -668,6 +854,7 @@ int lb_vip_add(ip46_address_t *prefix, u8 plen, lb_vip_type_t type, u32 new_leng
   vip->last_garbage_collection = (u32) vlib_time_now(vlib_get_main());
   vip->type = type;
   vip->flags = LB_VIP_FLAGS_USED;
+  vip->sticky_flows = sticky_flows;
   vip->as_indexes = 0;
 
   //Validate counters
@@ -687,6 +874,8 @@ int lb_vip_add(ip46_address_t *prefix, u8 plen, lb_vip_type_t type, u32 new_leng
   //Create adjacency to direct traffic
   lb_vip_add_adjacency(lbm, vip);
 
+  lb_update_sticky_buckets_target();
+
   //Return result
   *vip_index = vip - lbm->vips;
 
@@ -727,10 +916,28 @@ int lb_vip_del(u32 vip_index)
   //Set the VIP as unused
   vip->flags &= ~LB_VIP_FLAGS_USED;
 
+  lb_update_sticky_buckets_target();
+
   lb_put_writer_lock();
   return 0;
 }
 
+int lb_nat_enable_disable(u32 sw_if_index, u8 is_ip4, int is_enable)
+{
+  vnet_main_t *vnm = vnet_get_main();
+
+  if (pool_is_free_index(vnm->interface_main.sw_interfaces, sw_if_index))
+    return VNET_API_ERROR_INVALID_SW_IF_INDEX;
+
+  if (is_ip4)
+    vnet_feature_enable_disable("ip4-unicast", "lb4-nat4-in2out",
+                                sw_if_index, is_enable, 0, 0);
+  else
+    vnet_feature_enable_disable("ip6-unicast", "lb6-nat6-in2out",
+                                sw_if_index, is_enable, 0, 0);
+  return 0;
+}
+
 /* *INDENT-OFF* */
 VLIB_PLUGIN_REGISTER () = {
     .version = VPP_BUILD_VER,
@@ -775,7 +982,7 @@ lb_as_stack (lb_as_t *as)
 {
   lb_main_t *lbm = &lb_main;
   lb_vip_t *vip = &lbm->vips[as->vip_index];
-  dpo_stack(lb_vip_is_gre4(vip)?lbm->dpo_gre4_type:lbm->dpo_gre6_type,
+  dpo_stack(lb_vip_dpo_type(lbm, vip),
 	    lb_vip_is_ip4(vip)?DPO_PROTO_IP4:DPO_PROTO_IP6,
 	    &as->dpo,
 	    fib_entry_contribute_ip_forwarding(
@@ -813,17 +1020,24 @@ lb_init (vlib_main_t * vm)
   lbm->writer_lock = clib_mem_alloc_aligned (CLIB_CACHE_LINE_BYTES,  CLIB_CACHE_LINE_BYTES);
   lbm->writer_lock[0] = 0;
   lbm->per_cpu_sticky_buckets = LB_DEFAULT_PER_CPU_STICKY_BUCKETS;
+  lbm->per_cpu_sticky_buckets_max = LB_DEFAULT_PER_CPU_STICKY_BUCKETS_MAX;
+  lbm->per_cpu_sticky_buckets_target = LB_DEFAULT_PER_CPU_STICKY_BUCKETS;
   lbm->flow_timeout = LB_DEFAULT_FLOW_TIMEOUT;
   lbm->ip4_src_address.as_u32 = 0xffffffff;
   lbm->ip6_src_address.as_u64[0] = 0xffffffffffffffffL;
   lbm->ip6_src_address.as_u64[1] = 0xffffffffffffffffL;
   lbm->dpo_gre4_type = dpo_register_new_type(&lb_vft, lb_dpo_gre4_nodes);
   lbm->dpo_gre6_type = dpo_register_new_type(&lb_vft, lb_dpo_gre6_nodes);
+  lbm->dpo_l2dsr_type = dpo_register_new_type(&lb_vft, lb_dpo_l2dsr_nodes);
+  lbm->dpo_nat_type = dpo_register_new_type(&lb_vft, lb_dpo_nat_nodes);
   lbm->fib_node_type = fib_node_register_new_type(&lb_fib_node_vft);
 
   //Init AS reference counters
   vlib_refcount_init(&lbm->as_refcount);
 
+  clib_bihash_init_16_8(&lbm->nat_mapping, "lb nat mapping",
+                        LB_NAT_MAPPING_BUCKETS, LB_NAT_MAPPING_MEMORY_SIZE);
+
   //Allocate and init default AS.
   lbm->ass = 0;
   pool_get(lbm->ass, default_as);
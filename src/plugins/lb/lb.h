@@ -37,11 +37,17 @@
 #include <vnet/ip/ip.h>
 #include <vnet/dpo/dpo.h>
 #include <vnet/fib/fib_table.h>
+#include <vppinfra/bihash_16_8.h>
 
 #include <lb/lbhash.h>
 
 #define LB_DEFAULT_PER_CPU_STICKY_BUCKETS 1 << 10
+#define LB_DEFAULT_PER_CPU_STICKY_BUCKETS_MAX 1 << 20
 #define LB_DEFAULT_FLOW_TIMEOUT 40
+#define LB_DEFAULT_AS_WEIGHT 1
+
+#define LB_NAT_MAPPING_BUCKETS 1024
+#define LB_NAT_MAPPING_MEMORY_SIZE (16<<20)
 
 typedef enum {
   LB_NEXT_DROP,
@@ -75,11 +81,20 @@ typedef struct {
 
   /**
    * Some per-AS flags.
-   * For now only LB_AS_FLAGS_USED is defined.
+   * LB_AS_FLAGS_USED means the AS is configured.
+   * LB_AS_FLAGS_DRAIN means the AS keeps its established flows
+   * but does not get any new one.
    */
   u8 flags;
 
 #define LB_AS_FLAGS_USED 0x1
+#define LB_AS_FLAGS_DRAIN 0x2
+
+  /**
+   * Share of the new flows table given to this AS, relative to
+   * the other ASs of the VIP. An AS with a null weight gets no new flow.
+   */
+  u8 weight;
 
   /**
    * Rotating timestamp of when LB_AS_FLAGS_USED flag was last set.
@@ -131,15 +146,30 @@ typedef enum {
 /**
  * The load balancer supports IPv4 and IPv6 traffic
  * and GRE4 and GRE6 encap.
+ * Without encap, traffic can also be sent as is to the MAC address of ASs
+ * sharing a link with the load balancer (L2 DSR), or with its destination
+ * address translated to the AS (NAT). In both cases the AS must be of the
+ * same family as the VIP.
  */
 typedef enum {
   LB_VIP_TYPE_IP6_GRE6,
   LB_VIP_TYPE_IP6_GRE4,
   LB_VIP_TYPE_IP4_GRE6,
   LB_VIP_TYPE_IP4_GRE4,
+  LB_VIP_TYPE_IP6_L2DSR,
+  LB_VIP_TYPE_IP4_L2DSR,
+  LB_VIP_TYPE_IP6_NAT6,
+  LB_VIP_TYPE_IP4_NAT4,
   LB_VIP_N_TYPES,
 } lb_vip_type_t;
 
+#define lb_vip_type_is_ip4(t) ((t) == LB_VIP_TYPE_IP4_GRE6 || \
+                               (t) == LB_VIP_TYPE_IP4_GRE4 || \
+                               (t) == LB_VIP_TYPE_IP4_L2DSR || \
+                               (t) == LB_VIP_TYPE_IP4_NAT4)
+#define lb_vip_type_is_nat(t) ((t) == LB_VIP_TYPE_IP6_NAT6 || \
+                               (t) == LB_VIP_TYPE_IP4_NAT4)
+
 format_function_t format_lb_vip_type;
 unformat_function_t unformat_lb_vip_type;
 
@@ -205,6 +235,12 @@ typedef struct {
   u8 flags;
 #define LB_VIP_FLAGS_USED 0x1
 
+  /**
+   * Number of concurrent flows per core this VIP is expected to carry.
+   * The sticky tables are sized for the sum over all VIPs.
+   */
+  u32 sticky_flows;
+
   /**
    * Pool of AS indexes used for this VIP.
    * This also includes ASs that have been removed (but are still referenced).
@@ -212,8 +248,13 @@ typedef struct {
   u32 *as_indexes;
 } lb_vip_t;
 
-#define lb_vip_is_ip4(vip) ((vip)->type == LB_VIP_TYPE_IP4_GRE6 || (vip)->type == LB_VIP_TYPE_IP4_GRE4)
+#define lb_vip_is_ip4(vip) lb_vip_type_is_ip4((vip)->type)
 #define lb_vip_is_gre4(vip) ((vip)->type == LB_VIP_TYPE_IP6_GRE4 || (vip)->type == LB_VIP_TYPE_IP4_GRE4)
+#define lb_vip_is_gre(vip) ((vip)->type <= LB_VIP_TYPE_IP4_GRE4)
+#define lb_vip_is_l2dsr(vip) ((vip)->type == LB_VIP_TYPE_IP6_L2DSR || (vip)->type == LB_VIP_TYPE_IP4_L2DSR)
+#define lb_vip_is_nat(vip) lb_vip_type_is_nat((vip)->type)
+//ASs are of the family of the GRE encap, or of the VIP
+#define lb_vip_as_is_ip4(vip) (lb_vip_is_gre(vip)?lb_vip_is_gre4(vip):lb_vip_is_ip4(vip))
 format_function_t format_lb_vip;
 format_function_t format_lb_vip_detailed;
 
@@ -223,6 +264,18 @@ typedef struct {
    * One single table is used for all VIPs.
    */
   lb_hash_t *sticky_ht;
+
+  /**
+   * per_cpu_sticky_buckets the table was last sized for.
+   */
+  u32 sticky_buckets_conf;
+
+  /**
+   * New flows which could not be stored in the table
+   * during the second sticky_full_time.
+   */
+  u32 sticky_full;
+  u32 sticky_full_time;
 } lb_per_cpu_t;
 
 typedef struct {
@@ -267,10 +320,23 @@ typedef struct {
   ip4_address_t ip4_src_address;
 
   /**
-   * Number of buckets in the per-cpu sticky hash table.
+   * Initial number of buckets in the per-cpu sticky hash table.
    */
   u32 per_cpu_sticky_buckets;
 
+  /**
+   * Size up to which a per-cpu sticky hash table grows when it runs
+   * out of room for new flows.
+   */
+  u32 per_cpu_sticky_buckets_max;
+
+  /**
+   * Size the per-cpu sticky hash tables are given by the configuration,
+   * per_cpu_sticky_buckets raised to fit the VIPs sticky_flows.
+   * Each thread resizes its own table when this changes.
+   */
+  u32 per_cpu_sticky_buckets_target;
+
   /**
    * Flow timeout in seconds.
    */
@@ -286,6 +352,14 @@ typedef struct {
    */
   dpo_type_t dpo_gre4_type;
   dpo_type_t dpo_gre6_type;
+  dpo_type_t dpo_l2dsr_type;
+  dpo_type_t dpo_nat_type;
+
+  /**
+   * AS address to VIP index, for the ASs of NAT VIPs.
+   * Used to translate the source of the traffic coming back from ASs.
+   */
+  clib_bihash_16_8_t nat_mapping;
 
   /**
    * Node type for registering to fib changes.
@@ -308,26 +382,52 @@ extern vlib_node_registration_t lb4_node;
  * Fix global load-balancer parameters.
  * @param ip4_address IPv4 source address used for encapsulated traffic
  * @param ip6_address IPv6 source address used for encapsulated traffic
+ * @param sticky_buckets Initial per-cpu sticky table size
+ * @param sticky_buckets_max Size up to which sticky tables may grow
  * @return 0 on success. VNET_LB_ERR_XXX on error
  */
 int lb_conf(ip4_address_t *ip4_address, ip6_address_t *ip6_address,
-            u32 sticky_buckets, u32 flow_timeout);
+            u32 sticky_buckets, u32 sticky_buckets_max, u32 flow_timeout);
 
+/**
+ * Add a VIP.
+ * @param sticky_flows Expected number of concurrent flows per core, or 0
+ * @return 0 on success. VNET_LB_ERR_XXX on error
+ */
 int lb_vip_add(ip46_address_t *prefix, u8 plen, lb_vip_type_t type,
-               u32 new_length, u32 *vip_index);
+               u32 new_length, u32 sticky_flows, u32 *vip_index);
 int lb_vip_del(u32 vip_index);
 
 int lb_vip_find_index(ip46_address_t *prefix, u8 plen, u32 *vip_index);
 
 #define lb_vip_get_by_index(index) (pool_is_free_index(lb_main.vips, index)?NULL:pool_elt_at_index(lb_main.vips, index))
 
-int lb_vip_add_ass(u32 vip_index, ip46_address_t *addresses, u32 n);
+int lb_vip_add_ass(u32 vip_index, ip46_address_t *addresses, u32 n,
+                   u8 weight);
 int lb_vip_del_ass(u32 vip_index, ip46_address_t *addresses, u32 n);
 
+/**
+ * Change the weight or drain state of configured ASs.
+ * @param weight New weight, or ~0 to keep it
+ * @param drain 1 to drain, 0 to undrain, ~0 to keep the drain state
+ */
+int lb_vip_set_ass(u32 vip_index, ip46_address_t *addresses, u32 n,
+                   u32 weight, u32 drain);
+
 u32 lb_hash_time_now(vlib_main_t * vm);
 
+lb_hash_t *lb_get_sticky_table(u32 thread_index, u32 time_now);
+lb_hash_t *lb_sticky_table_resize(u32 thread_index, u32 buckets,
+                                  u32 time_now);
+
 void lb_garbage_collection();
 
+/**
+ * Enable or disable the translation of the traffic sent back by the ASs
+ * of NAT VIPs, as received on the given interface.
+ */
+int lb_nat_enable_disable(u32 sw_if_index, u8 is_ip4, int is_enable);
+
 format_function_t format_lb_main;
 
 #endif /* LB_PLUGIN_LB_LB_H_ */
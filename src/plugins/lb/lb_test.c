@@ -158,6 +158,8 @@ static int api_lb_add_del_vip (vat_main_t * vam)
   int ret;
   mps.is_del = 0;
   mps.is_gre4 = 0;
+  mps.encap = 0;
+  mps.sticky_flows = 0;
 
   if (!unformat(i, "%U",
                 unformat_ip46_prefix, mps.ip_prefix, &mps.prefix_length, IP46_TYPE_ANY)) {
@@ -169,6 +171,10 @@ static int api_lb_add_del_vip (vat_main_t * vam)
     mps.is_gre4 = 1;
   } else if (unformat(i, "gre6")) {
     mps.is_gre4 = 0;
+  } else if (unformat(i, "l2dsr")) {
+    mps.encap = 1;
+  } else if (unformat(i, "nat")) {
+    mps.encap = 2;
   } else {
     errmsg ("no encap\n");
     return -99;
@@ -179,6 +185,10 @@ static int api_lb_add_del_vip (vat_main_t * vam)
     return -99;
   }
 
+  if (unformat(i, "flows %d", &mps.sticky_flows)) {
+    ;
+  }
+
   if (unformat(i, "del")) {
     mps.is_del = 1;
   }
@@ -219,7 +229,7 @@ static int api_lb_add_del_as (vat_main_t * vam)
  */
 #define foreach_vpe_api_msg                             \
 _(lb_conf, "<ip4-src-addr> <ip6-src-address> <sticky_buckets_per_core> <flow_timeout>") \
-_(lb_add_del_vip, "<ip-prefix> [gre4|gre6] <new_table_len> [del]") \
+_(lb_add_del_vip, "<ip-prefix> [gre4|gre6|l2dsr|nat] <new_table_len> [flows <n>] [del]") \
 _(lb_add_del_as, "<vip-ip-prefix> <address> [del]")
 
 static void 
@@ -16,6 +16,7 @@
 #include <lb/lb.h>
 
 #include <vnet/gre/packet.h>
+#include <vnet/tcp/tcp_packet.h>
 #include <lb/lbhash.h>
 
 #define foreach_lb_error \
@@ -35,6 +36,18 @@ static char *lb_error_strings[] = {
 #undef _
 };
 
+/**
+ * How the lb nodes send traffic to the ASs.
+ */
+typedef enum {
+  LB_ENCAP_TYPE_GRE4,
+  LB_ENCAP_TYPE_GRE6,
+  //Unchanged, through the AS adjacency
+  LB_ENCAP_TYPE_L2DSR,
+  //Destination address translated to the AS
+  LB_ENCAP_TYPE_NAT,
+} lb_encap_type_t;
+
 typedef struct {
   u32 vip_index;
   u32 as_index;
@@ -60,32 +73,78 @@ format_lb_trace (u8 * s, va_list * args)
   return s;
 }
 
-lb_hash_t *lb_get_sticky_table(u32 thread_index)
+/**
+ * Move the sticky table of a thread to a table of the given size.
+ * Established flows are rehashed into the new table. The expired ones
+ * and those finding no room in their new bucket are dropped, releasing
+ * their AS reference. Only the thread owning the table may call this.
+ */
+lb_hash_t *lb_sticky_table_resize(u32 thread_index, u32 buckets,
+                                  u32 time_now)
 {
   lb_main_t *lbm = &lb_main;
-  lb_hash_t *sticky_ht = lbm->per_cpu[thread_index].sticky_ht;
-  //Check if size changed
-  if (PREDICT_FALSE(sticky_ht && (lbm->per_cpu_sticky_buckets != lb_hash_nbuckets(sticky_ht))))
-    {
-      //Dereference everything in there
-      lb_hash_bucket_t *b;
-      u32 i;
-      lb_hash_foreach_entry(sticky_ht, b, i) {
-	vlib_refcount_add(&lbm->as_refcount, thread_index, b->value[i], -1);
-	vlib_refcount_add(&lbm->as_refcount, thread_index, 0, 1);
+  lb_hash_t *old = lbm->per_cpu[thread_index].sticky_ht;
+  lb_hash_t *new;
+  lb_hash_bucket_t *b, *nb;
+  u32 i, j;
+
+  new = lb_hash_alloc(buckets, lbm->flow_timeout);
+  if (PREDICT_FALSE(new == NULL))
+    return old;
+
+  if (old) {
+    lb_hash_foreach_entry(old, b, i) {
+      if (!clib_u32_loop_gt(time_now, b->timeout[i])) {
+        nb = &new->buckets[b->hash[i] & new->buckets_mask];
+        for (j = 0; j < LBHASH_ENTRY_PER_BUCKET; j++)
+          if (clib_u32_loop_gt(time_now, nb->timeout[j]))
+            break;
+
+        if (j < LBHASH_ENTRY_PER_BUCKET) {
+          //The AS reference moves along with the entry
+          nb->hash[j] = b->hash[i];
+          nb->timeout[j] = b->timeout[i];
+          nb->vip[j] = b->vip[i];
+          nb->value[j] = b->value[i];
+          continue;
+        }
       }
 
-      lb_hash_free(sticky_ht);
-      sticky_ht = NULL;
+      vlib_refcount_add(&lbm->as_refcount, thread_index, b->value[i], -1);
+      vlib_refcount_add(&lbm->as_refcount, thread_index, 0, 1);
     }
-
-  //Create if necessary
-  if (PREDICT_FALSE(sticky_ht == NULL)) {
-    lbm->per_cpu[thread_index].sticky_ht = lb_hash_alloc(lbm->per_cpu_sticky_buckets, lbm->flow_timeout);
-    sticky_ht = lbm->per_cpu[thread_index].sticky_ht;
-    clib_warning("Regenerated sticky table %p", sticky_ht);
+    lb_hash_free(old);
   }
 
+  lbm->per_cpu[thread_index].sticky_ht = new;
+  return new;
+}
+
+lb_hash_t *lb_get_sticky_table(u32 thread_index, u32 time_now)
+{
+  lb_main_t *lbm = &lb_main;
+  lb_per_cpu_t *per_cpu = &lbm->per_cpu[thread_index];
+  lb_hash_t *sticky_ht = per_cpu->sticky_ht;
+  u32 target = lbm->per_cpu_sticky_buckets_target;
+
+  //Create if necessary, or resize to the newly configured size
+  if (PREDICT_FALSE(sticky_ht == NULL ||
+                    per_cpu->sticky_buckets_conf != target))
+    {
+      u32 buckets = target;
+
+      //A table which grew because it was full does not shrink when the
+      //configured size increases
+      if (sticky_ht && target > per_cpu->sticky_buckets_conf)
+        buckets = clib_max(buckets, lb_hash_nbuckets(sticky_ht));
+
+      if (sticky_ht == NULL || buckets != lb_hash_nbuckets(sticky_ht)) {
+        sticky_ht = lb_sticky_table_resize(thread_index, buckets, time_now);
+        clib_warning("Regenerated sticky table %p", sticky_ht);
+      }
+      per_cpu->sticky_buckets_conf = target;
+    }
+
   ASSERT(sticky_ht);
 
   //Update timeout
@@ -93,6 +152,31 @@ lb_hash_t *lb_get_sticky_table(u32 thread_index)
   return sticky_ht;
 }
 
+/**
+ * Grow the sticky table once more new flows than 1/64th of its buckets
+ * could not be stored within one second, up to per_cpu_sticky_buckets_max.
+ */
+static void
+lb_sticky_table_full(u32 thread_index, lb_hash_t *sticky_ht,
+                     u32 n_untracked, u32 time_now)
+{
+  lb_main_t *lbm = &lb_main;
+  lb_per_cpu_t *per_cpu = &lbm->per_cpu[thread_index];
+  u32 nbuckets = lb_hash_nbuckets(sticky_ht);
+
+  if (per_cpu->sticky_full_time != time_now) {
+    per_cpu->sticky_full_time = time_now;
+    per_cpu->sticky_full = 0;
+  }
+  per_cpu->sticky_full += n_untracked;
+
+  if (per_cpu->sticky_full > (nbuckets >> 6) &&
+      nbuckets < lbm->per_cpu_sticky_buckets_max) {
+    lb_sticky_table_resize(thread_index, nbuckets << 1, time_now);
+    per_cpu->sticky_full = 0;
+  }
+}
+
 u64
 lb_node_get_other_ports4(ip4_header_t *ip40)
 {
@@ -145,18 +229,87 @@ lb_node_get_hash(vlib_buffer_t *p, u8 is_input_v4)
   return hash;
 }
 
+/**
+ * Replace one of the addresses of an ip4 packet, updating the header and
+ * TCP/UDP checksums.
+ */
+static_always_inline void
+lb_nat4_rewrite (ip4_header_t *ip40, ip4_address_t *addr0, ip4_address_t new0)
+{
+  u32 old0 = addr0->as_u32;
+  ip_csum_t sum0;
+
+  addr0->as_u32 = new0.as_u32;
+  sum0 = ip_csum_update (ip40->checksum, old0, new0.as_u32,
+			 ip4_header_t, dst_address);
+  ip40->checksum = ip_csum_fold (sum0);
+
+  //Non first fragments carry no L4 header
+  if (PREDICT_FALSE (ip4_get_fragment_offset (ip40)))
+    return;
+
+  if (PREDICT_TRUE (ip40->protocol == IP_PROTOCOL_TCP))
+    {
+      tcp_header_t *tcp0 = ip4_next_header (ip40);
+      sum0 = ip_csum_update (tcp0->checksum, old0, new0.as_u32,
+			     ip4_header_t, dst_address);
+      tcp0->checksum = ip_csum_fold (sum0);
+    }
+  else if (ip40->protocol == IP_PROTOCOL_UDP)
+    {
+      udp_header_t *udp0 = ip4_next_header (ip40);
+      if (udp0->checksum) //Zero means no checksum
+	{
+	  sum0 = ip_csum_update (udp0->checksum, old0, new0.as_u32,
+				 ip4_header_t, dst_address);
+	  udp0->checksum = ip_csum_fold (sum0);
+	}
+    }
+}
+
+/**
+ * Replace one of the addresses of an ip6 packet, updating the
+ * TCP/UDP/ICMP checksum.
+ */
+static_always_inline void
+lb_nat6_rewrite (ip6_header_t *ip60, ip6_address_t *addr0, ip6_address_t *new0)
+{
+  ip6_address_t old0 = *addr0;
+  u16 *checksum0;
+  ip_csum_t sum0;
+
+  *addr0 = *new0;
+
+  if (PREDICT_TRUE (ip60->protocol == IP_PROTOCOL_TCP))
+    checksum0 = &((tcp_header_t *) (ip60 + 1))->checksum;
+  else if (ip60->protocol == IP_PROTOCOL_UDP)
+    checksum0 = &((udp_header_t *) (ip60 + 1))->checksum;
+  else if (ip60->protocol == IP_PROTOCOL_ICMP6)
+    checksum0 = &((icmp46_header_t *) (ip60 + 1))->checksum;
+  else
+    return;
+
+  sum0 = *checksum0;
+  sum0 = ip_csum_sub_even (sum0, old0.as_u64[0]);
+  sum0 = ip_csum_sub_even (sum0, old0.as_u64[1]);
+  sum0 = ip_csum_add_even (sum0, new0->as_u64[0]);
+  sum0 = ip_csum_add_even (sum0, new0->as_u64[1]);
+  *checksum0 = ip_csum_fold (sum0);
+}
+
 static_always_inline uword
 lb_node_fn (vlib_main_t * vm,
          vlib_node_runtime_t * node, vlib_frame_t * frame,
          u8 is_input_v4, //Compile-time parameter stating that is input is v4 (or v6)
-         u8 is_encap_v4) //Compile-time parameter stating that is GRE encap is v4 (or v6)
+         lb_encap_type_t encap_type) //Compile-time parameter stating how traffic is sent to ASs
 {
   lb_main_t *lbm = &lb_main;
   u32 n_left_from, *from, next_index, *to_next, n_left_to_next;
   u32 thread_index = vlib_get_thread_index();
   u32 lb_time = lb_hash_time_now(vm);
+  u32 n_untracked = 0;
 
-  lb_hash_t *sticky_ht = lb_get_sticky_table(thread_index);
+  lb_hash_t *sticky_ht = lb_get_sticky_table(thread_index, lb_time);
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
   next_index = node->cached_next_index;
@@ -186,7 +339,9 @@ lb_node_fn (vlib_main_t * vm,
 	  nexthash0 = lb_node_get_hash(p1, is_input_v4);
 	  lb_hash_prefetch_bucket(sticky_ht, nexthash0);
 	  //Prefetch for encap, next
-	  CLIB_PREFETCH (vlib_buffer_get_current(p1) - 64, 64, STORE);
+	  if (encap_type == LB_ENCAP_TYPE_GRE4 ||
+	      encap_type == LB_ENCAP_TYPE_GRE6)
+	    CLIB_PREFETCH (vlib_buffer_get_current(p1) - 64, 64, STORE);
 	}
 
       if (PREDICT_TRUE(n_left_from > 2))
@@ -257,6 +412,7 @@ lb_node_fn (vlib_main_t * vm,
 	  //Could not store new entry in the table
 	  asindex0 = vip0->new_flow_table[hash0 & vip0->new_flow_table_mask].as_index;
 	  counter = LB_VIP_COUNTER_UNTRACKED_PACKET;
+	  n_untracked++;
 	}
 
       vlib_increment_simple_counter(&lbm->vip_counters[counter],
@@ -265,9 +421,11 @@ lb_node_fn (vlib_main_t * vm,
 				    1);
 
       //Now let's encap
+      if (encap_type == LB_ENCAP_TYPE_GRE4 ||
+	  encap_type == LB_ENCAP_TYPE_GRE6)
       {
 	gre_header_t *gre0;
-	if (is_encap_v4)
+	if (encap_type == LB_ENCAP_TYPE_GRE4)
 	  {
 	    ip4_header_t *ip40;
 	    vlib_buffer_advance(p0, - sizeof(ip4_header_t) - sizeof(gre_header_t));
@@ -302,6 +460,22 @@ lb_node_fn (vlib_main_t * vm,
 	    clib_host_to_net_u16(0x0800):
 	    clib_host_to_net_u16(0x86DD);
       }
+      else if (encap_type == LB_ENCAP_TYPE_NAT)
+      {
+	if (is_input_v4)
+	  {
+	    ip4_header_t *ip40 = vlib_buffer_get_current(p0);
+	    lb_nat4_rewrite(ip40, &ip40->dst_address,
+			    lbm->ass[asindex0].address.ip4);
+	  }
+	else
+	  {
+	    ip6_header_t *ip60 = vlib_buffer_get_current(p0);
+	    lb_nat6_rewrite(ip60, &ip60->dst_address,
+			    &lbm->ass[asindex0].address.ip6);
+	  }
+      }
+      //L2DSR packets are sent as they are, the AS adjacency rewrites the MAC
 
       if (PREDICT_FALSE (p0->flags & VLIB_BUFFER_IS_TRACED))
 	{
@@ -320,6 +494,9 @@ lb_node_fn (vlib_main_t * vm,
     vlib_put_next_frame (vm, node, next_index, n_left_to_next);
   }
 
+  if (PREDICT_FALSE(n_untracked))
+    lb_sticky_table_full(thread_index, sticky_ht, n_untracked, lb_time);
+
   return frame->n_vectors;
 }
 
@@ -327,28 +504,172 @@ static uword
 lb6_gre6_node_fn (vlib_main_t * vm,
          vlib_node_runtime_t * node, vlib_frame_t * frame)
 {
-  return lb_node_fn(vm, node, frame, 0, 0);
+  return lb_node_fn(vm, node, frame, 0, LB_ENCAP_TYPE_GRE6);
 }
 
 static uword
 lb6_gre4_node_fn (vlib_main_t * vm,
          vlib_node_runtime_t * node, vlib_frame_t * frame)
 {
-  return lb_node_fn(vm, node, frame, 0, 1);
+  return lb_node_fn(vm, node, frame, 0, LB_ENCAP_TYPE_GRE4);
 }
 
 static uword
 lb4_gre6_node_fn (vlib_main_t * vm,
          vlib_node_runtime_t * node, vlib_frame_t * frame)
 {
-  return lb_node_fn(vm, node, frame, 1, 0);
+  return lb_node_fn(vm, node, frame, 1, LB_ENCAP_TYPE_GRE6);
 }
 
 static uword
 lb4_gre4_node_fn (vlib_main_t * vm,
          vlib_node_runtime_t * node, vlib_frame_t * frame)
 {
-  return lb_node_fn(vm, node, frame, 1, 1);
+  return lb_node_fn(vm, node, frame, 1, LB_ENCAP_TYPE_GRE4);
+}
+
+static uword
+lb6_l2dsr_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return lb_node_fn(vm, node, frame, 0, LB_ENCAP_TYPE_L2DSR);
+}
+
+static uword
+lb4_l2dsr_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return lb_node_fn(vm, node, frame, 1, LB_ENCAP_TYPE_L2DSR);
+}
+
+static uword
+lb6_nat6_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return lb_node_fn(vm, node, frame, 0, LB_ENCAP_TYPE_NAT);
+}
+
+static uword
+lb4_nat4_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return lb_node_fn(vm, node, frame, 1, LB_ENCAP_TYPE_NAT);
+}
+
+typedef struct {
+  u32 vip_index;
+} lb_nat_trace_t;
+
+u8 *
+format_lb_nat_trace (u8 * s, va_list * args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  lb_nat_trace_t *t = va_arg (*args, lb_nat_trace_t *);
+  if (t->vip_index == ~0)
+    return format(s, "lb nat: not from a NAT AS");
+  return format(s, "lb nat: source translated to vip[%d]", t->vip_index);
+}
+
+/**
+ * Traffic sent back by the ASs of NAT VIPs gets the VIP address
+ * as source again. Other traffic is left untouched.
+ */
+static_always_inline uword
+lb_nat_in2out_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame,
+         u8 is_ip4)
+{
+  lb_main_t *lbm = &lb_main;
+  u32 n_left_from, *from, next_index, *to_next, n_left_to_next;
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+  next_index = node->cached_next_index;
+
+  while (n_left_from > 0)
+  {
+    vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+    while (n_left_from > 0 && n_left_to_next > 0)
+    {
+      u32 pi0, next0;
+      vlib_buffer_t *p0;
+      ip46_address_t src0;
+      clib_bihash_kv_16_8_t kv0, value0;
+      u32 vip_index0 = ~0;
+
+      if (PREDICT_TRUE(n_left_from > 1))
+	{
+	  vlib_buffer_t *p1 = vlib_get_buffer (vm, from[1]);
+	  vlib_prefetch_buffer_header(p1, STORE);
+	  CLIB_PREFETCH (vlib_buffer_get_current(p1), 64, STORE);
+	}
+
+      pi0 = to_next[0] = from[0];
+      from += 1;
+      n_left_from -= 1;
+      to_next += 1;
+      n_left_to_next -= 1;
+
+      p0 = vlib_get_buffer (vm, pi0);
+      vnet_feature_next (vnet_buffer (p0)->sw_if_index[VLIB_RX], &next0, p0);
+
+      if (is_ip4)
+	{
+	  ip4_header_t *ip40 = vlib_buffer_get_current (p0);
+	  ip46_address_set_ip4 (&src0, &ip40->src_address);
+	}
+      else
+	{
+	  ip6_header_t *ip60 = vlib_buffer_get_current (p0);
+	  src0.ip6 = ip60->src_address;
+	}
+
+      kv0.key[0] = src0.as_u64[0];
+      kv0.key[1] = src0.as_u64[1];
+      if (!clib_bihash_search_16_8 (&lbm->nat_mapping, &kv0, &value0))
+	{
+	  lb_vip_t *vip0 = pool_elt_at_index (lbm->vips, value0.value);
+	  vip_index0 = value0.value;
+	  if (is_ip4)
+	    {
+	      ip4_header_t *ip40 = vlib_buffer_get_current (p0);
+	      lb_nat4_rewrite (ip40, &ip40->src_address, vip0->prefix.ip4);
+	    }
+	  else
+	    {
+	      ip6_header_t *ip60 = vlib_buffer_get_current (p0);
+	      lb_nat6_rewrite (ip60, &ip60->src_address, &vip0->prefix.ip6);
+	    }
+	}
+
+      if (PREDICT_FALSE (p0->flags & VLIB_BUFFER_IS_TRACED))
+	{
+	  lb_nat_trace_t *tr = vlib_add_trace (vm, node, p0, sizeof (*tr));
+	  tr->vip_index = vip_index0;
+	}
+
+      vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+				       n_left_to_next, pi0, next0);
+    }
+    vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+  }
+
+  return frame->n_vectors;
+}
+
+static uword
+lb4_nat4_in2out_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return lb_nat_in2out_node_fn(vm, node, frame, 1);
+}
+
+static uword
+lb6_nat6_in2out_node_fn (vlib_main_t * vm,
+         vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return lb_nat_in2out_node_fn(vm, node, frame, 0);
 }
 
 VLIB_REGISTER_NODE (lb6_gre6_node) =
@@ -419,3 +740,119 @@ VLIB_REGISTER_NODE (lb4_gre4_node) =
   },
 };
 
+VLIB_REGISTER_NODE (lb6_l2dsr_node) =
+{
+  .function = lb6_l2dsr_node_fn,
+  .name = "lb6-l2dsr",
+  .vector_size = sizeof (u32),
+  .format_trace = format_lb_trace,
+
+  .n_errors = LB_N_ERROR,
+  .error_strings = lb_error_strings,
+
+  .n_next_nodes = LB_N_NEXT,
+  .next_nodes =
+  {
+      [LB_NEXT_DROP] = "error-drop"
+  },
+};
+
+VLIB_REGISTER_NODE (lb4_l2dsr_node) =
+{
+  .function = lb4_l2dsr_node_fn,
+  .name = "lb4-l2dsr",
+  .vector_size = sizeof (u32),
+  .format_trace = format_lb_trace,
+
+  .n_errors = LB_N_ERROR,
+  .error_strings = lb_error_strings,
+
+  .n_next_nodes = LB_N_NEXT,
+  .next_nodes =
+  {
+      [LB_NEXT_DROP] = "error-drop"
+  },
+};
+
+VLIB_REGISTER_NODE (lb6_nat6_node) =
+{
+  .function = lb6_nat6_node_fn,
+  .name = "lb6-nat6",
+  .vector_size = sizeof (u32),
+  .format_trace = format_lb_trace,
+
+  .n_errors = LB_N_ERROR,
+  .error_strings = lb_error_strings,
+
+  .n_next_nodes = LB_N_NEXT,
+  .next_nodes =
+  {
+      [LB_NEXT_DROP] = "error-drop"
+  },
+};
+
+VLIB_REGISTER_NODE (lb4_nat4_node) =
+{
+  .function = lb4_nat4_node_fn,
+  .name = "lb4-nat4",
+  .vector_size = sizeof (u32),
+  .format_trace = format_lb_trace,
+
+  .n_errors = LB_N_ERROR,
+  .error_strings = lb_error_strings,
+
+  .n_next_nodes = LB_N_NEXT,
+  .next_nodes =
+  {
+      [LB_NEXT_DROP] = "error-drop"
+  },
+};
+
+VLIB_REGISTER_NODE (lb4_nat4_in2out_node) =
+{
+  .function = lb4_nat4_in2out_node_fn,
+  .name = "lb4-nat4-in2out",
+  .vector_size = sizeof (u32),
+  .format_trace = format_lb_nat_trace,
+
+  .n_errors = LB_N_ERROR,
+  .error_strings = lb_error_strings,
+
+  .n_next_nodes = LB_N_NEXT,
+  .next_nodes =
+  {
+      [LB_NEXT_DROP] = "error-drop"
+  },
+};
+
+VNET_FEATURE_INIT (lb4_nat4_in2out, static) =
+{
+  .arc_name = "ip4-unicast",
+  .node_name = "lb4-nat4-in2out",
+  .runs_before = VNET_FEATURES ("ip4-lookup"),
+};
+
+VLIB_REGISTER_NODE (lb6_nat6_in2out_node) =
+{
+  .function = lb6_nat6_in2out_node_fn,
+  .name = "lb6-nat6-in2out",
+  .vector_size = sizeof (u32),
+  .format_trace = format_lb_nat_trace,
+
+  .n_errors = LB_N_ERROR,
+  .error_strings = lb_error_strings,
+
+  .n_next_nodes = LB_N_NEXT,
+  .next_nodes =
+  {
+      [LB_NEXT_DROP] = "error-drop"
+  },
+};
+
+VNET_FEATURE_INIT (lb6_nat6_in2out, static) =
+{
+  .arc_name = "ip6-unicast",
+  .node_name = "lb6-nat6-in2out",
+  .runs_before = VNET_FEATURES ("ip6-lookup"),
+};
+
@@ -62,6 +62,8 @@ memif_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
 	args.is_master = 1;
       else if (unformat (line_input, "slave"))
 	args.is_master = 0;
+      else if (unformat (line_input, "zero-copy"))
+	args.is_zero_copy = 1;
       else if (unformat (line_input, "mode ip"))
 	args.mode = MEMIF_INTERFACE_MODE_IP;
       else if (unformat (line_input, "hw-addr %U",
@@ -76,6 +78,9 @@ memif_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
   if (!is_pow2 (ring_size))
     return clib_error_return (0, "ring size must be power of 2");
 
+  if (args.is_zero_copy && args.is_master)
+    return clib_error_return (0, "zero-copy is supported on slave only");
+
   if (ring_size > 32768)
     return clib_error_return (0, "maximum ring size is 32768");
 
@@ -113,7 +118,7 @@ VLIB_CLI_COMMAND (memif_create_command, static) = {
   .short_help = "create memif [id <id>] [socket <path>] "
                 "[ring-size <size>] [buffer-size <size>] [hw-addr <mac-address>] "
 		"<master|slave> [rx-queues <number>] [tx-queues <number>] "
-		"[mode ip] [secret <string>]",
+		"[mode ip] [secret <string>] [zero-copy]",
   .function = memif_create_command_fn,
 };
 /* *INDENT-ON* */
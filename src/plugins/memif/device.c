@@ -254,6 +254,127 @@ retry:
   return frame->n_vectors;
 }
 
+/**
+ * @brief Zero-copy slave transmit
+ *
+ * Each buffer segment gets its own S2M descriptor pointing at the
+ * buffer data in an exported buffer pool region. Buffers stay attached
+ * to their slots and are freed once the master moves the ring tail
+ * past them.
+ */
+static_always_inline uword
+memif_interface_tx_zc_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+			      vlib_frame_t * frame, memif_if_t * mif)
+{
+  u8 qid;
+  memif_ring_t *ring;
+  u32 *buffers = vlib_frame_args (frame);
+  u32 n_left = frame->n_vectors;
+  u16 ring_size, mask;
+  u16 head, tail;
+  u16 free_slots;
+  u32 thread_index = vlib_get_thread_index ();
+  u8 tx_queues = vec_len (mif->tx_queues);
+  memif_queue_t *mq;
+
+  if (tx_queues < vec_len (vlib_mains))
+    {
+      ASSERT (tx_queues > 0);
+      qid = thread_index % tx_queues;
+      clib_spinlock_lock_if_init (&mif->lockp);
+    }
+  else
+    qid = thread_index;
+
+  mq = vec_elt_at_index (mif->tx_queues, qid);
+  ring = mq->ring;
+  ring_size = 1 << mq->log2_ring_size;
+  mask = ring_size - 1;
+
+  /* free buffers the master is done with */
+  tail = ring->tail;
+  while (mq->last_tail != tail)
+    {
+      u16 slot = mq->last_tail & mask;
+      u16 n = clib_min ((u16) (tail - mq->last_tail), ring_size - slot);
+      vlib_buffer_free_no_next (vm, mq->buffers + slot, n);
+      mq->last_tail += n;
+    }
+
+  head = mq->last_head;
+  free_slots = ring_size - head + tail;
+
+  while (n_left)
+    {
+      vlib_buffer_t *b0 = vlib_get_buffer (vm, buffers[0]);
+      vlib_buffer_t *b = b0;
+      u32 bi = buffers[0];
+      u16 n_segs = 1;
+
+      if (n_left > 2)
+	{
+	  vlib_buffer_t *b2 = vlib_get_buffer (vm, buffers[2]);
+	  vlib_prefetch_buffer_header (b2, LOAD);
+	  CLIB_PREFETCH (&ring->desc[(head + 2) & mask],
+			 CLIB_CACHE_LINE_BYTES, STORE);
+	}
+
+      while (PREDICT_FALSE (b->flags & VLIB_BUFFER_NEXT_PRESENT))
+	{
+	  b = vlib_get_buffer (vm, b->next_buffer);
+	  n_segs++;
+	}
+      if (n_segs > free_slots)
+	break;
+
+      while (1)
+	{
+	  u16 slot = head & mask;
+	  memif_desc_t *d = &ring->desc[slot];
+
+	  b = vlib_get_buffer (vm, bi);
+
+	  memif_desc_set_vlib_buffer (vm, d, b);
+	  d->buffer_length = d->length = b->current_length;
+	  mq->buffers[slot] = bi;
+	  head++;
+
+	  if ((b->flags & VLIB_BUFFER_NEXT_PRESENT) == 0)
+	    {
+	      d->flags = 0;
+	      break;
+	    }
+	  d->flags = MEMIF_DESC_FLAG_NEXT;
+	  bi = b->next_buffer;
+	}
+
+      free_slots -= n_segs;
+      buffers++;
+      n_left--;
+    }
+
+  CLIB_MEMORY_STORE_BARRIER ();
+  ring->head = mq->last_head = head;
+
+  clib_spinlock_unlock_if_init (&mif->lockp);
+
+  if (n_left)
+    {
+      vlib_error_count (vm, node->node_index, MEMIF_TX_ERROR_NO_FREE_SLOTS,
+			n_left);
+      vlib_buffer_free (vm, buffers, n_left);
+    }
+
+  if ((ring->flags & MEMIF_RING_FLAG_MASK_INT) == 0 && mq->int_fd > -1)
+    {
+      u64 b = 1;
+      CLIB_UNUSED (int r) = write (mq->int_fd, &b, sizeof (b));
+      mq->int_count++;
+    }
+
+  return frame->n_vectors;
+}
+
 uword
 CLIB_MULTIARCH_FN (memif_interface_tx) (vlib_main_t * vm,
 					vlib_node_runtime_t * node,
@@ -263,7 +384,9 @@ CLIB_MULTIARCH_FN (memif_interface_tx) (vlib_main_t * vm,
   vnet_interface_output_runtime_t *rund = (void *) node->runtime_data;
   memif_if_t *mif = pool_elt_at_index (nm->interfaces, rund->dev_instance);
 
-  if (mif->flags & MEMIF_IF_FLAG_IS_SLAVE)
+  if (mif->flags & MEMIF_IF_FLAG_ZERO_COPY)
+    return memif_interface_tx_zc_inline (vm, node, frame, mif);
+  else if (mif->flags & MEMIF_IF_FLAG_IS_SLAVE)
     return memif_interface_tx_inline (vm, node, frame, mif, MEMIF_RING_S2M);
   else
     return memif_interface_tx_inline (vm, node, frame, mif, MEMIF_RING_M2S);
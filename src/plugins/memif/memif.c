@@ -65,10 +65,86 @@ memif_queue_intfd_close (memif_queue_t * mq)
     }
 }
 
+static u32
+memif_zero_copy_fill (vlib_main_t * vm, memif_queue_t * mq, u16 start,
+		      u16 n_slots)
+{
+  memif_ring_t *ring = mq->ring;
+  u16 ring_size = 1 << mq->log2_ring_size;
+  u16 mask = ring_size - 1;
+  u16 slot = start & mask;
+  u32 n_buffer_bytes = vlib_buffer_free_list_buffer_size (vm,
+							  VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
+  u32 n_alloc, i;
+
+  n_alloc = vlib_buffer_alloc_to_ring (vm, mq->buffers, slot, ring_size,
+				       n_slots);
+
+  for (i = 0; i < n_alloc; i++)
+    {
+      vlib_buffer_t *b = vlib_get_buffer (vm, mq->buffers[slot]);
+      memif_desc_t *d = &ring->desc[slot];
+
+      b->current_data = 0;
+      memif_desc_set_vlib_buffer (vm, d, b);
+      d->buffer_length = n_buffer_bytes;
+      d->length = 0;
+      d->flags = 0;
+      slot = (slot + 1) & mask;
+    }
+
+  return n_alloc;
+}
+
+/**
+ * @brief Give consumed rx slots back to the master
+ *
+ * Slots between last_tail and last_head were handed to the graph
+ * together with their buffers. Attach fresh buffers to them and move
+ * the ring tail past the ones which could be refilled.
+ *
+ * @return number of slots refilled
+ */
+u32
+memif_zero_copy_refill (vlib_main_t * vm, memif_queue_t * mq)
+{
+  u16 n_slots = mq->last_head - mq->last_tail;
+  u32 n_alloc;
+
+  if (n_slots == 0)
+    return 0;
+
+  n_alloc = memif_zero_copy_fill (vm, mq, mq->last_tail, n_slots);
+  mq->last_tail += n_alloc;
+
+  CLIB_MEMORY_STORE_BARRIER ();
+  mq->ring->tail = mq->last_tail;
+
+  return n_alloc;
+}
+
+static void
+memif_zero_copy_free (vlib_main_t * vm, memif_queue_t * mq, u16 start,
+		      u16 n_slots)
+{
+  u16 mask = (1 << mq->log2_ring_size) - 1;
+  u32 *to_free = 0;
+
+  while (n_slots--)
+    vec_add1 (to_free, mq->buffers[start++ & mask]);
+
+  /* every slot holds a single segment, chains span several slots */
+  if (vec_len (to_free))
+    vlib_buffer_free_no_next (vm, to_free, vec_len (to_free));
+  vec_free (to_free);
+  vec_free (mq->buffers);
+}
+
 void
 memif_disconnect (memif_if_t * mif, clib_error_t * err)
 {
   memif_main_t *mm = &memif_main;
+  vlib_main_t *vm = vlib_get_main ();
   vnet_main_t *vnm = vnet_get_main ();
   memif_region_t *mr;
   memif_queue_t *mq;
@@ -124,6 +200,22 @@ memif_disconnect (memif_if_t * mif, clib_error_t * err)
       }
   }
 
+  /* return buffers still attached to zero-copy ring slots: rx slots
+     not yet consumed, and tx slots the master has not released */
+  vec_foreach (mq, mif->rx_queues)
+  {
+    if (mq->buffers)
+      memif_zero_copy_free (vm, mq, mq->last_head,
+			    (u16) (mq->last_tail + (1 << mq->log2_ring_size)
+				   - mq->last_head));
+  }
+  vec_foreach (mq, mif->tx_queues)
+  {
+    if (mq->buffers)
+      memif_zero_copy_free (vm, mq, mq->last_tail,
+			    (u16) (mq->last_head - mq->last_tail));
+  }
+
   /* free tx and rx queues */
   vec_foreach (mq, mif->rx_queues) memif_queue_intfd_close (mq);
   vec_free (mif->rx_queues);
@@ -135,6 +227,8 @@ memif_disconnect (memif_if_t * mif, clib_error_t * err)
   vec_foreach (mr, mif->regions)
   {
     int rv;
+    if (mr->is_external)
+      continue;
     if ((rv = munmap (mr->shm, mr->region_size)))
       clib_warning ("munmap failed, rv = %d", rv);
     if (mr->fd > -1)
@@ -265,12 +359,14 @@ memif_get_ring (memif_if_t * mif, memif_ring_type_t type, u16 ring_num)
 clib_error_t *
 memif_init_regions_and_queues (memif_if_t * mif)
 {
+  vlib_main_t *vm = vlib_get_main ();
   memif_ring_t *ring = NULL;
   int i, j;
   u64 buffer_offset;
   memif_region_t *r;
   clib_mem_vm_alloc_t alloc = { 0 };
   clib_error_t *err;
+  int zero_copy = (mif->flags & MEMIF_IF_FLAG_ZERO_COPY) != 0;
 
   vec_validate_aligned (mif->regions, 0, CLIB_CACHE_LINE_BYTES);
   r = vec_elt_at_index (mif->regions, 0);
@@ -279,9 +375,11 @@ memif_init_regions_and_queues (memif_if_t * mif)
     (sizeof (memif_ring_t) +
      sizeof (memif_desc_t) * (1 << mif->run.log2_ring_size));
 
-  r->region_size = buffer_offset +
-    mif->run.buffer_size * (1 << mif->run.log2_ring_size) *
-    (mif->run.num_s2m_rings + mif->run.num_m2s_rings);
+  /* in zero-copy mode packet data lives in vlib buffers */
+  r->region_size = buffer_offset;
+  if (!zero_copy)
+    r->region_size += mif->run.buffer_size * (1 << mif->run.log2_ring_size) *
+      (mif->run.num_s2m_rings + mif->run.num_m2s_rings);
 
   alloc.name = "memif region";
   alloc.size = r->region_size;
@@ -294,6 +392,24 @@ memif_init_regions_and_queues (memif_if_t * mif)
   r->fd = alloc.fd;
   r->shm = alloc.addr;
 
+  if (zero_copy)
+    {
+      vlib_buffer_pool_t *bp;
+      vec_foreach (bp, vm->buffer_main->buffer_pools)
+      {
+	vlib_physmem_region_t *pr;
+	pr = vlib_physmem_get_region (vm, bp->physmem_region);
+	if (pr->fd < 0)
+	  return clib_error_return (0, "buffer pool %u is not shareable",
+				    bp - vm->buffer_main->buffer_pools);
+	vec_add2_aligned (mif->regions, r, 1, CLIB_CACHE_LINE_BYTES);
+	r->shm = pr->mem;
+	r->region_size = pr->size;
+	r->fd = pr->fd;
+	r->is_external = 1;
+      }
+    }
+
   for (i = 0; i < mif->run.num_s2m_rings; i++)
     {
       ring = memif_get_ring (mif, MEMIF_RING_S2M, i);
@@ -338,6 +454,9 @@ memif_init_regions_and_queues (memif_if_t * mif)
     mq->region = 0;
     mq->offset = (void *) mq->ring - (void *) mif->regions[mq->region].shm;
     mq->last_head = 0;
+    if (zero_copy)
+      vec_validate_aligned (mq->buffers, (1 << mq->log2_ring_size) - 1,
+			    CLIB_CACHE_LINE_BYTES);
   }
 
   ASSERT (mif->rx_queues == 0);
@@ -354,6 +473,18 @@ memif_init_regions_and_queues (memif_if_t * mif)
     mq->region = 0;
     mq->offset = (void *) mq->ring - (void *) mif->regions[mq->region].shm;
     mq->last_head = 0;
+    if (zero_copy)
+      {
+	/* whole ring is writable by the master before the first tail
+	   update, so every slot needs a buffer up front */
+	u16 ring_size = 1 << mq->log2_ring_size;
+	vec_validate_aligned (mq->buffers, ring_size - 1,
+			      CLIB_CACHE_LINE_BYTES);
+	mq->last_tail = 0;
+	if (memif_zero_copy_fill (vm, mq, 0, ring_size) != ring_size)
+	  return clib_error_return (0, "buffer allocation failure "
+				    "[rx queue %u]", i);
+      }
   }
 
   return 0;
@@ -733,7 +864,11 @@ memif_create_if (vlib_main_t * vm, memif_create_if_args_t * args)
   msf->ref_cnt++;
 
   if (args->is_master == 0)
-    mif->flags |= MEMIF_IF_FLAG_IS_SLAVE;
+    {
+      mif->flags |= MEMIF_IF_FLAG_IS_SLAVE;
+      if (args->is_zero_copy)
+	mif->flags |= MEMIF_IF_FLAG_ZERO_COPY;
+    }
 
   hw = vnet_get_hw_interface (vnm, mif->hw_if_index);
   hw->flags |= VNET_HW_INTERFACE_FLAG_SUPPORTS_INT_MODE;
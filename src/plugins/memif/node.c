@@ -447,6 +447,130 @@ memif_device_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   return n_rx_packets;
 }
 
+/**
+ * @brief Zero-copy slave receive
+ *
+ * Descriptors of the M2S ring point into buffers the slave attached to
+ * them, so received buffers are handed to the graph as they are and the
+ * consumed slots are refilled with new ones.
+ */
+static_always_inline uword
+memif_device_input_zc_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+			      memif_if_t * mif, u16 qid,
+			      memif_interface_mode_t mode)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  memif_queue_t *mq = vec_elt_at_index (mif->rx_queues, qid);
+  memif_ring_t *ring = mq->ring;
+  u16 mask = (1 << mq->log2_ring_size) - 1;
+  uword n_trace = vlib_get_trace_count (vm, node);
+  u32 thread_index = vlib_get_thread_index ();
+  u32 n_rx_packets = 0, n_rx_bytes = 0;
+  u32 next_index, n_left_to_next, *to_next;
+  u16 head, num_slots;
+
+  if (mode == MEMIF_INTERFACE_MODE_IP)
+    next_index = VNET_DEVICE_INPUT_NEXT_IP6_INPUT;
+  else
+    next_index = VNET_DEVICE_INPUT_NEXT_ETHERNET_INPUT;
+
+  head = ring->head;
+  num_slots = head - mq->last_head;
+
+  while (num_slots)
+    {
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (num_slots && n_left_to_next)
+	{
+	  u32 bi0, prev_bi, next0 = next_index;
+	  vlib_buffer_t *b0;
+	  memif_desc_t *d;
+	  u16 slot = mq->last_head & mask;
+
+	  if (num_slots > 2)
+	    {
+	      u16 s = (mq->last_head + 2) & mask;
+	      CLIB_PREFETCH (&ring->desc[s], CLIB_CACHE_LINE_BYTES, LOAD);
+	      vlib_prefetch_buffer_with_index (vm, mq->buffers[s], STORE);
+	      CLIB_PREFETCH (memif_get_buffer (mif, ring, (slot + 1) & mask),
+			     CLIB_CACHE_LINE_BYTES, LOAD);
+	    }
+
+	  d = &ring->desc[slot];
+	  bi0 = prev_bi = mq->buffers[slot];
+	  b0 = vlib_get_buffer (vm, bi0);
+	  b0->current_data = 0;
+	  b0->current_length = d->length;
+	  b0->total_length_not_including_first_buffer = 0;
+	  b0->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID;
+	  vnet_buffer (b0)->sw_if_index[VLIB_RX] = mif->sw_if_index;
+	  vnet_buffer (b0)->sw_if_index[VLIB_TX] = (u32) ~ 0;
+	  mq->last_head++;
+	  num_slots--;
+
+	  /* remaining segments of a chained packet */
+	  while ((d->flags & MEMIF_DESC_FLAG_NEXT) && num_slots)
+	    {
+	      vlib_buffer_t *b;
+	      u32 bi;
+
+	      slot = mq->last_head & mask;
+	      d = &ring->desc[slot];
+	      bi = mq->buffers[slot];
+	      b = vlib_get_buffer (vm, bi);
+	      b->current_data = 0;
+	      b->current_length = d->length;
+	      b->flags = 0;
+	      memif_buffer_add_to_chain (vm, bi, bi0, prev_bi);
+	      prev_bi = bi;
+	      mq->last_head++;
+	      num_slots--;
+	    }
+
+	  if (mode == MEMIF_INTERFACE_MODE_IP)
+	    next0 = memif_next_from_ip_hdr (node, b0);
+	  else if (PREDICT_FALSE (mif->per_interface_next_index != ~0))
+	    next0 = mif->per_interface_next_index;
+	  else
+	    vnet_feature_start_device_input_x1 (mif->sw_if_index, &next0, b0);
+
+	  VLIB_BUFFER_TRACE_TRAJECTORY_INIT (b0);
+
+	  if (PREDICT_FALSE (n_trace > 0))
+	    {
+	      memif_input_trace_t *tr;
+	      vlib_trace_buffer (vm, node, next0, b0, /* follow_chain */ 0);
+	      vlib_set_trace_count (vm, node, --n_trace);
+	      tr = vlib_add_trace (vm, node, b0, sizeof (*tr));
+	      tr->next_index = next0;
+	      tr->hw_if_index = mif->hw_if_index;
+	      tr->ring = qid;
+	    }
+
+	  to_next[0] = bi0;
+	  to_next += 1;
+	  n_left_to_next--;
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					   n_left_to_next, bi0, next0);
+
+	  n_rx_packets++;
+	  n_rx_bytes += vlib_buffer_length_in_chain (vm, b0);
+	}
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  /* also retries slots a previous allocation failure left empty */
+  memif_zero_copy_refill (vm, mq);
+
+  vlib_increment_combined_counter (vnm->interface_main.combined_sw_if_counters
+				   + VNET_INTERFACE_COUNTER_RX, thread_index,
+				   mif->hw_if_index, n_rx_packets,
+				   n_rx_bytes);
+
+  return n_rx_packets;
+}
+
 uword
 CLIB_MULTIARCH_FN (memif_input_fn) (vlib_main_t * vm,
 				    vlib_node_runtime_t * node,
@@ -464,7 +588,18 @@ CLIB_MULTIARCH_FN (memif_input_fn) (vlib_main_t * vm,
     if ((mif->flags & MEMIF_IF_FLAG_ADMIN_UP) &&
 	(mif->flags & MEMIF_IF_FLAG_CONNECTED))
       {
-	if (mif->flags & MEMIF_IF_FLAG_IS_SLAVE)
+	if (mif->flags & MEMIF_IF_FLAG_ZERO_COPY)
+	  {
+	    if (mif->mode == MEMIF_INTERFACE_MODE_IP)
+	      n_rx += memif_device_input_zc_inline (vm, node, mif,
+						    dq->queue_id,
+						    MEMIF_INTERFACE_MODE_IP);
+	    else
+	      n_rx += memif_device_input_zc_inline (vm, node, mif,
+						    dq->queue_id,
+						    MEMIF_INTERFACE_MODE_ETHERNET);
+	  }
+	else if (mif->flags & MEMIF_IF_FLAG_IS_SLAVE)
 	  {
 	    if (mif->mode == MEMIF_INTERFACE_MODE_IP)
 	      n_rx += memif_device_input_inline (vm, node, frame, mif,
@@ -82,6 +82,8 @@ typedef struct
   void *shm;
   memif_region_size_t region_size;
   int fd;
+  /* memory owned by someone else (vlib buffer pool), never unmapped */
+  u8 is_external;
 } memif_region_t;
 
 typedef struct
@@ -101,6 +103,9 @@ typedef struct
   u16 last_head;
   u16 last_tail;
 
+  /* zero-copy: vlib buffer index attached to each ring slot */
+  u32 *buffers;
+
   /* interrupts */
   int int_fd;
   uword int_clib_file_index;
@@ -112,7 +117,8 @@ typedef struct
   _(1, IS_SLAVE, "slave")		\
   _(2, CONNECTING, "connecting")	\
   _(3, CONNECTED, "connected")		\
-  _(4, DELETING, "deleting")
+  _(4, DELETING, "deleting")		\
+  _(5, ZERO_COPY, "zero-copy")
 
 typedef enum
 {
@@ -205,6 +211,7 @@ typedef struct
   u8 *socket_filename;
   u8 *secret;
   u8 is_master;
+  u8 is_zero_copy;
   memif_interface_mode_t mode:8;
   memif_log2_ring_size_t log2_ring_size;
   u16 buffer_size;
@@ -228,8 +235,22 @@ memif_get_buffer (memif_if_t * mif, memif_ring_t * ring, u16 slot)
   return mif->regions[region].shm + ring->desc[slot].offset;
 }
 
+/* In zero-copy mode region 0 holds the rings only, and region n + 1
+   exports vlib buffer pool n, so a descriptor can point straight at
+   the data of a vlib buffer. */
+static_always_inline void
+memif_desc_set_vlib_buffer (vlib_main_t * vm, memif_desc_t * d,
+			    vlib_buffer_t * b)
+{
+  vlib_buffer_pool_t *bp = vec_elt_at_index (vm->buffer_main->buffer_pools,
+					     b->buffer_pool_index);
+  d->region = b->buffer_pool_index + 1;
+  d->offset = pointer_to_uword (vlib_buffer_get_current (b)) - bp->start;
+}
+
 /* memif.c */
 clib_error_t *memif_init_regions_and_queues (memif_if_t * mif);
+u32 memif_zero_copy_refill (vlib_main_t * vm, memif_queue_t * mq);
 clib_error_t *memif_connect (memif_if_t * mif);
 void memif_disconnect (memif_if_t * mif, clib_error_t * err);
 
@@ -428,7 +428,8 @@ memif_msg_receive (memif_if_t ** mifp, clib_socket_t * sock, clib_file_t * uf)
       if ((err = memif_init_regions_and_queues (mif)))
 	return err;
       memif_msg_enq_init (mif);
-      memif_msg_enq_add_region (mif, 0);
+      vec_foreach_index (i, mif->regions)
+	memif_msg_enq_add_region (mif, i);
       vec_foreach_index (i, mif->tx_queues)
 	memif_msg_enq_add_ring (mif, i, MEMIF_RING_S2M);
       vec_foreach_index (i, mif->rx_queues)
@@ -1296,6 +1296,37 @@ snat_in2out_lb (snat_main_t *sm,
   return s;
 }
 
+/**
+ * Prefetch the in2out session hash bucket of a packet whose header is
+ * already in cache, so that it is warm by the time the packet is looked up.
+ */
+static_always_inline void
+snat_in2out_prefetch_bucket (snat_main_t * sm, vlib_buffer_t * b,
+                             u32 thread_index, int is_output_feature)
+{
+  ip4_header_t * ip;
+  udp_header_t * udp;
+  snat_session_key_t key;
+  clib_bihash_kv_8_8_t kv;
+  u32 iph_offset = 0;
+
+  if (is_output_feature)
+    iph_offset = vnet_buffer (b)->ip.save_rewrite_length;
+
+  ip = (ip4_header_t *) ((u8 *) vlib_buffer_get_current (b) + iph_offset);
+  udp = ip4_next_header (ip);
+
+  key.addr = ip->src_address;
+  key.port = udp->src_port;
+  key.protocol = ip_proto_to_snat_proto (ip->protocol);
+  key.fib_index = vec_elt (sm->ip4_main->fib_index_by_sw_if_index,
+                           vnet_buffer (b)->sw_if_index[VLIB_RX]);
+  kv.key = key.as_u64;
+
+  clib_bihash_prefetch_bucket_8_8 (&sm->per_thread_data[thread_index].in2out,
+                                   clib_bihash_hash_8_8 (&kv));
+}
+
 static inline uword
 snat_in2out_node_fn_inline (vlib_main_t * vm,
                             vlib_node_runtime_t * node,
@@ -1344,19 +1375,26 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
           clib_bihash_kv_8_8_t kv0, value0, kv1, value1;
           u32 iph_offset0 = 0, iph_offset1 = 0;
 
-	  /* Prefetch next iteration. */
-	  {
-	    vlib_buffer_t * p2, * p3;
+	  /* Prefetch the iteration after next. */
+	  if (PREDICT_TRUE (n_left_from >= 6))
+	    {
+	      vlib_buffer_t * p4, * p5;
 
-	    p2 = vlib_get_buffer (vm, from[2]);
-	    p3 = vlib_get_buffer (vm, from[3]);
+	      p4 = vlib_get_buffer (vm, from[4]);
+	      p5 = vlib_get_buffer (vm, from[5]);
 
-	    vlib_prefetch_buffer_header (p2, LOAD);
-	    vlib_prefetch_buffer_header (p3, LOAD);
+	      vlib_prefetch_buffer_header (p4, LOAD);
+	      vlib_prefetch_buffer_header (p5, LOAD);
 
-	    CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
-	    CLIB_PREFETCH (p3->data, CLIB_CACHE_LINE_BYTES, STORE);
-	  }
+	      CLIB_PREFETCH (p4->data, CLIB_CACHE_LINE_BYTES, STORE);
+	      CLIB_PREFETCH (p5->data, CLIB_CACHE_LINE_BYTES, STORE);
+	    }
+
+	  /* Prefetch session hash buckets of the next iteration. */
+	  snat_in2out_prefetch_bucket (sm, vlib_get_buffer (vm, from[2]),
+	                               thread_index, is_output_feature);
+	  snat_in2out_prefetch_bucket (sm, vlib_get_buffer (vm, from[3]),
+	                               thread_index, is_output_feature);
 
           /* speculatively enqueue b0 and b1 to the current next frame */
 	  to_next[0] = bi0 = from[0];
@@ -1439,7 +1477,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 
           kv0.key = key0.as_u64;
 
-          if (PREDICT_FALSE (clib_bihash_search_8_8 (
+          if (PREDICT_FALSE (clib_bihash_search_inline_2_8_8 (
               &sm->per_thread_data[thread_index].in2out, &kv0, &value0) != 0))
             {
               if (is_slow_path)
@@ -1618,7 +1656,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 
           kv1.key = key1.as_u64;
 
-            if (PREDICT_FALSE(clib_bihash_search_8_8 (
+            if (PREDICT_FALSE(clib_bihash_search_inline_2_8_8 (
                 &sm->per_thread_data[thread_index].in2out, &kv1, &value1) != 0))
             {
               if (is_slow_path)
@@ -1829,8 +1867,8 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 
           kv0.key = key0.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->per_thread_data[thread_index].in2out,
-                                      &kv0, &value0))
+          if (clib_bihash_search_inline_2_8_8 (
+              &sm->per_thread_data[thread_index].in2out, &kv0, &value0))
             {
               if (is_slow_path)
                 {
@@ -1137,7 +1137,7 @@ nat64_extract_ip4 (ip6_address_t * ip6, ip4_address_t * ip4, u32 fib_index)
 }
 
 /**
- * @brief Per worker process checking expire time for NAT64 sessions.
+ * @brief Per worker process advancing NAT64 session expiration timers.
  */
 static uword
 nat64_expire_worker_walk_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
@@ -1188,7 +1188,7 @@ nat64_expire_walk_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
 
   while (1)
     {
-      vlib_process_wait_for_event_or_clock (vm, 10.0);
+      vlib_process_wait_for_event_or_clock (vm, 1.0);
       vlib_process_get_events (vm, NULL);
       for (i = 0; i < vec_len (worker_vms); i++)
 	{
@@ -37,6 +37,10 @@ nat64_db_init (nat64_db_t * db, u32 bib_buckets, u32 bib_memory_size,
   clib_bihash_init_48_8 (&db->st.out2in, "st-out2in", st_buckets,
 			 st_memory_size);
 
+  tw_timer_wheel_init_16t_2w_512sl (&db->st.timers, 0, 1.0, ~0);
+  db->st.timers.last_run_time = vlib_time_now (vlib_get_main ());
+  db->st.expired_timers = 0;
+
   db->free_addr_port_cb = free_addr_port_cb;
   db->bib.limit = 10 * bib_buckets;
   db->bib.bib_entries_num = 0;
@@ -367,6 +371,14 @@ nat64_db_st_walk (nat64_db_t * db, u8 proto,
     }
 }
 
+static_always_inline u32
+nat64_db_st_timer_id (u8 proto)
+{
+  u32 snat_proto = ip_proto_to_snat_proto (proto);
+
+  return snat_proto == ~0 ? NAT64_DB_ST_TIMER_UNK_PROTO : snat_proto;
+}
+
 nat64_db_st_entry_t *
 nat64_db_st_entry_create (nat64_db_t * db, nat64_db_bib_entry_t * bibe,
 			  ip6_address_t * in_r_addr,
@@ -413,6 +425,10 @@ nat64_db_st_entry_create (nat64_db_t * db, nat64_db_bib_entry_t * bibe,
   ste->r_port = r_port;
   ste->bibe_index = bibe - bib;
   ste->proto = bibe->proto;
+  ste->timer_handle =
+    tw_timer_start_16t_2w_512sl (&db->st.timers, kv.value,
+				 nat64_db_st_timer_id (ste->proto),
+				 NAT64_DB_ST_TIMER_CHECK_INTERVAL);
 
   /* increment session number for BIB entry */
   bibe->ses_num++;
@@ -489,6 +505,9 @@ nat64_db_st_entry_free (nat64_db_t * db, nat64_db_st_entry_t * ste)
 
   db->st.st_entries_num--;
 
+  if (ste->timer_handle != ~0)
+    tw_timer_stop_16t_2w_512sl (&db->st.timers, ste->timer_handle);
+
   /* delete hash lookup */
   memset (&ste_key, 0, sizeof (ste_key));
   ste_key.l_addr.as_u64[0] = bibe->in_addr.as_u64[0];
@@ -636,33 +655,54 @@ nat64_db_st_entry_by_index (nat64_db_t * db, u8 proto, u32 ste_index)
 void
 nad64_db_st_free_expired (nat64_db_t * db, u32 now)
 {
-  u32 *ste_to_be_free = 0, *ste_index;
   nat64_db_st_entry_t *st, *ste;
+  u32 *handle, ste_index, timer_id, interval;
+
+  db->st.expired_timers =
+    tw_timer_expire_timers_vec_16t_2w_512sl (&db->st.timers, (f64) now,
+					     db->st.expired_timers);
+
+  vec_foreach (handle, db->st.expired_timers)
+  {
+    ste_index = handle[0] & 0x0FFFFFFF;
+    timer_id = handle[0] >> 28;
 
+    switch (timer_id)
+      {
 /* *INDENT-OFF* */
 #define _(N, i, n, s) \
-  st = db->st._##n##_st; \
-  pool_foreach (ste, st, ({\
-    if (i == SNAT_PROTOCOL_TCP && !ste->tcp_state) \
-      continue; \
-    if (ste->expire < now) \
-      vec_add1 (ste_to_be_free, ste - st); \
-  })); \
-  vec_foreach (ste_index, ste_to_be_free) \
-    nat64_db_st_entry_free (db, pool_elt_at_index(st, ste_index[0])); \
-  vec_free (ste_to_be_free); \
-  ste_to_be_free = 0;
-  foreach_snat_protocol
+      case SNAT_PROTOCOL_##N: \
+	st = db->st._##n##_st; \
+	break;
+	foreach_snat_protocol
 #undef _
-  st = db->st._unk_proto_st;
-  pool_foreach (ste, st, ({
-    if (ste->expire < now)
-      vec_add1 (ste_to_be_free, ste - st);
-  }));
-  vec_foreach (ste_index, ste_to_be_free)
-    nat64_db_st_entry_free (db, pool_elt_at_index(st, ste_index[0]));
-  vec_free (ste_to_be_free);
 /* *INDENT-ON* */
+      default:
+	st = db->st._unk_proto_st;
+	break;
+      }
+
+    ste = pool_elt_at_index (st, ste_index);
+    ste->timer_handle = ~0;
+
+    /* TCP sessions in CLOSED state are not subject to the timeout */
+    if (timer_id == SNAT_PROTOCOL_TCP && !ste->tcp_state)
+      interval = NAT64_DB_ST_TIMER_CHECK_INTERVAL;
+    else if (ste->expire >= now)
+      interval = clib_min (ste->expire - now + 1, (512 * 512) - 1);
+    else
+      {
+	nat64_db_st_entry_free (db, ste);
+	continue;
+      }
+
+    /* not expired yet, check again later */
+    ste->timer_handle =
+      tw_timer_start_16t_2w_512sl (&db->st.timers, ste_index, timer_id,
+				   interval);
+  }
+
+  vec_reset_length (db->st.expired_timers);
 }
 
 void
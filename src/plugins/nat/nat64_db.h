@@ -21,6 +21,7 @@
 
 #include <vppinfra/bihash_24_8.h>
 #include <vppinfra/bihash_48_8.h>
+#include <vppinfra/tw_timer_16t_2w_512sl.h>
 #include <nat/nat.h>
 
 
@@ -99,6 +100,7 @@ typedef CLIB_PACKED(struct
   u16 r_port;
   u32 bibe_index;
   u32 expire;
+  u32 timer_handle;
   u8 proto;
   u8 tcp_state;
 }) nat64_db_st_entry_t;
@@ -119,10 +121,19 @@ typedef struct
   clib_bihash_48_8_t in2out;
   clib_bihash_48_8_t out2in;
 
+  /* session expiration, one second tick */
+  tw_timer_wheel_16t_2w_512sl_t timers;
+  u32 *expired_timers;
+
   u32 limit;
   u32 st_entries_num;
 } nat64_db_st_t;
 
+/* session timer ID for "unknown" protocol session table */
+#define NAT64_DB_ST_TIMER_UNK_PROTO 3
+/* delay before a new session is first checked for expiration, in seconds */
+#define NAT64_DB_ST_TIMER_CHECK_INTERVAL 10
+
 struct nat64_db_s;
 
 /**
@@ -308,6 +319,10 @@ void nat64_db_st_walk (nat64_db_t * db, u8 proto,
 /**
  * @brief Free expired session entries in session tables.
  *
+ * Advance the session timer wheel and free sessions whose timers fired and
+ * whose timeout elapsed, sessions refreshed since the timer was started are
+ * rescheduled to their current expiration time.
+ *
  * @param db NAT64 DB.
  * @param now Current time.
  */
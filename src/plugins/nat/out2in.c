@@ -894,6 +894,30 @@ snat_out2in_lb (snat_main_t *sm,
   return s;
 }
 
+/**
+ * Prefetch the out2in session hash bucket of a packet whose header is
+ * already in cache, so that it is warm by the time the packet is looked up.
+ */
+static_always_inline void
+snat_out2in_prefetch_bucket (snat_main_t * sm, vlib_buffer_t * b,
+                             u32 thread_index)
+{
+  ip4_header_t * ip = vlib_buffer_get_current (b);
+  udp_header_t * udp = ip4_next_header (ip);
+  snat_session_key_t key;
+  clib_bihash_kv_8_8_t kv;
+
+  key.addr = ip->dst_address;
+  key.port = udp->dst_port;
+  key.protocol = ip_proto_to_snat_proto (ip->protocol);
+  key.fib_index = vec_elt (sm->ip4_main->fib_index_by_sw_if_index,
+                           vnet_buffer (b)->sw_if_index[VLIB_RX]);
+  kv.key = key.as_u64;
+
+  clib_bihash_prefetch_bucket_8_8 (&sm->per_thread_data[thread_index].out2in,
+                                   clib_bihash_hash_8_8 (&kv));
+}
+
 static uword
 snat_out2in_node_fn (vlib_main_t * vm,
 		  vlib_node_runtime_t * node,
@@ -939,19 +963,26 @@ snat_out2in_node_fn (vlib_main_t * vm,
           snat_session_t * s0 = 0, * s1 = 0;
           clib_bihash_kv_8_8_t kv0, kv1, value0, value1;
 
-	  /* Prefetch next iteration. */
-	  {
-	    vlib_buffer_t * p2, * p3;
+	  /* Prefetch the iteration after next. */
+	  if (PREDICT_TRUE (n_left_from >= 6))
+	    {
+	      vlib_buffer_t * p4, * p5;
 
-	    p2 = vlib_get_buffer (vm, from[2]);
-	    p3 = vlib_get_buffer (vm, from[3]);
+	      p4 = vlib_get_buffer (vm, from[4]);
+	      p5 = vlib_get_buffer (vm, from[5]);
 
-	    vlib_prefetch_buffer_header (p2, LOAD);
-	    vlib_prefetch_buffer_header (p3, LOAD);
+	      vlib_prefetch_buffer_header (p4, LOAD);
+	      vlib_prefetch_buffer_header (p5, LOAD);
 
-	    CLIB_PREFETCH (p2->data, CLIB_CACHE_LINE_BYTES, STORE);
-	    CLIB_PREFETCH (p3->data, CLIB_CACHE_LINE_BYTES, STORE);
-	  }
+	      CLIB_PREFETCH (p4->data, CLIB_CACHE_LINE_BYTES, STORE);
+	      CLIB_PREFETCH (p5->data, CLIB_CACHE_LINE_BYTES, STORE);
+	    }
+
+	  /* Prefetch session hash buckets of the next iteration. */
+	  snat_out2in_prefetch_bucket (sm, vlib_get_buffer (vm, from[2]),
+	                               thread_index);
+	  snat_out2in_prefetch_bucket (sm, vlib_get_buffer (vm, from[3]),
+	                               thread_index);
 
           /* speculatively enqueue b0 and b1 to the current next frame */
 	  to_next[0] = bi0 = from[0];
@@ -1018,8 +1049,8 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           kv0.key = key0.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->per_thread_data[thread_index].out2in,
-                                      &kv0, &value0))
+          if (clib_bihash_search_inline_2_8_8 (
+              &sm->per_thread_data[thread_index].out2in, &kv0, &value0))
             {
               /* Try to match static mapping by external address and port,
                  destination address and port in packet */
@@ -1181,8 +1212,8 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           kv1.key = key1.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->per_thread_data[thread_index].out2in,
-                                      &kv1, &value1))
+          if (clib_bihash_search_inline_2_8_8 (
+              &sm->per_thread_data[thread_index].out2in, &kv1, &value1))
             {
               /* Try to match static mapping by external address and port,
                  destination address and port in packet */
@@ -1380,8 +1411,8 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           kv0.key = key0.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->per_thread_data[thread_index].out2in,
-                                      &kv0, &value0))
+          if (clib_bihash_search_inline_2_8_8 (
+              &sm->per_thread_data[thread_index].out2in, &kv0, &value0))
             {
               /* Try to match static mapping by external address and port,
                  destination address and port in packet */
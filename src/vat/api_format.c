@@ -5292,6 +5292,7 @@ _(sr_steering_add_del_reply)                            \
 _(classify_add_del_session_reply)                       \
 _(classify_set_interface_ip_table_reply)                \
 _(classify_set_interface_l2_tables_reply)               \
+_(classify_set_parallel_lookup_reply)                   \
 _(l2tpv3_set_tunnel_cookies_reply)                      \
 _(l2tpv3_interface_enable_disable_reply)                \
 _(l2tpv3_set_lookup_key_reply)                          \
@@ -5512,6 +5513,8 @@ _(CLASSIFY_SET_INTERFACE_IP_TABLE_REPLY,                                \
 classify_set_interface_ip_table_reply)                                  \
 _(CLASSIFY_SET_INTERFACE_L2_TABLES_REPLY,                               \
   classify_set_interface_l2_tables_reply)                               \
+_(CLASSIFY_SET_PARALLEL_LOOKUP_REPLY,                                   \
+  classify_set_parallel_lookup_reply)                                   \
 _(GET_NODE_INDEX_REPLY, get_node_index_reply)                           \
 _(ADD_NODE_NEXT_REPLY, add_node_next_reply)                             \
 _(L2TPV3_CREATE_TUNNEL_REPLY, l2tpv3_create_tunnel_reply)               \
@@ -7781,6 +7784,8 @@ api_tap_create_v2 (vat_main_t * vam)
   u32 host_ip6_prefix_len = 0;
   int ret;
   int rx_ring_sz = 0, tx_ring_sz = 0;
+  u32 num_rx_queues = 0;
+  u8 gso_enabled = 0;
 
   memset (mac_address, 0, sizeof (mac_address));
 
@@ -7818,6 +7823,10 @@ api_tap_create_v2 (vat_main_t * vam)
 	;
       else if (unformat (i, "tx-ring-size %d", &tx_ring_sz))
 	;
+      else if (unformat (i, "num-rx-queues %u", &num_rx_queues))
+	;
+      else if (unformat (i, "gso"))
+	gso_enabled = 1;
       else
 	break;
     }
@@ -7880,6 +7889,8 @@ api_tap_create_v2 (vat_main_t * vam)
   mp->host_ip6_addr_set = host_ip6_prefix_len != 0;
   mp->rx_ring_sz = rx_ring_sz;
   mp->tx_ring_sz = tx_ring_sz;
+  mp->num_rx_queues = num_rx_queues;
+  mp->gso_enabled = gso_enabled;
 
   if (random_mac)
     clib_memcpy (mp->mac_address, mac_address, 6);
@@ -11793,6 +11804,44 @@ api_classify_set_interface_l2_tables (vat_main_t * vam)
   return ret;
 }
 
+static int
+api_classify_set_parallel_lookup (vat_main_t * vam)
+{
+  unformat_input_t *i = vam->input;
+  vl_api_classify_set_parallel_lookup_t *mp;
+  u32 table_index = ~0;
+  u8 is_enable = 1;
+  int ret;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "table %d", &table_index))
+	;
+      else if (unformat (i, "disable"))
+	is_enable = 0;
+      else
+	{
+	  clib_warning ("parse error '%U'", format_unformat_error, i);
+	  return -99;
+	}
+    }
+
+  if (table_index == ~0)
+    {
+      errmsg ("missing table index");
+      return -99;
+    }
+
+  M (CLASSIFY_SET_PARALLEL_LOOKUP, mp);
+
+  mp->table_index = ntohl (table_index);
+  mp->is_enable = is_enable;
+
+  S (mp);
+  W (ret);
+  return ret;
+}
+
 static int
 api_set_ipfix_exporter (vat_main_t * vam)
 {
@@ -22701,7 +22750,8 @@ _(tap_delete,                                                           \
   "<vpp-if-name> | sw_if_index <id>")                                   \
 _(sw_interface_tap_dump, "")                                            \
 _(tap_create_v2,                                                        \
-  "name <name> [hw-addr <mac-addr>] [host-ns <name>] [rx-ring-size <num> [tx-ring-size <num>]") \
+  "name <name> [hw-addr <mac-addr>] [host-ns <name>] [rx-ring-size <num> [tx-ring-size <num>]\n" \
+  "[num-rx-queues <n>] [gso]")                                           \
 _(tap_delete_v2,                                                        \
   "<vpp-if-name> | sw_if_index <id>")                                   \
 _(sw_interface_tap_v2_dump, "")                                         \
@@ -22796,6 +22846,7 @@ _(classify_set_interface_ip_table,                                      \
 _(classify_set_interface_l2_tables,                                     \
   "<intfc> | sw_if_index <nn> [ip4-table <nn>] [ip6-table <nn>]\n"      \
   "  [other-table <nn>]")                                               \
+_(classify_set_parallel_lookup, "table <nn> [disable]")                 \
 _(get_node_index, "node <node-name")                                    \
 _(add_node_next, "node <node-name> next <next-node-name>")              \
 _(l2tpv3_create_tunnel,                                                 \
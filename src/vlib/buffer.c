@@ -944,7 +944,7 @@ vlib_buffer_add_physmem_region (vlib_main_t * vm,
       clib_panic ("buffer memory size out of range!");
     }
 
-  vec_add2 (bm->buffer_pools, p, 1);
+  vec_add2_aligned (bm->buffer_pools, p, 1, CLIB_CACHE_LINE_BYTES);
   p->start = start;
   p->size = size;
   p->physmem_region = pri;
@@ -1020,7 +1020,7 @@ vlib_buffer_main_init (struct vlib_main_t * vm)
   vlib_physmem_region_index_t pri;
   clib_error_t *error;
 
-  vec_validate (vm->buffer_main, 0);
+  vec_validate_aligned (vm->buffer_main, 0, CLIB_CACHE_LINE_BYTES);
   bm = vm->buffer_main;
 
   if (vlib_buffer_callbacks)
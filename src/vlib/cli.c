@@ -699,6 +699,39 @@ vlib_cli_output (vlib_main_t * vm, char *fmt, ...)
   vec_free (s);
 }
 
+/* Resident memory of the main heap and its arenas, by page size. */
+static void
+show_memory_page_stats (vlib_main_t * vm)
+{
+  mheap_t *h = mheap_header (clib_per_cpu_mheaps[0]);
+  clib_slab_main_t *sm = &clib_slab_main;
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  clib_mem_page_stats_t stats;
+
+  vlib_cli_output (vm, "Resident memory by page size");
+
+  clib_mem_get_page_stats ((u8 *) h - h->vm_alloc_offset_from_header,
+			   h->vm_alloc_size, &stats);
+  vlib_cli_output (vm, "  %-16s%U", "main heap",
+		   format_clib_mem_page_stats, &stats);
+
+  if (sm->heap)
+    {
+      clib_mem_get_page_stats (sm->arena_start,
+			       sm->arena_end - sm->arena_start, &stats);
+      vlib_cli_output (vm, "  %-16s%U", "slab arena",
+		       format_clib_mem_page_stats, &stats);
+    }
+
+  if (hm->heap)
+    {
+      clib_mem_get_page_stats (hm->va_start, hm->va_end - hm->va_start,
+			       &stats);
+      vlib_cli_output (vm, "  %-16s%U", "hugepage arena",
+		       format_clib_mem_page_stats, &stats);
+    }
+}
+
 static clib_error_t *
 show_memory_usage (vlib_main_t * vm,
 		   unformat_input_t * input, vlib_cli_command_t * cmd)
@@ -727,6 +760,16 @@ show_memory_usage (vlib_main_t * vm,
       index++;
   }));
   /* *INDENT-ON* */
+
+  if (clib_slab_is_enabled (clib_per_cpu_mheaps[0]))
+    vlib_cli_output (vm, "Slab allocator\n%U\n", format_clib_slab, verbose);
+
+  if (clib_hugemem_is_enabled (clib_per_cpu_mheaps[0]))
+    vlib_cli_output (vm, "Hugepage arena\n%U\n", format_clib_hugemem,
+		     verbose);
+
+  show_memory_page_stats (vm);
+
   return 0;
 }
 
@@ -365,16 +365,43 @@ STATIC_ASSERT (sizeof (vnet_buffer_opaque_t) <=
 /* Full cache line (64 bytes) of additional space */
 typedef struct
 {
+#if VLIB_BUFFER_TRACE_TRAJECTORY > 0
+  /* buffer trajectory tracing, kept out of the union below since it
+     is added to by every node the buffer goes through */
+  u16 *trajectory_trace;
+#endif
+
   union
   {
-#if VLIB_BUFFER_TRACE_TRAJECTORY > 0
-    /* buffer trajectory tracing */
+    /* async crypto. The status is set by crypto-dispatch, the rest is
+       kept by the submitting node for its post node */
     struct
     {
-      u16 *trajectory_trace;
-    };
-#endif
-    u32 unused[12];
+      u8 status;
+      u8 pad[3];
+      union
+      {
+	struct
+	{
+	  /* the buffer the op reads from, freed by the post node */
+	  u32 src_bi;
+	  u32 sa_index;
+	  /* decrypt: sequence number, both: high bits of an ESN */
+	  u32 seq;
+	  u32 seq_hi;
+	  /* decrypt: decrypted length, encrypt: length covered by the ICV */
+	  u32 len;
+	  /* encrypt: offset of the esp header from b->data */
+	  u16 esp_offset;
+	  u16 next_index;
+	  u8 ip_hdr_size;
+	  u8 tunnel_mode;
+	  u8 transport_ip6;
+	} esp;
+      };
+    } crypto;
+
+    u32 unused[10];
   };
 } vnet_buffer_opaque2_t;
 
@@ -60,7 +60,8 @@ _(FLOW_CLASSIFY_SET_INTERFACE, flow_classify_set_interface)             \
 _(FLOW_CLASSIFY_DUMP, flow_classify_dump)                               \
 _(INPUT_ACL_SET_INTERFACE, input_acl_set_interface)                     \
 _(CLASSIFY_SET_INTERFACE_IP_TABLE, classify_set_interface_ip_table)     \
-_(CLASSIFY_SET_INTERFACE_L2_TABLES, classify_set_interface_l2_tables)
+_(CLASSIFY_SET_INTERFACE_L2_TABLES, classify_set_interface_l2_tables)  \
+_(CLASSIFY_SET_PARALLEL_LOOKUP, classify_set_parallel_lookup)
 
 #define foreach_classify_add_del_table_field    \
 _(table_index)                                  \
@@ -563,6 +564,19 @@ static void vl_api_classify_set_interface_l2_tables_t_handler
   REPLY_MACRO (VL_API_CLASSIFY_SET_INTERFACE_L2_TABLES_REPLY);
 }
 
+static void vl_api_classify_set_parallel_lookup_t_handler
+  (vl_api_classify_set_parallel_lookup_t * mp)
+{
+  vnet_classify_main_t *cm = &vnet_classify_main;
+  vl_api_classify_set_parallel_lookup_reply_t *rmp;
+  int rv;
+
+  rv = vnet_classify_set_parallel_lookup (cm, ntohl (mp->table_index),
+					  mp->is_enable);
+
+  REPLY_MACRO (VL_API_CLASSIFY_SET_PARALLEL_LOOKUP_REPLY);
+}
+
 static void vl_api_input_acl_set_interface_t_handler
   (vl_api_input_acl_set_interface_t * mp)
 {
@@ -786,6 +786,21 @@ vnet_classify_add_del_table (vnet_classify_main_t * cm,
   return 0;
 }
 
+/* Lookups starting at table_index hash the rest of the chain up front */
+int
+vnet_classify_set_parallel_lookup (vnet_classify_main_t * cm,
+				   u32 table_index, int is_enable)
+{
+  vnet_classify_table_t *t;
+
+  if (pool_is_free_index (cm->tables, table_index))
+    return VNET_API_ERROR_NO_SUCH_TABLE;
+
+  t = pool_elt_at_index (cm->tables, table_index);
+  t->parallel_lookup = is_enable != 0;
+  return 0;
+}
+
 #define foreach_tcp_proto_field                 \
 _(src)                                          \
 _(dst)
@@ -1503,6 +1518,7 @@ classify_table_command_fn (vlib_main_t * vm,
   u32 tmp;
   u32 current_data_flag = 0;
   int current_data_offset = 0;
+  int parallel_lookup = -1;
 
   u8 *mask = 0;
   vnet_classify_main_t *cm = &vnet_classify_main;
@@ -1555,6 +1571,10 @@ classify_table_command_fn (vlib_main_t * vm,
       else
 	if (unformat (input, "current-data-offset %d", &current_data_offset))
 	;
+      else if (unformat (input, "parallel-lookup"))
+	parallel_lookup = 1;
+      else if (unformat (input, "serial-lookup"))
+	parallel_lookup = 0;
 
       else
 	break;
@@ -1572,6 +1592,9 @@ classify_table_command_fn (vlib_main_t * vm,
   if (!is_add && table_index == ~0)
     return clib_error_return (0, "table index required for delete");
 
+  if (!is_add && parallel_lookup != -1)
+    return clib_error_return (0, "lookup mode is only set on add");
+
   rv = vnet_classify_add_del_table (cm, mask, nbuckets, memory_size,
 				    skip, match, next_table_index,
 				    miss_next_index, &table_index,
@@ -1586,6 +1609,15 @@ classify_table_command_fn (vlib_main_t * vm,
       return clib_error_return (0, "vnet_classify_add_del_table returned %d",
 				rv);
     }
+
+  if (is_add && parallel_lookup != -1)
+    {
+      rv = vnet_classify_set_parallel_lookup (cm, table_index,
+					      parallel_lookup);
+      if (rv)
+	return clib_error_return (0, "vnet_classify_set_parallel_lookup "
+				  "returned %d", rv);
+    }
   return 0;
 }
 
@@ -1597,7 +1629,7 @@ VLIB_CLI_COMMAND (classify_table, static) = {
   "\n mask <mask-value> buckets <nn> [skip <n>] [match <n>]"
   "\n [current-data-flag <n>] [current-data-offset <n>] [table <n>]"
   "\n [memory-size <nn>[M][G]] [next-table <n>]"
-  "\n [del] [del-chain]",
+  "\n [parallel-lookup|serial-lookup] [del] [del-chain]",
   .function = classify_table_command_fn,
 };
 /* *INDENT-ON* */
@@ -1628,6 +1660,8 @@ format_vnet_classify_table (u8 * s, va_list * args)
 	      t->current_data_flag, t->current_data_offset);
   s = format (s, "\n  mask %U", format_hex_bytes, t->mask,
 	      t->match_n_vectors * sizeof (u32x4));
+  if (t->parallel_lookup)
+    s = format (s, "\n  parallel chain lookup");
   s = format (s, "\n  linear-search buckets %d\n", t->linear_buckets);
 
   if (verbose == 0)
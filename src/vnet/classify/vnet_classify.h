@@ -46,6 +46,9 @@ extern vlib_node_registration_t ip6_classify_node;
 
 #define U32X4_ALIGNED(p) PREDICT_TRUE((((intptr_t)p) & 0xf) == 0)
 
+/* Tables of a chain looked up together by a parallel lookup */
+#define VNET_CLASSIFY_PARALLEL_MAX_TABLES 4
+
 /*
  * Classify table option to process packets
  *  CLASSIFY_FLAG_USE_CURR_DATA:
@@ -175,6 +178,9 @@ typedef struct
   /* Index of next table to try */
   u32 next_table_index;
 
+  /* Hash the packets into the next tables of the chain up front */
+  u8 parallel_lookup;
+
   /* Miss next index, return if next_table_index = 0 */
   u32 miss_next_index;
 
@@ -219,80 +225,91 @@ u8 *format_classify_table (u8 * s, va_list * args);
 
 u64 vnet_classify_hash_packet (vnet_classify_table_t * t, u8 * h);
 
-static inline u64
-vnet_classify_hash_packet_inline (vnet_classify_table_t * t, u8 * h)
-{
-  u32x4 *mask;
+/*
+ * Lookups specialized per mask size. The _n functions below are
+ * instantiated for each size of foreach_size_in_u32x4 with n a compile
+ * time constant, so the key loads and compares are straight line code and
+ * the packet data is masked once per lookup rather than once per entry
+ * probed. The _inline entry points pick the variant from the table's
+ * match_n_vectors, so the table is checked once per lookup instead of
+ * once per vector of every entry.
+ */
+
+#ifdef CLASSIFY_USE_SSE
+/* SSE copes with unaligned packet data through unaligned loads */
+#define vnet_classify_data_u32x4(h,i) \
+  clib_mem_unaligned ((h) + (i) * sizeof (u32x4), u32x4)
+#endif
 
+static_always_inline u64
+vnet_classify_hash_packet_n (vnet_classify_table_t * t, u8 * h, u32 n)
+{
   union
   {
     u32x4 as_u32x4;
     u64 as_u64[2];
   } xor_sum __attribute__ ((aligned (sizeof (u32x4))));
+  u32x4 *mask;
 
   ASSERT (t);
+  ASSERT (t->match_n_vectors == n);
   mask = t->mask;
+  h += t->skip_n_vectors * sizeof (u32x4);
+
 #ifdef CLASSIFY_USE_SSE
-  if (U32X4_ALIGNED (h))
-    {				//SSE can't handle unaligned data
-      u32x4 *data = (u32x4 *) h;
-      xor_sum.as_u32x4 = data[0 + t->skip_n_vectors] & mask[0];
-      switch (t->match_n_vectors)
-	{
-	case 5:
-	  xor_sum.as_u32x4 ^= data[4 + t->skip_n_vectors] & mask[4];
-	  /* FALLTHROUGH */
-	case 4:
-	  xor_sum.as_u32x4 ^= data[3 + t->skip_n_vectors] & mask[3];
-	  /* FALLTHROUGH */
-	case 3:
-	  xor_sum.as_u32x4 ^= data[2 + t->skip_n_vectors] & mask[2];
-	  /* FALLTHROUGH */
-	case 2:
-	  xor_sum.as_u32x4 ^= data[1 + t->skip_n_vectors] & mask[1];
-	  /* FALLTHROUGH */
-	case 1:
-	  break;
-	default:
-	  abort ();
-	}
-    }
-  else
+  xor_sum.as_u32x4 = vnet_classify_data_u32x4 (h, 0) & mask[0];
+  if (n > 1)
+    xor_sum.as_u32x4 ^= vnet_classify_data_u32x4 (h, 1) & mask[1];
+  if (n > 2)
+    xor_sum.as_u32x4 ^= vnet_classify_data_u32x4 (h, 2) & mask[2];
+  if (n > 3)
+    xor_sum.as_u32x4 ^= vnet_classify_data_u32x4 (h, 3) & mask[3];
+  if (n > 4)
+    xor_sum.as_u32x4 ^= vnet_classify_data_u32x4 (h, 4) & mask[4];
+#else
+  {
+    u64 *data64 = (u64 *) h;
+    u64 *mask64 = (u64 *) mask;
+    u32 i;
+
+    xor_sum.as_u64[0] = data64[0] & mask64[0];
+    xor_sum.as_u64[1] = data64[1] & mask64[1];
+    for (i = 1; i < n; i++)
+      {
+	xor_sum.as_u64[0] ^= data64[2 * i] & mask64[2 * i];
+	xor_sum.as_u64[1] ^= data64[2 * i + 1] & mask64[2 * i + 1];
+      }
+  }
 #endif /* CLASSIFY_USE_SSE */
-    {
-      u32 skip_u64 = t->skip_n_vectors * 2;
-      u64 *data64 = (u64 *) h;
-      xor_sum.as_u64[0] = data64[0 + skip_u64] & ((u64 *) mask)[0];
-      xor_sum.as_u64[1] = data64[1 + skip_u64] & ((u64 *) mask)[1];
-      switch (t->match_n_vectors)
-	{
-	case 5:
-	  xor_sum.as_u64[0] ^= data64[8 + skip_u64] & ((u64 *) mask)[8];
-	  xor_sum.as_u64[1] ^= data64[9 + skip_u64] & ((u64 *) mask)[9];
-	  /* FALLTHROUGH */
-	case 4:
-	  xor_sum.as_u64[0] ^= data64[6 + skip_u64] & ((u64 *) mask)[6];
-	  xor_sum.as_u64[1] ^= data64[7 + skip_u64] & ((u64 *) mask)[7];
-	  /* FALLTHROUGH */
-	case 3:
-	  xor_sum.as_u64[0] ^= data64[4 + skip_u64] & ((u64 *) mask)[4];
-	  xor_sum.as_u64[1] ^= data64[5 + skip_u64] & ((u64 *) mask)[5];
-	  /* FALLTHROUGH */
-	case 2:
-	  xor_sum.as_u64[0] ^= data64[2 + skip_u64] & ((u64 *) mask)[2];
-	  xor_sum.as_u64[1] ^= data64[3 + skip_u64] & ((u64 *) mask)[3];
-	  /* FALLTHROUGH */
-	case 1:
-	  break;
-
-	default:
-	  abort ();
-	}
-    }
 
   return clib_xxhash (xor_sum.as_u64[0] ^ xor_sum.as_u64[1]);
 }
 
+#define _(size)								\
+static inline u64							\
+vnet_classify_hash_packet_##size (vnet_classify_table_t * t, u8 * h)	\
+{									\
+  return vnet_classify_hash_packet_n (t, h, size);			\
+}
+foreach_size_in_u32x4;
+#undef _
+
+static inline u64
+vnet_classify_hash_packet_inline (vnet_classify_table_t * t, u8 * h)
+{
+  switch (t->match_n_vectors)
+    {
+#define _(size)							\
+    case size:							\
+      return vnet_classify_hash_packet_##size (t, h);
+      foreach_size_in_u32x4;
+#undef _
+    default:
+      abort ();
+    }
+  return 0;
+}
+
 static inline void
 vnet_classify_prefetch_bucket (vnet_classify_table_t * t, u64 hash)
 {
@@ -369,9 +386,9 @@ vnet_classify_prefetch_entry (vnet_classify_table_t * t, u64 hash)
 vnet_classify_entry_t *vnet_classify_find_entry (vnet_classify_table_t * t,
 						 u8 * h, u64 hash, f64 now);
 
-static inline vnet_classify_entry_t *
-vnet_classify_find_entry_inline (vnet_classify_table_t * t,
-				 u8 * h, u64 hash, f64 now)
+static_always_inline vnet_classify_entry_t *
+vnet_classify_find_entry_n (vnet_classify_table_t * t,
+			    u8 * h, u64 hash, f64 now, u32 n)
 {
   vnet_classify_entry_t *v;
   u32x4 *mask, *key;
@@ -386,6 +403,8 @@ vnet_classify_find_entry_inline (vnet_classify_table_t * t,
   u32 limit;
   int i;
 
+  ASSERT (t->match_n_vectors == n);
+
   bucket_index = hash & (t->nbuckets - 1);
   b = &t->buckets[bucket_index];
   mask = t->mask;
@@ -404,111 +423,289 @@ vnet_classify_find_entry_inline (vnet_classify_table_t * t,
       limit *= (1 << b->log2_pages);
     }
 
-  v = vnet_classify_entry_at_index (t, v, value_index);
+  v = (vnet_classify_entry_t *) ((u8 *) v + value_index *
+				 (sizeof (vnet_classify_entry_t) +
+				  n * sizeof (u32x4)));
+  h += t->skip_n_vectors * sizeof (u32x4);
 
 #ifdef CLASSIFY_USE_SSE
-  if (U32X4_ALIGNED (h))
+  {
+    u32x4 d0, d1 = { }, d2 = { }, d3 = { }, d4 = { };
+
+    d0 = vnet_classify_data_u32x4 (h, 0) & mask[0];
+    if (n > 1)
+      d1 = vnet_classify_data_u32x4 (h, 1) & mask[1];
+    if (n > 2)
+      d2 = vnet_classify_data_u32x4 (h, 2) & mask[2];
+    if (n > 3)
+      d3 = vnet_classify_data_u32x4 (h, 3) & mask[3];
+    if (n > 4)
+      d4 = vnet_classify_data_u32x4 (h, 4) & mask[4];
+
+    for (i = 0; i < limit; i++)
+      {
+	key = v->key;
+	result.as_u32x4 = d0 ^ key[0];
+	if (n > 1)
+	  result.as_u32x4 |= d1 ^ key[1];
+	if (n > 2)
+	  result.as_u32x4 |= d2 ^ key[2];
+	if (n > 3)
+	  result.as_u32x4 |= d3 ^ key[3];
+	if (n > 4)
+	  result.as_u32x4 |= d4 ^ key[4];
+
+	if (u32x4_zero_byte_mask (result.as_u32x4) == 0xffff)
+	  {
+	    if (PREDICT_TRUE (now))
+	      {
+		v->hits++;
+		v->last_heard = now;
+	      }
+	    return (v);
+	  }
+	v = (vnet_classify_entry_t *) (key + n);
+      }
+  }
+#else
+  {
+    u64 *data64 = (u64 *) h;
+    u64 *mask64 = (u64 *) mask;
+    u64 d[10];
+    int j;
+
+    for (j = 0; j < 2 * n; j++)
+      d[j] = data64[j] & mask64[j];
+
+    for (i = 0; i < limit; i++)
+      {
+	u64 *key64;
+
+	key = v->key;
+	key64 = (u64 *) key;
+	result.as_u64[0] = d[0] ^ key64[0];
+	result.as_u64[1] = d[1] ^ key64[1];
+	for (j = 1; j < n; j++)
+	  {
+	    result.as_u64[0] |= d[2 * j] ^ key64[2 * j];
+	    result.as_u64[1] |= d[2 * j + 1] ^ key64[2 * j + 1];
+	  }
+
+	if (result.as_u64[0] == 0 && result.as_u64[1] == 0)
+	  {
+	    if (PREDICT_TRUE (now))
+	      {
+		v->hits++;
+		v->last_heard = now;
+	      }
+	    return (v);
+	  }
+	v = (vnet_classify_entry_t *) (key + n);
+      }
+  }
+#endif /* CLASSIFY_USE_SSE */
+  return 0;
+}
+
+#define _(size)								\
+static inline vnet_classify_entry_t *					\
+vnet_classify_find_entry_##size (vnet_classify_table_t * t,		\
+				 u8 * h, u64 hash, f64 now)		\
+{									\
+  return vnet_classify_find_entry_n (t, h, hash, now, size);		\
+}
+foreach_size_in_u32x4;
+#undef _
+
+static inline vnet_classify_entry_t *
+vnet_classify_find_entry_inline (vnet_classify_table_t * t,
+				 u8 * h, u64 hash, f64 now)
+{
+  switch (t->match_n_vectors)
+    {
+#define _(size)							\
+    case size:							\
+      return vnet_classify_find_entry_##size (t, h, hash, now);
+      foreach_size_in_u32x4;
+#undef _
+    default:
+      abort ();
+    }
+  return 0;
+}
+
+static_always_inline u8 *
+vnet_classify_chain_data (vlib_buffer_t * b, vnet_classify_table_t * t,
+			  int from_current_data, int honor_data_flag)
+{
+  if (honor_data_flag && t->current_data_flag == CLASSIFY_FLAG_USE_CURR_DATA)
+    return (u8 *) vlib_buffer_get_current (b) + t->current_data_offset;
+  return from_current_data ? vlib_buffer_get_current (b) : b->data;
+}
+
+/*
+ * Chained lookup of a frame of packets, pipelined across the packets.
+ *
+ * The first table and hash of each packet are taken from
+ * vnet_buffer (b)->l2_classify, as left by the hashing pass of the
+ * classify nodes, a table index of ~0 meaning no lookup. Instead of each
+ * packet walking its chain alone, the packets which missed a table are
+ * hashed into the next table of their chain and get their buckets and
+ * entries prefetched together, one round per depth of the chains.
+ *
+ * When the first table has parallel_lookup set, the packet is hashed
+ * into the following VNET_CLASSIFY_PARALLEL_MAX_TABLES - 1 tables of the
+ * chain up front and all their buckets are prefetched before the first
+ * probe. The tables are then probed in chain order, so the first hit
+ * still wins, without waiting on one miss before fetching the next
+ * bucket. Deeper tables go through the rounds above.
+ *
+ * The tables match on b->data, or on the current data with
+ * from_current_data set; with honor_data_flag set the tables created
+ * with CLASSIFY_FLAG_USE_CURR_DATA match at their current data offset.
+ * On return entries[i] is the hit of packet i or 0 and table_indices[i]
+ * the table of the hit, or the last table tried on a miss. Returns the
+ * number of hits in a table other than the first one.
+ */
+static_always_inline u32
+vnet_classify_find_entries_chained (vlib_main_t * vm,
+				    vnet_classify_main_t * cm,
+				    u32 * buffers, u32 n_buffers,
+				    vnet_classify_entry_t ** entries,
+				    u32 * table_indices, f64 now,
+				    int from_current_data, int honor_data_flag)
+{
+  vnet_classify_table_t *t;
+  vnet_classify_entry_t *e;
+  vlib_buffer_t *b;
+  u64 hashes[VLIB_FRAME_SIZE];
+  u64 parallel_hashes[VLIB_FRAME_SIZE][VNET_CLASSIFY_PARALLEL_MAX_TABLES - 1];
+  u8 n_parallel[VLIB_FRAME_SIZE];
+  u32 pending[VLIB_FRAME_SIZE];
+  u32 i, j, n_pending = 0, n_left, chain_hits = 0;
+  u8 *h;
+
+  ASSERT (n_buffers <= VLIB_FRAME_SIZE);
+
+  /* Hash the chains of the parallel lookup tables up front */
+  for (i = 0; i < n_buffers; i++)
     {
-      u32x4 *data = (u32x4 *) h;
-      for (i = 0; i < limit; i++)
+      b = vlib_get_buffer (vm, buffers[i]);
+      n_parallel[i] = 0;
+      if (PREDICT_FALSE (vnet_buffer (b)->l2_classify.table_index == ~0))
+	continue;
+
+      t = pool_elt_at_index (cm->tables,
+			     vnet_buffer (b)->l2_classify.table_index);
+      if (PREDICT_TRUE (!t->parallel_lookup))
+	continue;
+
+      for (j = 0; j < VNET_CLASSIFY_PARALLEL_MAX_TABLES - 1; j++)
 	{
-	  key = v->key;
-	  result.as_u32x4 = (data[0 + t->skip_n_vectors] & mask[0]) ^ key[0];
-	  switch (t->match_n_vectors)
-	    {
-	    case 5:
-	      result.as_u32x4 |=
-		(data[4 + t->skip_n_vectors] & mask[4]) ^ key[4];
-	      /* FALLTHROUGH */
-	    case 4:
-	      result.as_u32x4 |=
-		(data[3 + t->skip_n_vectors] & mask[3]) ^ key[3];
-	      /* FALLTHROUGH */
-	    case 3:
-	      result.as_u32x4 |=
-		(data[2 + t->skip_n_vectors] & mask[2]) ^ key[2];
-	      /* FALLTHROUGH */
-	    case 2:
-	      result.as_u32x4 |=
-		(data[1 + t->skip_n_vectors] & mask[1]) ^ key[1];
-	      /* FALLTHROUGH */
-	    case 1:
-	      break;
-	    default:
-	      abort ();
-	    }
+	  if (t->next_table_index == ~0)
+	    break;
+	  t = pool_elt_at_index (cm->tables, t->next_table_index);
+	  h = vnet_classify_chain_data (b, t, from_current_data,
+					honor_data_flag);
+	  parallel_hashes[i][j] = vnet_classify_hash_packet_inline (t, h);
+	  vnet_classify_prefetch_bucket (t, parallel_hashes[i][j]);
+	}
+      n_parallel[i] = j;
+    }
 
-	  if (u32x4_zero_byte_mask (result.as_u32x4) == 0xffff)
+  /* First tables, their buckets were prefetched by the hashing pass */
+  for (i = 0; i < n_buffers; i++)
+    {
+      /* Stride 3 seems to work best */
+      if (PREDICT_TRUE (i + 3 < n_buffers))
+	{
+	  b = vlib_get_buffer (vm, buffers[i + 3]);
+	  if (PREDICT_TRUE (vnet_buffer (b)->l2_classify.table_index != ~0))
 	    {
-	      if (PREDICT_TRUE (now))
+	      t = pool_elt_at_index (cm->tables,
+				     vnet_buffer (b)->l2_classify.table_index);
+	      vnet_classify_prefetch_entry (t,
+					    vnet_buffer (b)->l2_classify.hash);
+	      for (j = 0; j < n_parallel[i + 3]; j++)
 		{
-		  v->hits++;
-		  v->last_heard = now;
+		  t = pool_elt_at_index (cm->tables, t->next_table_index);
+		  vnet_classify_prefetch_entry (t, parallel_hashes[i + 3][j]);
 		}
-	      return (v);
 	    }
-	  v = vnet_classify_entry_at_index (t, v, 1);
 	}
+
+      b = vlib_get_buffer (vm, buffers[i]);
+      entries[i] = 0;
+      table_indices[i] = vnet_buffer (b)->l2_classify.table_index;
+      if (PREDICT_FALSE (table_indices[i] == ~0))
+	continue;
+
+      t = pool_elt_at_index (cm->tables, table_indices[i]);
+      h = vnet_classify_chain_data (b, t, from_current_data,
+				    honor_data_flag);
+      e = vnet_classify_find_entry_inline (t, h,
+					   vnet_buffer (b)->l2_classify.hash,
+					   now);
+
+      for (j = 0; !e && j < n_parallel[i]; j++)
+	{
+	  table_indices[i] = t->next_table_index;
+	  t = pool_elt_at_index (cm->tables, table_indices[i]);
+	  h = vnet_classify_chain_data (b, t, from_current_data,
+					honor_data_flag);
+	  e = vnet_classify_find_entry_inline (t, h, parallel_hashes[i][j],
+					       now);
+	  chain_hits += (e != 0);
+	}
+
+      entries[i] = e;
+      if (!e && t->next_table_index != ~0)
+	pending[n_pending++] = i;
     }
-  else
-#endif /* CLASSIFY_USE_SSE */
+
+  /* Then one table further down the chains per round */
+  while (n_pending)
     {
-      u32 skip_u64 = t->skip_n_vectors * 2;
-      u64 *data64 = (u64 *) h;
-      for (i = 0; i < limit; i++)
+      for (j = 0; j < n_pending; j++)
 	{
-	  key = v->key;
+	  i = pending[j];
+	  t = pool_elt_at_index (cm->tables, table_indices[i]);
+	  table_indices[i] = t->next_table_index;
+	  t = pool_elt_at_index (cm->tables, table_indices[i]);
+	  b = vlib_get_buffer (vm, buffers[i]);
+	  h = vnet_classify_chain_data (b, t, from_current_data,
+					honor_data_flag);
+	  hashes[j] = vnet_classify_hash_packet_inline (t, h);
+	  vnet_classify_prefetch_bucket (t, hashes[j]);
+	}
 
-	  result.as_u64[0] =
-	    (data64[0 + skip_u64] & ((u64 *) mask)[0]) ^ ((u64 *) key)[0];
-	  result.as_u64[1] =
-	    (data64[1 + skip_u64] & ((u64 *) mask)[1]) ^ ((u64 *) key)[1];
-	  switch (t->match_n_vectors)
-	    {
-	    case 5:
-	      result.as_u64[0] |=
-		(data64[8 + skip_u64] & ((u64 *) mask)[8]) ^ ((u64 *) key)[8];
-	      result.as_u64[1] |=
-		(data64[9 + skip_u64] & ((u64 *) mask)[9]) ^ ((u64 *) key)[9];
-	      /* FALLTHROUGH */
-	    case 4:
-	      result.as_u64[0] |=
-		(data64[6 + skip_u64] & ((u64 *) mask)[6]) ^ ((u64 *) key)[6];
-	      result.as_u64[1] |=
-		(data64[7 + skip_u64] & ((u64 *) mask)[7]) ^ ((u64 *) key)[7];
-	      /* FALLTHROUGH */
-	    case 3:
-	      result.as_u64[0] |=
-		(data64[4 + skip_u64] & ((u64 *) mask)[4]) ^ ((u64 *) key)[4];
-	      result.as_u64[1] |=
-		(data64[5 + skip_u64] & ((u64 *) mask)[5]) ^ ((u64 *) key)[5];
-	      /* FALLTHROUGH */
-	    case 2:
-	      result.as_u64[0] |=
-		(data64[2 + skip_u64] & ((u64 *) mask)[2]) ^ ((u64 *) key)[2];
-	      result.as_u64[1] |=
-		(data64[3 + skip_u64] & ((u64 *) mask)[3]) ^ ((u64 *) key)[3];
-	      /* FALLTHROUGH */
-	    case 1:
-	      break;
-	    default:
-	      abort ();
-	    }
+      for (j = 0; j < n_pending; j++)
+	{
+	  t = pool_elt_at_index (cm->tables, table_indices[pending[j]]);
+	  vnet_classify_prefetch_entry (t, hashes[j]);
+	}
 
-	  if (result.as_u64[0] == 0 && result.as_u64[1] == 0)
+      n_left = n_pending;
+      n_pending = 0;
+      for (j = 0; j < n_left; j++)
+	{
+	  i = pending[j];
+	  t = pool_elt_at_index (cm->tables, table_indices[i]);
+	  b = vlib_get_buffer (vm, buffers[i]);
+	  h = vnet_classify_chain_data (b, t, from_current_data,
+					honor_data_flag);
+	  e = vnet_classify_find_entry_inline (t, h, hashes[j], now);
+	  if (e)
 	    {
-	      if (PREDICT_TRUE (now))
-		{
-		  v->hits++;
-		  v->last_heard = now;
-		}
-	      return (v);
+	      entries[i] = e;
+	      chain_hits++;
 	    }
-
-	  v = vnet_classify_entry_at_index (t, v, 1);
+	  else if (t->next_table_index != ~0)
+	    pending[n_pending++] = i;
 	}
     }
-  return 0;
+
+  return chain_hits;
 }
 
 vnet_classify_table_t *vnet_classify_new_table (vnet_classify_main_t * cm,
@@ -538,6 +735,9 @@ int vnet_classify_add_del_table (vnet_classify_main_t * cm,
 				 i16 current_data_offset,
 				 int is_add, int del_chain);
 
+int vnet_classify_set_parallel_lookup (vnet_classify_main_t * cm,
+				       u32 table_index, int is_enable);
+
 unformat_function_t unformat_ip4_mask;
 unformat_function_t unformat_ip6_mask;
 unformat_function_t unformat_l3_mask;
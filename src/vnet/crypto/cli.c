@@ -0,0 +1,175 @@
+/*
+ * cli.c : crypto engine debug CLI
+ *
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vnet/crypto/crypto.h>
+
+static clib_error_t *
+show_crypto_engines_command_fn (vlib_main_t * vm,
+				unformat_input_t * input,
+				vlib_cli_command_t * cmd)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *p;
+
+  if (vec_len (cm->engines) == 0)
+    {
+      vlib_cli_output (vm, "No crypto engines registered");
+      return 0;
+    }
+
+  vlib_cli_output (vm, "%-20s%-8s%-7s%s", "Name", "Prio", "Async",
+		   "Description");
+  /* *INDENT-OFF* */
+  vec_foreach (p, cm->engines)
+    {
+      vlib_cli_output (vm, "%-20s%-8u%-7s%s", p->name, p->priority,
+		       p->enqueue_handler ? "yes" : "no", p->desc);
+    }
+  /* *INDENT-ON* */
+  return 0;
+}
+
+/*?
+ * List the registered crypto engines.
+ *
+ * @cliexpar
+ * @cliexstart{show crypto engines}
+ * Name                Prio    Async  Description
+ * sw_scheduler        100     yes    SW Scheduler Async Engine
+ * openssl             50      no     OpenSSL
+ * vaes                100     no     Native AES, VAES and VPCLMULQDQ
+ * @cliexend
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_crypto_engines_command, static) =
+{
+  .path = "show crypto engines",
+  .short_help = "show crypto engines",
+  .function = show_crypto_engines_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+show_crypto_handlers_command_fn (vlib_main_t * vm,
+				 unformat_input_t * input,
+				 vlib_cli_command_t * cmd)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_op_id_t opt;
+  vnet_crypto_engine_t *e;
+  u8 *s = 0;
+
+  vlib_cli_output (vm, "%-20s%-16s%s", "Op", "Active", "Candidates");
+
+  for (opt = VNET_CRYPTO_OP_NONE + 1; opt < VNET_CRYPTO_N_OP_IDS; opt++)
+    {
+      /* *INDENT-OFF* */
+      vec_foreach (e, cm->engines)
+	if (e->ops_handlers[opt])
+	  s = format (s, "%s ", e->name);
+      /* *INDENT-ON* */
+
+      vlib_cli_output (vm, "%-20U%-16U%v", format_vnet_crypto_op, opt,
+		       format_vnet_crypto_engine,
+		       cm->active_engine_index_by_op[opt], s);
+      vec_reset_length (s);
+    }
+
+  vlib_cli_output (vm, "async: %U", format_vnet_crypto_engine,
+		   cm->async_engine_index);
+  vec_free (s);
+  return 0;
+}
+
+/*?
+ * Show which engine runs each crypto op.
+ *
+ * @cliexpar
+ * @cliexstart{show crypto handlers}
+ * Op                  Active          Candidates
+ * des-cbc-enc         openssl         openssl
+ * ...
+ * aes-128-gcm-enc     vaes            openssl vaes
+ * async: sw_scheduler
+ * @cliexend
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_crypto_handlers_command, static) =
+{
+  .path = "show crypto handlers",
+  .short_help = "show crypto handlers",
+  .function = show_crypto_handlers_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+set_crypto_handler_command_fn (vlib_main_t * vm,
+			       unformat_input_t * input,
+			       vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  u8 *op_name = 0, *engine = 0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return clib_error_return (0, "expected arguments");
+
+  if (!unformat (line_input, "%s %s", &op_name, &engine))
+    {
+      error = clib_error_return (0, "unknown input '%U'",
+				 format_unformat_error, line_input);
+      goto done;
+    }
+
+  vec_add1 (op_name, 0);
+  vec_add1 (engine, 0);
+
+  if (vnet_crypto_set_handler ((char *) op_name, (char *) engine))
+    error = clib_error_return (0, "failed to set engine %s for %s",
+			       engine, op_name);
+
+done:
+  vec_free (op_name);
+  vec_free (engine);
+  unformat_free (line_input);
+  return error;
+}
+
+/*?
+ * Select the engine for one op, or for every op the engine implements.
+ *
+ * @cliexpar
+ * @cliexstart{set crypto handler aes-128-gcm-enc openssl}
+ * @cliexend
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_crypto_handler_command, static) =
+{
+  .path = "set crypto handler",
+  .short_help = "set crypto handler <op|all> <engine>",
+  .function = set_crypto_handler_command_fn,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
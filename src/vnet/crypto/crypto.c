@@ -0,0 +1,403 @@
+/*
+ * crypto.c : data plane crypto ops and engines
+ *
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vnet/crypto/crypto.h>
+
+vnet_crypto_main_t crypto_main;
+
+static_always_inline u32
+vnet_crypto_process_ops_call_handler (vlib_main_t * vm,
+				      vnet_crypto_main_t * cm,
+				      vnet_crypto_op_id_t opt,
+				      vnet_crypto_op_t * ops, u32 n_ops)
+{
+  u32 i;
+
+  if (n_ops == 0)
+    return 0;
+
+  if (PREDICT_FALSE (cm->ops_handlers[opt] == 0))
+    {
+      for (i = 0; i < n_ops; i++)
+	ops[i].status = VNET_CRYPTO_OP_STATUS_FAIL_NO_HANDLER;
+      return 0;
+    }
+
+  return (cm->ops_handlers[opt]) (vm, ops, n_ops);
+}
+
+u32
+vnet_crypto_process_ops (vlib_main_t * vm, vnet_crypto_op_t ops[], u32 n_ops)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  u32 i, n_start = 0, rv = 0;
+
+  /* one handler call per run of ops with the same op id */
+  for (i = 1; i <= n_ops; i++)
+    if (i == n_ops || ops[i].op != ops[n_start].op)
+      {
+	rv += vnet_crypto_process_ops_call_handler (vm, cm, ops[n_start].op,
+						    ops + n_start,
+						    i - n_start);
+	n_start = i;
+      }
+
+  return rv;
+}
+
+u32
+vnet_crypto_register_engine (vlib_main_t * vm, char *name, int prio,
+			     char *desc)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *p;
+
+  vec_add2 (cm->engines, p, 1);
+  p->name = name;
+  p->desc = desc;
+  p->priority = prio;
+
+  hash_set_mem (cm->engine_index_by_name, p->name, p - cm->engines);
+
+  return p - cm->engines;
+}
+
+void
+vnet_crypto_register_ops_handler (vlib_main_t * vm, u32 engine_index,
+				  vnet_crypto_op_id_t opt,
+				  vnet_crypto_ops_handler_t * fn)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *ae, *e = vec_elt_at_index (cm->engines,
+						   engine_index);
+
+  ASSERT (opt > VNET_CRYPTO_OP_NONE && opt < VNET_CRYPTO_N_OP_IDS);
+  e->ops_handlers[opt] = fn;
+
+  /* the handler of the highest priority engine is used */
+  if (cm->active_engine_index_by_op[opt] == ~0)
+    {
+      cm->active_engine_index_by_op[opt] = engine_index;
+      cm->ops_handlers[opt] = fn;
+      return;
+    }
+
+  ae = vec_elt_at_index (cm->engines, cm->active_engine_index_by_op[opt]);
+  if (ae->priority < e->priority)
+    {
+      cm->active_engine_index_by_op[opt] = engine_index;
+      cm->ops_handlers[opt] = fn;
+    }
+}
+
+void
+vnet_crypto_register_key_handler (vlib_main_t * vm, u32 engine_index,
+				  vnet_crypto_key_handler_t * key_handler)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *e = vec_elt_at_index (cm->engines, engine_index);
+
+  e->key_op_handler = key_handler;
+}
+
+void
+vnet_crypto_register_async_handler (vlib_main_t * vm, u32 engine_index,
+				    vnet_crypto_frame_enqueue_t * enq,
+				    vnet_crypto_frame_dequeue_t * deq)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *e = vec_elt_at_index (cm->engines, engine_index);
+
+  e->enqueue_handler = enq;
+  e->dequeue_handler = deq;
+
+  if (cm->async_engine_index != ~0 &&
+      cm->engines[cm->async_engine_index].priority >= e->priority)
+    return;
+
+  cm->async_engine_index = engine_index;
+  cm->enqueue_handler = enq;
+  cm->dequeue_handler = deq;
+}
+
+static void
+vnet_crypto_set_op_handler (vnet_crypto_op_id_t opt, u32 engine_index)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *e = vec_elt_at_index (cm->engines, engine_index);
+
+  if (e->ops_handlers[opt] == 0)
+    return;
+
+  cm->active_engine_index_by_op[opt] = engine_index;
+  cm->ops_handlers[opt] = e->ops_handlers[opt];
+}
+
+int
+vnet_crypto_set_handler (char *op_name, char *engine)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_op_id_t opt;
+  uword *p;
+  u32 ei;
+
+  p = hash_get_mem (cm->engine_index_by_name, engine);
+  if (!p)
+    return -1;
+  ei = p[0];
+
+  if (!strcmp (op_name, "all"))
+    {
+      for (opt = VNET_CRYPTO_OP_NONE + 1; opt < VNET_CRYPTO_N_OP_IDS; opt++)
+	vnet_crypto_set_op_handler (opt, ei);
+      return 0;
+    }
+
+  p = hash_get_mem (cm->op_id_by_name, op_name);
+  if (!p)
+    return -1;
+
+  if (cm->engines[ei].ops_handlers[p[0]] == 0)
+    return -1;
+
+  vnet_crypto_set_op_handler (p[0], ei);
+  return 0;
+}
+
+u32
+vnet_crypto_key_add (vlib_main_t * vm, vnet_crypto_alg_t alg, u8 * data,
+		     u16 length)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *engine;
+  vnet_crypto_key_t *key;
+  u32 index;
+
+  pool_get (cm->keys, key);
+  memset (key, 0, sizeof (*key));
+  index = key - cm->keys;
+  key->alg = alg;
+  vec_validate_aligned (key->data, length - 1, CLIB_CACHE_LINE_BYTES);
+  clib_memcpy (key->data, data, length);
+
+  /* *INDENT-OFF* */
+  vec_foreach (engine, cm->engines)
+    if (engine->key_op_handler)
+      engine->key_op_handler (vm, VNET_CRYPTO_KEY_OP_ADD, index);
+  /* *INDENT-ON* */
+
+  return index;
+}
+
+void
+vnet_crypto_key_del (vlib_main_t * vm, u32 index)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *engine;
+  vnet_crypto_key_t *key = pool_elt_at_index (cm->keys, index);
+
+  /* *INDENT-OFF* */
+  vec_foreach (engine, cm->engines)
+    if (engine->key_op_handler)
+      engine->key_op_handler (vm, VNET_CRYPTO_KEY_OP_DEL, index);
+  /* *INDENT-ON* */
+
+  memset (key->data, 0, vec_len (key->data));
+  vec_free (key->data);
+  pool_put (cm->keys, key);
+}
+
+static void
+vnet_crypto_alloc_frames (void)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_thread_t *ct;
+  i32 i;
+
+  /* *INDENT-OFF* */
+  vec_foreach (ct, cm->threads)
+    {
+      if (ct->frames)
+	continue;
+      vec_validate_aligned (ct->frames, VNET_CRYPTO_FRAME_POOL_SIZE - 1,
+			    CLIB_CACHE_LINE_BYTES);
+      for (i = VNET_CRYPTO_FRAME_POOL_SIZE - 1; i >= 0; i--)
+	vec_add1 (ct->free_frames, i);
+    }
+  /* *INDENT-ON* */
+}
+
+void
+vnet_crypto_request_async_mode (int is_enable)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vlib_node_state_t state;
+  u32 i;
+
+  if (is_enable)
+    {
+      if (cm->async_refcount++)
+	return;
+      vnet_crypto_alloc_frames ();
+      state = VLIB_NODE_STATE_POLLING;
+    }
+  else
+    {
+      ASSERT (cm->async_refcount > 0);
+      if (--cm->async_refcount)
+	return;
+      state = VLIB_NODE_STATE_DISABLED;
+    }
+
+  for (i = 0; i < tm->n_vlib_mains; i++)
+    vlib_node_set_state (vlib_mains[i], crypto_dispatch_node.index, state);
+}
+
+u32
+vnet_crypto_register_post_node (vlib_main_t * vm, char *post_node_name)
+{
+  vlib_node_t *pn = vlib_get_node_by_name (vm, (u8 *) post_node_name);
+
+  ASSERT (pn);
+  return vlib_node_add_next (vm, crypto_dispatch_node.index, pn->index);
+}
+
+vnet_crypto_async_frame_t *
+vnet_crypto_async_get_frame (vlib_main_t * vm, vnet_crypto_op_id_t opt)
+{
+  vnet_crypto_thread_t *ct =
+    vec_elt_at_index (crypto_main.threads, vm->thread_index);
+  vnet_crypto_async_frame_t *f;
+  u32 n_free = vec_len (ct->free_frames);
+
+  if (PREDICT_FALSE (n_free == 0))
+    return 0;
+
+  f = vec_elt_at_index (ct->frames, ct->free_frames[n_free - 1]);
+  _vec_len (ct->free_frames) = n_free - 1;
+  f->state = VNET_CRYPTO_FRAME_STATE_NOT_PROCESSED;
+  f->op = opt;
+  f->n_elts = 0;
+  return f;
+}
+
+void
+vnet_crypto_async_free_frame (vlib_main_t * vm, vnet_crypto_async_frame_t * f)
+{
+  vnet_crypto_thread_t *ct =
+    vec_elt_at_index (crypto_main.threads, vm->thread_index);
+
+  ASSERT (f >= ct->frames && f < vec_end (ct->frames));
+  f->state = VNET_CRYPTO_FRAME_STATE_NOT_PROCESSED;
+  vec_add1 (ct->free_frames, f - ct->frames);
+}
+
+u8 *
+format_vnet_crypto_alg (u8 * s, va_list * args)
+{
+  vnet_crypto_alg_t alg = va_arg (*args, vnet_crypto_alg_t);
+  char *t = 0;
+
+  switch (alg)
+    {
+#define _(n, str) case VNET_CRYPTO_ALG_##n: t = str; break;
+      foreach_crypto_alg
+#undef _
+    default:
+      return format (s, "unknown");
+    }
+  return format (s, "%s", t);
+}
+
+u8 *
+format_vnet_crypto_op (u8 * s, va_list * args)
+{
+  vnet_crypto_op_id_t opt = va_arg (*args, vnet_crypto_op_id_t);
+
+  if (opt <= VNET_CRYPTO_OP_NONE || opt >= VNET_CRYPTO_N_OP_IDS)
+    return format (s, "unknown");
+
+  return format (s, "%U-%s", format_vnet_crypto_alg, vnet_crypto_op_alg (opt),
+		 vnet_crypto_op_is_encrypt (opt) ? "enc" : "dec");
+}
+
+u8 *
+format_vnet_crypto_op_status (u8 * s, va_list * args)
+{
+  vnet_crypto_op_status_t st = va_arg (*args, vnet_crypto_op_status_t);
+  char *t = 0;
+
+  switch (st)
+    {
+#define _(n, str) case VNET_CRYPTO_OP_STATUS_##n: t = str; break;
+      foreach_crypto_op_status
+#undef _
+    default:
+      return format (s, "unknown");
+    }
+  return format (s, "%s", t);
+}
+
+u8 *
+format_vnet_crypto_engine (u8 * s, va_list * args)
+{
+  u32 engine_index = va_arg (*args, u32);
+  vnet_crypto_engine_t *e;
+
+  if (engine_index == ~0)
+    return format (s, "none");
+
+  e = vec_elt_at_index (crypto_main.engines, engine_index);
+  return format (s, "%s", e->name);
+}
+
+clib_error_t *
+vnet_crypto_init (vlib_main_t * vm)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vnet_crypto_op_id_t opt;
+
+  cm->engine_index_by_name = hash_create_string ( /* size */ 0,
+						 sizeof (uword));
+  cm->op_id_by_name = hash_create_string (0, sizeof (uword));
+  cm->async_engine_index = ~0;
+
+  for (opt = VNET_CRYPTO_OP_NONE + 1; opt < VNET_CRYPTO_N_OP_IDS; opt++)
+    {
+      u8 *name = format (0, "%U%c", format_vnet_crypto_op, opt, 0);
+      hash_set_mem (cm->op_id_by_name, name, opt);
+      cm->active_engine_index_by_op[opt] = ~0;
+    }
+
+  vec_validate_aligned (cm->threads, tm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (vnet_crypto_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
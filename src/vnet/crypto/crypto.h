@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef included_vnet_crypto_crypto_h
+#define included_vnet_crypto_crypto_h
+
+#include <vlib/vlib.h>
+
+/*
+ * Cipher operations for the data plane.
+ *
+ * Users describe the work on a packet as a vnet_crypto_op_t and either
+ * run a vector of ops in place with vnet_crypto_process_ops (), or, in
+ * async mode, put them into a frame which is handed to an async engine.
+ * Completed frames are returned by the crypto-dispatch input node on the
+ * thread which submitted them, and their buffers are sent to the post
+ * node given for each op.
+ *
+ * Keys are registered once, engines expand them into whatever form they
+ * need and ops only carry the key index.
+ */
+
+#define foreach_crypto_alg			\
+  _(DES_CBC, "des-cbc")				\
+  _(3DES_CBC, "3des-cbc")			\
+  _(AES_128_CBC, "aes-128-cbc")			\
+  _(AES_192_CBC, "aes-192-cbc")			\
+  _(AES_256_CBC, "aes-256-cbc")			\
+  _(AES_128_GCM, "aes-128-gcm")			\
+  _(AES_192_GCM, "aes-192-gcm")			\
+  _(AES_256_GCM, "aes-256-gcm")
+
+typedef enum
+{
+  VNET_CRYPTO_ALG_NONE = 0,
+#define _(n, s) VNET_CRYPTO_ALG_##n,
+  foreach_crypto_alg
+#undef _
+    VNET_CRYPTO_N_ALGS,
+} vnet_crypto_alg_t;
+
+/* an encrypt and a decrypt op per algorithm, in this order */
+typedef enum
+{
+  VNET_CRYPTO_OP_NONE = 0,
+#define _(n, s) VNET_CRYPTO_OP_##n##_ENC, VNET_CRYPTO_OP_##n##_DEC,
+  foreach_crypto_alg
+#undef _
+    VNET_CRYPTO_N_OP_IDS,
+} vnet_crypto_op_id_t;
+
+#define foreach_crypto_op_status		\
+  _(NOT_PROCESSED, "not-processed")		\
+  _(COMPLETED, "completed")			\
+  _(FAIL_BAD_TAG, "bad-tag")			\
+  _(FAIL_NO_HANDLER, "no-handler")
+
+typedef enum
+{
+#define _(n, s) VNET_CRYPTO_OP_STATUS_##n,
+  foreach_crypto_op_status
+#undef _
+    VNET_CRYPTO_OP_N_STATUS,
+} vnet_crypto_op_status_t;
+
+/* One cipher operation on one packet */
+typedef struct
+{
+  u8 *src;
+  u8 *dst;
+  u8 *iv;
+  /* aead only, tag to write or to verify */
+  u8 *tag;
+  u32 len;
+  u32 key_index;
+  u32 user_data;
+  u16 op;
+  u8 status;
+  u8 aad_len;
+  /* aead only, copied so ops can outlive the caller's frame */
+  u8 aad[12];
+} vnet_crypto_op_t;
+
+typedef struct
+{
+  vnet_crypto_alg_t alg;
+  /* key material; for aes-gcm followed by the 4 byte salt */
+  u8 *data;
+} vnet_crypto_key_t;
+
+typedef enum
+{
+  VNET_CRYPTO_KEY_OP_ADD,
+  VNET_CRYPTO_KEY_OP_DEL,
+} vnet_crypto_key_op_t;
+
+/* process a vector of ops sharing the same op id, set the status of
+   each and return the number completed */
+typedef u32 (vnet_crypto_ops_handler_t) (vlib_main_t * vm,
+					 vnet_crypto_op_t * ops, u32 n_ops);
+
+typedef void (vnet_crypto_key_handler_t) (vlib_main_t * vm,
+					  vnet_crypto_key_op_t kop,
+					  u32 key_index);
+
+/*
+ * Async frames
+ */
+
+#define VNET_CRYPTO_FRAME_SIZE		VLIB_FRAME_SIZE
+/* frames a thread may have in flight */
+#define VNET_CRYPTO_FRAME_POOL_SIZE	64
+
+typedef enum
+{
+  VNET_CRYPTO_FRAME_STATE_NOT_PROCESSED,
+  VNET_CRYPTO_FRAME_STATE_PENDING,
+  VNET_CRYPTO_FRAME_STATE_WORK_IN_PROGRESS,
+  VNET_CRYPTO_FRAME_STATE_SUCCESS,
+  VNET_CRYPTO_FRAME_STATE_ELT_ERROR,
+} vnet_crypto_async_frame_state_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u8 state;
+  u16 op;
+  u16 n_elts;
+  u32 enqueue_thread_index;
+  vnet_crypto_op_t elts[VNET_CRYPTO_FRAME_SIZE];
+  u32 buffer_indices[VNET_CRYPTO_FRAME_SIZE];
+  /* crypto-dispatch next index of the post node of each buffer */
+  u16 next_node_index[VNET_CRYPTO_FRAME_SIZE];
+} vnet_crypto_async_frame_t;
+
+/* take a frame, returns non-zero when the engine could not accept it */
+typedef int (vnet_crypto_frame_enqueue_t) (vlib_main_t * vm,
+					   vnet_crypto_async_frame_t * f);
+
+/* return a completed frame submitted by the calling thread, or 0 */
+typedef vnet_crypto_async_frame_t *(vnet_crypto_frame_dequeue_t)
+  (vlib_main_t * vm);
+
+typedef struct
+{
+  char *name;
+  char *desc;
+  int priority;
+  vnet_crypto_key_handler_t *key_op_handler;
+  vnet_crypto_ops_handler_t *ops_handlers[VNET_CRYPTO_N_OP_IDS];
+  vnet_crypto_frame_enqueue_t *enqueue_handler;
+  vnet_crypto_frame_dequeue_t *dequeue_handler;
+} vnet_crypto_engine_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  /* fixed at VNET_CRYPTO_FRAME_POOL_SIZE, never reallocated, so engines
+     can hold frame pointers across threads */
+  vnet_crypto_async_frame_t *frames;
+  u32 *free_frames;
+} vnet_crypto_thread_t;
+
+typedef struct
+{
+  vnet_crypto_ops_handler_t *ops_handlers[VNET_CRYPTO_N_OP_IDS];
+  u32 active_engine_index_by_op[VNET_CRYPTO_N_OP_IDS];
+  vnet_crypto_engine_t *engines;
+  vnet_crypto_key_t *keys;
+  uword *engine_index_by_name;
+  uword *op_id_by_name;
+
+  /* async */
+  u32 async_engine_index;
+  vnet_crypto_frame_enqueue_t *enqueue_handler;
+  vnet_crypto_frame_dequeue_t *dequeue_handler;
+  vnet_crypto_thread_t *threads;
+  u32 async_refcount;
+} vnet_crypto_main_t;
+
+extern vnet_crypto_main_t crypto_main;
+extern vlib_node_registration_t crypto_dispatch_node;
+
+u32 vnet_crypto_register_engine (vlib_main_t * vm, char *name, int prio,
+				 char *desc);
+void vnet_crypto_register_ops_handler (vlib_main_t * vm, u32 engine_index,
+				       vnet_crypto_op_id_t opt,
+				       vnet_crypto_ops_handler_t * f);
+void vnet_crypto_register_key_handler (vlib_main_t * vm, u32 engine_index,
+				       vnet_crypto_key_handler_t * keyh);
+void vnet_crypto_register_async_handler (vlib_main_t * vm, u32 engine_index,
+					 vnet_crypto_frame_enqueue_t * enq,
+					 vnet_crypto_frame_dequeue_t * deq);
+
+int vnet_crypto_set_handler (char *op_name, char *engine);
+
+u32 vnet_crypto_key_add (vlib_main_t * vm, vnet_crypto_alg_t alg, u8 * data,
+			 u16 length);
+void vnet_crypto_key_del (vlib_main_t * vm, u32 key_index);
+
+u32 vnet_crypto_process_ops (vlib_main_t * vm, vnet_crypto_op_t ops[],
+			     u32 n_ops);
+
+/* async mode is reference counted, while any user holds it frames are
+   allocated and crypto-dispatch polls on every thread */
+void vnet_crypto_request_async_mode (int is_enable);
+u32 vnet_crypto_register_post_node (vlib_main_t * vm, char *post_node_name);
+vnet_crypto_async_frame_t *vnet_crypto_async_get_frame (vlib_main_t * vm,
+							vnet_crypto_op_id_t
+							op);
+void vnet_crypto_async_free_frame (vlib_main_t * vm,
+				   vnet_crypto_async_frame_t * f);
+
+format_function_t format_vnet_crypto_alg;
+format_function_t format_vnet_crypto_op;
+format_function_t format_vnet_crypto_op_status;
+format_function_t format_vnet_crypto_engine;
+
+static_always_inline vnet_crypto_op_id_t
+vnet_crypto_op_id (vnet_crypto_alg_t alg, int is_encrypt)
+{
+  ASSERT (alg > VNET_CRYPTO_ALG_NONE && alg < VNET_CRYPTO_N_ALGS);
+  return 2 * alg - (is_encrypt != 0);
+}
+
+static_always_inline vnet_crypto_alg_t
+vnet_crypto_op_alg (vnet_crypto_op_id_t op)
+{
+  return (op + 1) / 2;
+}
+
+static_always_inline int
+vnet_crypto_op_is_encrypt (vnet_crypto_op_id_t op)
+{
+  return op & 1;
+}
+
+static_always_inline vnet_crypto_key_t *
+vnet_crypto_get_key (u32 key_index)
+{
+  return pool_elt_at_index (crypto_main.keys, key_index);
+}
+
+static_always_inline void
+vnet_crypto_op_init (vnet_crypto_op_t * op, vnet_crypto_op_id_t type)
+{
+  op->op = type;
+  op->status = VNET_CRYPTO_OP_STATUS_NOT_PROCESSED;
+}
+
+/* add an element to an open frame, the caller fills in the op */
+static_always_inline vnet_crypto_op_t *
+vnet_crypto_async_add_to_frame (vnet_crypto_async_frame_t * f,
+				u32 buffer_index, u16 next_node)
+{
+  vnet_crypto_op_t *op;
+  u16 n = f->n_elts;
+
+  ASSERT (n < VNET_CRYPTO_FRAME_SIZE);
+  op = f->elts + n;
+  vnet_crypto_op_init (op, f->op);
+  f->buffer_indices[n] = buffer_index;
+  f->next_node_index[n] = next_node;
+  f->n_elts = n + 1;
+  return op;
+}
+
+static_always_inline int
+vnet_crypto_async_frame_is_full (vnet_crypto_async_frame_t * f)
+{
+  return f->n_elts == VNET_CRYPTO_FRAME_SIZE;
+}
+
+/* hand a frame to the async engine; on failure the frame is still owned
+   by the caller, which drops its buffers and frees it */
+static_always_inline int
+vnet_crypto_async_submit_open_frame (vlib_main_t * vm,
+				     vnet_crypto_async_frame_t * f)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+
+  if (PREDICT_FALSE (cm->enqueue_handler == 0))
+    return -1;
+  f->state = VNET_CRYPTO_FRAME_STATE_PENDING;
+  f->enqueue_thread_index = vm->thread_index;
+  return cm->enqueue_handler (vm, f);
+}
+
+#endif /* included_vnet_crypto_crypto_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
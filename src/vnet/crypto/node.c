@@ -0,0 +1,167 @@
+/*
+ * node.c : async crypto completion node
+ *
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vnet/vnet.h>
+#include <vnet/buffer.h>
+#include <vnet/crypto/crypto.h>
+
+#define foreach_crypto_dispatch_error			\
+  _(DISPATCHED, "Crypto ops dispatched")		\
+  _(FAILED, "Crypto ops failed")
+
+typedef enum
+{
+#define _(sym,str) CRYPTO_DISPATCH_ERROR_##sym,
+  foreach_crypto_dispatch_error
+#undef _
+    CRYPTO_DISPATCH_N_ERROR,
+} crypto_dispatch_error_t;
+
+static char *crypto_dispatch_error_strings[] = {
+#define _(sym,string) string,
+  foreach_crypto_dispatch_error
+#undef _
+};
+
+typedef struct
+{
+  vnet_crypto_op_id_t op;
+  vnet_crypto_op_status_t status;
+} crypto_dispatch_trace_t;
+
+static u8 *
+format_crypto_dispatch_trace (u8 * s, va_list * args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  crypto_dispatch_trace_t *t = va_arg (*args, crypto_dispatch_trace_t *);
+
+  s = format (s, "crypto: op %U status %U", format_vnet_crypto_op, t->op,
+	      format_vnet_crypto_op_status, t->status);
+  return s;
+}
+
+/* send the buffers of a completed frame to their post nodes, the op
+   status is left in the buffer for the post node to act on */
+static_always_inline u32
+crypto_dispatch_frame (vlib_main_t * vm, vlib_node_runtime_t * node,
+		       vnet_crypto_async_frame_t * f)
+{
+  u32 n_left = f->n_elts, n_failed = 0, next_index, *to_next;
+  u32 *bi = f->buffer_indices;
+  u16 *next = f->next_node_index;
+  vnet_crypto_op_t *op = f->elts;
+
+  next_index = node->cached_next_index;
+
+  while (n_left > 0)
+    {
+      u32 n_left_to_next;
+
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (n_left > 0 && n_left_to_next > 0)
+	{
+	  vlib_buffer_t *b0;
+	  u32 bi0 = bi[0], next0 = next[0];
+
+	  to_next[0] = bi0;
+	  to_next += 1;
+	  n_left_to_next -= 1;
+
+	  b0 = vlib_get_buffer (vm, bi0);
+	  vnet_buffer2 (b0)->crypto.status = op->status;
+	  n_failed += op->status != VNET_CRYPTO_OP_STATUS_COMPLETED;
+
+	  if (PREDICT_FALSE (b0->flags & VLIB_BUFFER_IS_TRACED))
+	    {
+	      crypto_dispatch_trace_t *tr =
+		vlib_add_trace (vm, node, b0, sizeof (*tr));
+	      tr->op = op->op;
+	      tr->status = op->status;
+	    }
+
+	  bi += 1;
+	  next += 1;
+	  op += 1;
+	  n_left -= 1;
+
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					   n_left_to_next, bi0, next0);
+	}
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  if (n_failed)
+    vlib_node_increment_counter (vm, node->node_index,
+				 CRYPTO_DISPATCH_ERROR_FAILED, n_failed);
+  return f->n_elts;
+}
+
+static uword
+crypto_dispatch_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
+			 vlib_frame_t * frame)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_async_frame_t *f;
+  u32 n_dispatched = 0, n_frames = 0;
+
+  if (PREDICT_FALSE (cm->dequeue_handler == 0))
+    return 0;
+
+  /* bounded, so a busy engine does not starve the other input nodes */
+  while (n_frames < 4 && (f = cm->dequeue_handler (vm)))
+    {
+      n_dispatched += crypto_dispatch_frame (vm, node, f);
+      vnet_crypto_async_free_frame (vm, f);
+      n_frames++;
+    }
+
+  if (n_dispatched)
+    vlib_node_increment_counter (vm, node->node_index,
+				 CRYPTO_DISPATCH_ERROR_DISPATCHED,
+				 n_dispatched);
+  return n_dispatched;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (crypto_dispatch_node) = {
+  .function = crypto_dispatch_node_fn,
+  .name = "crypto-dispatch",
+  .type = VLIB_NODE_TYPE_INPUT,
+  .state = VLIB_NODE_STATE_DISABLED,
+  .format_trace = format_crypto_dispatch_trace,
+
+  .n_errors = ARRAY_LEN (crypto_dispatch_error_strings),
+  .error_strings = crypto_dispatch_error_strings,
+
+  /* post nodes are added by vnet_crypto_register_post_node */
+  .n_next_nodes = 1,
+  .next_nodes = {
+    [0] = "error-drop",
+  },
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
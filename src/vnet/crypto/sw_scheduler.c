@@ -0,0 +1,313 @@
+/*
+ * sw_scheduler.c : software async crypto engine
+ *
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Async engine running the sync handlers on crypto workers.
+ *
+ * Each thread has a ring of the frames it submitted; only that thread
+ * writes the head and the tail. Crypto workers scan the rings of all
+ * threads, claim a pending frame by moving its state to work in progress
+ * and run its ops with vnet_crypto_process_ops (). The submitting thread
+ * pops frames from the tail once they are done, so completions are
+ * returned in submission order.
+ *
+ * Frames come from the fixed per thread frame vectors of the crypto main,
+ * a stale pointer seen by a worker therefore always points at a frame
+ * and the state compare and swap decides who owns it.
+ */
+
+#include <vlib/vlib.h>
+#include <vnet/vnet.h>
+#include <vnet/crypto/crypto.h>
+
+#define CRYPTO_SW_SCHEDULER_QUEUE_SIZE VNET_CRYPTO_FRAME_POOL_SIZE
+#define CRYPTO_SW_SCHEDULER_QUEUE_MASK (CRYPTO_SW_SCHEDULER_QUEUE_SIZE - 1)
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u32 head;
+  volatile u32 tail;
+  vnet_crypto_async_frame_t *queue[CRYPTO_SW_SCHEDULER_QUEUE_SIZE];
+  /* this thread works on frames */
+  u8 self_crypto_enabled;
+  u32 last_serve_thread;
+} crypto_sw_scheduler_per_thread_data_t;
+
+typedef struct
+{
+  crypto_sw_scheduler_per_thread_data_t *per_thread_data;
+  u32 crypto_engine_index;
+} crypto_sw_scheduler_main_t;
+
+crypto_sw_scheduler_main_t crypto_sw_scheduler_main;
+
+static int
+crypto_sw_scheduler_enqueue (vlib_main_t * vm, vnet_crypto_async_frame_t * f)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  crypto_sw_scheduler_per_thread_data_t *ptd =
+    vec_elt_at_index (cm->per_thread_data, vm->thread_index);
+  u32 head = ptd->head;
+
+  if (PREDICT_FALSE (head - ptd->tail >= CRYPTO_SW_SCHEDULER_QUEUE_SIZE))
+    return -1;
+
+  ptd->queue[head & CRYPTO_SW_SCHEDULER_QUEUE_MASK] = f;
+  /* the frame and the slot are visible before the new head */
+  __atomic_store_n (&ptd->head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static_always_inline void
+crypto_sw_scheduler_process_frame (vlib_main_t * vm,
+				   vnet_crypto_async_frame_t * f)
+{
+  u32 n_ok = vnet_crypto_process_ops (vm, f->elts, f->n_elts);
+  u8 state = n_ok == f->n_elts ? VNET_CRYPTO_FRAME_STATE_SUCCESS :
+    VNET_CRYPTO_FRAME_STATE_ELT_ERROR;
+
+  __atomic_store_n (&f->state, state, __ATOMIC_RELEASE);
+}
+
+/* claim and run one pending frame of any thread, starting after the
+   thread served last time */
+static_always_inline int
+crypto_sw_scheduler_serve (vlib_main_t * vm,
+			   crypto_sw_scheduler_per_thread_data_t * ptd)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  u32 n_threads = vec_len (cm->per_thread_data);
+  u32 i, j, ti = ptd->last_serve_thread;
+
+  for (i = 0; i < n_threads; i++)
+    {
+      crypto_sw_scheduler_per_thread_data_t *q;
+      u32 head, tail;
+
+      if (++ti >= n_threads)
+	ti = 0;
+      q = cm->per_thread_data + ti;
+      head = __atomic_load_n (&q->head, __ATOMIC_ACQUIRE);
+      tail = q->tail;
+
+      for (j = tail; j != head; j++)
+	{
+	  vnet_crypto_async_frame_t *f =
+	    q->queue[j & CRYPTO_SW_SCHEDULER_QUEUE_MASK];
+
+	  if (f->state != VNET_CRYPTO_FRAME_STATE_PENDING)
+	    continue;
+	  if (!__sync_bool_compare_and_swap
+	      (&f->state, VNET_CRYPTO_FRAME_STATE_PENDING,
+	       VNET_CRYPTO_FRAME_STATE_WORK_IN_PROGRESS))
+	    continue;
+
+	  crypto_sw_scheduler_process_frame (vm, f);
+	  ptd->last_serve_thread = ti;
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+static vnet_crypto_async_frame_t *
+crypto_sw_scheduler_dequeue (vlib_main_t * vm)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  crypto_sw_scheduler_per_thread_data_t *ptd =
+    vec_elt_at_index (cm->per_thread_data, vm->thread_index);
+  vnet_crypto_async_frame_t *f;
+  u8 state;
+
+  if (ptd->self_crypto_enabled)
+    crypto_sw_scheduler_serve (vm, ptd);
+
+  if (ptd->tail == ptd->head)
+    return 0;
+
+  f = ptd->queue[ptd->tail & CRYPTO_SW_SCHEDULER_QUEUE_MASK];
+  state = __atomic_load_n (&f->state, __ATOMIC_ACQUIRE);
+  if (state < VNET_CRYPTO_FRAME_STATE_SUCCESS)
+    return 0;
+
+  ptd->tail++;
+  return f;
+}
+
+static int
+crypto_sw_scheduler_set_worker_crypto (u32 worker_idx, u8 enabled)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  u32 count = 0, i = vlib_num_workers () > 0;
+
+  if (worker_idx >= vlib_num_workers ())
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  /* at least one thread has to serve the queues */
+  for (; i < tm->n_vlib_mains; i++)
+    count += cm->per_thread_data[i].self_crypto_enabled;
+
+  if (enabled || count > 1)
+    {
+      cm->per_thread_data[vlib_get_worker_thread_index
+			  (worker_idx)].self_crypto_enabled = enabled;
+      return 0;
+    }
+
+  return VNET_API_ERROR_INVALID_VALUE_2;
+}
+
+static clib_error_t *
+sw_scheduler_set_worker_crypto (vlib_main_t * vm, unformat_input_t * input,
+				vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  u32 worker_index = ~0;
+  u8 crypto_enable = 0;
+  int rv;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return clib_error_return (0, "expected arguments");
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "worker %u", &worker_index))
+	;
+      else if (unformat (line_input, "crypto on"))
+	crypto_enable = 1;
+      else if (unformat (line_input, "crypto off"))
+	crypto_enable = 0;
+      else
+	{
+	  error = clib_error_return (0, "unknown input '%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  if (worker_index == ~0)
+    {
+      error = clib_error_return (0, "worker index required");
+      goto done;
+    }
+
+  rv = crypto_sw_scheduler_set_worker_crypto (worker_index, crypto_enable);
+  if (rv == VNET_API_ERROR_INVALID_VALUE)
+    error = clib_error_return (0, "invalid worker index %u", worker_index);
+  else if (rv == VNET_API_ERROR_INVALID_VALUE_2)
+    error = clib_error_return (0, "at least one crypto worker is needed");
+
+done:
+  unformat_free (line_input);
+  return error;
+}
+
+/*?
+ * Choose the workers which run the ops of async crypto frames. By
+ * default every worker does, or the main thread when there are none.
+ *
+ * @cliexpar
+ * @cliexstart{set sw_scheduler worker 0 crypto off}
+ * @cliexend
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (cmd_set_sw_scheduler_worker_crypto, static) = {
+  .path = "set sw_scheduler",
+  .short_help = "set sw_scheduler worker <idx> crypto <on|off>",
+  .function = sw_scheduler_set_worker_crypto,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+sw_scheduler_show_workers (vlib_main_t * vm, unformat_input_t * input,
+			   vlib_cli_command_t * cmd)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  u32 i;
+
+  vlib_cli_output (vm, "%-7s%-20s%-8s%s", "ID", "Name", "Crypto",
+		   "Queued");
+  for (i = 0; i < vec_len (cm->per_thread_data); i++)
+    {
+      crypto_sw_scheduler_per_thread_data_t *ptd = cm->per_thread_data + i;
+      vlib_cli_output (vm, "%-7d%-20s%-8s%u", i,
+		       vlib_worker_threads[i].name,
+		       ptd->self_crypto_enabled ? "on" : "off",
+		       ptd->head - ptd->tail);
+    }
+
+  return 0;
+}
+
+/*?
+ * List the threads and whether they run async crypto frames.
+ *
+ * @cliexpar
+ * @cliexstart{show sw_scheduler workers}
+ * ID     Name                Crypto  Queued
+ * 0      vpp_main            off     0
+ * 1      vpp_wk_0            on      0
+ * @cliexend
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (cmd_show_sw_scheduler_workers, static) = {
+  .path = "show sw_scheduler workers",
+  .short_help = "show sw_scheduler workers",
+  .function = sw_scheduler_show_workers,
+};
+/* *INDENT-ON* */
+
+clib_error_t *
+crypto_sw_scheduler_init (vlib_main_t * vm)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  clib_error_t *error;
+  u32 i;
+
+  if ((error = vlib_call_init_function (vm, vnet_crypto_init)))
+    return error;
+
+  vec_validate_aligned (cm->per_thread_data, tm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+
+  /* the main thread only does crypto when there are no workers */
+  for (i = vlib_num_workers () > 0; i < tm->n_vlib_mains; i++)
+    cm->per_thread_data[i].self_crypto_enabled = 1;
+
+  cm->crypto_engine_index =
+    vnet_crypto_register_engine (vm, "sw_scheduler", 100,
+				 "SW Scheduler Async Engine");
+
+  vnet_crypto_register_async_handler (vm, cm->crypto_engine_index,
+				      crypto_sw_scheduler_enqueue,
+				      crypto_sw_scheduler_dequeue);
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (crypto_sw_scheduler_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
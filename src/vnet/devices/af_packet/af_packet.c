@@ -44,13 +44,18 @@ af_packet_main_t af_packet_main;
 #define AF_PACKET_TX_BLOCK_SIZE	 	(AF_PACKET_TX_FRAME_SIZE * \
 					 AF_PACKET_TX_FRAMES_PER_BLOCK)
 
-#define AF_PACKET_RX_FRAMES_PER_BLOCK	1024
+/* TPACKET_V3 rx ring: the kernel packs packets back to back into a
+   block and hands over the whole block once it is full or the retire
+   timeout expires */
+#define AF_PACKET_RX_BLOCK_SIZE		(1 << 17)
+#define AF_PACKET_RX_BLOCK_NR		80
 #define AF_PACKET_RX_FRAME_SIZE	 	(2048 * 5)
-#define AF_PACKET_RX_BLOCK_NR		1
 #define AF_PACKET_RX_FRAME_NR		(AF_PACKET_RX_BLOCK_NR * \
-					 AF_PACKET_RX_FRAMES_PER_BLOCK)
-#define AF_PACKET_RX_BLOCK_SIZE		(AF_PACKET_RX_FRAME_SIZE * \
-					 AF_PACKET_RX_FRAMES_PER_BLOCK)
+					 (AF_PACKET_RX_BLOCK_SIZE / \
+					  AF_PACKET_RX_FRAME_SIZE))
+#define AF_PACKET_RX_RETIRE_TIMEOUT_MS	1
+
+#define AF_PACKET_MAX_QUEUES		64
 
 #if AF_PACKET_DEBUG_SOCKET == 1
 #define DBG_SOCK(args...) clib_warning(args);
@@ -62,6 +67,7 @@ af_packet_main_t af_packet_main;
 unsigned int if_nametoindex (const char *ifname);
 
 typedef struct tpacket_req tpacket_req_t;
+typedef struct tpacket_req3 tpacket_req3_t;
 
 static u32
 af_packet_eth_flag_change (vnet_main_t * vnm, vnet_hw_interface_t * hi,
@@ -95,14 +101,15 @@ af_packet_fd_read_ready (clib_file_t * uf)
 {
   af_packet_main_t *apm = &af_packet_main;
   vnet_main_t *vnm = vnet_get_main ();
-  u32 idx = uf->private_data;
+  u32 idx = uf->private_data >> 16;
+  u16 qid = uf->private_data & 0xFFFF;
   af_packet_if_t *apif = pool_elt_at_index (apm->interfaces, idx);
 
   apm->pending_input_bitmap =
     clib_bitmap_set (apm->pending_input_bitmap, idx, 1);
 
   /* Schedule the rx node */
-  vnet_device_input_set_interrupt_pending (vnm, apif->hw_if_index, 0);
+  vnet_device_input_set_interrupt_pending (vnm, apif->hw_if_index, qid);
 
   return 0;
 }
@@ -127,15 +134,14 @@ is_bridge (const u8 * host_if_name)
 }
 
 static int
-create_packet_v2_sock (int host_if_index, tpacket_req_t * rx_req,
-		       tpacket_req_t * tx_req, int *fd, u8 ** ring)
+create_packet_v3_rx_sock (int host_if_index, tpacket_req3_t * rx_req,
+			  u16 fanout_id, int *fd, u8 ** ring)
 {
   int ret, err;
   struct sockaddr_ll sll;
-  int ver = TPACKET_V2;
-  socklen_t req_sz = sizeof (struct tpacket_req);
-  u32 ring_sz = rx_req->tp_block_size * rx_req->tp_block_nr +
-    tx_req->tp_block_size * tx_req->tp_block_nr;
+  int ver = TPACKET_V3;
+  socklen_t req_sz = sizeof (struct tpacket_req3);
+  u32 ring_sz = rx_req->tp_block_size * rx_req->tp_block_nr;
 
   if ((*fd = socket (AF_PACKET, SOCK_RAW, htons (ETH_P_ALL))) < 0)
     {
@@ -152,23 +158,102 @@ create_packet_v2_sock (int host_if_index, tpacket_req_t * rx_req,
       goto error;
     }
 
-  int opt = 1;
   if ((err =
-       setsockopt (*fd, SOL_PACKET, PACKET_LOSS, &opt, sizeof (opt))) < 0)
+       setsockopt (*fd, SOL_PACKET, PACKET_RX_RING, rx_req, req_sz)) < 0)
     {
-      DBG_SOCK ("Failed to set packet tx ring error handling option");
+      DBG_SOCK ("Failed to set packet rx ring options");
+      ret = VNET_API_ERROR_SYSCALL_ERROR_1;
+      goto error;
+    }
+
+  *ring =
+    mmap (NULL, ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, *fd,
+	  0);
+  if (*ring == MAP_FAILED)
+    {
+      DBG_SOCK ("mmap failure");
+      ret = VNET_API_ERROR_SYSCALL_ERROR_1;
+      goto error;
+    }
+
+  memset (&sll, 0, sizeof (sll));
+  sll.sll_family = PF_PACKET;
+  sll.sll_protocol = htons (ETH_P_ALL);
+  sll.sll_ifindex = host_if_index;
+
+  if ((err = bind (*fd, (struct sockaddr *) &sll, sizeof (sll))) < 0)
+    {
+      DBG_SOCK ("Failed to bind rx packet socket (error %d)", err);
+      ret = VNET_API_ERROR_SYSCALL_ERROR_1;
+      goto error;
+    }
+
+  /* spread flows over the rx sockets of this interface */
+  if (fanout_id)
+    {
+      int fanout = fanout_id | (PACKET_FANOUT_HASH << 16);
+      if ((err = setsockopt (*fd, SOL_PACKET, PACKET_FANOUT, &fanout,
+			     sizeof (fanout))) < 0)
+	{
+	  DBG_SOCK ("Failed to join fanout group %u", fanout_id);
+	  ret = VNET_API_ERROR_SYSCALL_ERROR_1;
+	  goto error;
+	}
+    }
+
+  return 0;
+error:
+  if (*ring && *ring != MAP_FAILED)
+    munmap (*ring, ring_sz);
+  *ring = 0;
+  if (*fd >= 0)
+    close (*fd);
+  *fd = -1;
+  return ret;
+}
+
+static int
+create_packet_v2_tx_sock (int host_if_index, tpacket_req_t * tx_req,
+			  int *fd, u8 ** ring)
+{
+  int ret, err;
+  struct sockaddr_ll sll;
+  int ver = TPACKET_V2;
+  socklen_t req_sz = sizeof (struct tpacket_req);
+  u32 ring_sz = tx_req->tp_block_size * tx_req->tp_block_nr;
+
+  /* protocol 0: the socket is only used to send and never receives */
+  if ((*fd = socket (AF_PACKET, SOCK_RAW, 0)) < 0)
+    {
+      DBG_SOCK ("Failed to create socket");
       ret = VNET_API_ERROR_SYSCALL_ERROR_1;
       goto error;
     }
 
   if ((err =
-       setsockopt (*fd, SOL_PACKET, PACKET_RX_RING, rx_req, req_sz)) < 0)
+       setsockopt (*fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof (ver))) < 0)
     {
-      DBG_SOCK ("Failed to set packet rx ring options");
+      DBG_SOCK ("Failed to set tx packet interface version");
+      ret = VNET_API_ERROR_SYSCALL_ERROR_1;
+      goto error;
+    }
+
+  int opt = 1;
+  if ((err =
+       setsockopt (*fd, SOL_PACKET, PACKET_LOSS, &opt, sizeof (opt))) < 0)
+    {
+      DBG_SOCK ("Failed to set packet tx ring error handling option");
       ret = VNET_API_ERROR_SYSCALL_ERROR_1;
       goto error;
     }
 
+#ifdef PACKET_QDISC_BYPASS
+  /* hand frames straight to the driver, optional on older kernels */
+  if ((err = setsockopt (*fd, SOL_PACKET, PACKET_QDISC_BYPASS, &opt,
+			 sizeof (opt))) < 0)
+    DBG_SOCK ("Failed to enable qdisc bypass");
+#endif
+
   if ((err =
        setsockopt (*fd, SOL_PACKET, PACKET_TX_RING, tx_req, req_sz)) < 0)
     {
@@ -189,34 +274,67 @@ create_packet_v2_sock (int host_if_index, tpacket_req_t * rx_req,
 
   memset (&sll, 0, sizeof (sll));
   sll.sll_family = PF_PACKET;
-  sll.sll_protocol = htons (ETH_P_ALL);
   sll.sll_ifindex = host_if_index;
 
   if ((err = bind (*fd, (struct sockaddr *) &sll, sizeof (sll))) < 0)
     {
-      DBG_SOCK ("Failed to bind rx packet socket (error %d)", err);
+      DBG_SOCK ("Failed to bind tx packet socket (error %d)", err);
       ret = VNET_API_ERROR_SYSCALL_ERROR_1;
       goto error;
     }
 
   return 0;
 error:
+  if (*ring && *ring != MAP_FAILED)
+    munmap (*ring, ring_sz);
+  *ring = 0;
   if (*fd >= 0)
     close (*fd);
   *fd = -1;
   return ret;
 }
 
+static void
+af_packet_queue_free (af_packet_queue_t * q, u32 ring_sz)
+{
+  if (q->clib_file_index != ~0)
+    {
+      clib_file_del (&file_main, file_main.file_pool + q->clib_file_index);
+      q->clib_file_index = ~0;
+    }
+  else if (q->fd >= 0)
+    close (q->fd);
+
+  if (q->ring && munmap (q->ring, ring_sz))
+    clib_warning ("could not free packet ring");
+
+  q->ring = 0;
+  q->fd = -1;
+}
+
+static void
+af_packet_queues_free (af_packet_if_t * apif)
+{
+  af_packet_queue_t *q;
+  u32 rx_ring_sz = apif->rx_req->tp_block_size * apif->rx_req->tp_block_nr;
+  u32 tx_ring_sz = apif->tx_req->tp_block_size * apif->tx_req->tp_block_nr;
+
+  vec_foreach (q, apif->rx_queues) af_packet_queue_free (q, rx_ring_sz);
+  vec_foreach (q, apif->tx_queues) af_packet_queue_free (q, tx_ring_sz);
+  vec_free (apif->rx_queues);
+  vec_free (apif->tx_queues);
+}
+
 int
 af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
-		     u32 * sw_if_index)
+		     u16 num_rx_queues, u16 num_tx_queues, u32 * sw_if_index)
 {
   af_packet_main_t *apm = &af_packet_main;
-  int ret, fd = -1;
-  struct tpacket_req *rx_req = 0;
+  int ret;
+  struct tpacket_req3 *rx_req = 0;
   struct tpacket_req *tx_req = 0;
-  u8 *ring = 0;
   af_packet_if_t *apif = 0;
+  af_packet_queue_t *q;
   u8 hw_addr[6];
   clib_error_t *error;
   vnet_sw_interface_t *sw;
@@ -225,8 +343,9 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
   vnet_main_t *vnm = vnet_get_main ();
   uword *p;
   uword if_index;
-  u8 *host_if_name_dup = vec_dup (host_if_name);
+  u8 *host_if_name_dup;
   int host_if_index = -1;
+  u16 i;
 
   p = mhash_get (&apm->if_index_by_host_if_name, host_if_name);
   if (p)
@@ -234,11 +353,27 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
       return VNET_API_ERROR_SUBIF_ALREADY_EXISTS;
     }
 
+  if (num_rx_queues == 0 || num_rx_queues > AF_PACKET_MAX_QUEUES ||
+      num_tx_queues == 0 || num_tx_queues > AF_PACKET_MAX_QUEUES)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  /* a tx queue per thread at most, extra ones would never be used */
+  num_tx_queues = clib_min (num_tx_queues, tm->n_vlib_mains);
+
+  host_if_index = if_nametoindex ((const char *) host_if_name);
+
+  if (!host_if_index)
+    {
+      DBG_SOCK ("Wrong host interface name");
+      return VNET_API_ERROR_INVALID_INTERFACE;
+    }
+
   vec_validate (rx_req, 0);
   rx_req->tp_block_size = AF_PACKET_RX_BLOCK_SIZE;
   rx_req->tp_frame_size = AF_PACKET_RX_FRAME_SIZE;
   rx_req->tp_block_nr = AF_PACKET_RX_BLOCK_NR;
   rx_req->tp_frame_nr = AF_PACKET_RX_FRAME_NR;
+  rx_req->tp_retire_blk_tov = AF_PACKET_RX_RETIRE_TIMEOUT_MS;
 
   vec_validate (tx_req, 0);
   tx_req->tp_block_size = AF_PACKET_TX_BLOCK_SIZE;
@@ -246,50 +381,61 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
   tx_req->tp_block_nr = AF_PACKET_TX_BLOCK_NR;
   tx_req->tp_frame_nr = AF_PACKET_TX_FRAME_NR;
 
-  host_if_index = if_nametoindex ((const char *) host_if_name);
+  host_if_name_dup = vec_dup (host_if_name);
 
-  if (!host_if_index)
+  pool_get_aligned (apm->interfaces, apif, CLIB_CACHE_LINE_BYTES);
+  memset (apif, 0, sizeof (*apif));
+  if_index = apif - apm->interfaces;
+
+  apif->rx_req = rx_req;
+  apif->tx_req = tx_req;
+  apif->host_if_name = host_if_name_dup;
+  apif->per_interface_next_index = ~0;
+  apif->hw_if_index = ~0;
+
+  /* fanout group ids are global to the network namespace */
+  if (num_rx_queues > 1)
+    apif->fanout_id = ((getpid () << 8) ^ host_if_index) | 1;
+
+  for (i = 0; i < num_rx_queues; i++)
     {
-      DBG_SOCK ("Wrong host interface name");
-      return VNET_API_ERROR_INVALID_INTERFACE;
+      clib_file_t template = { 0 };
+
+      vec_add2_aligned (apif->rx_queues, q, 1, CLIB_CACHE_LINE_BYTES);
+      q->queue_id = i;
+      q->clib_file_index = ~0;
+      ret = create_packet_v3_rx_sock (host_if_index, rx_req, apif->fanout_id,
+				      &q->fd, &q->ring);
+      if (ret != 0)
+	goto error;
+
+      template.read_function = af_packet_fd_read_ready;
+      template.file_descriptor = q->fd;
+      template.private_data = (if_index << 16) | i;
+      template.flags = UNIX_FILE_EVENT_EDGE_TRIGGERED;
+      q->clib_file_index = clib_file_add (&file_main, &template);
     }
 
-  ret = create_packet_v2_sock (host_if_index, rx_req, tx_req, &fd, &ring);
-
-  if (ret != 0)
-    goto error;
+  for (i = 0; i < num_tx_queues; i++)
+    {
+      vec_add2_aligned (apif->tx_queues, q, 1, CLIB_CACHE_LINE_BYTES);
+      q->queue_id = i;
+      q->clib_file_index = ~0;
+      ret = create_packet_v2_tx_sock (host_if_index, tx_req, &q->fd,
+				      &q->ring);
+      if (ret != 0)
+	goto error;
+
+      if (num_tx_queues < tm->n_vlib_mains)
+	clib_spinlock_init (&q->lockp);
+    }
 
   ret = is_bridge (host_if_name);
 
   if (ret == 0)			/* is a bridge, ignore state */
     host_if_index = -1;
 
-  /* So far everything looks good, let's create interface */
-  pool_get (apm->interfaces, apif);
-  if_index = apif - apm->interfaces;
-
   apif->host_if_index = host_if_index;
-  apif->fd = fd;
-  apif->rx_ring = ring;
-  apif->tx_ring = ring + rx_req->tp_block_size * rx_req->tp_block_nr;
-  apif->rx_req = rx_req;
-  apif->tx_req = tx_req;
-  apif->host_if_name = host_if_name_dup;
-  apif->per_interface_next_index = ~0;
-  apif->next_tx_frame = 0;
-  apif->next_rx_frame = 0;
-
-  if (tm->n_vlib_mains > 1)
-    clib_spinlock_init (&apif->lockp);
-
-  {
-    clib_file_t template = { 0 };
-    template.read_function = af_packet_fd_read_ready;
-    template.file_descriptor = fd;
-    template.private_data = if_index;
-    template.flags = UNIX_FILE_EVENT_EDGE_TRIGGERED;
-    apif->clib_file_index = clib_file_add (&file_main, &template);
-  }
 
   /*use configured or generate random MAC address */
   if (hw_addr_set)
@@ -312,8 +458,6 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
 
   if (error)
     {
-      memset (apif, 0, sizeof (*apif));
-      pool_put (apm->interfaces, apif);
       clib_error_report (error);
       ret = VNET_API_ERROR_SYSCALL_ERROR_1;
       goto error;
@@ -325,15 +469,17 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
   vnet_hw_interface_set_input_node (vnm, apif->hw_if_index,
 				    af_packet_input_node.index);
 
-  vnet_hw_interface_assign_rx_thread (vnm, apif->hw_if_index, 0,	/* queue */
-				      ~0 /* any cpu */ );
-
   hw->flags |= VNET_HW_INTERFACE_FLAG_SUPPORTS_INT_MODE;
   vnet_hw_interface_set_flags (vnm, apif->hw_if_index,
 			       VNET_HW_INTERFACE_FLAG_LINK_UP);
 
-  vnet_hw_interface_set_rx_mode (vnm, apif->hw_if_index, 0,
-				 VNET_HW_INTERFACE_RX_MODE_INTERRUPT);
+  vec_foreach (q, apif->rx_queues)
+  {
+    vnet_hw_interface_assign_rx_thread (vnm, apif->hw_if_index, q->queue_id,
+					~0 /* any cpu */ );
+    vnet_hw_interface_set_rx_mode (vnm, apif->hw_if_index, q->queue_id,
+				   VNET_HW_INTERFACE_RX_MODE_INTERRUPT);
+  }
 
   mhash_set_mem (&apm->if_index_by_host_if_name, host_if_name_dup, &if_index,
 		 0);
@@ -343,6 +489,9 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
   return 0;
 
 error:
+  af_packet_queues_free (apif);
+  memset (apif, 0, sizeof (*apif));
+  pool_put (apm->interfaces, apif);
   vec_free (host_if_name_dup);
   vec_free (rx_req);
   vec_free (tx_req);
@@ -355,9 +504,9 @@ af_packet_delete_if (vlib_main_t * vm, u8 * host_if_name)
   vnet_main_t *vnm = vnet_get_main ();
   af_packet_main_t *apm = &af_packet_main;
   af_packet_if_t *apif;
+  af_packet_queue_t *q;
   uword *p;
   uword if_index;
-  u32 ring_sz;
 
   p = mhash_get (&apm->if_index_by_host_if_name, host_if_name);
   if (p == NULL)
@@ -370,25 +519,12 @@ af_packet_delete_if (vlib_main_t * vm, u8 * host_if_name)
 
   /* bring down the interface */
   vnet_hw_interface_set_flags (vnm, apif->hw_if_index, 0);
-  vnet_hw_interface_unassign_rx_thread (vnm, apif->hw_if_index, 0);
+  vec_foreach (q, apif->rx_queues)
+    vnet_hw_interface_unassign_rx_thread (vnm, apif->hw_if_index,
+					 q->queue_id);
 
   /* clean up */
-  if (apif->clib_file_index != ~0)
-    {
-      clib_file_del (&file_main, file_main.file_pool + apif->clib_file_index);
-      apif->clib_file_index = ~0;
-    }
-  else
-    close (apif->fd);
-
-  ring_sz = apif->rx_req->tp_block_size * apif->rx_req->tp_block_nr +
-    apif->tx_req->tp_block_size * apif->tx_req->tp_block_nr;
-  if (munmap (apif->rx_ring, ring_sz))
-    clib_warning ("Host interface %s could not free rx/tx ring",
-		  host_if_name);
-  apif->rx_ring = NULL;
-  apif->tx_ring = NULL;
-  apif->fd = -1;
+  af_packet_queues_free (apif);
 
   vec_free (apif->rx_req);
   apif->rx_req = NULL;
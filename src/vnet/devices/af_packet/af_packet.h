@@ -23,19 +23,35 @@ typedef struct
 {
   CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
   clib_spinlock_t lockp;
+  int fd;
+  u8 *ring;
+  u32 clib_file_index;
+  u16 queue_id;
+
+  /* rx: block being processed, and the next packet in it */
+  u32 next_rx_block;
+  u32 rx_pkt_offset;
+  u32 n_rx_pkts_left;
+
+  /* tx */
+  u32 next_tx_frame;
+} af_packet_queue_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
   u8 *host_if_name;
   int host_if_index;
-  int fd;
-  struct tpacket_req *rx_req;
+  struct tpacket_req3 *rx_req;
   struct tpacket_req *tx_req;
-  u8 *rx_ring;
-  u8 *tx_ring;
+
+  /* one PACKET_MMAP socket per queue, rx sockets share a fanout group */
+  af_packet_queue_t *rx_queues;
+  af_packet_queue_t *tx_queues;
+  u16 fanout_id;
+
   u32 hw_if_index;
   u32 sw_if_index;
-  u32 clib_file_index;
-
-  u32 next_rx_frame;
-  u32 next_tx_frame;
 
   u32 per_interface_next_index;
   u8 is_admin_up;
@@ -61,7 +77,8 @@ extern vnet_device_class_t af_packet_device_class;
 extern vlib_node_registration_t af_packet_input_node;
 
 int af_packet_create_if (vlib_main_t * vm, u8 * host_if_name,
-			 u8 * hw_addr_set, u32 * sw_if_index);
+			 u8 * hw_addr_set, u16 num_rx_queues,
+			 u16 num_tx_queues, u32 * sw_if_index);
 int af_packet_delete_if (vlib_main_t * vm, u8 * host_if_name);
 int af_packet_set_l4_cksum_offload (vlib_main_t * vm, u32 sw_if_index,
 				    u8 set);
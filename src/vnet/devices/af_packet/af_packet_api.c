@@ -61,6 +61,7 @@ vl_api_af_packet_create_t_handler (vl_api_af_packet_create_t * mp)
 
   rv = af_packet_create_if (vm, host_if_name,
 			    mp->use_random_hw_addr ? 0 : mp->hw_addr,
+			    1 /* rx queues */ , 1 /* tx queues */ ,
 			    &sw_if_index);
 
   vec_free (host_if_name);
@@ -48,6 +48,7 @@ af_packet_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
   u8 hwaddr[6];
   u8 *hw_addr_ptr = 0;
   u32 sw_if_index;
+  u32 num_rx_queues = 1, num_tx_queues = 1;
   int r;
   clib_error_t *error = NULL;
 
@@ -63,6 +64,10 @@ af_packet_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
 	if (unformat
 	    (line_input, "hw-addr %U", unformat_ethernet_address, hwaddr))
 	hw_addr_ptr = hwaddr;
+      else if (unformat (line_input, "num-rx-queues %u", &num_rx_queues))
+	;
+      else if (unformat (line_input, "num-tx-queues %u", &num_tx_queues))
+	;
       else
 	{
 	  error = clib_error_return (0, "unknown input `%U'",
@@ -77,7 +82,8 @@ af_packet_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
       goto done;
     }
 
-  r = af_packet_create_if (vm, host_if_name, hw_addr_ptr, &sw_if_index);
+  r = af_packet_create_if (vm, host_if_name, hw_addr_ptr, num_rx_queues,
+			   num_tx_queues, &sw_if_index);
 
   if (r == VNET_API_ERROR_SYSCALL_ERROR_1)
     {
@@ -91,6 +97,12 @@ af_packet_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
       goto done;
     }
 
+  if (r == VNET_API_ERROR_INVALID_VALUE)
+    {
+      error = clib_error_return (0, "number of queues must be 1 - 64");
+      goto done;
+    }
+
   if (r == VNET_API_ERROR_SUBIF_ALREADY_EXISTS)
     {
       error = clib_error_return (0, "Interface elready exists");
@@ -120,6 +132,14 @@ done:
  * - <b>hw-addr <mac-addr></b> - Optional ethernet address, can be in either
  * X:X:X:X:X:X unix or X.X.X cisco format.
  *
+ * - <b>num-rx-queues <n></b> - Number of receive queues, default 1. Each
+ * queue is a separate PACKET socket, the kernel spreads flows over them
+ * with PACKET_FANOUT and each queue can be placed on its own worker.
+ *
+ * - <b>num-tx-queues <n></b> - Number of transmit queues, default 1.
+ * Threads share queues under a lock when there are fewer queues than
+ * threads.
+ *
  * @cliexpar
  * Example of how to create a host interface tied to one side of an
  * existing linux veth pair named vpp1:
@@ -132,7 +152,8 @@ done:
 /* *INDENT-OFF* */
 VLIB_CLI_COMMAND (af_packet_create_command, static) = {
   .path = "create host-interface",
-  .short_help = "create host-interface name <ifname> [hw-addr <mac-addr>]",
+  .short_help = "create host-interface name <ifname> [hw-addr <mac-addr>] "
+    "[num-rx-queues <n>] [num-tx-queues <n>]",
   .function = af_packet_create_command_fn,
 };
 /* *INDENT-ON* */
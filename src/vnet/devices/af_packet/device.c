@@ -65,7 +65,24 @@ format_af_packet_device_name (u8 * s, va_list * args)
 static u8 *
 format_af_packet_device (u8 * s, va_list * args)
 {
+  u32 dev_instance = va_arg (*args, u32);
+  int verbose = va_arg (*args, int);
+  af_packet_main_t *apm = &af_packet_main;
+  af_packet_if_t *apif = pool_elt_at_index (apm->interfaces, dev_instance);
+  u32 indent = format_get_indent (s);
+
   s = format (s, "Linux PACKET socket interface");
+  if (verbose)
+    {
+      s = format (s, "\n%Urx queues %u tx queues %u", format_white_space,
+		  indent + 2, vec_len (apif->rx_queues),
+		  vec_len (apif->tx_queues));
+      if (apif->fanout_id)
+	s = format (s, " fanout group %u", apif->fanout_id);
+      s = format (s, "\n%Urx block size %u blocks %u", format_white_space,
+		  indent + 2, apif->rx_req->tp_block_size,
+		  apif->rx_req->tp_block_nr);
+    }
   return s;
 }
 
@@ -87,16 +104,19 @@ af_packet_interface_tx (vlib_main_t * vm,
   vnet_interface_output_runtime_t *rd = (void *) node->runtime_data;
   af_packet_if_t *apif =
     pool_elt_at_index (apm->interfaces, rd->dev_instance);
-  int block = 0;
-  u32 block_size = apif->tx_req->tp_block_size;
+  u32 thread_index = vlib_get_thread_index ();
+  af_packet_queue_t *q = vec_elt_at_index (apif->tx_queues, thread_index %
+					   vec_len (apif->tx_queues));
   u32 frame_size = apif->tx_req->tp_frame_size;
   u32 frame_num = apif->tx_req->tp_frame_nr;
-  u8 *block_start = apif->tx_ring + block * block_size;
-  u32 tx_frame = apif->next_tx_frame;
+  u8 *block_start = q->ring;
+  u32 tx_frame;
   struct tpacket2_hdr *tph;
   u32 frame_not_ready = 0;
 
-  clib_spinlock_lock_if_init (&apif->lockp);
+  clib_spinlock_lock_if_init (&q->lockp);
+
+  tx_frame = q->next_tx_frame;
 
   while (n_left > 0)
     {
@@ -107,6 +127,14 @@ af_packet_interface_tx (vlib_main_t * vm,
       u32 bi = buffers[0];
       buffers++;
 
+      if (n_left)
+	{
+	  vlib_buffer_t *b1 = vlib_get_buffer (vm, buffers[0]);
+	  vlib_prefetch_buffer_header (b1, LOAD);
+	  CLIB_PREFETCH (vlib_buffer_get_current (b1), CLIB_CACHE_LINE_BYTES,
+			 LOAD);
+	}
+
       tph = (struct tpacket2_hdr *) (block_start + tx_frame * frame_size);
 
       if (PREDICT_FALSE
@@ -141,11 +169,12 @@ af_packet_interface_tx (vlib_main_t * vm,
 
   CLIB_MEMORY_BARRIER ();
 
+  /* one kick for the whole vector */
   if (PREDICT_TRUE (n_sent))
     {
-      apif->next_tx_frame = tx_frame;
+      q->next_tx_frame = tx_frame;
 
-      if (PREDICT_FALSE (sendto (apif->fd, NULL, 0,
+      if (PREDICT_FALSE (sendto (q->fd, NULL, 0,
 				 MSG_DONTWAIT, NULL, 0) == -1))
 	{
 	  /* Uh-oh, drop & move on, but count whether it was fatal or not.
@@ -159,7 +188,7 @@ af_packet_interface_tx (vlib_main_t * vm,
 	}
     }
 
-  clib_spinlock_unlock_if_init (&apif->lockp);
+  clib_spinlock_unlock_if_init (&q->lockp);
 
   if (PREDICT_FALSE (frame_not_ready))
     vlib_error_count (vm, node->node_index,
@@ -49,8 +49,9 @@ typedef struct
 {
   u32 next_index;
   u32 hw_if_index;
+  u16 queue_id;
   int block;
-  struct tpacket2_hdr tph;
+  struct tpacket3_hdr tph;
 } af_packet_input_trace_t;
 
 static u8 *
@@ -61,12 +62,12 @@ format_af_packet_input_trace (u8 * s, va_list * args)
   af_packet_input_trace_t *t = va_arg (*args, af_packet_input_trace_t *);
   u32 indent = format_get_indent (s);
 
-  s = format (s, "af_packet: hw_if_index %d next-index %d",
-	      t->hw_if_index, t->next_index);
+  s = format (s, "af_packet: hw_if_index %d queue %u block %d next-index %d",
+	      t->hw_if_index, t->queue_id, t->block, t->next_index);
 
   s =
     format (s,
-	    "\n%Utpacket2_hdr:\n%Ustatus 0x%x len %u snaplen %u mac %u net %u"
+	    "\n%Utpacket3_hdr:\n%Ustatus 0x%x len %u snaplen %u mac %u net %u"
 	    "\n%Usec 0x%x nsec 0x%x vlan %U"
 #ifdef TP_STATUS_VLAN_TPID_VALID
 	    " vlan_tpid %u"
@@ -81,9 +82,9 @@ format_af_packet_input_trace (u8 * s, va_list * args)
 	    t->tph.tp_net,
 	    format_white_space, indent + 4,
 	    t->tph.tp_sec,
-	    t->tph.tp_nsec, format_ethernet_vlan_tci, t->tph.tp_vlan_tci
+	    t->tph.tp_nsec, format_ethernet_vlan_tci, t->tph.hv1.tp_vlan_tci
 #ifdef TP_STATUS_VLAN_TPID_VALID
-	    , t->tph.tp_vlan_tpid
+	    , t->tph.hv1.tp_vlan_tpid
 #endif
     );
   return s;
@@ -172,34 +173,43 @@ mark_tcp_udp_cksum_calc (vlib_buffer_t * b)
     }
 }
 
+/* sockaddr_ll follows the TPACKET_V3 header of each packet */
+static_always_inline struct sockaddr_ll *
+af_packet_tph_sll (struct tpacket3_hdr *tph)
+{
+  return (struct sockaddr_ll *) ((u8 *) tph +
+				 TPACKET_ALIGN (sizeof (struct tpacket3_hdr)));
+}
+
 always_inline uword
 af_packet_device_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
-			   vlib_frame_t * frame, af_packet_if_t * apif)
+			   vlib_frame_t * frame, af_packet_if_t * apif,
+			   u16 queue_id)
 {
   af_packet_main_t *apm = &af_packet_main;
-  struct tpacket2_hdr *tph;
+  af_packet_queue_t *q = vec_elt_at_index (apif->rx_queues, queue_id);
+  struct tpacket_block_desc *bd;
+  struct tpacket3_hdr *tph;
   u32 next_index = VNET_DEVICE_INPUT_NEXT_ETHERNET_INPUT;
-  u32 block = 0;
-  u32 rx_frame;
+  u32 block = q->next_rx_block;
   u32 n_free_bufs;
   u32 n_rx_packets = 0;
   u32 n_rx_bytes = 0;
   u32 *to_next = 0;
   u32 block_size = apif->rx_req->tp_block_size;
-  u32 frame_size = apif->rx_req->tp_frame_size;
-  u32 frame_num = apif->rx_req->tp_frame_nr;
-  u8 *block_start = apif->rx_ring + block * block_size;
+  u32 block_nr = apif->rx_req->tp_block_nr;
   uword n_trace = vlib_get_trace_count (vm, node);
   u32 thread_index = vlib_get_thread_index ();
   u32 n_buffer_bytes = vlib_buffer_free_list_buffer_size (vm,
 							  VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
-  u32 min_bufs = apif->rx_req->tp_frame_size / n_buffer_bytes;
+  /* enough buffers for the largest packet a block can hold */
+  u32 min_bufs = block_size / n_buffer_bytes + 1;
 
   if (apif->per_interface_next_index != ~0)
     next_index = apif->per_interface_next_index;
 
   n_free_bufs = vec_len (apm->rx_buffers[thread_index]);
-  if (PREDICT_FALSE (n_free_bufs < VLIB_FRAME_SIZE))
+  if (PREDICT_FALSE (n_free_bufs < VLIB_FRAME_SIZE + min_bufs))
     {
       vec_validate (apm->rx_buffers[thread_index],
 		    VLIB_FRAME_SIZE + n_free_bufs - 1);
@@ -209,22 +219,41 @@ af_packet_device_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
       _vec_len (apm->rx_buffers[thread_index]) = n_free_bufs;
     }
 
-  rx_frame = apif->next_rx_frame;
-  tph = (struct tpacket2_hdr *) (block_start + rx_frame * frame_size);
-  while ((tph->tp_status & TP_STATUS_USER) && (n_free_bufs > min_bufs))
+  bd = (struct tpacket_block_desc *) (q->ring + block * block_size);
+  while ((bd->hdr.bh1.block_status & TP_STATUS_USER) &&
+	 (n_free_bufs > min_bufs))
     {
       vlib_buffer_t *b0 = 0, *first_b0 = 0;
       u32 next0 = next_index;
-
       u32 n_left_to_next;
+
+      /* start of a newly retired block */
+      if (q->n_rx_pkts_left == 0)
+	{
+	  q->n_rx_pkts_left = bd->hdr.bh1.num_pkts;
+	  q->rx_pkt_offset = bd->hdr.bh1.offset_to_first_pkt;
+	}
+
       vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
-      while ((tph->tp_status & TP_STATUS_USER) && (n_free_bufs > min_bufs) &&
-	     n_left_to_next)
+      while (q->n_rx_pkts_left && (n_free_bufs > min_bufs) && n_left_to_next)
 	{
-	  u32 data_len = tph->tp_snaplen;
-	  u32 offset = 0;
+	  u32 data_len, offset = 0;
 	  u32 bi0 = 0, first_bi0 = 0, prev_bi0;
 
+	  tph = (struct tpacket3_hdr *) ((u8 *) bd + q->rx_pkt_offset);
+	  q->rx_pkt_offset += tph->tp_next_offset;
+	  q->n_rx_pkts_left--;
+
+	  if (q->n_rx_pkts_left)
+	    CLIB_PREFETCH ((u8 *) bd + q->rx_pkt_offset,
+			   2 * CLIB_CACHE_LINE_BYTES, LOAD);
+
+	  /* our own tx sockets show up here as outgoing, skip them */
+	  if (PREDICT_FALSE (af_packet_tph_sll (tph)->sll_pkttype ==
+			     PACKET_OUTGOING))
+	    continue;
+
+	  data_len = tph->tp_snaplen;
 	  while (data_len)
 	    {
 	      /* grab free buffer */
@@ -254,7 +283,7 @@ af_packet_device_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
 		      ethernet_vlan_header_t *vlan =
 			(ethernet_vlan_header_t *) (eth + 1);
 		      vlan->priority_cfi_and_id =
-			clib_host_to_net_u16 (tph->tp_vlan_tci);
+			clib_host_to_net_u16 (tph->hv1.tp_vlan_tci);
 		      vlan->type = eth->type;
 		      eth->type = clib_host_to_net_u16 (ETHERNET_TYPE_VLAN);
 		      vlan_len = sizeof (ethernet_vlan_header_t);
@@ -303,7 +332,9 @@ af_packet_device_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
 	      tr = vlib_add_trace (vm, node, first_b0, sizeof (*tr));
 	      tr->next_index = next0;
 	      tr->hw_if_index = apif->hw_if_index;
-	      clib_memcpy (&tr->tph, tph, sizeof (struct tpacket2_hdr));
+	      tr->queue_id = queue_id;
+	      tr->block = block;
+	      clib_memcpy (&tr->tph, tph, sizeof (struct tpacket3_hdr));
 	    }
 
 	  /* redirect if feature path enabled */
@@ -312,17 +343,26 @@ af_packet_device_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
 	  /* enque and take next packet */
 	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
 					   n_left_to_next, first_bi0, next0);
-
-	  /* next packet */
-	  tph->tp_status = TP_STATUS_KERNEL;
-	  rx_frame = (rx_frame + 1) % frame_num;
-	  tph = (struct tpacket2_hdr *) (block_start + rx_frame * frame_size);
 	}
 
       vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+
+      /* whole block consumed, give it back to the kernel */
+      if (q->n_rx_pkts_left == 0)
+	{
+	  bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	  block = (block + 1) % block_nr;
+	  bd = (struct tpacket_block_desc *) (q->ring + block * block_size);
+	}
     }
 
-  apif->next_rx_frame = rx_frame;
+  q->next_rx_block = block;
+
+  /* out of buffers with retired blocks left: the kernel does not wake us
+     again for them, and drops everything once it runs out of blocks */
+  if (bd->hdr.bh1.block_status & TP_STATUS_USER)
+    vnet_device_input_set_interrupt_pending (vnet_get_main (),
+					     apif->hw_if_index, queue_id);
 
   vlib_increment_combined_counter
     (vnet_get_main ()->interface_main.combined_sw_if_counters
@@ -347,7 +387,8 @@ af_packet_input_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
     af_packet_if_t *apif;
     apif = vec_elt_at_index (apm->interfaces, dq->dev_instance);
     if (apif->is_admin_up)
-      n_rx_packets += af_packet_device_input_fn (vm, node, frame, apif);
+      n_rx_packets += af_packet_device_input_fn (vm, node, frame, apif,
+						 dq->queue_id);
   }
 
   return n_rx_packets;
@@ -207,6 +207,27 @@ vnet_netlink_set_link_mtu (int ifindex, int mtu)
   return vnet_netlink_msg_send (&m);
 }
 
+clib_error_t *
+vnet_netlink_set_link_xdp_fd (int ifindex, int fd, u32 flags)
+{
+  vnet_netlink_msg_t m, nest = { 0 };
+  struct ifinfomsg ifmsg = { 0 };
+
+  ifmsg.ifi_index = ifindex;
+
+  vnet_netlink_msg_init (&m, RTM_SETLINK, NLM_F_REQUEST,
+			 &ifmsg, sizeof (struct ifinfomsg));
+
+  /* fd -1 detaches the program currently attached */
+  vnet_netlink_msg_add_rtattr (&nest, IFLA_XDP_FD, &fd, sizeof (int));
+  if (flags)
+    vnet_netlink_msg_add_rtattr (&nest, IFLA_XDP_FLAGS, &flags, sizeof (u32));
+  vnet_netlink_msg_add_rtattr (&m, IFLA_XDP | NLA_F_NESTED, nest.data,
+			       vec_len (nest.data));
+  vec_free (nest.data);
+  return vnet_netlink_msg_send (&m);
+}
+
 clib_error_t *
 vnet_netlink_add_ip4_addr (int ifindex, void *addr, int pfx_len)
 {
@@ -37,6 +37,7 @@ tap_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
   unformat_input_t _line_input, *line_input = &_line_input;
   tap_create_if_args_t args = { 0 };
   int ip_addr_set = 0;
+  u32 tmp;
 
   args.id = ~0;
 
@@ -71,10 +72,14 @@ tap_create_command_fn (vlib_main_t * vm, unformat_input_t * input,
 	  else if (unformat (line_input, "host-ip6-gw %U",
 			     unformat_ip6_address, &args.host_ip6_gw))
 	    args.host_ip6_gw_set = 1;
-	  else if (unformat (line_input, "rx-ring-size %d", &args.rx_ring_sz))
-	    ;
-	  else if (unformat (line_input, "tx-ring-size %d", &args.tx_ring_sz))
-	    ;
+	  else if (unformat (line_input, "rx-ring-size %u", &tmp))
+	    args.rx_ring_sz = tmp;
+	  else if (unformat (line_input, "tx-ring-size %u", &tmp))
+	    args.tx_ring_sz = tmp;
+	  else if (unformat (line_input, "num-rx-queues %u", &tmp))
+	    args.num_rx_queues = tmp;
+	  else if (unformat (line_input, "gso"))
+	    args.tap_flags |= TAP_FLAG_GSO;
 	  else if (unformat (line_input, "hw-addr %U",
 			     unformat_ethernet_address, args.mac_addr))
 	    args.mac_addr_set = 1;
@@ -109,7 +114,8 @@ VLIB_CLI_COMMAND (tap_create_command, static) = {
     "[rx-ring-size <size>] [tx-ring-size <size>] [host-ns <netns>] "
     "[host-bridge <bridge-name>] [host-ip4-addr <ip4addr/mask>] "
     "[host-ip6-addr <ip6-addr>] [host-ip4-gw <ip4-addr>] "
-    "[host-ip6-gw <ip6-addr>] [host-if-name <name>]",
+    "[host-ip6-gw <ip6-addr>] [host-if-name <name>] "
+    "[num-rx-queues <n>] [gso]",
   .function = tap_create_command_fn,
 };
 /* *INDENT-ON* */
@@ -240,8 +246,10 @@ tap_show_command_fn (vlib_main_t * vm, unformat_input_t * input,
 			     flag_entry->bit);
 	  flag_entry++;
 	}
-      vlib_cli_output (vm, "  fd %d", vif->fd);
-      vlib_cli_output (vm, "  tap-fd %d", vif->tap_fd);
+      vlib_cli_output (vm, "  queue pairs %u", vif->num_queue_pairs);
+      vec_foreach_index (i, vif->vhost_fds)
+	vlib_cli_output (vm, "    queue %u: vhost-fd %d tap-fd %d", i,
+			 vif->vhost_fds[i], vif->tap_fds[i]);
       vlib_cli_output (vm, "  features 0x%lx", vif->features);
       feat_entry = (struct feat_struct *) &feat_array;
       while (feat_entry->str)
@@ -264,7 +272,8 @@ tap_show_command_fn (vlib_main_t * vm, unformat_input_t * input,
       {
 	// RX = 0, TX = 1
 	vring = vec_elt_at_index (vif->vrings, i);
-	vlib_cli_output (vm, "  Virtqueue (%s)", (i & 1) ? "TX" : "RX");
+	vlib_cli_output (vm, "  Virtqueue %u (%s)", i >> 1,
+			 (i & 1) ? "TX" : "RX");
 	vlib_cli_output (vm, "    qsz %d, last_used_idx %d, desc_in_use %d",
 			 vring->size, vring->last_used_idx,
 			 vring->desc_in_use);
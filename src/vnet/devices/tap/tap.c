@@ -76,6 +76,19 @@ open_netns_fd (char *netns)
 }
 
 
+static void
+virtio_close_fds (virtio_if_t * vif)
+{
+  int i;
+
+  vec_foreach_index (i, vif->tap_fds) if (vif->tap_fds[i] != -1)
+    close (vif->tap_fds[i]);
+  vec_foreach_index (i, vif->vhost_fds) if (vif->vhost_fds[i] != -1)
+    close (vif->vhost_fds[i]);
+  vec_free (vif->tap_fds);
+  vec_free (vif->vhost_fds);
+}
+
 void
 tap_create_if (vlib_main_t * vm, tap_create_if_args_t * args)
 {
@@ -91,6 +104,9 @@ tap_create_if (vlib_main_t * vm, tap_create_if_args_t * args)
   struct vhost_memory *vhost_mem = 0;
   virtio_if_t *vif = 0;
   clib_error_t *err = 0;
+  unsigned int offload;
+  u64 vhost_features;
+  u16 num_queue_pairs;
   uword *p;
 
   if (args->id != ~0)
@@ -123,22 +139,34 @@ tap_create_if (vlib_main_t * vm, tap_create_if_args_t * args)
 	}
     }
 
+  num_queue_pairs = args->num_rx_queues ? args->num_rx_queues : 1;
+  if (num_queue_pairs > TAP_MAX_QUEUE_PAIRS)
+    {
+      args->rv = VNET_API_ERROR_INVALID_VALUE;
+      args->error = clib_error_return (0, "too many rx queues (max %u)",
+				       TAP_MAX_QUEUE_PAIRS);
+      return;
+    }
+
   memset (&ifr, 0, sizeof (ifr));
   pool_get (vim->interfaces, vif);
   vif->dev_instance = vif - vim->interfaces;
-  vif->tap_fd = -1;
   vif->id = args->id;
+  vif->num_queue_pairs = num_queue_pairs;
+  vec_validate_init_empty (vif->vhost_fds, num_queue_pairs - 1, -1);
+  vec_validate_init_empty (vif->tap_fds, num_queue_pairs - 1, -1);
 
   hash_set (tm->dev_instance_by_interface_id, vif->id, vif->dev_instance);
 
-  if ((vif->fd = open ("/dev/vhost-net", O_RDWR | O_NONBLOCK)) < 0)
-    {
-      args->rv = VNET_API_ERROR_SYSCALL_ERROR_1;
-      args->error = clib_error_return_unix (0, "open '/dev/vhost-net'");
-      goto error;
-    }
+  for (i = 0; i < num_queue_pairs; i++)
+    if ((vif->vhost_fds[i] = open ("/dev/vhost-net", O_RDWR | O_NONBLOCK)) < 0)
+      {
+	args->rv = VNET_API_ERROR_SYSCALL_ERROR_1;
+	args->error = clib_error_return_unix (0, "open '/dev/vhost-net'");
+	goto error;
+      }
 
-  _IOCTL (vif->fd, VHOST_GET_FEATURES, &vif->remote_features);
+  _IOCTL (vif->vhost_fds[0], VHOST_GET_FEATURES, &vif->remote_features);
 
   if ((vif->remote_features & (1ULL << VIRTIO_NET_F_MRG_RXBUF)) == 0)
     {
@@ -168,24 +196,55 @@ tap_create_if (vlib_main_t * vm, tap_create_if_args_t * args)
   vif->features |= 1ULL << VIRTIO_F_VERSION_1;
   vif->features |= 1ULL << VIRTIO_RING_F_INDIRECT_DESC;
 
-  _IOCTL (vif->fd, VHOST_SET_FEATURES, &vif->features);
+  /* the first TUNSETIFF creates the device, with multiple queues each
+     further one attaches another queue to it */
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_ONE_QUEUE | IFF_VNET_HDR;
+  if (num_queue_pairs > 1)
+    ifr.ifr_flags |= IFF_MULTI_QUEUE;
 
-  if ((vif->tap_fd = open ("/dev/net/tun", O_RDWR | O_NONBLOCK)) < 0)
+  for (i = 0; i < num_queue_pairs; i++)
     {
-      args->rv = VNET_API_ERROR_SYSCALL_ERROR_2;
-      args->error = clib_error_return_unix (0, "open '/dev/net/tun'");
-      goto error;
+      if ((vif->tap_fds[i] = open ("/dev/net/tun", O_RDWR | O_NONBLOCK)) < 0)
+	{
+	  args->rv = VNET_API_ERROR_SYSCALL_ERROR_2;
+	  args->error = clib_error_return_unix (0, "open '/dev/net/tun'");
+	  goto error;
+	}
+      _IOCTL (vif->tap_fds[i], TUNSETIFF, (void *) &ifr);
     }
-
-  ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_ONE_QUEUE | IFF_VNET_HDR;
-  _IOCTL (vif->tap_fd, TUNSETIFF, (void *) &ifr);
   vif->ifindex = if_nametoindex (ifr.ifr_ifrn.ifrn_name);
 
-  unsigned int offload = 0;
   hdrsz = sizeof (struct virtio_net_hdr_v1);
-  _IOCTL (vif->tap_fd, TUNSETOFFLOAD, offload);
-  _IOCTL (vif->tap_fd, TUNSETVNETHDRSZ, &hdrsz);
-  _IOCTL (vif->fd, VHOST_SET_OWNER, 0);
+  _IOCTL (vif->tap_fds[0], TUNSETVNETHDRSZ, &hdrsz);
+
+  /* Offloads tell the kernel what it may leave to us in the virtio net
+     header of packets it sends. Partial checksums are always accepted,
+     TSO only on request as it costs a software segmentation here. */
+  offload = TUN_F_CSUM;
+  if (args->tap_flags & TAP_FLAG_GSO)
+    offload |= TUN_F_TSO4 | TUN_F_TSO6;
+  if (ioctl (vif->tap_fds[0], TUNSETOFFLOAD, offload) < 0)
+    {
+      offload = 0;
+      _IOCTL (vif->tap_fds[0], TUNSETOFFLOAD, offload);
+    }
+  if (offload & TUN_F_CSUM)
+    vif->features |= VIRTIO_FEATURE (VIRTIO_NET_F_CSUM) |
+      VIRTIO_FEATURE (VIRTIO_NET_F_GUEST_CSUM);
+  if (offload & TUN_F_TSO4)
+    vif->features |= VIRTIO_FEATURE (VIRTIO_NET_F_GUEST_TSO4);
+  if (offload & TUN_F_TSO6)
+    vif->features |= VIRTIO_FEATURE (VIRTIO_NET_F_GUEST_TSO6);
+
+  /* All features are settled before vhost-net is told about them. It
+     only takes the ring features it reported, the offloads above reach
+     the kernel through TUNSETOFFLOAD and the virtio net header. */
+  vhost_features = vif->features & vif->remote_features;
+  for (i = 0; i < num_queue_pairs; i++)
+    _IOCTL (vif->vhost_fds[i], VHOST_SET_FEATURES, &vhost_features);
+
+  for (i = 0; i < num_queue_pairs; i++)
+    _IOCTL (vif->vhost_fds[i], VHOST_SET_OWNER, 0);
 
   /* if namespace is specified, all further netlink messages should be excuted
      after we change our net namespace */
@@ -330,20 +389,33 @@ tap_create_if (vlib_main_t * vm, tap_create_if_args_t * args)
   memset (vhost_mem, 0, i);
   vhost_mem->nregions = 1;
   vhost_mem->regions[0].memory_size = (1ULL << 47) - 4096;
-  _IOCTL (vif->fd, VHOST_SET_MEM_TABLE, vhost_mem);
+  for (i = 0; i < num_queue_pairs; i++)
+    _IOCTL (vif->vhost_fds[i], VHOST_SET_MEM_TABLE, vhost_mem);
 
-  if ((args->error = virtio_vring_init (vm, vif, 0, args->rx_ring_sz)))
+  for (i = 0; i < num_queue_pairs; i++)
     {
-      args->rv = VNET_API_ERROR_INIT_FAILED;
-      goto error;
-    }
+      if ((args->error = virtio_vring_init (vm, vif, 2 * i,
+					    args->rx_ring_sz)))
+	{
+	  args->rv = VNET_API_ERROR_INIT_FAILED;
+	  goto error;
+	}
 
-  if ((args->error = virtio_vring_init (vm, vif, 1, args->tx_ring_sz)))
-    {
-      args->rv = VNET_API_ERROR_INIT_FAILED;
-      goto error;
+      if ((args->error = virtio_vring_init (vm, vif, 2 * i + 1,
+					    args->tx_ring_sz)))
+	{
+	  args->rv = VNET_API_ERROR_INIT_FAILED;
+	  goto error;
+	}
+
+      /* tx queues are picked by thread index, so are shared when there
+         are fewer of them than threads */
+      if (num_queue_pairs < vlib_get_thread_main ()->n_vlib_mains)
+	clib_spinlock_init (&vif->vrings[2 * i + 1].lockp);
     }
 
+  vec_validate (vim->gso_buffers, vlib_get_thread_main ()->n_vlib_mains - 1);
+
   if (!args->mac_addr_set)
     {
       f64 now = vlib_time_now (vm);
@@ -387,11 +459,16 @@ tap_create_if (vlib_main_t * vm, tap_create_if_args_t * args)
   args->sw_if_index = vif->sw_if_index;
   hw = vnet_get_hw_interface (vnm, vif->hw_if_index);
   hw->flags |= VNET_HW_INTERFACE_FLAG_SUPPORTS_INT_MODE;
+  if (vif->features & VIRTIO_FEATURE (VIRTIO_NET_F_CSUM))
+    hw->flags |= VNET_HW_INTERFACE_FLAG_SUPPORTS_TX_L4_CKSUM_OFFLOAD;
   vnet_hw_interface_set_input_node (vnm, vif->hw_if_index,
 				    virtio_input_node.index);
-  vnet_hw_interface_assign_rx_thread (vnm, vif->hw_if_index, 0, ~0);
-  vnet_hw_interface_set_rx_mode (vnm, vif->hw_if_index, 0,
-				 VNET_HW_INTERFACE_RX_MODE_DEFAULT);
+  for (i = 0; i < num_queue_pairs; i++)
+    {
+      vnet_hw_interface_assign_rx_thread (vnm, vif->hw_if_index, i, ~0);
+      vnet_hw_interface_set_rx_mode (vnm, vif->hw_if_index, i,
+				     VNET_HW_INTERFACE_RX_MODE_DEFAULT);
+    }
   vif->per_interface_next_index = ~0;
   vif->type = VIRTIO_IF_TYPE_TAP;
   vif->flags |= VIRTIO_IF_FLAG_ADMIN_UP;
@@ -406,11 +483,10 @@ error:
       args->error = err;
       args->rv = VNET_API_ERROR_SYSCALL_ERROR_3;
     }
-  if (vif->tap_fd != -1)
-    close (vif->tap_fd);
-  if (vif->fd != -1)
-    close (vif->fd);
   vec_foreach_index (i, vif->vrings) virtio_vring_free (vm, vif, i);
+  vec_free (vif->vrings);
+  virtio_close_fds (vif);
+  hash_unset (tm->dev_instance_by_interface_id, vif->id);
   memset (vif, 0, sizeof (virtio_if_t));
   pool_put (vim->interfaces, vif);
 
@@ -444,13 +520,9 @@ tap_delete_if (vlib_main_t * vm, u32 sw_if_index)
   ethernet_delete_interface (vnm, vif->hw_if_index);
   vif->hw_if_index = ~0;
 
-  if (vif->tap_fd != -1)
-    close (vif->tap_fd);
-  if (vif->fd != -1)
-    close (vif->fd);
-
   vec_foreach_index (i, vif->vrings) virtio_vring_free (vm, vif, i);
   vec_free (vif->vrings);
+  virtio_close_fds (vif);
 
   hash_unset (tm->dev_instance_by_interface_id, vif->id);
   memset (vif, 0, sizeof (*vif));
@@ -22,6 +22,8 @@
 #define MIN(x,y) (((x)<(y))?(x):(y))
 #endif
 
+#define TAP_MAX_QUEUE_PAIRS 64
+
 typedef struct
 {
   u32 id;
@@ -29,6 +31,9 @@ typedef struct
   u8 mac_addr[6];
   u16 rx_ring_sz;
   u16 tx_ring_sz;
+  u16 num_rx_queues;
+  u32 tap_flags;
+#define TAP_FLAG_GSO (1 << 0)
   u8 *host_namespace;
   u8 *host_if_name;
   u8 host_mac_addr[6];
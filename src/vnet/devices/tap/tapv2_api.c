@@ -67,6 +67,9 @@ vl_api_tap_create_v2_t_handler (vl_api_tap_create_v2_t * mp)
     }
   ap->rx_ring_sz = ntohs (mp->rx_ring_sz);
   ap->tx_ring_sz = ntohs (mp->tx_ring_sz);
+  ap->num_rx_queues = mp->num_rx_queues;
+  if (mp->gso_enabled)
+    ap->tap_flags |= TAP_FLAG_GSO;
   ap->sw_if_index = (u32) ~ 0;
 
   if (mp->host_if_name_set)
@@ -26,6 +26,8 @@
 #include <vnet/ethernet/ethernet.h>
 #include <vnet/ip/ip4_packet.h>
 #include <vnet/ip/ip6_packet.h>
+#include <vnet/tcp/tcp_packet.h>
+#include <vnet/udp/udp_packet.h>
 #include <vnet/devices/virtio/virtio.h>
 
 #define foreach_virtio_tx_func_error	       \
@@ -121,6 +123,66 @@ virtio_free_used_desc (vlib_main_t * vm, virtio_vring_t * vring)
   vring->last_used_idx = last;
 }
 
+/* Checksums left to the device are computed by the kernel from the
+   virtio net header, which wants the pseudo-header sum in the checksum
+   field. The IP header checksum has no such offload. */
+static_always_inline void
+virtio_tx_offload (vlib_buffer_t * b, struct virtio_net_hdr_v1 *hdr)
+{
+  u32 oflags = b->flags & (VNET_BUFFER_F_OFFLOAD_IP_CKSUM |
+			   VNET_BUFFER_F_OFFLOAD_TCP_CKSUM |
+			   VNET_BUFFER_F_OFFLOAD_UDP_CKSUM);
+  u8 *l3 = b->data + vnet_buffer (b)->l3_hdr_offset;
+  u8 *l4 = b->data + vnet_buffer (b)->l4_hdr_offset;
+  u8 proto = (oflags & VNET_BUFFER_F_OFFLOAD_TCP_CKSUM) ?
+    IP_PROTOCOL_TCP : IP_PROTOCOL_UDP;
+  ip_csum_t sum = 0;
+  u32 l4_len;
+  u16 *csum;
+
+  memset (hdr, 0, sizeof (*hdr));
+
+  if (PREDICT_TRUE (oflags == 0))
+    return;
+
+  if (b->flags & VNET_BUFFER_F_IS_IP4)
+    {
+      ip4_header_t *ip4 = (ip4_header_t *) l3;
+      if (oflags & VNET_BUFFER_F_OFFLOAD_IP_CKSUM)
+	ip4->checksum = ip4_header_checksum (ip4);
+      l4_len = clib_net_to_host_u16 (ip4->length) - (l4 - l3);
+      sum = clib_host_to_net_u32 (l4_len + (proto << 16));
+      sum = ip_csum_with_carry (sum,
+				clib_mem_unaligned (&ip4->src_address, u64));
+    }
+  else if (b->flags & VNET_BUFFER_F_IS_IP6)
+    {
+      ip6_header_t *ip6 = (ip6_header_t *) l3;
+      l4_len = clib_net_to_host_u16 (ip6->payload_length) -
+	(l4 - l3 - sizeof (ip6_header_t));
+      sum = clib_host_to_net_u32 (l4_len + (proto << 16));
+      sum = ip_csum_with_carry (sum, ip6->src_address.as_u64[0]);
+      sum = ip_csum_with_carry (sum, ip6->src_address.as_u64[1]);
+      sum = ip_csum_with_carry (sum, ip6->dst_address.as_u64[0]);
+      sum = ip_csum_with_carry (sum, ip6->dst_address.as_u64[1]);
+    }
+  else
+    return;
+
+  if ((oflags & (VNET_BUFFER_F_OFFLOAD_TCP_CKSUM |
+		 VNET_BUFFER_F_OFFLOAD_UDP_CKSUM)) == 0)
+    return;
+
+  hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+  hdr->csum_start = l4 - (b->data + b->current_data);
+  if (proto == IP_PROTOCOL_TCP)
+    hdr->csum_offset = STRUCT_OFFSET_OF (tcp_header_t, checksum);
+  else
+    hdr->csum_offset = STRUCT_OFFSET_OF (udp_header_t, checksum);
+  csum = (u16 *) (l4 + hdr->csum_offset);
+  *csum = ip_csum_fold (sum);
+}
+
 static_always_inline u16
 add_buffer_to_slot (vlib_main_t * vm, virtio_vring_t * vring, u32 bi,
 		    u16 avail, u16 next, u16 mask)
@@ -131,6 +193,8 @@ add_buffer_to_slot (vlib_main_t * vm, virtio_vring_t * vring, u32 bi,
   d = &vring->desc[next];
   vlib_buffer_t *b = vlib_get_buffer (vm, bi);
 
+  virtio_tx_offload (b, vlib_buffer_get_current (b) - hdr_sz);
+
   if (PREDICT_TRUE ((b->flags & VLIB_BUFFER_NEXT_PRESENT) == 0))
     {
       d->addr = pointer_to_uword (vlib_buffer_get_current (b)) - hdr_sz;
@@ -171,7 +235,7 @@ static_always_inline uword
 virtio_interface_tx_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 			    vlib_frame_t * frame, virtio_if_t * vif)
 {
-  u8 qid = 0;
+  u16 qid = vm->thread_index % vif->num_queue_pairs;
   u16 n_left = frame->n_vectors;
   virtio_vring_t *vring = vec_elt_at_index (vif->vrings, (qid << 1) + 1);
   u16 used, next, avail;
@@ -179,6 +243,8 @@ virtio_interface_tx_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   u16 mask = sz - 1;
   u32 *buffers = vlib_frame_args (frame);
 
+  clib_spinlock_lock_if_init (&vring->lockp);
+
   /* free consumed buffers */
   virtio_free_used_desc (vm, vring);
 
@@ -211,6 +277,8 @@ virtio_interface_tx_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
     }
 
 
+  clib_spinlock_unlock_if_init (&vring->lockp);
+
   if (n_left)
     {
       vlib_error_count (vm, node->node_index, TAP_TX_ERROR_NO_FREE_SLOTS,
@@ -265,7 +333,7 @@ virtio_interface_rx_mode_change (vnet_main_t * vnm, u32 hw_if_index, u32 qid,
   virtio_main_t *mm = &virtio_main;
   vnet_hw_interface_t *hw = vnet_get_hw_interface (vnm, hw_if_index);
   virtio_if_t *vif = pool_elt_at_index (mm->interfaces, hw->dev_instance);
-  virtio_vring_t *vring = vec_elt_at_index (vif->vrings, qid);
+  virtio_vring_t *vring = vec_elt_at_index (vif->vrings, qid << 1);
 
   if (mode == VNET_HW_INTERFACE_RX_MODE_POLLING)
     vring->avail->flags |= VIRTIO_RING_FLAG_MASK_INT;
@@ -32,11 +32,15 @@
 #include <vnet/feature/feature.h>
 #include <vnet/ip/ip4_packet.h>
 #include <vnet/ip/ip6_packet.h>
+#include <vnet/tcp/tcp_packet.h>
+#include <vnet/udp/udp_packet.h>
 #include <vnet/devices/virtio/virtio.h>
 
 
 #define foreach_virtio_input_error \
-  _(UNKNOWN, "unknown")
+  _(UNKNOWN, "unknown") \
+  _(GSO_INVALID, "invalid GSO packet") \
+  _(GSO_BUFFER_ALLOC, "GSO segment buffer alloc error")
 
 typedef enum
 {
@@ -57,7 +61,7 @@ typedef struct
   u32 next_index;
   u32 hw_if_index;
   u16 ring;
-  u16 len;
+  u32 len;
   struct virtio_net_hdr_v1 hdr;
 } virtio_input_trace_t;
 
@@ -79,6 +83,216 @@ format_virtio_input_trace (u8 * s, va_list * args)
   return s;
 }
 
+/* Fill in a checksum left partial by the kernel, in software. */
+static_always_inline void
+virtio_rx_csum_sw (vlib_main_t * vm, vlib_buffer_t * b,
+		   struct virtio_net_hdr_v1 *hdr)
+{
+  vlib_buffer_t *cb = b;
+  u16 *csum = vlib_buffer_get_current (b) + hdr->csum_start +
+    hdr->csum_offset;
+  u32 offset = hdr->csum_start;
+  ip_csum_t sum = 0;
+
+  /* all buffers but the last are filled to an even length */
+  while (1)
+    {
+      sum = ip_incremental_checksum (sum, vlib_buffer_get_current (cb) +
+				     offset, cb->current_length - offset);
+      if (!(cb->flags & VLIB_BUFFER_NEXT_PRESENT))
+	break;
+      cb = vlib_get_buffer (vm, cb->next_buffer);
+      offset = 0;
+    }
+  *csum = ~ip_csum_fold (sum);
+}
+
+/* Packets sent by the host stack may come with the L4 checksum left
+   to the device. They are marked for checksum offload, so whatever
+   interface they leave on computes it, in hardware or in
+   interface-output. */
+static_always_inline void
+virtio_rx_offload (vlib_main_t * vm, vlib_buffer_t * b,
+		   struct virtio_net_hdr_v1 *hdr)
+{
+  ethernet_header_t *eh = vlib_buffer_get_current (b);
+  u16 ethertype = clib_net_to_host_u16 (eh->type);
+  u16 l2_len = sizeof (ethernet_header_t);
+  u16 *csum;
+  int n_tags = 0;
+
+  while (ethernet_frame_is_tagged (ethertype) && n_tags++ < 2)
+    {
+      ethernet_vlan_header_t *vh = (void *) eh + l2_len;
+      ethertype = clib_net_to_host_u16 (vh->type);
+      l2_len += sizeof (ethernet_vlan_header_t);
+    }
+
+  if (ethertype == ETHERNET_TYPE_IP4)
+    b->flags |= VNET_BUFFER_F_IS_IP4;
+  else if (ethertype == ETHERNET_TYPE_IP6)
+    b->flags |= VNET_BUFFER_F_IS_IP6;
+  else
+    {
+      virtio_rx_csum_sw (vm, b, hdr);
+      return;
+    }
+
+  if (hdr->csum_offset == STRUCT_OFFSET_OF (tcp_header_t, checksum))
+    b->flags |= VNET_BUFFER_F_OFFLOAD_TCP_CKSUM;
+  else if (hdr->csum_offset == STRUCT_OFFSET_OF (udp_header_t, checksum))
+    b->flags |= VNET_BUFFER_F_OFFLOAD_UDP_CKSUM;
+  else
+    {
+      b->flags &= ~(VNET_BUFFER_F_IS_IP4 | VNET_BUFFER_F_IS_IP6);
+      virtio_rx_csum_sw (vm, b, hdr);
+      return;
+    }
+
+  vnet_buffer (b)->l2_hdr_offset = b->current_data;
+  vnet_buffer (b)->l3_hdr_offset = b->current_data + l2_len;
+  vnet_buffer (b)->l4_hdr_offset = b->current_data + hdr->csum_start;
+  b->flags |= VNET_BUFFER_F_L2_HDR_OFFSET_VALID |
+    VNET_BUFFER_F_L3_HDR_OFFSET_VALID | VNET_BUFFER_F_L4_HDR_OFFSET_VALID |
+    VNET_BUFFER_F_L4_CHECKSUM_COMPUTED | VNET_BUFFER_F_L4_CHECKSUM_CORRECT;
+
+  /* offload expects the checksum field zeroed, the kernel left the
+     pseudo-header sum in it */
+  csum = vlib_buffer_get_current (b) + hdr->csum_start + hdr->csum_offset;
+  *csum = 0;
+}
+
+/* Cut a TCP packet the kernel sent unsegmented (GSO) into segments of
+   gso_size bytes of payload, each in its own buffer with a copy of the
+   headers. The original chain is freed. Returns the number of
+   segments, left in the per-thread gso_buffers vector. */
+static_always_inline u32
+virtio_gso_segment (vlib_main_t * vm, vlib_node_runtime_t * node,
+		    u32 bi0, struct virtio_net_hdr_v1 *hdr)
+{
+  virtio_main_t *vim = &virtio_main;
+  u32 **segs = vec_elt_at_index (vim->gso_buffers, vm->thread_index);
+  vlib_buffer_t *b0 = vlib_get_buffer (vm, bi0);
+  u8 *h0 = vlib_buffer_get_current (b0);
+  u16 l3_off = vnet_buffer (b0)->l3_hdr_offset - b0->current_data;
+  u16 l4_off = vnet_buffer (b0)->l4_hdr_offset - b0->current_data;
+  tcp_header_t *tcp = (tcp_header_t *) (h0 + l4_off);
+  int is_ip4 = (b0->flags & VNET_BUFFER_F_IS_IP4) != 0;
+  u16 mss = hdr->gso_size;
+  u16 hdr_len, ip_id = 0;
+  u32 i, total, n_segs, n_alloc, seq;
+  vlib_buffer_t *sb;
+  u32 src_off;
+  u8 tcp_flags;
+
+  if (PREDICT_FALSE ((b0->flags & VNET_BUFFER_F_OFFLOAD_TCP_CKSUM) == 0 ||
+		     l4_off + sizeof (tcp_header_t) > b0->current_length))
+    {
+      vlib_error_count (vm, node->node_index, TAP_INPUT_ERROR_GSO_INVALID,
+			1);
+      goto free;
+    }
+
+  hdr_len = l4_off + tcp_header_bytes (tcp);
+  total = vlib_buffer_length_in_chain (vm, b0);
+  if (PREDICT_FALSE (mss == 0 || hdr_len > b0->current_length ||
+		     hdr_len + mss > VLIB_BUFFER_DATA_SIZE ||
+		     total <= hdr_len))
+    {
+      vlib_error_count (vm, node->node_index, TAP_INPUT_ERROR_GSO_INVALID,
+			1);
+      goto free;
+    }
+
+  n_segs = (total - hdr_len + mss - 1) / mss;
+  vec_validate (*segs, n_segs - 1);
+  _vec_len (*segs) = n_segs;
+  n_alloc = vlib_buffer_alloc (vm, *segs, n_segs);
+  if (PREDICT_FALSE (n_alloc != n_segs))
+    {
+      vlib_error_count (vm, node->node_index,
+			TAP_INPUT_ERROR_GSO_BUFFER_ALLOC, 1);
+      if (n_alloc)
+	vlib_buffer_free (vm, *segs, n_alloc);
+      goto free;
+    }
+
+  if (is_ip4)
+    ip_id = clib_net_to_host_u16 (((ip4_header_t *) (h0 + l3_off))->
+				  fragment_id);
+  seq = clib_net_to_host_u32 (tcp->seq_number);
+  tcp_flags = tcp->flags;
+  sb = b0;
+  src_off = hdr_len;
+
+  for (i = 0; i < n_segs; i++)
+    {
+      vlib_buffer_t *b = vlib_get_buffer (vm, (*segs)[i]);
+      u32 n_payload = clib_min (mss, total - hdr_len - i * mss);
+      u8 *dst = b->data + hdr_len;
+      u32 n_left = n_payload;
+      tcp_header_t *t;
+
+      clib_memcpy (b->data, h0, hdr_len);
+      while (n_left)
+	{
+	  u32 n;
+	  if (src_off == sb->current_length)
+	    {
+	      sb = vlib_get_buffer (vm, sb->next_buffer);
+	      src_off = 0;
+	    }
+	  n = clib_min (n_left, sb->current_length - src_off);
+	  clib_memcpy (dst, vlib_buffer_get_current (sb) + src_off, n);
+	  dst += n;
+	  src_off += n;
+	  n_left -= n;
+	}
+
+      b->current_data = 0;
+      b->current_length = hdr_len + n_payload;
+      b->total_length_not_including_first_buffer = 0;
+      b->flags = (b0->flags & ~VLIB_BUFFER_NEXT_PRESENT) |
+	VLIB_BUFFER_TOTAL_LENGTH_VALID;
+      vnet_buffer (b)->sw_if_index[VLIB_RX] =
+	vnet_buffer (b0)->sw_if_index[VLIB_RX];
+      vnet_buffer (b)->sw_if_index[VLIB_TX] = (u32) ~ 0;
+      vnet_buffer (b)->l2_hdr_offset = 0;
+      vnet_buffer (b)->l3_hdr_offset = l3_off;
+      vnet_buffer (b)->l4_hdr_offset = l4_off;
+
+      if (is_ip4)
+	{
+	  ip4_header_t *ip4 = (ip4_header_t *) (b->data + l3_off);
+	  ip4->length = clib_host_to_net_u16 (hdr_len - l3_off + n_payload);
+	  ip4->fragment_id = clib_host_to_net_u16 (ip_id + i);
+	  ip4->checksum = ip4_header_checksum (ip4);
+	}
+      else
+	{
+	  ip6_header_t *ip6 = (ip6_header_t *) (b->data + l3_off);
+	  ip6->payload_length =
+	    clib_host_to_net_u16 (hdr_len - l3_off - sizeof (ip6_header_t) +
+				  n_payload);
+	}
+
+      t = (tcp_header_t *) (b->data + l4_off);
+      t->seq_number = clib_host_to_net_u32 (seq + i * mss);
+      t->flags = tcp_flags;
+      if (i > 0)
+	t->flags &= ~TCP_FLAG_CWR;
+      if (i < n_segs - 1)
+	t->flags &= ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+    }
+
+  vlib_buffer_free (vm, &bi0, 1);
+  return n_segs;
+
+free:
+  vlib_buffer_free (vm, &bi0, 1);
+  return 0;
+}
+
 static_always_inline void
 virtio_refill_vring (vlib_main_t * vm, virtio_vring_t * vring)
 {
@@ -130,7 +344,7 @@ virtio_device_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   vnet_main_t *vnm = vnet_get_main ();
   u32 thread_index = vlib_get_thread_index ();
   uword n_trace = vlib_get_trace_count (vm, node);
-  virtio_vring_t *vring = vec_elt_at_index (vif->vrings, 0);
+  virtio_vring_t *vring = vec_elt_at_index (vif->vrings, qid << 1);
   u32 next_index = VNET_DEVICE_INPUT_NEXT_ETHERNET_INPUT;
   const int hdr_sz = sizeof (struct virtio_net_hdr_v1);
   u32 *to_next = 0;
@@ -146,20 +360,21 @@ virtio_device_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   while (n_left)
     {
       u32 n_left_to_next;
-      u32 next0 = next_index;
       vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
 
       while (n_left && n_left_to_next)
 	{
 	  u16 num_buffers;
 	  struct vring_used_elem *e = &vring->used->ring[last & mask];
-	  struct virtio_net_hdr_v1 *hdr;
+	  struct virtio_net_hdr_v1 hdr;
 	  u16 slot = e->id;
 	  u16 len = e->len - hdr_sz;
 	  u32 bi0 = vring->buffers[slot];
 	  vlib_buffer_t *b0 = vlib_get_buffer (vm, bi0);
-	  hdr = vlib_buffer_get_current (b0) - hdr_sz;
-	  num_buffers = hdr->num_buffers;
+	  u32 *segs, n_segs, i;
+
+	  clib_memcpy (&hdr, vlib_buffer_get_current (b0) - hdr_sz, hdr_sz);
+	  num_buffers = hdr.num_buffers;
 
 	  b0->current_data = 0;
 	  b0->current_length = len;
@@ -183,6 +398,7 @@ virtio_device_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 		  /* current buffer */
 		  cb->current_data = -hdr_sz;
 		  cb->current_length = e->len;
+		  cb->flags = 0;
 
 		  /* previous buffer */
 		  pb->next_buffer = cbi;
@@ -198,42 +414,74 @@ virtio_device_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 		}
 	    }
 
-	  if (PREDICT_FALSE (vif->per_interface_next_index != ~0))
-	    next0 = vif->per_interface_next_index;
-	  else
-	    /* redirect if feature path enabled */
-	    vnet_feature_start_device_input_x1 (vif->sw_if_index, &next0, b0);
-	  /* trace */
-	  VLIB_BUFFER_TRACE_TRAJECTORY_INIT (b0);
+	  vring->desc_in_use--;
+	  n_left--;
+	  last++;
+
+	  if (PREDICT_FALSE (hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM))
+	    virtio_rx_offload (vm, b0, &hdr);
 
-	  if (PREDICT_FALSE (n_trace > 0))
+	  if (PREDICT_FALSE (hdr.gso_type != VIRTIO_NET_HDR_GSO_NONE))
+	    {
+	      n_segs = virtio_gso_segment (vm, node, bi0, &hdr);
+	      segs = virtio_main.gso_buffers[thread_index];
+	    }
+	  else
 	    {
-	      virtio_input_trace_t *tr;
-	      vlib_trace_buffer (vm, node, next0, b0,
-				 /* follow_chain */ 0);
-	      vlib_set_trace_count (vm, node, --n_trace);
-	      tr = vlib_add_trace (vm, node, b0, sizeof (*tr));
-	      tr->next_index = next0;
-	      tr->hw_if_index = vif->hw_if_index;
-	      tr->len = len;
-	      clib_memcpy (&tr->hdr, hdr, hdr_sz);
+	      n_segs = 1;
+	      segs = &bi0;
 	    }
 
-	  /* enqueue buffer */
-	  to_next[0] = bi0;
-	  vring->desc_in_use--;
-	  to_next += 1;
-	  n_left_to_next--;
-	  n_left--;
-	  last++;
+	  for (i = 0; i < n_segs; i++)
+	    {
+	      u32 bi = segs[i];
+	      vlib_buffer_t *b = vlib_get_buffer (vm, bi);
+	      u32 next0, n_bytes = vlib_buffer_length_in_chain (vm, b);
 
-	  /* enqueue */
-	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
-					   n_left_to_next, bi0, next0);
+	      if (PREDICT_FALSE (n_left_to_next == 0))
+		{
+		  vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+		  vlib_get_next_frame (vm, node, next_index, to_next,
+				       n_left_to_next);
+		}
+
+	      next0 = VNET_DEVICE_INPUT_NEXT_ETHERNET_INPUT;
+	      if (PREDICT_FALSE (vif->per_interface_next_index != ~0))
+		next0 = vif->per_interface_next_index;
+	      else
+		/* redirect if feature path enabled */
+		vnet_feature_start_device_input_x1 (vif->sw_if_index, &next0,
+						    b);
+	      /* trace */
+	      VLIB_BUFFER_TRACE_TRAJECTORY_INIT (b);
+
+	      if (PREDICT_FALSE (n_trace > 0))
+		{
+		  virtio_input_trace_t *tr;
+		  vlib_trace_buffer (vm, node, next0, b,
+				     /* follow_chain */ 0);
+		  vlib_set_trace_count (vm, node, --n_trace);
+		  tr = vlib_add_trace (vm, node, b, sizeof (*tr));
+		  tr->next_index = next0;
+		  tr->hw_if_index = vif->hw_if_index;
+		  tr->ring = qid;
+		  tr->len = n_bytes;
+		  clib_memcpy (&tr->hdr, &hdr, hdr_sz);
+		}
+
+	      /* counted as delivered, after GSO segmentation */
+	      n_rx_packets++;
+	      n_rx_bytes += n_bytes;
 
-	  /* next packet */
-	  n_rx_packets++;
-	  n_rx_bytes += len;
+	      /* enqueue buffer */
+	      to_next[0] = bi;
+	      to_next += 1;
+	      n_left_to_next--;
+
+	      /* enqueue */
+	      vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					       n_left_to_next, bi, next0);
+	    }
 	}
       vlib_put_next_frame (vm, node, next_index, n_left_to_next);
     }
@@ -439,6 +439,135 @@ vhost_user_rx_thread_placement ()
   /* *INDENT-ON* */
 }
 
+/*
+ * A new rx queue placement must lower the load of the busiest worker by
+ * at least this many percent to be applied, so that queues are not
+ * moved back and forth on noise.
+ */
+#define VHOST_USER_REBALANCE_MIN_GAIN 20
+
+typedef struct
+{
+  u64 load;
+  u32 if_index;
+  u32 thread_index;
+  u32 new_thread_index;
+  u16 qid;
+} vhost_user_queue_load_t;
+
+static int
+vhost_user_queue_load_cmp (void *a1, void *a2)
+{
+  vhost_user_queue_load_t *l1 = a1, *l2 = a2;
+
+  /* Heaviest first */
+  return (l1->load < l2->load) - (l1->load > l2->load);
+}
+
+/**
+ * @brief Move rx queues between workers according to their load
+ *
+ * The load of a queue is the number of descriptor chains consumed since
+ * the previous check. Queues are placed heaviest first on the least
+ * loaded worker, and the result is applied if it is significantly
+ * better than the current placement.
+ */
+static void
+vhost_user_rx_thread_rebalance (void)
+{
+  vhost_user_main_t *vum = &vhost_user_main;
+  vnet_device_main_t *vdm = &vnet_device_main;
+  vnet_main_t *vnm = vnet_get_main ();
+  vhost_user_queue_load_t *loads = 0, *l;
+  u64 *old_load = 0, *new_load = 0, old_max = 0, new_max = 0;
+  vhost_user_vring_t *txvq;
+  vhost_user_intf_t *vui;
+  vnet_hw_interface_t *hw;
+  u32 first = vdm->first_worker_thread_index, n_workers, i, best;
+  u16 *queue;
+  int rv;
+
+  /* Nothing to balance without at least 2 workers */
+  if (first == 0 || vdm->last_worker_thread_index == first)
+    return;
+
+  n_workers = vdm->last_worker_thread_index - first + 1;
+  vec_validate (old_load, n_workers - 1);
+  vec_validate (new_load, n_workers - 1);
+
+  /* *INDENT-OFF* */
+  pool_foreach (vui, vum->vhost_user_interfaces, {
+      hw = vnet_get_hw_interface (vnm, vui->hw_if_index);
+      vec_foreach (queue, vui->rx_queues)
+	{
+	  txvq = &vui->vrings[VHOST_VRING_IDX_TX (*queue)];
+	  vec_add2 (loads, l, 1);
+	  l->if_index = vui - vum->vhost_user_interfaces;
+	  l->qid = *queue;
+	  l->load = txvq->n_descs - txvq->n_descs_last_check;
+	  txvq->n_descs_last_check = txvq->n_descs;
+	  l->thread_index = hw->input_node_thread_index_by_queue[*queue];
+	  if (l->thread_index >= first &&
+	      l->thread_index <= vdm->last_worker_thread_index)
+	    old_load[l->thread_index - first] += l->load;
+	}
+  });
+  /* *INDENT-ON* */
+
+  vec_sort_with_function (loads, vhost_user_queue_load_cmp);
+
+  vec_foreach (l, loads)
+  {
+    best = 0;
+    for (i = 1; i < n_workers; i++)
+      if (new_load[i] < new_load[best])
+	best = i;
+    new_load[best] += l->load;
+    l->new_thread_index = first + best;
+  }
+
+  for (i = 0; i < n_workers; i++)
+    {
+      old_max = clib_max (old_max, old_load[i]);
+      new_max = clib_max (new_max, new_load[i]);
+    }
+
+  if (old_max == 0 ||
+      new_max * 100 > old_max * (100 - VHOST_USER_REBALANCE_MIN_GAIN))
+    goto done;
+
+  vec_foreach (l, loads)
+  {
+    if (l->new_thread_index == l->thread_index)
+      continue;
+
+    vui = pool_elt_at_index (vum->vhost_user_interfaces, l->if_index);
+    txvq = &vui->vrings[VHOST_VRING_IDX_TX (l->qid)];
+    DBG_SOCK ("moving interface %d queue %d from thread %d to %d",
+	      vui->sw_if_index, l->qid, l->thread_index, l->new_thread_index);
+
+    rv = vnet_hw_interface_unassign_rx_thread (vnm, vui->hw_if_index, l->qid);
+    if (rv)
+      {
+	clib_warning ("Warning: unable to unassign interface %d, "
+		      "queue %d: rc=%d", vui->hw_if_index, l->qid, rv);
+	continue;
+      }
+    vnet_hw_interface_assign_rx_thread (vnm, vui->hw_if_index, l->qid,
+					l->new_thread_index);
+    rv = vnet_hw_interface_set_rx_mode (vnm, vui->hw_if_index, l->qid,
+					txvq->mode);
+    if (rv)
+      clib_warning ("Warning: unable to set rx mode for interface %d, "
+		    "queue %d: rc=%d", vui->hw_if_index, l->qid, rv);
+  }
+
+done:
+  vec_free (loads);
+  vec_free (old_load);
+  vec_free (new_load);
+}
+
 /** @brief Returns whether at least one TX and one RX vring are enabled */
 int
 vhost_user_intf_ready (vhost_user_intf_t * vui)
@@ -1359,6 +1488,21 @@ vhost_user_send_call (vlib_main_t * vm, vhost_user_vring_t * vq)
   vq->int_deadline = vlib_time_now (vm) + vum->coalesce_time;
 }
 
+/*
+ * Guest packet data is cold in cache and so are the buffers it is copied
+ * to, both on RX and TX. Prefetch source and destination of the copy two
+ * entries ahead, up to 4 cache lines: that covers the headers of large
+ * packets and all of small ones, the hardware prefetcher follows the
+ * rest of long copies.
+ */
+static_always_inline void
+vhost_user_prefetch_copy (void *dst, void *src, u32 len)
+{
+  u32 n_bytes = clib_min (len, 4 * CLIB_CACHE_LINE_BYTES);
+  CLIB_PREFETCH (src, n_bytes, LOAD);
+  CLIB_PREFETCH (dst, n_bytes, STORE);
+}
+
 static_always_inline u32
 vhost_user_input_copy (vhost_user_intf_t * vui, vhost_copy_t * cpy,
 		       u16 copy_len, u32 * map_hint)
@@ -1383,8 +1527,8 @@ vhost_user_input_copy (vhost_user_intf_t * vui, vhost_copy_t * cpy,
 	      (!(src3 = map_guest_mem (vui, cpy[3].src, map_hint))))
 	    return 1;
 
-	  CLIB_PREFETCH (src2, 64, LOAD);
-	  CLIB_PREFETCH (src3, 64, LOAD);
+	  vhost_user_prefetch_copy ((void *) cpy[2].dst, src2, cpy[2].len);
+	  vhost_user_prefetch_copy ((void *) cpy[3].dst, src3, cpy[3].len);
 
 	  clib_memcpy ((void *) cpy[0].dst, src0, cpy[0].len);
 	  clib_memcpy ((void *) cpy[1].dst, src1, cpy[1].len);
@@ -1616,6 +1760,19 @@ vhost_user_if_input (vlib_main_t * vm,
 
 	  desc_current =
 	    txvq->avail->ring[txvq->last_avail_idx & txvq->qsz_mask];
+
+	  /* Prefetch next chain head and the used ring slot it returns to */
+	  if (PREDICT_TRUE (n_left > 1))
+	    {
+	      u16 desc_next = txvq->avail->ring[(txvq->last_avail_idx + 1) &
+						txvq->qsz_mask];
+	      CLIB_PREFETCH (&txvq->desc[desc_next], sizeof (vring_desc_t),
+			     LOAD);
+	      CLIB_PREFETCH (&txvq->used->ring[(txvq->last_used_idx + 1) &
+					       txvq->qsz_mask],
+			     sizeof (txvq->used->ring[0]), STORE);
+	    }
+
 	  vum->cpus[thread_index].rx_buffers_len--;
 	  bi_current = (vum->cpus[thread_index].rx_buffers)
 	    [vum->cpus[thread_index].rx_buffers_len];
@@ -1837,6 +1994,8 @@ vhost_user_if_input (vlib_main_t * vm,
 	vhost_user_send_call (vm, txvq);
     }
 
+  txvq->n_descs += n_rx_packets;
+
   /* increase rx counters */
   vlib_increment_combined_counter
     (vnet_main.interface_main.combined_sw_if_counters
@@ -1953,8 +2112,8 @@ vhost_user_tx_copy (vhost_user_intf_t * vui, vhost_copy_t * cpy,
 	      (!(dst3 = map_guest_mem (vui, cpy[3].dst, map_hint))))
 	    return 1;
 
-	  CLIB_PREFETCH ((void *) cpy[2].src, 64, LOAD);
-	  CLIB_PREFETCH ((void *) cpy[3].src, 64, LOAD);
+	  vhost_user_prefetch_copy (dst2, (void *) cpy[2].src, cpy[2].len);
+	  vhost_user_prefetch_copy (dst3, (void *) cpy[3].src, cpy[3].len);
 
 	  clib_memcpy (dst0, (void *) cpy[0].src, cpy[0].len);
 	  clib_memcpy (dst1, (void *) cpy[1].src, cpy[1].len);
@@ -2053,6 +2212,12 @@ retry:
       desc_head = desc_index =
 	rxvq->avail->ring[rxvq->last_avail_idx & rxvq->qsz_mask];
 
+      /* Prefetch the chain head the next packet is likely to use */
+      if (PREDICT_TRUE ((u16) (rxvq->last_avail_idx + 1) != rxvq->avail->idx))
+	CLIB_PREFETCH (&rxvq->desc[rxvq->avail->ring[(rxvq->last_avail_idx +
+						      1) & rxvq->qsz_mask]],
+		       sizeof (vring_desc_t), LOAD);
+
       /* Go deeper in case of indirect descriptor
        * I don't know of any driver providing indirect for RX. */
       if (PREDICT_FALSE (rxvq->desc[desc_head].flags & VIRTQ_DESC_F_INDIRECT))
@@ -2525,6 +2690,8 @@ vhost_user_process (vlib_main_t * vm,
       vec_reset_length (event_data);
 
       timeout = 3.0;
+      if (vum->rebalance_interval > 0)
+	timeout = clib_min (timeout, vum->rebalance_interval);
 
       /* *INDENT-OFF* */
       pool_foreach (vui, vum->vhost_user_interfaces, {
@@ -2596,6 +2763,14 @@ vhost_user_process (vlib_main_t * vm,
 	  }
       });
       /* *INDENT-ON* */
+
+      if (vum->rebalance_interval > 0 &&
+	  vlib_time_now (vm) - vum->last_rebalance_time >=
+	  vum->rebalance_interval)
+	{
+	  vhost_user_rx_thread_rebalance ();
+	  vum->last_rebalance_time = vlib_time_now (vm);
+	}
     }
   return 0;
 }
@@ -3638,6 +3813,9 @@ vhost_user_config (vlib_main_t * vm, unformat_input_t * input)
 	;
       else if (unformat (input, "dont-dump-memory"))
 	vum->dont_dump_vhost_user_memory = 1;
+      else if (unformat (input, "rebalance-interval %f",
+			 &vum->rebalance_interval))
+	;
       else
 	return clib_error_return (0, "unknown input `%U'",
 				  format_unformat_error, input);
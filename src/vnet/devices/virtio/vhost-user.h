@@ -203,6 +203,9 @@ typedef struct
   u8 started;
   u8 enabled;
   u8 log_used;
+
+  /* Descriptor chains consumed, drives load-aware rx queue placement */
+  u64 n_descs;
   //Put non-runtime in a different cache line
     CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
   int errfd;
@@ -212,6 +215,9 @@ typedef struct
 
   /* The rx queue policy (interrupt/adaptive/polling) for this queue */
   u32 mode;
+
+  /* n_descs at last rx queue placement check */
+  u64 n_descs_last_check;
 } vhost_user_vring_t;
 
 #define VHOST_USER_EVENT_START_TIMER 1
@@ -312,6 +318,10 @@ typedef struct
   /* The number of rx interface/queue pairs in interrupt mode */
   u32 ifq_count;
 
+  /* Seconds between rx queue load checks, 0 disables rebalancing */
+  f64 rebalance_interval;
+  f64 last_rebalance_time;
+
   /* debug on or off */
   u8 debug;
 } vhost_user_main_t;
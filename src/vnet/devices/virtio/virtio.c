@@ -53,16 +53,21 @@ call_read_ready (clib_file_t * uf)
 
   CLIB_UNUSED (ssize_t size) = read (uf->file_descriptor, &b, sizeof (b));
   if ((qid & 1) == 0)
-    vnet_device_input_set_interrupt_pending (vnm, vif->hw_if_index, qid);
+    vnet_device_input_set_interrupt_pending (vnm, vif->hw_if_index,
+					     qid >> 1);
 
   return 0;
 }
 
 
+/* Vrings 2n and 2n + 1 are the rx and tx rings of queue pair n, which
+   are rings 0 and 1 of the n-th vhost-net device, backed by the n-th
+   tap queue. */
 clib_error_t *
 virtio_vring_init (vlib_main_t * vm, virtio_if_t * vif, u16 idx, u16 sz)
 {
   clib_error_t *err = 0;
+  int vhost_fd = vif->vhost_fds[idx >> 1];
   virtio_vring_t *vring;
   struct vhost_vring_state state = { 0 };
   struct vhost_vring_addr addr = { 0 };
@@ -111,24 +116,24 @@ virtio_vring_init (vlib_main_t * vm, virtio_if_t * vif, u16 idx, u16 sz)
   t.private_data = vif->dev_instance << 16 | idx;
   vring->call_file_index = clib_file_add (&file_main, &t);
 
-  state.index = idx;
+  state.index = idx & 1;
   state.num = sz;
-  _IOCTL (vif->fd, VHOST_SET_VRING_NUM, &state);
+  _IOCTL (vhost_fd, VHOST_SET_VRING_NUM, &state);
 
-  addr.index = idx;
+  addr.index = idx & 1;
   addr.flags = 0;
   addr.desc_user_addr = pointer_to_uword (vring->desc);
   addr.avail_user_addr = pointer_to_uword (vring->avail);
   addr.used_user_addr = pointer_to_uword (vring->used);
-  _IOCTL (vif->fd, VHOST_SET_VRING_ADDR, &addr);
+  _IOCTL (vhost_fd, VHOST_SET_VRING_ADDR, &addr);
 
-  file.index = idx;
+  file.index = idx & 1;
   file.fd = vring->kick_fd;
-  _IOCTL (vif->fd, VHOST_SET_VRING_KICK, &file);
+  _IOCTL (vhost_fd, VHOST_SET_VRING_KICK, &file);
   file.fd = vring->call_fd;
-  _IOCTL (vif->fd, VHOST_SET_VRING_CALL, &file);
-  file.fd = vif->tap_fd;
-  _IOCTL (vif->fd, VHOST_NET_SET_BACKEND, &file);
+  _IOCTL (vhost_fd, VHOST_SET_VRING_CALL, &file);
+  file.fd = vif->tap_fds[idx >> 1];
+  _IOCTL (vhost_fd, VHOST_NET_SET_BACKEND, &file);
 
 error:
   return err;
@@ -170,6 +175,7 @@ virtio_vring_free (vlib_main_t * vm, virtio_if_t * vif, u32 idx)
   if (vring->avail)
     clib_mem_free (vring->avail);
   vec_free (vring->buffers);
+  clib_spinlock_free (&vring->lockp);
   return 0;
 }
 
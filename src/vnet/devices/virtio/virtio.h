@@ -71,8 +71,12 @@ typedef enum
 } virtio_if_type_t;
 
 
+#define VIRTIO_FEATURE(X) (1ULL << X)
+
 typedef struct
 {
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  clib_spinlock_t lockp;
   struct vring_desc *desc;
   struct vring_used *used;
   struct vring_avail *avail;
@@ -96,8 +100,10 @@ typedef struct
   u32 hw_if_index;
   u32 sw_if_index;
   u32 per_interface_next_index;
-  int fd;
-  int tap_fd;
+  /* one vhost-net fd and one tap queue fd per rx/tx vring pair */
+  int *vhost_fds;
+  int *tap_fds;
+  u16 num_queue_pairs;
   virtio_vring_t *vrings;
 
   u64 features, remote_features;
@@ -120,6 +126,9 @@ typedef struct
 typedef struct
 {
   virtio_if_t *interfaces;
+
+  /* per-thread buffer indices of segments produced from a GSO packet */
+  u32 **gso_buffers;
 } virtio_main_t;
 
 extern virtio_main_t virtio_main;
@@ -71,6 +71,8 @@ ip_inacl_inline (vlib_main_t * vm,
   u32 hits = 0;
   u32 misses = 0;
   u32 chain_hits = 0;
+  vnet_classify_entry_t *entries[VLIB_FRAME_SIZE], **e;
+  u32 table_indices[VLIB_FRAME_SIZE], *ti;
   input_acl_table_id_t tid;
   vlib_node_runtime_t *error_node;
   u32 n_next_nodes;
@@ -139,7 +141,7 @@ ip_inacl_inline (vlib_main_t * vm,
 	h0 = b0->data;
 
       vnet_buffer (b0)->l2_classify.hash =
-	vnet_classify_hash_packet (t0, (u8 *) h0);
+	vnet_classify_hash_packet_inline (t0, (u8 *) h0);
 
       vnet_classify_prefetch_bucket (t0, vnet_buffer (b0)->l2_classify.hash);
 
@@ -149,7 +151,7 @@ ip_inacl_inline (vlib_main_t * vm,
 	h1 = b1->data;
 
       vnet_buffer (b1)->l2_classify.hash =
-	vnet_classify_hash_packet (t1, (u8 *) h1);
+	vnet_classify_hash_packet_inline (t1, (u8 *) h1);
 
       vnet_classify_prefetch_bucket (t1, vnet_buffer (b1)->l2_classify.hash);
 
@@ -185,7 +187,7 @@ ip_inacl_inline (vlib_main_t * vm,
 	h0 = b0->data;
 
       vnet_buffer (b0)->l2_classify.hash =
-	vnet_classify_hash_packet (t0, (u8 *) h0);
+	vnet_classify_hash_packet_inline (t0, (u8 *) h0);
 
       vnet_buffer (b0)->l2_classify.table_index = table_index0;
       vnet_classify_prefetch_bucket (t0, vnet_buffer (b0)->l2_classify.hash);
@@ -194,9 +196,18 @@ ip_inacl_inline (vlib_main_t * vm,
       n_left_from--;
     }
 
-  next_index = node->cached_next_index;
+  /* Second pass: walk the table chains */
   from = vlib_frame_vector_args (frame);
+  chain_hits = vnet_classify_find_entries_chained (vm, vcm, from,
+						   frame->n_vectors, entries,
+						   table_indices, now,
+						   0 /* from_current_data */ ,
+						   1 /* honor_data_flag */ );
+
+  next_index = node->cached_next_index;
   n_left_from = frame->n_vectors;
+  e = entries;
+  ti = table_indices;
 
   while (n_left_from > 0)
     {
@@ -213,28 +224,8 @@ ip_inacl_inline (vlib_main_t * vm,
 	  u32 table_index0;
 	  vnet_classify_table_t *t0;
 	  vnet_classify_entry_t *e0;
-	  u64 hash0;
-	  u8 *h0;
 	  u8 error0;
 
-	  /* Stride 3 seems to work best */
-	  if (PREDICT_TRUE (n_left_from > 3))
-	    {
-	      vlib_buffer_t *p1 = vlib_get_buffer (vm, from[3]);
-	      vnet_classify_table_t *tp1;
-	      u32 table_index1;
-	      u64 phash1;
-
-	      table_index1 = vnet_buffer (p1)->l2_classify.table_index;
-
-	      if (PREDICT_TRUE (table_index1 != ~0))
-		{
-		  tp1 = pool_elt_at_index (vcm->tables, table_index1);
-		  phash1 = vnet_buffer (p1)->l2_classify.hash;
-		  vnet_classify_prefetch_entry (tp1, phash1);
-		}
-	    }
-
 	  /* speculatively enqueue b0 to the current next frame */
 	  bi0 = from[0];
 	  to_next[0] = bi0;
@@ -244,9 +235,11 @@ ip_inacl_inline (vlib_main_t * vm,
 	  n_left_to_next -= 1;
 
 	  b0 = vlib_get_buffer (vm, bi0);
-	  table_index0 = vnet_buffer (b0)->l2_classify.table_index;
-	  e0 = 0;
+	  table_index0 = ti[0];
+	  e0 = e[0];
 	  t0 = 0;
+	  ti += 1;
+	  e += 1;
 	  vnet_get_config_data (am->vnet_config_main[tid],
 				&b0->current_config_index, &next0,
 				/* # bytes of config data */ 0);
@@ -255,17 +248,8 @@ ip_inacl_inline (vlib_main_t * vm,
 
 	  if (PREDICT_TRUE (table_index0 != ~0))
 	    {
-	      hash0 = vnet_buffer (b0)->l2_classify.hash;
 	      t0 = pool_elt_at_index (vcm->tables, table_index0);
 
-	      if (t0->current_data_flag == CLASSIFY_FLAG_USE_CURR_DATA)
-		h0 =
-		  (void *) vlib_buffer_get_current (b0) +
-		  t0->current_data_offset;
-	      else
-		h0 = b0->data;
-
-	      e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
 	      if (e0)
 		{
 		  vnet_buffer (b0)->l2_classify.opaque_index
@@ -293,65 +277,18 @@ ip_inacl_inline (vlib_main_t * vm,
 		}
 	      else
 		{
-		  while (1)
-		    {
-		      if (PREDICT_TRUE (t0->next_table_index != ~0))
-			t0 = pool_elt_at_index (vcm->tables,
-						t0->next_table_index);
-		      else
-			{
-			  next0 = (t0->miss_next_index < n_next_nodes) ?
-			    t0->miss_next_index : next0;
-
-			  misses++;
-
-			  if (is_ip4)
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      IP4_ERROR_INACL_TABLE_MISS : IP4_ERROR_NONE;
-			  else
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      IP6_ERROR_INACL_TABLE_MISS : IP6_ERROR_NONE;
-			  b0->error = error_node->errors[error0];
-			  break;
-			}
-
-		      if (t0->current_data_flag ==
-			  CLASSIFY_FLAG_USE_CURR_DATA)
-			h0 =
-			  (void *) vlib_buffer_get_current (b0) +
-			  t0->current_data_offset;
-		      else
-			h0 = b0->data;
-
-		      hash0 = vnet_classify_hash_packet (t0, (u8 *) h0);
-		      e0 = vnet_classify_find_entry
-			(t0, (u8 *) h0, hash0, now);
-		      if (e0)
-			{
-			  vnet_buffer (b0)->l2_classify.opaque_index
-			    = e0->opaque_index;
-			  vlib_buffer_advance (b0, e0->advance);
-			  next0 = (e0->next_index < n_next_nodes) ?
-			    e0->next_index : next0;
-			  hits++;
-			  chain_hits++;
-
-			  if (is_ip4)
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      IP4_ERROR_INACL_SESSION_DENY : IP4_ERROR_NONE;
-			  else
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      IP6_ERROR_INACL_SESSION_DENY : IP6_ERROR_NONE;
-			  b0->error = error_node->errors[error0];
-
-			  if (e0->action == CLASSIFY_ACTION_SET_IP4_FIB_INDEX
-			      || e0->action ==
-			      CLASSIFY_ACTION_SET_IP6_FIB_INDEX)
-			    vnet_buffer (b0)->sw_if_index[VLIB_TX] =
-			      e0->metadata;
-			  break;
-			}
-		    }
+		  next0 = (t0->miss_next_index < n_next_nodes) ?
+		    t0->miss_next_index : next0;
+
+		  misses++;
+
+		  if (is_ip4)
+		    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
+		      IP4_ERROR_INACL_TABLE_MISS : IP4_ERROR_NONE;
+		  else
+		    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
+		      IP6_ERROR_INACL_TABLE_MISS : IP6_ERROR_NONE;
+		  b0->error = error_node->errors[error0];
 		}
 	    }
 
@@ -104,7 +104,7 @@ ah_decrypt_node_fn (vlib_main_t * vm,
 	  ah_header_t *ah0;
 	  ipsec_sa_t *sa0;
 	  u32 sa_index0 = ~0;
-	  u32 seq;
+	  u64 seq;
 	  ip4_header_t *ih4 = 0, *oh4 = 0;
 	  ip6_header_t *ih6 = 0, *oh6 = 0;
 	  u8 tunnel_mode = 1;
@@ -131,21 +131,14 @@ ah_decrypt_node_fn (vlib_main_t * vm,
 	  sa_index0 = vnet_buffer (i_b0)->ipsec.sad_index;
 	  sa0 = pool_elt_at_index (im->sad, sa_index0);
 
-	  seq = clib_host_to_net_u32 (ah0->seq_no);
+	  seq = esp_replay_seq (sa0, clib_host_to_net_u32 (ah0->seq_no));
 	  /* anti-replay check */
 	  //TODO UT remaining
 	  if (sa0->use_anti_replay)
 	    {
-	      int rv = 0;
-
-	      if (PREDICT_TRUE (sa0->use_esn))
-		rv = esp_replay_check_esn (sa0, seq);
-	      else
-		rv = esp_replay_check (sa0, seq);
-
-	      if (PREDICT_FALSE (rv))
+	      if (PREDICT_FALSE (esp_replay_check (sa0, seq)))
 		{
-		  clib_warning ("anti-replay SPI %u seq %u", sa0->spi, seq);
+		  clib_warning ("anti-replay SPI %u seq %lu", sa0->spi, seq);
 		  vlib_node_increment_counter (vm, ah_decrypt_node.index,
 					       AH_DECRYPT_ERROR_REPLAY, 1);
 		  to_next[0] = i_bi0;
@@ -181,7 +174,7 @@ ah_decrypt_node_fn (vlib_main_t * vm,
 		}		//TODO else part for IPv6
 	      hmac_calc (sa0->integ_alg, sa0->integ_key, sa0->integ_key_len,
 			 (u8 *) ih4, i_b0->current_length, sig, sa0->use_esn,
-			 sa0->seq_hi);
+			 seq >> 32);
 
 	      if (PREDICT_FALSE (memcmp (digest, sig, icv_size)))
 		{
@@ -194,12 +187,14 @@ ah_decrypt_node_fn (vlib_main_t * vm,
 		}
 
 	      //TODO UT remaining
-	      if (PREDICT_TRUE (sa0->use_anti_replay))
+	      if (PREDICT_TRUE (sa0->use_anti_replay) &&
+		  PREDICT_FALSE (esp_replay_advance (sa0, seq)))
 		{
-		  if (PREDICT_TRUE (sa0->use_esn))
-		    esp_replay_advance_esn (sa0, seq);
-		  else
-		    esp_replay_advance (sa0, seq);
+		  vlib_node_increment_counter (vm, ah_decrypt_node.index,
+					       AH_DECRYPT_ERROR_REPLAY, 1);
+		  to_next[0] = i_bi0;
+		  to_next += 1;
+		  goto trace;
 		}
 
 	    }
@@ -88,6 +88,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
   n_left_from = from_frame->n_vectors;
   ipsec_main_t *im = &ipsec_main;
   ipsec_proto_main_t *em = &ipsec_proto_main;
+  u32 thread_index = vlib_get_thread_index ();
   next_index = node->cached_next_index;
 
   while (n_left_from > 0)
@@ -110,6 +111,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
 	  u8 transport_mode = 0;
 	  u8 tos = 0;
 	  u8 ttl = 0;
+	  u64 seq0 = 0;
 
 	  i_bi0 = from[0];
 	  from += 1;
@@ -123,7 +125,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
 	  sa_index0 = vnet_buffer (i_b0)->ipsec.sad_index;
 	  sa0 = pool_elt_at_index (im->sad, sa_index0);
 
-	  if (PREDICT_FALSE (esp_seq_advance (sa0)))
+	  if (PREDICT_FALSE (esp_seq_advance (sa0, thread_index, &seq0)))
 	    {
 	      clib_warning ("sequence number counter has cycled SPI %u",
 			    sa0->spi);
@@ -194,7 +196,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
 	      oh6_0->ip6.protocol = IP_PROTOCOL_IPSEC_AH;
 	      oh6_0->ip6.hop_limit = 254;
 	      oh6_0->ah.spi = clib_net_to_host_u32 (sa0->spi);
-	      oh6_0->ah.seq_no = clib_net_to_host_u32 (sa0->seq);
+	      oh6_0->ah.seq_no = clib_net_to_host_u32 ((u32) seq0);
 	      oh6_0->ip6.payload_length =
 		clib_host_to_net_u16 (vlib_buffer_length_in_chain (vm, i_b0) -
 				      sizeof (ip6_header_t));
@@ -224,7 +226,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
 	      oh0->ip4.tos = 0;
 	      oh0->ip4.protocol = IP_PROTOCOL_IPSEC_AH;
 	      oh0->ah.spi = clib_net_to_host_u32 (sa0->spi);
-	      oh0->ah.seq_no = clib_net_to_host_u32 (sa0->seq);
+	      oh0->ah.seq_no = clib_net_to_host_u32 ((u32) seq0);
 	      oh0->ip4.checksum = 0;
 	      oh0->ah.nexthdr = next_hdr_type;
 	      oh0->ah.hdrlen = 4;
@@ -272,7 +274,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
 	  hmac_calc (sa0->integ_alg, sa0->integ_key,
 		     sa0->integ_key_len,
 		     (u8 *) vlib_buffer_get_current (i_b0),
-		     i_b0->current_length, sig, sa0->use_esn, sa0->seq_hi);
+		     i_b0->current_length, sig, sa0->use_esn, seq0 >> 32);
 
 	  memcpy (digest, (char *) &sig[0], 12);
 
@@ -296,7 +298,7 @@ ah_encrypt_node_fn (vlib_main_t * vm,
 	      ah_encrypt_trace_t *tr =
 		vlib_add_trace (vm, node, i_b0, sizeof (*tr));
 	      tr->spi = sa0->spi;
-	      tr->seq = sa0->seq - 1;
+	      tr->seq = seq0;
 	      tr->integ_alg = sa0->integ_alg;
 	    }
 
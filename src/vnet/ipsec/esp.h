@@ -17,6 +17,7 @@
 
 #include <vnet/ip/ip.h>
 #include <vnet/ipsec/ipsec.h>
+#include <vnet/crypto/crypto.h>
 
 #include <openssl/hmac.h>
 #include <openssl/rand.h>
@@ -49,11 +50,50 @@ typedef CLIB_PACKED (struct {
 }) ip6_and_esp_header_t;
 /* *INDENT-ON* */
 
+/* AES round keys and GHASH key powers of a crypto key, expanded when
+   the key is added so the native engine does no key setup per packet */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  u8 encrypt_key[15][16];
+  u8 decrypt_key[15][16];
+  /* H^16 down to H^1, byte reflected */
+  u8 ghash_key[16][16];
+  /* aes-gcm, RFC 4106 salt in network order */
+  u32 salt;
+} esp_aes_key_t;
+
+/* the native AES engine of one cpu variant */
+typedef struct
+{
+  char *name;
+  char *desc;
+  void (*key_expand) (esp_aes_key_t * k, u8 * key, u32 key_len);
+  vnet_crypto_ops_handler_t *aes_cbc_encrypt;
+  vnet_crypto_ops_handler_t *aes_cbc_decrypt;
+  vnet_crypto_ops_handler_t *aes_gcm_encrypt;
+  vnet_crypto_ops_handler_t *aes_gcm_decrypt;
+} esp_crypto_engine_t;
+
+/* integrity check value of an outbound packet, computed once the
+   payload is encrypted */
+typedef struct
+{
+  u8 *data;
+  u8 *icv;
+  u32 len;
+  u32 sa_index;
+  u32 seq_hi;
+} esp_integ_op_t;
+
 typedef struct
 {
   const EVP_CIPHER *type;
   u8 iv_size;
   u8 block_size;
+  /* non-zero for combined mode algorithms */
+  u8 icv_size;
+  vnet_crypto_alg_t alg;
 } ipsec_proto_main_crypto_alg_t;
 
 typedef struct
@@ -82,9 +122,13 @@ typedef struct
 #else
   HMAC_CTX hmac_ctx;
 #endif
-  ipsec_crypto_alg_t last_encrypt_alg;
-  ipsec_crypto_alg_t last_decrypt_alg;
+  vnet_crypto_alg_t last_encrypt_alg;
+  vnet_crypto_alg_t last_decrypt_alg;
   ipsec_integ_alg_t last_integ_alg;
+  vnet_crypto_op_t *ops[IPSEC_CRYPTO_N_ALG];
+  esp_integ_op_t *integ_ops;
+  /* async mode, frames being filled by the current node call */
+  vnet_crypto_async_frame_t *async_frames[IPSEC_CRYPTO_N_ALG];
 } ipsec_proto_main_per_thread_data_t;
 
 typedef struct
@@ -92,156 +136,158 @@ typedef struct
   ipsec_proto_main_crypto_alg_t *ipsec_proto_main_crypto_algs;
   ipsec_proto_main_integ_alg_t *ipsec_proto_main_integ_algs;
   ipsec_proto_main_per_thread_data_t *per_thread_data;
+
+  /* native AES engine, null when the cpu has no AES instructions */
+  esp_crypto_engine_t *aes_engine;
+  /* indexed by crypto key index */
+  esp_aes_key_t *aes_keys;
 } ipsec_proto_main_t;
 
 extern ipsec_proto_main_t ipsec_proto_main;
 
+void esp_crypto_init (void);
+
 #define ESP_WINDOW_SIZE		(64)
 #define ESP_SEQ_MAX 		(4294967295UL)
 
 u8 *format_esp_header (u8 * s, va_list * args);
 
-always_inline int
-esp_replay_check (ipsec_sa_t * sa, u32 seq)
+/* the sequence number of a received packet with the high bits of an
+   extended sequence number inferred from the window, RFC 4303 A.2 */
+always_inline u64
+esp_replay_seq (ipsec_sa_t * sa, u32 seq)
 {
-  u32 diff;
+  u64 top = __atomic_load_n (&sa->last_seq, __ATOMIC_RELAXED);
+  u32 tl = top, th = top >> 32;
 
-  if (PREDICT_TRUE (seq > sa->last_seq))
-    return 0;
+  if (!sa->use_esn)
+    return seq;
+
+  if (PREDICT_TRUE (tl >= (ESP_WINDOW_SIZE - 1)))
+    th += seq < (tl - ESP_WINDOW_SIZE + 1);
+  else if (th)
+    th -= seq >= (tl - ESP_WINDOW_SIZE + 1);
 
-  diff = sa->last_seq - seq;
+  return ((u64) th << 32) | seq;
+}
 
-  if (ESP_WINDOW_SIZE > diff)
-    return (sa->replay_window & (1ULL << diff)) ? 1 : 0;
-  else
-    return 1;
+/* compare the block held by a replay window slot with the block of seq,
+   positive when the slot holds a newer block */
+always_inline i32
+esp_replay_block_cmp (u64 slot, u64 seq)
+{
+  return (i32) ((u32) (slot >> 32) -
+		(u32) (seq >> IPSEC_SA_REPLAY_BLOCK_BITS));
+}
 
-  return 0;
+always_inline u64 *
+esp_replay_slot (ipsec_sa_t * sa, u64 seq)
+{
+  return sa->replay_window + ((seq >> IPSEC_SA_REPLAY_BLOCK_BITS) &
+			      (IPSEC_SA_REPLAY_N_SLOTS - 1));
 }
 
 always_inline int
-esp_replay_check_esn (ipsec_sa_t * sa, u32 seq)
+esp_replay_check (ipsec_sa_t * sa, u64 seq)
 {
-  u32 tl = sa->last_seq;
-  u32 th = sa->last_seq_hi;
-  u32 diff = tl - seq;
+  u64 top = __atomic_load_n (&sa->last_seq, __ATOMIC_RELAXED);
+  u64 slot;
+  i32 cmp;
 
-  if (PREDICT_TRUE (tl >= (ESP_WINDOW_SIZE - 1)))
-    {
-      if (seq >= (tl - ESP_WINDOW_SIZE + 1))
-	{
-	  sa->seq_hi = th;
-	  if (seq <= tl)
-	    return (sa->replay_window & (1ULL << diff)) ? 1 : 0;
-	  else
-	    return 0;
-	}
-      else
-	{
-	  sa->seq_hi = th + 1;
-	  return 0;
-	}
-    }
-  else
-    {
-      if (seq >= (tl - ESP_WINDOW_SIZE + 1))
-	{
-	  sa->seq_hi = th - 1;
-	  return (sa->replay_window & (1ULL << diff)) ? 1 : 0;
-	}
-      else
-	{
-	  sa->seq_hi = th;
-	  if (seq <= tl)
-	    return (sa->replay_window & (1ULL << diff)) ? 1 : 0;
-	  else
-	    return 0;
-	}
-    }
+  if (PREDICT_TRUE (seq > top))
+    return 0;
 
-  return 0;
-}
+  if (top - seq >= ESP_WINDOW_SIZE)
+    return 1;
 
-/* TODO seq increment should be atomic to be accessed by multiple workers */
-always_inline void
-esp_replay_advance (ipsec_sa_t * sa, u32 seq)
-{
-  u32 pos;
+  slot = __atomic_load_n (esp_replay_slot (sa, seq), __ATOMIC_RELAXED);
+  cmp = esp_replay_block_cmp (slot, seq);
 
-  if (seq > sa->last_seq)
-    {
-      pos = seq - sa->last_seq;
-      if (pos < ESP_WINDOW_SIZE)
-	sa->replay_window = ((sa->replay_window) << pos) | 1;
-      else
-	sa->replay_window = 1;
-      sa->last_seq = seq;
-    }
-  else
-    {
-      pos = sa->last_seq - seq;
-      sa->replay_window |= (1ULL << pos);
-    }
+  /* a newer block took the slot: seq is behind the window. An older
+     one: nothing of seq's block was received yet */
+  if (cmp)
+    return cmp > 0;
+
+  return (slot >> (seq & 31)) & 1;
 }
 
-always_inline void
-esp_replay_advance_esn (ipsec_sa_t * sa, u32 seq)
+/*
+ * Mark seq as received and move the top of the window. Workers receiving
+ * on the same SA race here: the slot is updated with a compare and swap,
+ * so a slot taken over by a newer block is reset in the same step, and
+ * exactly one of two copies of a sequence number sets its bit. Returns 1
+ * for the copy that lost.
+ */
+always_inline int
+esp_replay_advance (ipsec_sa_t * sa, u64 seq)
 {
-  int wrap = sa->seq_hi - sa->last_seq_hi;
-  u32 pos;
+  u64 *p = esp_replay_slot (sa, seq);
+  u64 bit = 1ULL << (seq & 31);
+  u64 old, new, top;
+  i32 cmp;
 
-  if (wrap == 0 && seq > sa->last_seq)
+  old = __atomic_load_n (p, __ATOMIC_RELAXED);
+  do
     {
-      pos = seq - sa->last_seq;
-      if (pos < ESP_WINDOW_SIZE)
-	sa->replay_window = ((sa->replay_window) << pos) | 1;
-      else
-	sa->replay_window = 1;
-      sa->last_seq = seq;
-    }
-  else if (wrap > 0)
-    {
-      pos = ~seq + sa->last_seq + 1;
-      if (pos < ESP_WINDOW_SIZE)
-	sa->replay_window = ((sa->replay_window) << pos) | 1;
+      cmp = esp_replay_block_cmp (old, seq);
+      if (cmp > 0)
+	return 1;
+      if (cmp < 0)
+	new = ((u64) (u32) (seq >> IPSEC_SA_REPLAY_BLOCK_BITS) << 32) | bit;
+      else if (old & bit)
+	return 1;
       else
-	sa->replay_window = 1;
-      sa->last_seq = seq;
-      sa->last_seq_hi = sa->seq_hi;
-    }
-  else if (wrap < 0)
-    {
-      pos = ~seq + sa->last_seq + 1;
-      sa->replay_window |= (1ULL << pos);
-    }
-  else
-    {
-      pos = sa->last_seq - seq;
-      sa->replay_window |= (1ULL << pos);
+	new = old | bit;
     }
+  while (!__atomic_compare_exchange_n (p, &old, new, 1, __ATOMIC_RELAXED,
+				       __ATOMIC_RELAXED));
+
+  top = __atomic_load_n (&sa->last_seq, __ATOMIC_RELAXED);
+  while (seq > top &&
+	 !__atomic_compare_exchange_n (&sa->last_seq, &top, seq, 1,
+				       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+
+  return 0;
 }
 
+/*
+ * Take the next outbound sequence number. Each thread reserves a block of
+ * the SA's sequence space at a time, so workers sharing one SA only write
+ * the SA once per block. A worker that goes idle while others keep
+ * sending would fall behind the peer's replay window with the rest of its
+ * block, so a block is dropped once the SA's sequence number moved more
+ * than ESP_WINDOW_SIZE - seq_block_size past it and a fresh one is taken.
+ * The skipped sequence numbers are never sent. Returns 1 once the
+ * sequence number would cycle.
+ */
 always_inline int
-esp_seq_advance (ipsec_sa_t * sa)
+esp_seq_advance (ipsec_sa_t * sa, u32 thread_index, u64 * seq)
 {
-  if (PREDICT_TRUE (sa->use_esn))
-    {
-      if (PREDICT_FALSE (sa->seq == ESP_SEQ_MAX))
-	{
-	  if (PREDICT_FALSE
-	      (sa->use_anti_replay && sa->seq_hi == ESP_SEQ_MAX))
-	    return 1;
-	  sa->seq_hi++;
-	}
-      sa->seq++;
-    }
-  else
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_sa_seq_block_t *blk;
+  u64 next;
+
+  blk = vec_elt_at_index (im->seq_blocks_by_thread[thread_index],
+			  sa - im->sad);
+
+  if (PREDICT_FALSE (blk->next == blk->end ||
+		     __atomic_load_n (&sa->seq, __ATOMIC_RELAXED) -
+		     blk->next > ESP_WINDOW_SIZE - im->seq_block_size))
     {
-      if (PREDICT_FALSE (sa->use_anti_replay && sa->seq == ESP_SEQ_MAX))
-	return 1;
-      sa->seq++;
+      next = __atomic_fetch_add (&sa->seq, im->seq_block_size,
+				 __ATOMIC_RELAXED) + 1;
+      blk->next = next;
+      blk->end = next + im->seq_block_size;
     }
 
+  next = blk->next;
+  if (PREDICT_FALSE (sa->use_anti_replay &&
+		     (sa->use_esn ? next == 0 : next > ESP_SEQ_MAX)))
+    return 1;
+
+  blk->next = next + 1;
+  *seq = next;
   return 0;
 }
 
@@ -250,6 +296,7 @@ ipsec_proto_init ()
 {
   ipsec_proto_main_t *em = &ipsec_proto_main;
   vlib_thread_main_t *tm = vlib_get_thread_main ();
+  ipsec_crypto_alg_t i;
 
   memset (em, 0, sizeof (em[0]));
 
@@ -278,34 +325,62 @@ ipsec_proto_init ()
   em->ipsec_proto_main_crypto_algs[IPSEC_CRYPTO_ALG_DES_CBC].iv_size = 8;
   em->ipsec_proto_main_crypto_algs[IPSEC_CRYPTO_ALG_3DES_CBC].iv_size = 8;
 
+  /* RFC 4106, padding is to 4 bytes and the IV is 8 bytes */
+  em->ipsec_proto_main_crypto_algs[IPSEC_CRYPTO_ALG_AES_GCM_128].type =
+    EVP_aes_128_gcm ();
+  em->ipsec_proto_main_crypto_algs[IPSEC_CRYPTO_ALG_AES_GCM_192].type =
+    EVP_aes_192_gcm ();
+  em->ipsec_proto_main_crypto_algs[IPSEC_CRYPTO_ALG_AES_GCM_256].type =
+    EVP_aes_256_gcm ();
+  for (i = IPSEC_CRYPTO_ALG_AES_GCM_128; i <= IPSEC_CRYPTO_ALG_AES_GCM_256;
+       i++)
+    {
+      em->ipsec_proto_main_crypto_algs[i].iv_size = 8;
+      em->ipsec_proto_main_crypto_algs[i].block_size = 4;
+      em->ipsec_proto_main_crypto_algs[i].icv_size = 16;
+    }
+
+#define _(a, b)								\
+  em->ipsec_proto_main_crypto_algs[IPSEC_CRYPTO_ALG_##a].alg =		\
+    VNET_CRYPTO_ALG_##b;
+  _(AES_CBC_128, AES_128_CBC)
+  _(AES_CBC_192, AES_192_CBC)
+  _(AES_CBC_256, AES_256_CBC)
+  _(AES_GCM_128, AES_128_GCM)
+  _(AES_GCM_192, AES_192_GCM)
+  _(AES_GCM_256, AES_256_GCM)
+  _(DES_CBC, DES_CBC)
+  _(3DES_CBC, 3DES_CBC)
+#undef _
+
   vec_validate (em->ipsec_proto_main_integ_algs, IPSEC_INTEG_N_ALG - 1);
-  ipsec_proto_main_integ_alg_t *i;
+  ipsec_proto_main_integ_alg_t *ia;
 
-  i = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA1_96];
-  i->md = EVP_sha1 ();
-  i->trunc_size = 12;
+  ia = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA1_96];
+  ia->md = EVP_sha1 ();
+  ia->trunc_size = 12;
 
-  i = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_256_96];
-  i->md = EVP_sha256 ();
-  i->trunc_size = 12;
+  ia = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_256_96];
+  ia->md = EVP_sha256 ();
+  ia->trunc_size = 12;
 
-  i = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_256_128];
-  i->md = EVP_sha256 ();
-  i->trunc_size = 16;
+  ia = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_256_128];
+  ia->md = EVP_sha256 ();
+  ia->trunc_size = 16;
 
-  i = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_384_192];
-  i->md = EVP_sha384 ();
-  i->trunc_size = 24;
+  ia = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_384_192];
+  ia->md = EVP_sha384 ();
+  ia->trunc_size = 24;
 
-  i = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_512_256];
-  i->md = EVP_sha512 ();
-  i->trunc_size = 32;
+  ia = &em->ipsec_proto_main_integ_algs[IPSEC_INTEG_ALG_SHA_512_256];
+  ia->md = EVP_sha512 ();
+  ia->trunc_size = 32;
 
   vec_validate_aligned (em->per_thread_data, tm->n_vlib_mains - 1,
 			CLIB_CACHE_LINE_BYTES);
   int thread_id;
 
-  for (thread_id = 0; thread_id < tm->n_vlib_mains - 1; thread_id++)
+  for (thread_id = 0; thread_id < tm->n_vlib_mains; thread_id++)
     {
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
       em->per_thread_data[thread_id].encrypt_ctx = EVP_CIPHER_CTX_new ();
@@ -317,6 +392,8 @@ ipsec_proto_init ()
       HMAC_CTX_init (&(em->per_thread_data[thread_id].hmac_ctx));
 #endif
     }
+
+  esp_crypto_init ();
 }
 
 always_inline unsigned int
@@ -350,13 +427,101 @@ hmac_calc (ipsec_integ_alg_t alg,
 
   HMAC_Update (ctx, data, data_len);
 
+  /* the high bits of the ESN are appended in network order, RFC 4303 */
   if (PREDICT_TRUE (use_esn))
-    HMAC_Update (ctx, (u8 *) & seq_hi, sizeof (seq_hi));
+    {
+      seq_hi = clib_host_to_net_u32 (seq_hi);
+      HMAC_Update (ctx, (u8 *) & seq_hi, sizeof (seq_hi));
+    }
   HMAC_Final (ctx, signature, &len);
 
   return em->ipsec_proto_main_integ_algs[alg].trunc_size;
 }
 
+always_inline vnet_crypto_op_t *
+esp_crypto_op_add (ipsec_proto_main_per_thread_data_t * ptd,
+		   ipsec_sa_t * sa, int is_encrypt)
+{
+  ipsec_proto_main_crypto_alg_t *a =
+    ipsec_proto_main.ipsec_proto_main_crypto_algs + sa->crypto_alg;
+  vnet_crypto_op_t *op;
+
+  vec_add2 (ptd->ops[sa->crypto_alg], op, 1);
+  vnet_crypto_op_init (op, vnet_crypto_op_id (a->alg, is_encrypt));
+  op->key_index = sa->crypto_key_index;
+  return op;
+}
+
+/* async mode, add the op of a buffer to the open frame of the SA's
+   algorithm; returns 0 when no frame is available */
+always_inline vnet_crypto_op_t *
+esp_crypto_async_op_add (vlib_main_t * vm,
+			 ipsec_proto_main_per_thread_data_t * ptd,
+			 ipsec_sa_t * sa, int is_encrypt, u32 bi,
+			 u16 post_next)
+{
+  ipsec_proto_main_crypto_alg_t *a =
+    ipsec_proto_main.ipsec_proto_main_crypto_algs + sa->crypto_alg;
+  vnet_crypto_async_frame_t **f = ptd->async_frames + sa->crypto_alg;
+  vnet_crypto_op_t *op;
+
+  if (*f == 0)
+    {
+      *f = vnet_crypto_async_get_frame (vm,
+					vnet_crypto_op_id (a->alg,
+							   is_encrypt));
+      if (PREDICT_FALSE (*f == 0))
+	return 0;
+    }
+
+  op = vnet_crypto_async_add_to_frame (*f, bi, post_next);
+  op->key_index = sa->crypto_key_index;
+  return op;
+}
+
+/* async mode, hand a frame filled by an esp node to the engine. When it
+   is not taken the packets are dropped, their output buffers and the
+   input buffers their ops read from. */
+always_inline void
+esp_crypto_async_submit (vlib_main_t * vm, vnet_crypto_async_frame_t * f,
+			 u32 node_index, u32 error)
+{
+  u32 i;
+
+  if (PREDICT_TRUE (vnet_crypto_async_submit_open_frame (vm, f) == 0))
+    return;
+
+  for (i = 0; i < f->n_elts; i++)
+    {
+      vlib_buffer_t *b = vlib_get_buffer (vm, f->buffer_indices[i]);
+      vlib_buffer_free_one (vm, vnet_buffer2 (b)->crypto.esp.src_bi);
+    }
+  vlib_buffer_free (vm, f->buffer_indices, f->n_elts);
+  vlib_node_increment_counter (vm, node_index, error, f->n_elts);
+  vnet_crypto_async_free_frame (vm, f);
+}
+
+/* RFC 4106, the AAD is the SPI and the 32 or 64 bit sequence number */
+always_inline void
+esp_crypto_op_set_aad (vnet_crypto_op_t * op, ipsec_sa_t * sa,
+		       esp_header_t * esp, u32 seq_hi)
+{
+  seq_hi = clib_host_to_net_u32 (seq_hi);
+
+  clib_memcpy (op->aad, &esp->spi, sizeof (esp->spi));
+  if (sa->use_esn)
+    {
+      clib_memcpy (op->aad + 4, &seq_hi, sizeof (seq_hi));
+      clib_memcpy (op->aad + 8, &esp->seq, sizeof (esp->seq));
+      op->aad_len = 12;
+    }
+  else
+    {
+      clib_memcpy (op->aad + 4, &esp->seq, sizeof (esp->seq));
+      op->aad_len = 8;
+    }
+}
+
 #endif /* __ESP_H__ */
 
 /*
@@ -0,0 +1,1067 @@
+/*
+ * esp_crypto.c : IPSec ESP cipher engines
+ *
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Cipher engines of the ESP nodes, registered with vnet crypto which
+ * runs the ops of a whole frame in one call per op:
+ *
+ *  - the native AES engine, built once per cpu variant: AES-NI with 128
+ *    bit registers, and VAES / VPCLMULQDQ with 512 bit registers, each
+ *    instruction working on four blocks. Key schedules are expanded when
+ *    the crypto key of an SA is added.
+ *  - OpenSSL, used for DES and 3DES and when the cpu has no AES
+ *    instructions.
+ *
+ * CBC encryption is serial within a packet, so blocks of several packets
+ * are interleaved instead. CBC decryption and GCM are parallel within a
+ * packet; GHASH uses precomputed powers of H and reduces once per group
+ * of blocks.
+ */
+
+#include <vnet/vnet.h>
+#include <vnet/ip/ip.h>
+
+#include <vnet/ipsec/ipsec.h>
+#include <vnet/ipsec/esp.h>
+
+#if defined (CLIB_MULTIARCH_VARIANT) && defined (__AES__) && defined (__PCLMUL__)
+#include <x86intrin.h>
+
+#if defined (__VAES__) && defined (__VPCLMULQDQ__) && defined (__AVX512BW__)
+#define ESP_AES_WIDE 1
+#endif
+
+static_always_inline __m128i
+aes_byte_swap (__m128i x)
+{
+  return _mm_shuffle_epi8 (x, _mm_setr_epi8 (15, 14, 13, 12, 11, 10, 9, 8,
+					     7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+/* counter blocks are kept with the 32 bit counter in host byte order so
+   they can be incremented with a vector add */
+static_always_inline __m128i
+aes_ctr_byte_swap (__m128i x)
+{
+  return _mm_shuffle_epi8 (x, _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+					     8, 9, 10, 11, 15, 14, 13, 12));
+}
+
+static_always_inline __m128i
+aes_encrypt_block (__m128i x, __m128i * k, int rounds)
+{
+  int i;
+
+  x ^= k[0];
+  for (i = 1; i < rounds; i++)
+    x = _mm_aesenc_si128 (x, k[i]);
+  return _mm_aesenclast_si128 (x, k[rounds]);
+}
+
+/*
+ * GHASH multiplication on byte reflected operands, carry-less multiply
+ * followed by a shift and reduction modulo x^128 + x^7 + x^2 + x + 1.
+ * Products of several blocks are summed before the single reduction.
+ */
+typedef struct
+{
+  __m128i lo, mid, hi;
+} ghash_data_t;
+
+static_always_inline void
+ghash_mul_first (ghash_data_t * gd, __m128i a, __m128i b)
+{
+  gd->lo = _mm_clmulepi64_si128 (a, b, 0x00);
+  gd->hi = _mm_clmulepi64_si128 (a, b, 0x11);
+  gd->mid = _mm_clmulepi64_si128 (a, b, 0x01) ^
+    _mm_clmulepi64_si128 (a, b, 0x10);
+}
+
+static_always_inline void
+ghash_mul_next (ghash_data_t * gd, __m128i a, __m128i b)
+{
+  gd->lo ^= _mm_clmulepi64_si128 (a, b, 0x00);
+  gd->hi ^= _mm_clmulepi64_si128 (a, b, 0x11);
+  gd->mid ^= _mm_clmulepi64_si128 (a, b, 0x01) ^
+    _mm_clmulepi64_si128 (a, b, 0x10);
+}
+
+static_always_inline __m128i
+ghash_reduce (ghash_data_t * gd)
+{
+  __m128i lo = gd->lo ^ _mm_slli_si128 (gd->mid, 8);
+  __m128i hi = gd->hi ^ _mm_srli_si128 (gd->mid, 8);
+  __m128i t0, t1, t2;
+
+  /* the product of two reflected values is one bit short */
+  t0 = _mm_srli_epi32 (lo, 31);
+  t1 = _mm_srli_epi32 (hi, 31);
+  lo = _mm_slli_epi32 (lo, 1);
+  hi = _mm_slli_epi32 (hi, 1);
+  t2 = _mm_srli_si128 (t0, 12);
+  lo |= _mm_slli_si128 (t0, 4);
+  hi |= _mm_slli_si128 (t1, 4) | t2;
+
+  t0 = _mm_slli_epi32 (lo, 31) ^ _mm_slli_epi32 (lo, 30) ^
+    _mm_slli_epi32 (lo, 25);
+  t1 = _mm_srli_si128 (t0, 4);
+  lo ^= _mm_slli_si128 (t0, 12);
+  t2 = _mm_srli_epi32 (lo, 1) ^ _mm_srli_epi32 (lo, 2) ^
+    _mm_srli_epi32 (lo, 7) ^ t1;
+
+  return hi ^ lo ^ t2;
+}
+
+static_always_inline __m128i
+ghash_mul (__m128i a, __m128i b)
+{
+  ghash_data_t gd;
+  ghash_mul_first (&gd, a, b);
+  return ghash_reduce (&gd);
+}
+
+static_always_inline u32
+aes_sub_word (u32 w)
+{
+  return _mm_cvtsi128_si32 (_mm_aeskeygenassist_si128
+			    (_mm_set_epi32 (0, 0, w, 0), 0));
+}
+
+static void
+esp_aes_key_expand (esp_aes_key_t * kd, u8 * key, u32 key_len)
+{
+  __m128i *ek = (__m128i *) kd->encrypt_key;
+  __m128i *dk = (__m128i *) kd->decrypt_key;
+  __m128i *hk = (__m128i *) kd->ghash_key;
+  u32 w[4 * 15];
+  u32 nk = key_len / 4, rounds = nk + 6, i;
+  u8 rcon = 1;
+  __m128i h;
+
+  /* FIPS-197 key expansion, one 32 bit word at a time */
+  clib_memcpy (w, key, key_len);
+  for (i = nk; i < 4 * (rounds + 1); i++)
+    {
+      u32 t = w[i - 1];
+      if (i % nk == 0)
+	{
+	  t = aes_sub_word ((t >> 8) | (t << 24)) ^ rcon;
+	  rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0);
+	}
+      else if (nk > 6 && i % nk == 4)
+	t = aes_sub_word (t);
+      w[i] = w[i - nk] ^ t;
+    }
+
+  for (i = 0; i <= rounds; i++)
+    ek[i] = _mm_loadu_si128 ((__m128i *) w + i);
+
+  /* equivalent inverse cipher */
+  dk[0] = ek[rounds];
+  for (i = 1; i < rounds; i++)
+    dk[i] = _mm_aesimc_si128 (ek[rounds - i]);
+  dk[rounds] = ek[0];
+
+  h = aes_byte_swap (aes_encrypt_block (_mm_setzero_si128 (), ek, rounds));
+  hk[15] = h;
+  for (i = 15; i > 0; i--)
+    hk[i - 1] = ghash_mul (hk[i], h);
+}
+
+static_always_inline esp_aes_key_t *
+esp_aes_op_key (vnet_crypto_op_t * op)
+{
+  return vec_elt_at_index (ipsec_proto_main.aes_keys, op->key_index);
+}
+
+static_always_inline __m128i
+aes_gcm_j0 (vnet_crypto_op_t * op)
+{
+  u32 iv0, iv1;
+
+  clib_memcpy (&iv0, op->iv, 4);
+  clib_memcpy (&iv1, op->iv + 4, 4);
+  return _mm_set_epi32 (clib_host_to_net_u32 (1), iv1, iv0,
+			esp_aes_op_key (op)->salt);
+}
+
+static_always_inline __m128i
+aes_gcm_aad_hash (vnet_crypto_op_t * op, __m128i h)
+{
+  u8 aad[16] = { 0 };
+
+  clib_memcpy (aad, op->aad, op->aad_len);
+  return ghash_mul (aes_byte_swap (_mm_loadu_si128 ((__m128i *) aad)), h);
+}
+
+static_always_inline int
+aes_gcm_tag (vnet_crypto_op_t * op, __m128i x, __m128i j0, __m128i * k,
+	     __m128i h, int rounds, int is_encrypt)
+{
+  __m128i t, len;
+
+  len = _mm_set_epi64x ((u64) op->aad_len * 8, (u64) op->len * 8);
+  x = ghash_mul (x ^ len, h);
+  t = aes_byte_swap (x) ^ aes_encrypt_block (j0, k, rounds);
+
+  if (is_encrypt)
+    {
+      _mm_storeu_si128 ((__m128i *) op->tag, t);
+      return 1;
+    }
+
+  t ^= _mm_loadu_si128 ((__m128i *) op->tag);
+  return _mm_testz_si128 (t, t);
+}
+
+#ifndef ESP_AES_WIDE
+
+/*
+ * AES-NI, 128 bit registers
+ */
+
+#define ESP_AES_CBC_N_LANES 4
+
+static_always_inline void
+aes_cbc_encrypt_inline (vnet_crypto_op_t * ops, u32 n_ops, int rounds)
+{
+  u8 scratch[16];
+  __m128i x[ESP_AES_CBC_N_LANES], *k[ESP_AES_CBC_N_LANES];
+  u8 *src[ESP_AES_CBC_N_LANES], *dst[ESP_AES_CBC_N_LANES];
+  u32 n_blocks[ESP_AES_CBC_N_LANES];
+  u32 i, l, r, n, next = 0;
+
+  for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+    {
+      k[l] = (__m128i *) esp_aes_op_key (ops)->encrypt_key;
+      n_blocks[l] = 0;
+      x[l] = _mm_setzero_si128 ();
+    }
+
+  for (;;)
+    {
+      /* put the next op on each lane that ran dry, idle lanes spin on
+         a scratch block */
+      n = ~0;
+      for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	{
+	  if (n_blocks[l] == 0 && next < n_ops)
+	    {
+	      vnet_crypto_op_t *op = ops + next++;
+	      k[l] = (__m128i *) esp_aes_op_key (op)->encrypt_key;
+	      x[l] = _mm_loadu_si128 ((__m128i *) op->iv);
+	      src[l] = op->src;
+	      dst[l] = op->dst;
+	      n_blocks[l] = op->len / 16;
+	    }
+	  if (n_blocks[l] == 0)
+	    src[l] = dst[l] = scratch;
+	  else
+	    n = clib_min (n, n_blocks[l]);
+	}
+
+      if (n == ~0)
+	break;
+
+      for (i = 0; i < n; i++)
+	{
+	  for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	    x[l] ^= _mm_loadu_si128 ((__m128i *) src[l]) ^ k[l][0];
+	  for (r = 1; r < rounds; r++)
+	    for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	      x[l] = _mm_aesenc_si128 (x[l], k[l][r]);
+	  for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	    {
+	      x[l] = _mm_aesenclast_si128 (x[l], k[l][rounds]);
+	      _mm_storeu_si128 ((__m128i *) dst[l], x[l]);
+	      if (n_blocks[l])
+		{
+		  src[l] += 16;
+		  dst[l] += 16;
+		}
+	    }
+	}
+
+      for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	if (n_blocks[l])
+	  n_blocks[l] -= n;
+    }
+}
+
+static_always_inline void
+aes_cbc_decrypt_inline (vnet_crypto_op_t * ops, u32 n_ops, int rounds)
+{
+  u32 i, r, n_blocks;
+
+  for (; n_ops; ops++, n_ops--)
+    {
+      __m128i *k = (__m128i *) esp_aes_op_key (ops)->decrypt_key;
+      __m128i iv = _mm_loadu_si128 ((__m128i *) ops->iv);
+      __m128i *src = (__m128i *) ops->src;
+      __m128i *dst = (__m128i *) ops->dst;
+      __m128i c[4], x[4];
+
+      n_blocks = ops->len / 16;
+
+      while (n_blocks >= 4)
+	{
+	  for (i = 0; i < 4; i++)
+	    {
+	      c[i] = _mm_loadu_si128 (src + i);
+	      x[i] = c[i] ^ k[0];
+	    }
+	  for (r = 1; r < rounds; r++)
+	    for (i = 0; i < 4; i++)
+	      x[i] = _mm_aesdec_si128 (x[i], k[r]);
+	  for (i = 0; i < 4; i++)
+	    x[i] = _mm_aesdeclast_si128 (x[i], k[rounds]);
+
+	  _mm_storeu_si128 (dst + 0, x[0] ^ iv);
+	  _mm_storeu_si128 (dst + 1, x[1] ^ c[0]);
+	  _mm_storeu_si128 (dst + 2, x[2] ^ c[1]);
+	  _mm_storeu_si128 (dst + 3, x[3] ^ c[2]);
+	  iv = c[3];
+	  src += 4;
+	  dst += 4;
+	  n_blocks -= 4;
+	}
+
+      while (n_blocks)
+	{
+	  c[0] = _mm_loadu_si128 (src);
+	  x[0] = c[0] ^ k[0];
+	  for (r = 1; r < rounds; r++)
+	    x[0] = _mm_aesdec_si128 (x[0], k[r]);
+	  x[0] = _mm_aesdeclast_si128 (x[0], k[rounds]);
+	  _mm_storeu_si128 (dst, x[0] ^ iv);
+	  iv = c[0];
+	  src++;
+	  dst++;
+	  n_blocks--;
+	}
+    }
+}
+
+static_always_inline void
+aes_ctr_blocks (__m128i * ctr, __m128i * k, u8 * src, u8 * dst, int n,
+		int rounds)
+{
+  __m128i x[4];
+  int i, r;
+
+  for (i = 0; i < n; i++)
+    {
+      x[i] = aes_ctr_byte_swap (*ctr) ^ k[0];
+      *ctr = _mm_add_epi32 (*ctr, _mm_setr_epi32 (0, 0, 0, 1));
+    }
+  for (r = 1; r < rounds; r++)
+    for (i = 0; i < n; i++)
+      x[i] = _mm_aesenc_si128 (x[i], k[r]);
+  for (i = 0; i < n; i++)
+    {
+      x[i] = _mm_aesenclast_si128 (x[i], k[rounds]);
+      x[i] ^= _mm_loadu_si128 ((__m128i *) src + i);
+      _mm_storeu_si128 ((__m128i *) dst + i, x[i]);
+    }
+}
+
+/* hash n blocks into x, h points to H^n ... H^1 */
+static_always_inline __m128i
+ghash_blocks (__m128i x, __m128i * h, u8 * data, int n)
+{
+  ghash_data_t gd;
+  int i;
+
+  x ^= aes_byte_swap (_mm_loadu_si128 ((__m128i *) data));
+  ghash_mul_first (&gd, x, h[0]);
+  for (i = 1; i < n; i++)
+    ghash_mul_next (&gd,
+		    aes_byte_swap (_mm_loadu_si128 ((__m128i *) data + i)),
+		    h[i]);
+  return ghash_reduce (&gd);
+}
+
+static_always_inline int
+aes_gcm_inline (vnet_crypto_op_t * op, int rounds, int is_encrypt)
+{
+  esp_aes_key_t *kd = esp_aes_op_key (op);
+  __m128i *k = (__m128i *) kd->encrypt_key;
+  __m128i *hk = (__m128i *) kd->ghash_key;
+  __m128i j0, ctr, x;
+  u8 *src = op->src, *dst = op->dst;
+  u32 n_left = op->len;
+
+  j0 = aes_gcm_j0 (op);
+  ctr = _mm_add_epi32 (aes_ctr_byte_swap (j0), _mm_setr_epi32 (0, 0, 0, 1));
+  x = aes_gcm_aad_hash (op, hk[15]);
+
+  while (n_left >= 64)
+    {
+      if (is_encrypt)
+	{
+	  aes_ctr_blocks (&ctr, k, src, dst, 4, rounds);
+	  x = ghash_blocks (x, hk + 12, dst, 4);
+	}
+      else
+	{
+	  x = ghash_blocks (x, hk + 12, src, 4);
+	  aes_ctr_blocks (&ctr, k, src, dst, 4, rounds);
+	}
+      src += 64;
+      dst += 64;
+      n_left -= 64;
+    }
+
+  if (n_left)
+    {
+      /* last blocks go through a zero padded copy */
+      u8 tmp[64] = { 0 };
+      int n_blocks = (n_left + 15) / 16;
+
+      clib_memcpy (tmp, src, n_left);
+      if (is_encrypt)
+	{
+	  aes_ctr_blocks (&ctr, k, tmp, tmp, n_blocks, rounds);
+	  memset (tmp + n_left, 0, sizeof (tmp) - n_left);
+	  x = ghash_blocks (x, hk + 16 - n_blocks, tmp, n_blocks);
+	}
+      else
+	{
+	  x = ghash_blocks (x, hk + 16 - n_blocks, tmp, n_blocks);
+	  aes_ctr_blocks (&ctr, k, tmp, tmp, n_blocks, rounds);
+	}
+      clib_memcpy (dst, tmp, n_left);
+    }
+
+  return aes_gcm_tag (op, x, j0, k, hk[15], rounds, is_encrypt);
+}
+
+#else /* ESP_AES_WIDE */
+
+/*
+ * VAES and VPCLMULQDQ, 512 bit registers holding four blocks
+ */
+
+#define ESP_AES_CBC_N_LANES 8
+
+static_always_inline __m512i
+aes_byte_swap_x4 (__m512i x)
+{
+  __m128i m = _mm_setr_epi8 (15, 14, 13, 12, 11, 10, 9, 8,
+			     7, 6, 5, 4, 3, 2, 1, 0);
+  return _mm512_shuffle_epi8 (x, _mm512_broadcast_i32x4 (m));
+}
+
+static_always_inline __m512i
+aes_ctr_byte_swap_x4 (__m512i x)
+{
+  __m128i m = _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+			     8, 9, 10, 11, 15, 14, 13, 12);
+  return _mm512_shuffle_epi8 (x, _mm512_broadcast_i32x4 (m));
+}
+
+static_always_inline __m128i
+aes_xor_lanes_x4 (__m512i x)
+{
+  __m256i y = _mm512_castsi512_si256 (x) ^ _mm512_extracti64x4_epi64 (x, 1);
+  return _mm256_castsi256_si128 (y) ^ _mm256_extracti128_si256 (y, 1);
+}
+
+static_always_inline void
+aes_broadcast_key (__m512i * kz, __m128i * k, int rounds)
+{
+  int r;
+  for (r = 0; r <= rounds; r++)
+    kz[r] = _mm512_broadcast_i32x4 (k[r]);
+}
+
+static_always_inline __m512i
+aes_load_lanes_x4 (u8 ** p)
+{
+  __m512i x;
+  x = _mm512_castsi128_si512 (_mm_loadu_si128 ((__m128i *) p[0]));
+  x = _mm512_inserti32x4 (x, _mm_loadu_si128 ((__m128i *) p[1]), 1);
+  x = _mm512_inserti32x4 (x, _mm_loadu_si128 ((__m128i *) p[2]), 2);
+  x = _mm512_inserti32x4 (x, _mm_loadu_si128 ((__m128i *) p[3]), 3);
+  return x;
+}
+
+static_always_inline void
+aes_store_lanes_x4 (u8 ** p, __m512i x)
+{
+  _mm_storeu_si128 ((__m128i *) p[0], _mm512_castsi512_si128 (x));
+  _mm_storeu_si128 ((__m128i *) p[1], _mm512_extracti32x4_epi32 (x, 1));
+  _mm_storeu_si128 ((__m128i *) p[2], _mm512_extracti32x4_epi32 (x, 2));
+  _mm_storeu_si128 ((__m128i *) p[3], _mm512_extracti32x4_epi32 (x, 3));
+}
+
+static_always_inline void
+aes_cbc_encrypt_inline (vnet_crypto_op_t * ops, u32 n_ops, int rounds)
+{
+  u8 scratch[16];
+  __m512i x[ESP_AES_CBC_N_LANES / 4];
+  __m512i kz[ESP_AES_CBC_N_LANES / 4][15];
+  u8 *src[ESP_AES_CBC_N_LANES], *dst[ESP_AES_CBC_N_LANES];
+  u32 n_blocks[ESP_AES_CBC_N_LANES];
+  u32 i, l, r, z, n, next = 0;
+
+  for (z = 0; z < ESP_AES_CBC_N_LANES / 4; z++)
+    {
+      aes_broadcast_key (kz[z], (__m128i *) esp_aes_op_key (ops)->encrypt_key,
+			 rounds);
+      x[z] = _mm512_setzero_si512 ();
+    }
+  for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+    n_blocks[l] = 0;
+
+  for (;;)
+    {
+      n = ~0;
+      for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	{
+	  if (n_blocks[l] == 0 && next < n_ops)
+	    {
+	      vnet_crypto_op_t *op = ops + next++;
+	      __m128i *k = (__m128i *) esp_aes_op_key (op)->encrypt_key;
+	      __mmask16 m = 0xf << (4 * (l & 3));
+
+	      /* each 128 bit lane of the round keys belongs to one op */
+	      for (r = 0; r <= rounds; r++)
+		kz[l / 4][r] = _mm512_mask_broadcast_i32x4 (kz[l / 4][r], m,
+							    k[r]);
+	      x[l / 4] = _mm512_mask_broadcast_i32x4 (x[l / 4], m,
+						      _mm_loadu_si128
+						      ((__m128i *) op->iv));
+	      src[l] = op->src;
+	      dst[l] = op->dst;
+	      n_blocks[l] = op->len / 16;
+	    }
+	  if (n_blocks[l] == 0)
+	    src[l] = dst[l] = scratch;
+	  else
+	    n = clib_min (n, n_blocks[l]);
+	}
+
+      if (n == ~0)
+	break;
+
+      for (i = 0; i < n; i++)
+	{
+	  for (z = 0; z < ESP_AES_CBC_N_LANES / 4; z++)
+	    x[z] ^= aes_load_lanes_x4 (src + 4 * z) ^ kz[z][0];
+	  for (r = 1; r < rounds; r++)
+	    for (z = 0; z < ESP_AES_CBC_N_LANES / 4; z++)
+	      x[z] = _mm512_aesenc_epi128 (x[z], kz[z][r]);
+	  for (z = 0; z < ESP_AES_CBC_N_LANES / 4; z++)
+	    {
+	      x[z] = _mm512_aesenclast_epi128 (x[z], kz[z][rounds]);
+	      aes_store_lanes_x4 (dst + 4 * z, x[z]);
+	    }
+	  for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	    if (n_blocks[l])
+	      {
+		src[l] += 16;
+		dst[l] += 16;
+	      }
+	}
+
+      for (l = 0; l < ESP_AES_CBC_N_LANES; l++)
+	if (n_blocks[l])
+	  n_blocks[l] -= n;
+    }
+}
+
+static_always_inline void
+aes_cbc_decrypt_inline (vnet_crypto_op_t * ops, u32 n_ops, int rounds)
+{
+  __m512i kz[15], c[4], x[4], last;
+  u32 i, r, n_blocks, last_key_index = ~0;
+
+  for (; n_ops; ops++, n_ops--)
+    {
+      u8 *src = ops->src;
+      u8 *dst = ops->dst;
+
+      if (ops->key_index != last_key_index)
+	{
+	  aes_broadcast_key (kz,
+			     (__m128i *) esp_aes_op_key (ops)->decrypt_key,
+			     rounds);
+	  last_key_index = ops->key_index;
+	}
+
+      /* only the last lane of the previous ciphertext is used */
+      last = _mm512_broadcast_i32x4 (_mm_loadu_si128 ((__m128i *) ops->iv));
+      n_blocks = ops->len / 16;
+
+      while (n_blocks >= 16)
+	{
+	  for (i = 0; i < 4; i++)
+	    {
+	      c[i] = _mm512_loadu_si512 (src + 64 * i);
+	      x[i] = c[i] ^ kz[0];
+	    }
+	  for (r = 1; r < rounds; r++)
+	    for (i = 0; i < 4; i++)
+	      x[i] = _mm512_aesdec_epi128 (x[i], kz[r]);
+	  for (i = 0; i < 4; i++)
+	    x[i] = _mm512_aesdeclast_epi128 (x[i], kz[rounds]);
+
+	  x[0] ^= _mm512_alignr_epi64 (c[0], last, 6);
+	  x[1] ^= _mm512_alignr_epi64 (c[1], c[0], 6);
+	  x[2] ^= _mm512_alignr_epi64 (c[2], c[1], 6);
+	  x[3] ^= _mm512_alignr_epi64 (c[3], c[2], 6);
+	  for (i = 0; i < 4; i++)
+	    _mm512_storeu_si512 (dst + 64 * i, x[i]);
+
+	  last = c[3];
+	  src += 256;
+	  dst += 256;
+	  n_blocks -= 16;
+	}
+
+      while (n_blocks)
+	{
+	  u32 n = clib_min (n_blocks, 4);
+	  __mmask8 m = n == 4 ? 0xff : (1 << (2 * n)) - 1;
+
+	  c[0] = _mm512_maskz_loadu_epi64 (m, src);
+	  x[0] = c[0] ^ kz[0];
+	  for (r = 1; r < rounds; r++)
+	    x[0] = _mm512_aesdec_epi128 (x[0], kz[r]);
+	  x[0] = _mm512_aesdeclast_epi128 (x[0], kz[rounds]);
+	  x[0] ^= _mm512_alignr_epi64 (c[0], last, 6);
+	  _mm512_mask_storeu_epi64 (dst, m, x[0]);
+
+	  last = c[0];
+	  src += 16 * n;
+	  dst += 16 * n;
+	  n_blocks -= n;
+	}
+    }
+}
+
+/*
+ * Up to 16 blocks, in up to four registers. Register i covers bytes
+ * [64 * i, 64 * i + 64) of n_bytes, the tail is handled with byte masks
+ * so no copy is needed. hp points to H^n ... H^1 for the n blocks.
+ */
+static_always_inline __m128i
+aes_gcm_blocks_x4 (__m512i * ctr, __m512i * kz, __m128i * hp, __m128i x,
+		   u8 * src, u8 * dst, u32 n_bytes, int n_regs, int rounds,
+		   int is_encrypt)
+{
+  __m512i inc = _mm512_setr_epi32 (0, 0, 0, 4, 0, 0, 0, 4,
+				   0, 0, 0, 4, 0, 0, 0, 4);
+  __m512i d[4], ks[4], lo, mid, hi, g, h;
+  __mmask64 bm[4];
+  int i, r;
+
+  for (i = 0; i < n_regs; i++)
+    {
+      u32 n = n_bytes - 64 * i;
+      bm[i] = n >= 64 ? ~0ULL : (1ULL << n) - 1;
+      d[i] = _mm512_maskz_loadu_epi8 (bm[i], src + 64 * i);
+      ks[i] = aes_ctr_byte_swap_x4 (*ctr) ^ kz[0];
+      *ctr = _mm512_add_epi32 (*ctr, inc);
+    }
+
+  for (r = 1; r < rounds; r++)
+    for (i = 0; i < n_regs; i++)
+      ks[i] = _mm512_aesenc_epi128 (ks[i], kz[r]);
+
+  lo = mid = hi = _mm512_setzero_si512 ();
+  for (i = 0; i < n_regs; i++)
+    {
+      u32 n_blocks = clib_min (4, (n_bytes - 64 * i + 15) / 16);
+      __mmask8 hm = n_blocks == 4 ? 0xff : (1 << (2 * n_blocks)) - 1;
+
+      ks[i] = _mm512_aesenclast_epi128 (ks[i], kz[rounds]) ^ d[i];
+      _mm512_mask_storeu_epi8 (dst + 64 * i, bm[i], ks[i]);
+
+      g = is_encrypt ? _mm512_maskz_mov_epi8 (bm[i], ks[i]) : d[i];
+      g = aes_byte_swap_x4 (g);
+      if (i == 0)
+	g ^= _mm512_zextsi128_si512 (x);
+      h = _mm512_maskz_loadu_epi64 (hm, hp + 4 * i);
+
+      lo ^= _mm512_clmulepi64_epi128 (g, h, 0x00);
+      hi ^= _mm512_clmulepi64_epi128 (g, h, 0x11);
+      mid ^= _mm512_clmulepi64_epi128 (g, h, 0x01) ^
+	_mm512_clmulepi64_epi128 (g, h, 0x10);
+    }
+
+  {
+    ghash_data_t gd;
+    gd.lo = aes_xor_lanes_x4 (lo);
+    gd.mid = aes_xor_lanes_x4 (mid);
+    gd.hi = aes_xor_lanes_x4 (hi);
+    return ghash_reduce (&gd);
+  }
+}
+
+static_always_inline int
+aes_gcm_inline (vnet_crypto_op_t * op, int rounds, int is_encrypt)
+{
+  esp_aes_key_t *kd = esp_aes_op_key (op);
+  __m128i *k = (__m128i *) kd->encrypt_key;
+  __m128i *hk = (__m128i *) kd->ghash_key;
+  __m512i kz[15], ctr;
+  __m128i j0, x;
+  u8 *src = op->src, *dst = op->dst;
+  u32 n_left = op->len;
+
+  aes_broadcast_key (kz, k, rounds);
+
+  j0 = aes_gcm_j0 (op);
+  ctr = _mm512_add_epi32 (_mm512_broadcast_i32x4 (aes_ctr_byte_swap (j0)),
+			  _mm512_setr_epi32 (0, 0, 0, 1, 0, 0, 0, 2,
+					     0, 0, 0, 3, 0, 0, 0, 4));
+  x = aes_gcm_aad_hash (op, hk[15]);
+
+  while (n_left >= 256)
+    {
+      x = aes_gcm_blocks_x4 (&ctr, kz, hk, x, src, dst, 256, 4, rounds,
+			     is_encrypt);
+      src += 256;
+      dst += 256;
+      n_left -= 256;
+    }
+
+  if (n_left)
+    {
+      u32 n_blocks = (n_left + 15) / 16;
+      x = aes_gcm_blocks_x4 (&ctr, kz, hk + 16 - n_blocks, x, src, dst,
+			     n_left, (n_left + 63) / 64, rounds, is_encrypt);
+    }
+
+  return aes_gcm_tag (op, x, j0, k, hk[15], rounds, is_encrypt);
+}
+
+#endif /* ESP_AES_WIDE */
+
+static_always_inline int
+esp_aes_rounds (vnet_crypto_alg_t alg)
+{
+  switch (alg)
+    {
+    case VNET_CRYPTO_ALG_AES_128_CBC:
+    case VNET_CRYPTO_ALG_AES_128_GCM:
+      return 10;
+    case VNET_CRYPTO_ALG_AES_192_CBC:
+    case VNET_CRYPTO_ALG_AES_192_GCM:
+      return 12;
+    default:
+      return 14;
+    }
+}
+
+/* the round count is made a constant so round loops are unrolled */
+#define foreach_aes_rounds _(10) _(12) _(14)
+
+static_always_inline u32
+esp_aes_ops_done (vnet_crypto_op_t * ops, u32 n_ops)
+{
+  u32 i, n_ok = 0;
+
+  for (i = 0; i < n_ops; i++)
+    if (ops[i].status == VNET_CRYPTO_OP_STATUS_NOT_PROCESSED)
+      {
+	ops[i].status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+	n_ok++;
+      }
+  return n_ok;
+}
+
+static u32
+esp_aes_cbc_encrypt (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops)
+{
+  switch (esp_aes_rounds (vnet_crypto_op_alg (ops->op)))
+    {
+#define _(r) case r: aes_cbc_encrypt_inline (ops, n_ops, r); break;
+      foreach_aes_rounds
+#undef _
+    }
+  return esp_aes_ops_done (ops, n_ops);
+}
+
+static u32
+esp_aes_cbc_decrypt (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops)
+{
+  switch (esp_aes_rounds (vnet_crypto_op_alg (ops->op)))
+    {
+#define _(r) case r: aes_cbc_decrypt_inline (ops, n_ops, r); break;
+      foreach_aes_rounds
+#undef _
+    }
+  return esp_aes_ops_done (ops, n_ops);
+}
+
+static u32
+esp_aes_gcm_encrypt (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops)
+{
+  u32 i;
+
+  switch (esp_aes_rounds (vnet_crypto_op_alg (ops->op)))
+    {
+#define _(r)					\
+    case r:					\
+      for (i = 0; i < n_ops; i++)		\
+	aes_gcm_inline (ops + i, r, 1);		\
+      break;
+      foreach_aes_rounds
+#undef _
+    }
+  return esp_aes_ops_done (ops, n_ops);
+}
+
+static u32
+esp_aes_gcm_decrypt (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops)
+{
+  u32 i;
+
+  switch (esp_aes_rounds (vnet_crypto_op_alg (ops->op)))
+    {
+#define _(r)							\
+    case r:							\
+      for (i = 0; i < n_ops; i++)				\
+	if (!aes_gcm_inline (ops + i, r, 0))			\
+	  ops[i].status = VNET_CRYPTO_OP_STATUS_FAIL_BAD_TAG;	\
+      break;
+      foreach_aes_rounds
+#undef _
+    }
+  return esp_aes_ops_done (ops, n_ops);
+}
+
+esp_crypto_engine_t CLIB_MULTIARCH_FN (esp_aes_engine) =
+{
+#ifdef ESP_AES_WIDE
+  .name = "vaes",
+  .desc = "Native AES, VAES and VPCLMULQDQ",
+#else
+  .name = "aes-ni",
+  .desc = "Native AES, AES-NI and PCLMULQDQ",
+#endif
+  .key_expand = esp_aes_key_expand,
+  .aes_cbc_encrypt = esp_aes_cbc_encrypt,
+  .aes_cbc_decrypt = esp_aes_cbc_decrypt,
+  .aes_gcm_encrypt = esp_aes_gcm_encrypt,
+  .aes_gcm_decrypt = esp_aes_gcm_decrypt,
+};
+
+#endif /* CLIB_MULTIARCH_VARIANT && __AES__ && __PCLMUL__ */
+
+#ifndef CLIB_MULTIARCH_VARIANT
+
+/*
+ * OpenSSL, one EVP call sequence per op
+ */
+
+static const EVP_CIPHER *esp_openssl_ciphers[VNET_CRYPTO_N_ALGS];
+
+static_always_inline u32
+esp_openssl_ops (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops,
+		 int is_encrypt)
+{
+  ipsec_proto_main_t *em = &ipsec_proto_main;
+  ipsec_proto_main_per_thread_data_t *ptd =
+    vec_elt_at_index (em->per_thread_data, vm->thread_index);
+  vnet_crypto_alg_t alg = vnet_crypto_op_alg (ops->op), *last_alg;
+  const EVP_CIPHER *cipher = 0;
+  EVP_CIPHER_CTX *ctx;
+  int len, is_gcm;
+  u32 i, n_ok = 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  ctx = is_encrypt ? ptd->encrypt_ctx : ptd->decrypt_ctx;
+#else
+  ctx = is_encrypt ? &ptd->encrypt_ctx : &ptd->decrypt_ctx;
+#endif
+  last_alg = is_encrypt ? &ptd->last_encrypt_alg : &ptd->last_decrypt_alg;
+
+  if (PREDICT_FALSE (alg != *last_alg))
+    {
+      cipher = esp_openssl_ciphers[alg];
+      *last_alg = alg;
+    }
+
+  is_gcm = alg >= VNET_CRYPTO_ALG_AES_128_GCM &&
+    alg <= VNET_CRYPTO_ALG_AES_256_GCM;
+
+  for (i = 0; i < n_ops; i++)
+    {
+      vnet_crypto_op_t *op = ops + i;
+      vnet_crypto_key_t *key = vnet_crypto_get_key (op->key_index);
+
+      op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+
+      if (is_gcm)
+	{
+	  u8 nonce[12];
+
+	  /* RFC 4106, the salt follows the key */
+	  clib_memcpy (nonce, vec_end (key->data) - 4, 4);
+	  clib_memcpy (nonce + 4, op->iv, 8);
+	  EVP_CipherInit_ex (ctx, cipher, 0, key->data, nonce, is_encrypt);
+	  EVP_CipherUpdate (ctx, 0, &len, op->aad, op->aad_len);
+	  if (!is_encrypt)
+	    EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_TAG, 16, op->tag);
+	  EVP_CipherUpdate (ctx, op->dst, &len, op->src, op->len);
+	  if (EVP_CipherFinal_ex (ctx, op->dst + len, &len) <= 0)
+	    op->status = VNET_CRYPTO_OP_STATUS_FAIL_BAD_TAG;
+	  if (is_encrypt)
+	    EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_GET_TAG, 16, op->tag);
+	}
+      else
+	{
+	  EVP_CipherInit_ex (ctx, cipher, 0, key->data, op->iv, is_encrypt);
+	  /* ESP does its own padding */
+	  EVP_CIPHER_CTX_set_padding (ctx, 0);
+	  EVP_CipherUpdate (ctx, op->dst, &len, op->src, op->len);
+	  EVP_CipherFinal_ex (ctx, op->dst + len, &len);
+	}
+      n_ok += op->status == VNET_CRYPTO_OP_STATUS_COMPLETED;
+      cipher = 0;
+    }
+  return n_ok;
+}
+
+static u32
+esp_openssl_encrypt (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops)
+{
+  return esp_openssl_ops (vm, ops, n_ops, 1);
+}
+
+static u32
+esp_openssl_decrypt (vlib_main_t * vm, vnet_crypto_op_t * ops, u32 n_ops)
+{
+  return esp_openssl_ops (vm, ops, n_ops, 0);
+}
+
+extern esp_crypto_engine_t __clib_weak esp_aes_engine_avx512;
+extern esp_crypto_engine_t __clib_weak esp_aes_engine_avx2;
+
+static esp_crypto_engine_t *
+esp_aes_engine_select (void)
+{
+#if __x86_64__
+  if (&esp_aes_engine_avx512 && clib_cpu_supports_avx512f () &&
+      clib_cpu_supports_avx512bw () && clib_cpu_supports_vaes () &&
+      clib_cpu_supports_vpclmulqdq ())
+    return &esp_aes_engine_avx512;
+  if (&esp_aes_engine_avx2 && clib_cpu_supports_avx2 () &&
+      clib_cpu_supports_x86_aes () && clib_cpu_supports_pclmulqdq ())
+    return &esp_aes_engine_avx2;
+#endif
+  return 0;
+}
+
+/* expand the round keys of every AES key as it is added */
+static void
+esp_aes_key_handler (vlib_main_t * vm, vnet_crypto_key_op_t kop,
+		     u32 key_index)
+{
+  ipsec_proto_main_t *em = &ipsec_proto_main;
+  vnet_crypto_key_t *key = vnet_crypto_get_key (key_index);
+  u32 key_len = vec_len (key->data);
+  esp_aes_key_t *kd;
+
+  switch (key->alg)
+    {
+    case VNET_CRYPTO_ALG_AES_128_GCM:
+    case VNET_CRYPTO_ALG_AES_192_GCM:
+    case VNET_CRYPTO_ALG_AES_256_GCM:
+      key_len -= 4;
+      break;
+    case VNET_CRYPTO_ALG_AES_128_CBC:
+    case VNET_CRYPTO_ALG_AES_192_CBC:
+    case VNET_CRYPTO_ALG_AES_256_CBC:
+      break;
+    default:
+      return;
+    }
+
+  vec_validate_aligned (em->aes_keys, key_index, CLIB_CACHE_LINE_BYTES);
+  kd = vec_elt_at_index (em->aes_keys, key_index);
+
+  if (kop == VNET_CRYPTO_KEY_OP_DEL)
+    {
+      memset (kd, 0, sizeof (kd[0]));
+      return;
+    }
+
+  em->aes_engine->key_expand (kd, key->data, key_len);
+  if (key_len < vec_len (key->data))
+    clib_memcpy (&kd->salt, key->data + key_len, 4);
+}
+
+void
+esp_crypto_init (void)
+{
+  ipsec_proto_main_t *em = &ipsec_proto_main;
+  vlib_main_t *vm = vlib_get_main ();
+  esp_crypto_engine_t *e;
+  ipsec_crypto_alg_t i;
+  vnet_crypto_alg_t alg;
+  u32 ei;
+
+  ei = vnet_crypto_register_engine (vm, "openssl", 50, "OpenSSL");
+  for (i = IPSEC_CRYPTO_ALG_NONE + 1; i < IPSEC_CRYPTO_N_ALG; i++)
+    {
+      alg = em->ipsec_proto_main_crypto_algs[i].alg;
+      if (alg == VNET_CRYPTO_ALG_NONE)
+	continue;
+      esp_openssl_ciphers[alg] = em->ipsec_proto_main_crypto_algs[i].type;
+      vnet_crypto_register_ops_handler (vm, ei, vnet_crypto_op_id (alg, 1),
+					esp_openssl_encrypt);
+      vnet_crypto_register_ops_handler (vm, ei, vnet_crypto_op_id (alg, 0),
+					esp_openssl_decrypt);
+    }
+
+  if ((e = em->aes_engine = esp_aes_engine_select ()) == 0)
+    return;
+
+  ei = vnet_crypto_register_engine (vm, e->name, 100, e->desc);
+  vnet_crypto_register_key_handler (vm, ei, esp_aes_key_handler);
+  for (alg = VNET_CRYPTO_ALG_AES_128_CBC; alg <= VNET_CRYPTO_ALG_AES_256_CBC;
+       alg++)
+    {
+      vnet_crypto_register_ops_handler (vm, ei, vnet_crypto_op_id (alg, 1),
+					e->aes_cbc_encrypt);
+      vnet_crypto_register_ops_handler (vm, ei, vnet_crypto_op_id (alg, 0),
+					e->aes_cbc_decrypt);
+    }
+  for (alg = VNET_CRYPTO_ALG_AES_128_GCM; alg <= VNET_CRYPTO_ALG_AES_256_GCM;
+       alg++)
+    {
+      vnet_crypto_register_ops_handler (vm, ei, vnet_crypto_op_id (alg, 1),
+					e->aes_gcm_encrypt);
+      vnet_crypto_register_ops_handler (vm, ei, vnet_crypto_op_id (alg, 0),
+					e->aes_gcm_decrypt);
+    }
+}
+
+#endif /* CLIB_MULTIARCH_VARIANT */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
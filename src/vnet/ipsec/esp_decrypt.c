@@ -43,7 +43,8 @@ typedef enum
  _(DECRYPTION_FAILED, "ESP decryption failed")      \
  _(INTEG_ERROR, "Integrity check failed")           \
  _(REPLAY, "SA replayed packet")                    \
- _(NOT_IP, "Not IP packet (dropped)")
+ _(NOT_IP, "Not IP packet (dropped)")               \
+ _(NO_CRYPTO_FRAME, "No async crypto frame (packet dropped)")
 
 
 typedef enum
@@ -80,36 +81,158 @@ format_esp_decrypt_trace (u8 * s, va_list * args)
   return s;
 }
 
-always_inline void
-esp_decrypt_cbc (ipsec_crypto_alg_t alg,
-		 u8 * in, u8 * out, size_t in_len, u8 * key, u8 * iv)
+/* state of a packet between collecting the cipher ops of a frame and
+   running them */
+typedef struct
 {
-  ipsec_proto_main_t *em = &ipsec_proto_main;
-  u32 thread_index = vlib_get_thread_index ();
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-  EVP_CIPHER_CTX *ctx = em->per_thread_data[thread_index].decrypt_ctx;
-#else
-  EVP_CIPHER_CTX *ctx = &(em->per_thread_data[thread_index].decrypt_ctx);
-#endif
-  const EVP_CIPHER *cipher = NULL;
-  int out_len;
+  u32 i_bi;
+  u32 o_bi;
+  u32 sa_index;
+  /* with the high bits of an ESN */
+  u64 seq;
+  /* decrypted length, including the footer */
+  u32 len;
+  u8 ip_hdr_size;
+  u8 tunnel_mode;
+  u8 transport_ip6;
+  u8 drop;
+  /* continues in esp-decrypt-post */
+  u8 async;
+} esp_decrypt_packet_t;
+
+/* once the payload is decrypted: advance the replay window, strip the
+   padding and restore the inner header, returns the next index */
+static_always_inline u32
+esp_decrypt_finish (vlib_main_t * vm, vlib_node_runtime_t * node,
+		    esp_decrypt_packet_t * pkt)
+{
+  ipsec_main_t *im = &ipsec_main;
+  u32 next0 = ESP_DECRYPT_NEXT_DROP;
+  vlib_buffer_t *i_b0;
+  vlib_buffer_t *o_b0 = 0;
+  ipsec_sa_t *sa0;
+  esp_footer_t *f0;
+  ip4_header_t *ih4 = 0, *oh4 = 0;
+  ip6_header_t *ih6 = 0, *oh6 = 0;
+
+  i_b0 = vlib_get_buffer (vm, pkt->i_bi);
+  sa0 = pool_elt_at_index (im->sad, pkt->sa_index);
+
+  if (PREDICT_FALSE (pkt->drop))
+    goto next;
+
+  /* the window may have moved on a copy earlier in the frame or on
+     another worker */
+  if (PREDICT_TRUE (sa0->use_anti_replay))
+    {
+      if (PREDICT_FALSE (esp_replay_check (sa0, pkt->seq) ||
+			 esp_replay_advance (sa0, pkt->seq)))
+	{
+	  vlib_node_increment_counter (vm, node->node_index,
+				       ESP_DECRYPT_ERROR_REPLAY, 1);
+	  goto next;
+	}
+    }
 
-  ASSERT (alg < IPSEC_CRYPTO_N_ALG);
+  o_b0 = vlib_get_buffer (vm, pkt->o_bi);
+  if (!pkt->tunnel_mode)
+    {
+      ih4 = (ip4_header_t *) (i_b0->data + sizeof (ethernet_header_t));
+      ih6 = (ip6_header_t *) ih4;
+      oh4 = vlib_buffer_get_current (o_b0);
+      oh6 = vlib_buffer_get_current (o_b0);
+    }
 
-  if (PREDICT_FALSE (em->ipsec_proto_main_crypto_algs[alg].type == 0))
-    return;
+  o_b0->current_length = pkt->len - 2 + pkt->ip_hdr_size;
+  o_b0->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID;
+  f0 =
+    (esp_footer_t *) ((u8 *) vlib_buffer_get_current (o_b0) +
+		      o_b0->current_length);
+  if (PREDICT_FALSE (f0->pad_length > pkt->len - 2))
+    {
+      vlib_node_increment_counter (vm, node->node_index,
+				   ESP_DECRYPT_ERROR_DECRYPTION_FAILED, 1);
+      o_b0 = 0;
+      goto next;
+    }
+  o_b0->current_length -= f0->pad_length;
 
-  if (PREDICT_FALSE
-      (alg != em->per_thread_data[thread_index].last_decrypt_alg))
+  /* tunnel mode */
+  if (PREDICT_TRUE (pkt->tunnel_mode))
+    {
+      if (PREDICT_TRUE (f0->next_header == IP_PROTOCOL_IP_IN_IP))
+	next0 = ESP_DECRYPT_NEXT_IP4_INPUT;
+      else if (f0->next_header == IP_PROTOCOL_IPV6)
+	next0 = ESP_DECRYPT_NEXT_IP6_INPUT;
+      else
+	{
+	  clib_warning ("next header: 0x%x", f0->next_header);
+	  vlib_node_increment_counter (vm, node->node_index,
+				       ESP_DECRYPT_ERROR_DECRYPTION_FAILED,
+				       1);
+	  o_b0 = 0;
+	  goto next;
+	}
+    }
+  /* transport mode */
+  else
     {
-      cipher = em->ipsec_proto_main_crypto_algs[alg].type;
-      em->per_thread_data[thread_index].last_decrypt_alg = alg;
+      if (PREDICT_FALSE (pkt->transport_ip6))
+	{
+	  next0 = ESP_DECRYPT_NEXT_IP6_INPUT;
+	  oh6->ip_version_traffic_class_and_flow_label =
+	    ih6->ip_version_traffic_class_and_flow_label;
+	  oh6->protocol = f0->next_header;
+	  oh6->hop_limit = ih6->hop_limit;
+	  oh6->src_address.as_u64[0] = ih6->src_address.as_u64[0];
+	  oh6->src_address.as_u64[1] = ih6->src_address.as_u64[1];
+	  oh6->dst_address.as_u64[0] = ih6->dst_address.as_u64[0];
+	  oh6->dst_address.as_u64[1] = ih6->dst_address.as_u64[1];
+	  oh6->payload_length =
+	    clib_host_to_net_u16 (vlib_buffer_length_in_chain
+				  (vm, o_b0) - sizeof (ip6_header_t));
+	}
+      else
+	{
+	  next0 = ESP_DECRYPT_NEXT_IP4_INPUT;
+	  oh4->ip_version_and_header_length = 0x45;
+	  oh4->tos = ih4->tos;
+	  oh4->fragment_id = 0;
+	  oh4->flags_and_fragment_offset = 0;
+	  oh4->ttl = ih4->ttl;
+	  oh4->protocol = f0->next_header;
+	  oh4->src_address.as_u32 = ih4->src_address.as_u32;
+	  oh4->dst_address.as_u32 = ih4->dst_address.as_u32;
+	  oh4->length =
+	    clib_host_to_net_u16 (vlib_buffer_length_in_chain (vm, o_b0));
+	  oh4->checksum = ip4_header_checksum (oh4);
+	}
     }
 
-  EVP_DecryptInit_ex (ctx, cipher, NULL, key, iv);
+  /* for IPSec-GRE tunnel next node is ipsec-gre-input */
+  if (PREDICT_FALSE
+      ((vnet_buffer (i_b0)->ipsec.flags) & IPSEC_FLAG_IPSEC_GRE_TUNNEL))
+    next0 = ESP_DECRYPT_NEXT_IPSEC_GRE_INPUT;
+
+  vnet_buffer (o_b0)->sw_if_index[VLIB_TX] = (u32) ~ 0;
+  vnet_buffer (o_b0)->sw_if_index[VLIB_RX] =
+    vnet_buffer (i_b0)->sw_if_index[VLIB_RX];
+
+next:
+  if (PREDICT_FALSE (i_b0->flags & VLIB_BUFFER_IS_TRACED))
+    {
+      if (o_b0)
+	{
+	  o_b0->flags |= VLIB_BUFFER_IS_TRACED;
+	  o_b0->trace_index = i_b0->trace_index;
+	  esp_decrypt_trace_t *tr =
+	    vlib_add_trace (vm, node, o_b0, sizeof (*tr));
+	  tr->crypto_alg = sa0->crypto_alg;
+	  tr->integ_alg = sa0->integ_alg;
+	}
+    }
 
-  EVP_DecryptUpdate (ctx, out, &out_len, in, in_len);
-  EVP_DecryptFinal_ex (ctx, out + out_len, &out_len);
+  return next0;
 }
 
 static uword
@@ -123,6 +246,11 @@ esp_decrypt_node_fn (vlib_main_t * vm,
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
   u32 thread_index = vlib_get_thread_index ();
+  ipsec_proto_main_per_thread_data_t *ptd =
+    vec_elt_at_index (em->per_thread_data, thread_index);
+  esp_decrypt_packet_t pkts[VLIB_FRAME_SIZE], *pkt;
+  ipsec_crypto_alg_t alg;
+  u32 i;
 
   ipsec_alloc_empty_buffers (vm, im);
 
@@ -135,268 +263,229 @@ esp_decrypt_node_fn (vlib_main_t * vm,
       goto free_buffers_and_exit;
     }
 
-  next_index = node->cached_next_index;
-
-  while (n_left_from > 0)
+  /* verify and collect the cipher work of the frame */
+  for (i = 0; i < n_left_from; i++)
     {
-      u32 n_left_to_next;
-
-      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+      vlib_buffer_t *i_b0, *o_b0;
+      esp_header_t *esp0;
+      ipsec_sa_t *sa0;
+      vnet_crypto_op_t *op;
+      ip4_header_t *ih4;
 
-      while (n_left_from > 0 && n_left_to_next > 0)
-	{
-	  u32 i_bi0, o_bi0 = (u32) ~ 0, next0;
-	  vlib_buffer_t *i_b0;
-	  vlib_buffer_t *o_b0 = 0;
-	  esp_header_t *esp0;
-	  ipsec_sa_t *sa0;
-	  u32 sa_index0 = ~0;
-	  u32 seq;
-	  ip4_header_t *ih4 = 0, *oh4 = 0;
-	  ip6_header_t *ih6 = 0, *oh6 = 0;
-	  u8 tunnel_mode = 1;
-	  u8 transport_ip6 = 0;
-
-
-	  i_bi0 = from[0];
-	  from += 1;
-	  n_left_from -= 1;
-	  n_left_to_next -= 1;
+      pkt = pkts + i;
+      pkt->i_bi = pkt->o_bi = from[i];
+      pkt->drop = 1;
+      pkt->async = 0;
 
-	  next0 = ESP_DECRYPT_NEXT_DROP;
+      i_b0 = vlib_get_buffer (vm, pkt->i_bi);
+      esp0 = vlib_buffer_get_current (i_b0);
 
-	  i_b0 = vlib_get_buffer (vm, i_bi0);
-	  esp0 = vlib_buffer_get_current (i_b0);
+      pkt->sa_index = vnet_buffer (i_b0)->ipsec.sad_index;
+      sa0 = pool_elt_at_index (im->sad, pkt->sa_index);
 
-	  sa_index0 = vnet_buffer (i_b0)->ipsec.sad_index;
-	  sa0 = pool_elt_at_index (im->sad, sa_index0);
+      pkt->seq = esp_replay_seq (sa0, clib_host_to_net_u32 (esp0->seq));
 
-	  seq = clib_host_to_net_u32 (esp0->seq);
-
-	  /* anti-replay check */
-	  if (sa0->use_anti_replay)
+      /* anti-replay check */
+      if (sa0->use_anti_replay)
+	{
+	  if (PREDICT_FALSE (esp_replay_check (sa0, pkt->seq)))
 	    {
-	      int rv = 0;
+	      clib_warning ("anti-replay SPI %u seq %lu", sa0->spi, pkt->seq);
+	      vlib_node_increment_counter (vm, esp_decrypt_node.index,
+					   ESP_DECRYPT_ERROR_REPLAY, 1);
+	      continue;
+	    }
+	}
 
-	      if (PREDICT_TRUE (sa0->use_esn))
-		rv = esp_replay_check_esn (sa0, seq);
-	      else
-		rv = esp_replay_check (sa0, seq);
+      sa0->total_data_size += i_b0->current_length;
 
-	      if (PREDICT_FALSE (rv))
-		{
-		  clib_warning ("anti-replay SPI %u seq %u", sa0->spi, seq);
-		  vlib_node_increment_counter (vm, esp_decrypt_node.index,
-					       ESP_DECRYPT_ERROR_REPLAY, 1);
-		  o_bi0 = i_bi0;
-		  to_next[0] = o_bi0;
-		  to_next += 1;
-		  goto trace;
-		}
+      if (PREDICT_TRUE (sa0->integ_alg != IPSEC_INTEG_ALG_NONE))
+	{
+	  u8 sig[64];
+	  int icv_size =
+	    em->ipsec_proto_main_integ_algs[sa0->integ_alg].trunc_size;
+	  memset (sig, 0, sizeof (sig));
+	  u8 *icv =
+	    vlib_buffer_get_current (i_b0) + i_b0->current_length - icv_size;
+	  i_b0->current_length -= icv_size;
+
+	  hmac_calc (sa0->integ_alg, sa0->integ_key, sa0->integ_key_len,
+		     (u8 *) esp0, i_b0->current_length, sig, sa0->use_esn,
+		     pkt->seq >> 32);
+
+	  if (PREDICT_FALSE (memcmp (icv, sig, icv_size)))
+	    {
+	      vlib_node_increment_counter (vm, esp_decrypt_node.index,
+					   ESP_DECRYPT_ERROR_INTEG_ERROR, 1);
+	      continue;
 	    }
+	}
 
-	  sa0->total_data_size += i_b0->current_length;
+      /* grab free buffer */
+      uword last_empty_buffer = vec_len (empty_buffers) - 1;
+      pkt->o_bi = empty_buffers[last_empty_buffer];
+      o_b0 = vlib_get_buffer (vm, pkt->o_bi);
+      vlib_prefetch_buffer_with_index (vm,
+				       empty_buffers[last_empty_buffer - 1],
+				       STORE);
+      _vec_len (empty_buffers) = last_empty_buffer;
+
+      /* add old buffer to the recycle list */
+      vec_add1 (recycle, pkt->i_bi);
+
+      if (PREDICT_FALSE (sa0->crypto_alg == IPSEC_CRYPTO_ALG_NONE))
+	continue;
+
+      ipsec_proto_main_crypto_alg_t *a =
+	em->ipsec_proto_main_crypto_algs + sa0->crypto_alg;
+      const int BLOCK_SIZE = a->block_size;
+      const int IV_SIZE = a->iv_size;
+      i32 len = i_b0->current_length - sizeof (esp_header_t) - IV_SIZE -
+	a->icv_size;
+
+      if (PREDICT_FALSE (len < (i32) sizeof (esp_footer_t)))
+	{
+	  vlib_node_increment_counter (vm, esp_decrypt_node.index,
+				       ESP_DECRYPT_ERROR_DECRYPTION_FAILED,
+				       1);
+	  continue;
+	}
 
-	  if (PREDICT_TRUE (sa0->integ_alg != IPSEC_INTEG_ALG_NONE))
+      o_b0->current_data = sizeof (ethernet_header_t);
+      pkt->ip_hdr_size = 0;
+      pkt->tunnel_mode = 1;
+      pkt->transport_ip6 = 0;
+
+      /* transport mode */
+      if (PREDICT_FALSE (!sa0->is_tunnel && !sa0->is_tunnel_ip6))
+	{
+	  pkt->tunnel_mode = 0;
+	  ih4 = (ip4_header_t *) (i_b0->data + sizeof (ethernet_header_t));
+	  if (PREDICT_TRUE
+	      ((ih4->ip_version_and_header_length & 0xF0) != 0x40))
 	    {
-	      u8 sig[64];
-	      int icv_size =
-		em->ipsec_proto_main_integ_algs[sa0->integ_alg].trunc_size;
-	      memset (sig, 0, sizeof (sig));
-	      u8 *icv =
-		vlib_buffer_get_current (i_b0) + i_b0->current_length -
-		icv_size;
-	      i_b0->current_length -= icv_size;
-
-	      hmac_calc (sa0->integ_alg, sa0->integ_key, sa0->integ_key_len,
-			 (u8 *) esp0, i_b0->current_length, sig, sa0->use_esn,
-			 sa0->seq_hi);
-
-	      if (PREDICT_FALSE (memcmp (icv, sig, icv_size)))
+	      if (PREDICT_TRUE
+		  ((ih4->ip_version_and_header_length & 0xF0) == 0x60))
+		{
+		  pkt->transport_ip6 = 1;
+		  pkt->ip_hdr_size = sizeof (ip6_header_t);
+		}
+	      else
 		{
 		  vlib_node_increment_counter (vm, esp_decrypt_node.index,
-					       ESP_DECRYPT_ERROR_INTEG_ERROR,
-					       1);
-		  o_bi0 = i_bi0;
-		  to_next[0] = o_bi0;
-		  to_next += 1;
-		  goto trace;
+					       ESP_DECRYPT_ERROR_NOT_IP, 1);
+		  continue;
 		}
 	    }
+	  else
+	    pkt->ip_hdr_size = sizeof (ip4_header_t);
+	}
 
-	  if (PREDICT_TRUE (sa0->use_anti_replay))
+      if (im->async_mode)
+	{
+	  op = esp_crypto_async_op_add (vm, ptd, sa0, 0, pkt->o_bi,
+					im->esp_decrypt_post_next_index);
+	  if (PREDICT_FALSE (op == 0))
 	    {
-	      if (PREDICT_TRUE (sa0->use_esn))
-		esp_replay_advance_esn (sa0, seq);
-	      else
-		esp_replay_advance (sa0, seq);
+	      vlib_node_increment_counter (vm, esp_decrypt_node.index,
+					   ESP_DECRYPT_ERROR_NO_CRYPTO_FRAME,
+					   1);
+	      continue;
 	    }
+	}
+      else
+	{
+	  op = esp_crypto_op_add (ptd, sa0, 0);
+	  op->user_data = i;
+	}
+      op->iv = esp0->data;
+      op->src = esp0->data + IV_SIZE;
+      op->dst = (u8 *) vlib_buffer_get_current (o_b0) + pkt->ip_hdr_size;
 
-	  /* grab free buffer */
-	  uword last_empty_buffer = vec_len (empty_buffers) - 1;
-	  o_bi0 = empty_buffers[last_empty_buffer];
-	  to_next[0] = o_bi0;
-	  to_next += 1;
-	  o_b0 = vlib_get_buffer (vm, o_bi0);
-	  vlib_prefetch_buffer_with_index (vm,
-					   empty_buffers[last_empty_buffer -
-							 1], STORE);
-	  _vec_len (empty_buffers) = last_empty_buffer;
-
-	  /* add old buffer to the recycle list */
-	  vec_add1 (recycle, i_bi0);
-
-	  if ((sa0->crypto_alg >= IPSEC_CRYPTO_ALG_AES_CBC_128 &&
-	       sa0->crypto_alg <= IPSEC_CRYPTO_ALG_AES_CBC_256) ||
-	      (sa0->crypto_alg >= IPSEC_CRYPTO_ALG_DES_CBC &&
-	       sa0->crypto_alg <= IPSEC_CRYPTO_ALG_3DES_CBC))
-	    {
-	      const int BLOCK_SIZE =
-		em->ipsec_proto_main_crypto_algs[sa0->crypto_alg].block_size;;
-	      const int IV_SIZE =
-		em->ipsec_proto_main_crypto_algs[sa0->crypto_alg].iv_size;
-	      esp_footer_t *f0;
-	      u8 ip_hdr_size = 0;
+      if (a->icv_size)
+	{
+	  op->len = len;
+	  op->tag = op->src + len;
+	  esp_crypto_op_set_aad (op, sa0, esp0, pkt->seq >> 32);
+	}
+      else
+	op->len = (len / BLOCK_SIZE) * BLOCK_SIZE;
 
-	      int blocks =
-		(i_b0->current_length - sizeof (esp_header_t) -
-		 IV_SIZE) / BLOCK_SIZE;
+      pkt->len = op->len;
+      pkt->drop = 0;
 
-	      o_b0->current_data = sizeof (ethernet_header_t);
+      if (im->async_mode)
+	{
+	  /* the post node frees the input buffer once it is decrypted */
+	  _vec_len (recycle) -= 1;
+	  pkt->async = 1;
+	  vnet_buffer2 (o_b0)->crypto.esp.src_bi = pkt->i_bi;
+	  vnet_buffer2 (o_b0)->crypto.esp.sa_index = pkt->sa_index;
+	  vnet_buffer2 (o_b0)->crypto.esp.seq = pkt->seq;
+	  vnet_buffer2 (o_b0)->crypto.esp.seq_hi = pkt->seq >> 32;
+	  vnet_buffer2 (o_b0)->crypto.esp.len = pkt->len;
+	  vnet_buffer2 (o_b0)->crypto.esp.ip_hdr_size = pkt->ip_hdr_size;
+	  vnet_buffer2 (o_b0)->crypto.esp.tunnel_mode = pkt->tunnel_mode;
+	  vnet_buffer2 (o_b0)->crypto.esp.transport_ip6 = pkt->transport_ip6;
+	}
+    }
 
-	      /* transport mode */
-	      if (PREDICT_FALSE (!sa0->is_tunnel && !sa0->is_tunnel_ip6))
-		{
-		  tunnel_mode = 0;
-		  ih4 =
-		    (ip4_header_t *) (i_b0->data +
-				      sizeof (ethernet_header_t));
-		  if (PREDICT_TRUE
-		      ((ih4->ip_version_and_header_length & 0xF0) != 0x40))
-		    {
-		      if (PREDICT_TRUE
-			  ((ih4->ip_version_and_header_length & 0xF0) ==
-			   0x60))
-			{
-			  transport_ip6 = 1;
-			  ip_hdr_size = sizeof (ip6_header_t);
-			  ih6 =
-			    (ip6_header_t *) (i_b0->data +
-					      sizeof (ethernet_header_t));
-			  oh6 = vlib_buffer_get_current (o_b0);
-			}
-		      else
-			{
-			  vlib_node_increment_counter (vm,
-						       esp_decrypt_node.index,
-						       ESP_DECRYPT_ERROR_NOT_IP,
-						       1);
-			  o_b0 = 0;
-			  goto trace;
-			}
-		    }
-		  else
-		    {
-		      oh4 = vlib_buffer_get_current (o_b0);
-		      ip_hdr_size = sizeof (ip4_header_t);
-		    }
-		}
+  for (alg = IPSEC_CRYPTO_ALG_NONE + 1; alg < IPSEC_CRYPTO_N_ALG; alg++)
+    {
+      vnet_crypto_op_t *op;
 
-	      esp_decrypt_cbc (sa0->crypto_alg,
-			       esp0->data + IV_SIZE,
-			       (u8 *) vlib_buffer_get_current (o_b0) +
-			       ip_hdr_size, BLOCK_SIZE * blocks,
-			       sa0->crypto_key, esp0->data);
-
-	      o_b0->current_length = (blocks * BLOCK_SIZE) - 2 + ip_hdr_size;
-	      o_b0->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID;
-	      f0 =
-		(esp_footer_t *) ((u8 *) vlib_buffer_get_current (o_b0) +
-				  o_b0->current_length);
-	      o_b0->current_length -= f0->pad_length;
-
-	      /* tunnel mode */
-	      if (PREDICT_TRUE (tunnel_mode))
-		{
-		  if (PREDICT_TRUE (f0->next_header == IP_PROTOCOL_IP_IN_IP))
-		    {
-		      next0 = ESP_DECRYPT_NEXT_IP4_INPUT;
-		      oh4 = vlib_buffer_get_current (o_b0);
-		    }
-		  else if (f0->next_header == IP_PROTOCOL_IPV6)
-		    next0 = ESP_DECRYPT_NEXT_IP6_INPUT;
-		  else
-		    {
-		      clib_warning ("next header: 0x%x", f0->next_header);
-		      vlib_node_increment_counter (vm, esp_decrypt_node.index,
-						   ESP_DECRYPT_ERROR_DECRYPTION_FAILED,
-						   1);
-		      o_b0 = 0;
-		      goto trace;
-		    }
-		}
-	      /* transport mode */
-	      else
-		{
-		  if (PREDICT_FALSE (transport_ip6))
-		    {
-		      next0 = ESP_DECRYPT_NEXT_IP6_INPUT;
-		      oh6->ip_version_traffic_class_and_flow_label =
-			ih6->ip_version_traffic_class_and_flow_label;
-		      oh6->protocol = f0->next_header;
-		      oh6->hop_limit = ih6->hop_limit;
-		      oh6->src_address.as_u64[0] = ih6->src_address.as_u64[0];
-		      oh6->src_address.as_u64[1] = ih6->src_address.as_u64[1];
-		      oh6->dst_address.as_u64[0] = ih6->dst_address.as_u64[0];
-		      oh6->dst_address.as_u64[1] = ih6->dst_address.as_u64[1];
-		      oh6->payload_length =
-			clib_host_to_net_u16 (vlib_buffer_length_in_chain
-					      (vm,
-					       o_b0) - sizeof (ip6_header_t));
-		    }
-		  else
-		    {
-		      next0 = ESP_DECRYPT_NEXT_IP4_INPUT;
-		      oh4->ip_version_and_header_length = 0x45;
-		      oh4->tos = ih4->tos;
-		      oh4->fragment_id = 0;
-		      oh4->flags_and_fragment_offset = 0;
-		      oh4->ttl = ih4->ttl;
-		      oh4->protocol = f0->next_header;
-		      oh4->src_address.as_u32 = ih4->src_address.as_u32;
-		      oh4->dst_address.as_u32 = ih4->dst_address.as_u32;
-		      oh4->length =
-			clib_host_to_net_u16 (vlib_buffer_length_in_chain
-					      (vm, o_b0));
-		      oh4->checksum = ip4_header_checksum (oh4);
-		    }
-		}
+      if (ptd->async_frames[alg])
+	{
+	  esp_crypto_async_submit (vm, ptd->async_frames[alg],
+				   esp_decrypt_node.index,
+				   ESP_DECRYPT_ERROR_NO_CRYPTO_FRAME);
+	  ptd->async_frames[alg] = 0;
+	}
 
-	      /* for IPSec-GRE tunnel next node is ipsec-gre-input */
-	      if (PREDICT_FALSE
-		  ((vnet_buffer (i_b0)->ipsec.flags) &
-		   IPSEC_FLAG_IPSEC_GRE_TUNNEL))
-		next0 = ESP_DECRYPT_NEXT_IPSEC_GRE_INPUT;
+      if (vec_len (ptd->ops[alg]) == 0)
+	continue;
 
-	      vnet_buffer (o_b0)->sw_if_index[VLIB_TX] = (u32) ~ 0;
-	      vnet_buffer (o_b0)->sw_if_index[VLIB_RX] =
-		vnet_buffer (i_b0)->sw_if_index[VLIB_RX];
-	    }
+      vnet_crypto_process_ops (vm, ptd->ops[alg], vec_len (ptd->ops[alg]));
+
+      vec_foreach (op, ptd->ops[alg])
+	if (PREDICT_FALSE (op->status != VNET_CRYPTO_OP_STATUS_COMPLETED))
+	{
+	  vlib_node_increment_counter (vm, esp_decrypt_node.index,
+				       ESP_DECRYPT_ERROR_INTEG_ERROR, 1);
+	  pkts[op->user_data].drop = 1;
+	}
+      vec_reset_length (ptd->ops[alg]);
+    }
+
+  next_index = node->cached_next_index;
+  pkt = pkts;
 
-	trace:
-	  if (PREDICT_FALSE (i_b0->flags & VLIB_BUFFER_IS_TRACED))
+  while (n_left_from > 0)
+    {
+      u32 n_left_to_next;
+
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (n_left_from > 0 && n_left_to_next > 0)
+	{
+	  u32 o_bi0, next0;
+
+	  if (pkt->async)
 	    {
-	      if (o_b0)
-		{
-		  o_b0->flags |= VLIB_BUFFER_IS_TRACED;
-		  o_b0->trace_index = i_b0->trace_index;
-		  esp_decrypt_trace_t *tr =
-		    vlib_add_trace (vm, node, o_b0, sizeof (*tr));
-		  tr->crypto_alg = sa0->crypto_alg;
-		  tr->integ_alg = sa0->integ_alg;
-		}
+	      pkt++;
+	      n_left_from -= 1;
+	      continue;
 	    }
 
+	  o_bi0 = pkt->o_bi;
+	  to_next[0] = o_bi0;
+	  to_next += 1;
+	  n_left_from -= 1;
+	  n_left_to_next -= 1;
+
+	  next0 = esp_decrypt_finish (vm, node, pkt);
+
+	  pkt++;
 	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
 					   n_left_to_next, o_bi0, next0);
 	}
@@ -435,6 +524,92 @@ VLIB_REGISTER_NODE (esp_decrypt_node) = {
 /* *INDENT-ON* */
 
 VLIB_NODE_FUNCTION_MULTIARCH (esp_decrypt_node, esp_decrypt_node_fn)
+
+/* async mode, buffers of completed ops from crypto-dispatch */
+static uword
+esp_decrypt_post_node_fn (vlib_main_t * vm,
+			  vlib_node_runtime_t * node,
+			  vlib_frame_t * from_frame)
+{
+  u32 n_left_from, *from, next_index, *to_next;
+  u32 src_bis[VLIB_FRAME_SIZE], n_src = 0;
+
+  from = vlib_frame_vector_args (from_frame);
+  n_left_from = from_frame->n_vectors;
+  next_index = node->cached_next_index;
+
+  while (n_left_from > 0)
+    {
+      u32 n_left_to_next;
+
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (n_left_from > 0 && n_left_to_next > 0)
+	{
+	  esp_decrypt_packet_t pkt;
+	  vlib_buffer_t *b0;
+	  u32 bi0, next0;
+
+	  bi0 = from[0];
+	  from += 1;
+	  n_left_from -= 1;
+	  to_next[0] = bi0;
+	  to_next += 1;
+	  n_left_to_next -= 1;
+
+	  b0 = vlib_get_buffer (vm, bi0);
+	  pkt.i_bi = vnet_buffer2 (b0)->crypto.esp.src_bi;
+	  pkt.o_bi = bi0;
+	  pkt.sa_index = vnet_buffer2 (b0)->crypto.esp.sa_index;
+	  pkt.seq = ((u64) vnet_buffer2 (b0)->crypto.esp.seq_hi << 32) |
+	    vnet_buffer2 (b0)->crypto.esp.seq;
+	  pkt.len = vnet_buffer2 (b0)->crypto.esp.len;
+	  pkt.ip_hdr_size = vnet_buffer2 (b0)->crypto.esp.ip_hdr_size;
+	  pkt.tunnel_mode = vnet_buffer2 (b0)->crypto.esp.tunnel_mode;
+	  pkt.transport_ip6 = vnet_buffer2 (b0)->crypto.esp.transport_ip6;
+	  pkt.drop = 0;
+	  pkt.async = 0;
+	  src_bis[n_src++] = pkt.i_bi;
+
+	  if (PREDICT_FALSE (vnet_buffer2 (b0)->crypto.status !=
+			     VNET_CRYPTO_OP_STATUS_COMPLETED))
+	    {
+	      vlib_node_increment_counter (vm, node->node_index,
+					   ESP_DECRYPT_ERROR_INTEG_ERROR, 1);
+	      pkt.drop = 1;
+	    }
+
+	  next0 = esp_decrypt_finish (vm, node, &pkt);
+
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					   n_left_to_next, bi0, next0);
+	}
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  vlib_buffer_free (vm, src_bis, n_src);
+  return from_frame->n_vectors;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (esp_decrypt_post_node) = {
+  .function = esp_decrypt_post_node_fn,
+  .name = "esp-decrypt-post",
+  .vector_size = sizeof (u32),
+  .format_trace = format_esp_decrypt_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+
+  .n_errors = ARRAY_LEN(esp_decrypt_error_strings),
+  .error_strings = esp_decrypt_error_strings,
+
+  .n_next_nodes = ESP_DECRYPT_N_NEXT,
+  .next_nodes = {
+#define _(s,n) [ESP_DECRYPT_NEXT_##s] = n,
+    foreach_esp_decrypt_next
+#undef _
+  },
+};
+/* *INDENT-ON* */
 /*
  * fd.io coding-style-patch-verification: ON
  *
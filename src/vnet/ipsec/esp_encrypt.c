@@ -42,7 +42,8 @@ typedef enum
  _(RX_PKTS, "ESP pkts received")                    \
  _(NO_BUFFER, "No buffer (packet dropped)")         \
  _(DECRYPTION_FAILED, "ESP encryption failed")      \
- _(SEQ_CYCLED, "sequence number cycled")
+ _(SEQ_CYCLED, "sequence number cycled")            \
+ _(NO_CRYPTO_FRAME, "No async crypto frame (packet dropped)")
 
 
 typedef enum
@@ -60,6 +61,7 @@ static char *esp_encrypt_error_strings[] = {
 };
 
 vlib_node_registration_t esp_encrypt_node;
+vlib_node_registration_t esp_encrypt_post_node;
 
 typedef struct
 {
@@ -84,37 +86,80 @@ format_esp_encrypt_trace (u8 * s, va_list * args)
   return s;
 }
 
-always_inline void
-esp_encrypt_cbc (ipsec_crypto_alg_t alg,
-		 u8 * in, u8 * out, size_t in_len, u8 * key, u8 * iv)
+/* one call for the random IVs of all packets */
+static_always_inline void
+esp_encrypt_fill_ivs (ipsec_proto_main_crypto_alg_t * a,
+		      vnet_crypto_op_t * ops, u32 n_ops)
 {
-  ipsec_proto_main_t *em = &ipsec_proto_main;
-  u32 thread_index = vlib_get_thread_index ();
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-  EVP_CIPHER_CTX *ctx = em->per_thread_data[thread_index].encrypt_ctx;
-#else
-  EVP_CIPHER_CTX *ctx = &(em->per_thread_data[thread_index].encrypt_ctx);
-#endif
-  const EVP_CIPHER *cipher = NULL;
-  int out_len;
-
-  ASSERT (alg < IPSEC_CRYPTO_N_ALG);
-
-  if (PREDICT_FALSE
-      (em->ipsec_proto_main_crypto_algs[alg].type == IPSEC_CRYPTO_ALG_NONE))
+  u8 ivs[VLIB_FRAME_SIZE * 16], *iv = ivs;
+  u32 i;
+
+  /* aead ops take the sequence number */
+  if (a->icv_size)
     return;
 
-  if (PREDICT_FALSE
-      (alg != em->per_thread_data[thread_index].last_encrypt_alg))
+  ASSERT (n_ops <= VLIB_FRAME_SIZE && a->iv_size <= 16);
+  RAND_bytes (ivs, n_ops * a->iv_size);
+  for (i = 0; i < n_ops; i++)
+    {
+      clib_memcpy (ops[i].iv, iv, a->iv_size);
+      iv += a->iv_size;
+    }
+}
+
+/* run the cipher and then the integrity ops collected for a frame */
+static_always_inline void
+esp_encrypt_process_ops (vlib_main_t * vm,
+			 ipsec_proto_main_per_thread_data_t * ptd)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_proto_main_t *em = &ipsec_proto_main;
+  ipsec_crypto_alg_t alg;
+  esp_integ_op_t *iop;
+
+  for (alg = IPSEC_CRYPTO_ALG_NONE + 1; alg < IPSEC_CRYPTO_N_ALG; alg++)
     {
-      cipher = em->ipsec_proto_main_crypto_algs[alg].type;
-      em->per_thread_data[thread_index].last_encrypt_alg = alg;
+      u32 n_ops = vec_len (ptd->ops[alg]);
+
+      if (n_ops == 0)
+	continue;
+
+      esp_encrypt_fill_ivs (em->ipsec_proto_main_crypto_algs + alg,
+			    ptd->ops[alg], n_ops);
+      vnet_crypto_process_ops (vm, ptd->ops[alg], n_ops);
+      vec_reset_length (ptd->ops[alg]);
     }
 
-  EVP_EncryptInit_ex (ctx, cipher, NULL, key, iv);
+  vec_foreach (iop, ptd->integ_ops)
+  {
+    ipsec_sa_t *sa = pool_elt_at_index (im->sad, iop->sa_index);
+    hmac_calc (sa->integ_alg, sa->integ_key, sa->integ_key_len, iop->data,
+	       iop->len, iop->icv, sa->use_esn, iop->seq_hi);
+  }
+  vec_reset_length (ptd->integ_ops);
+}
+
+/* async mode, hand the frames filled by this node call to the engine */
+static_always_inline void
+esp_encrypt_submit_frames (vlib_main_t * vm, vlib_node_runtime_t * node,
+			   ipsec_proto_main_per_thread_data_t * ptd)
+{
+  ipsec_proto_main_t *em = &ipsec_proto_main;
+  ipsec_crypto_alg_t alg;
+
+  for (alg = IPSEC_CRYPTO_ALG_NONE + 1; alg < IPSEC_CRYPTO_N_ALG; alg++)
+    {
+      vnet_crypto_async_frame_t *f = ptd->async_frames[alg];
+
+      if (f == 0)
+	continue;
+      ptd->async_frames[alg] = 0;
 
-  EVP_EncryptUpdate (ctx, out, &out_len, in, in_len);
-  EVP_EncryptFinal_ex (ctx, out + out_len, &out_len);
+      esp_encrypt_fill_ivs (em->ipsec_proto_main_crypto_algs + alg,
+			    f->elts, f->n_elts);
+      esp_crypto_async_submit (vm, f, node->node_index,
+			       ESP_ENCRYPT_ERROR_NO_CRYPTO_FRAME);
+    }
 }
 
 static uword
@@ -128,6 +173,8 @@ esp_encrypt_node_fn (vlib_main_t * vm,
   ipsec_proto_main_t *em = &ipsec_proto_main;
   u32 *recycle = 0;
   u32 thread_index = vlib_get_thread_index ();
+  ipsec_proto_main_per_thread_data_t *ptd =
+    vec_elt_at_index (em->per_thread_data, thread_index);
 
   ipsec_alloc_empty_buffers (vm, im);
 
@@ -165,6 +212,8 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	  u8 next_hdr_type;
 	  u32 ip_proto = 0;
 	  u8 transport_mode = 0;
+	  u8 async0 = 0;
+	  u64 seq0 = 0;
 
 	  i_bi0 = from[0];
 	  from += 1;
@@ -177,7 +226,7 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	  sa_index0 = vnet_buffer (i_b0)->ipsec.sad_index;
 	  sa0 = pool_elt_at_index (im->sad, sa_index0);
 
-	  if (PREDICT_FALSE (esp_seq_advance (sa0)))
+	  if (PREDICT_FALSE (esp_seq_advance (sa0, thread_index, &seq0)))
 	    {
 	      clib_warning ("sequence number counter has cycled SPI %u",
 			    sa0->spi);
@@ -191,6 +240,8 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	    }
 
 	  sa0->total_data_size += i_b0->current_length;
+	  async0 = im->async_mode &&
+	    sa0->crypto_alg != IPSEC_CRYPTO_ALG_NONE;
 
 	  /* grab free buffer */
 	  last_empty_buffer = vec_len (empty_buffers) - 1;
@@ -206,8 +257,10 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	  to_next[0] = o_bi0;
 	  to_next += 1;
 
-	  /* add old buffer to the recycle list */
-	  vec_add1 (recycle, i_bi0);
+	  /* add old buffer to the recycle list, in async mode the post
+	     node frees it once the payload is encrypted */
+	  if (!async0)
+	    vec_add1 (recycle, i_bi0);
 
 	  /* is ipv6 */
 	  if (PREDICT_FALSE
@@ -233,7 +286,7 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	      oh6_0->ip6.dst_address.as_u64[1] =
 		ih6_0->ip6.dst_address.as_u64[1];
 	      oh6_0->esp.spi = clib_net_to_host_u32 (sa0->spi);
-	      oh6_0->esp.seq = clib_net_to_host_u32 (sa0->seq);
+	      oh6_0->esp.seq = clib_net_to_host_u32 ((u32) seq0);
 	      ip_proto = ih6_0->ip6.protocol;
 
 	      next0 = ESP_ENCRYPT_NEXT_IP6_LOOKUP;
@@ -255,7 +308,7 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	      oh0->ip4.src_address.as_u32 = ih0->ip4.src_address.as_u32;
 	      oh0->ip4.dst_address.as_u32 = ih0->ip4.dst_address.as_u32;
 	      oh0->esp.spi = clib_net_to_host_u32 (sa0->spi);
-	      oh0->esp.seq = clib_net_to_host_u32 (sa0->seq);
+	      oh0->esp.seq = clib_net_to_host_u32 ((u32) seq0);
 	      ip_proto = ih0->ip4.protocol;
 
 	      next0 = ESP_ENCRYPT_NEXT_IP4_LOOKUP;
@@ -306,12 +359,12 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 
 	  if (PREDICT_TRUE (sa0->crypto_alg != IPSEC_CRYPTO_ALG_NONE))
 	    {
-
-	      const int BLOCK_SIZE =
-		em->ipsec_proto_main_crypto_algs[sa0->crypto_alg].block_size;
-	      const int IV_SIZE =
-		em->ipsec_proto_main_crypto_algs[sa0->crypto_alg].iv_size;
+	      ipsec_proto_main_crypto_alg_t *a =
+		em->ipsec_proto_main_crypto_algs + sa0->crypto_alg;
+	      const int BLOCK_SIZE = a->block_size;
+	      const int IV_SIZE = a->iv_size;
 	      int blocks = 1 + (i_b0->current_length + 1) / BLOCK_SIZE;
+	      vnet_crypto_op_t *op;
 
 	      /* pad packet in input buffer */
 	      u8 pad_bytes = BLOCK_SIZE * blocks - 2 - i_b0->current_length;
@@ -333,32 +386,67 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 	      vnet_buffer (o_b0)->sw_if_index[VLIB_RX] =
 		vnet_buffer (i_b0)->sw_if_index[VLIB_RX];
 
-	      u8 iv[em->
-		    ipsec_proto_main_crypto_algs[sa0->crypto_alg].iv_size];
-	      RAND_bytes (iv, sizeof (iv));
-
-	      clib_memcpy ((u8 *) vlib_buffer_get_current (o_b0) +
-			   ip_hdr_size + sizeof (esp_header_t), iv,
-			   em->ipsec_proto_main_crypto_algs[sa0->
-							    crypto_alg].iv_size);
-
-	      esp_encrypt_cbc (sa0->crypto_alg,
-			       (u8 *) vlib_buffer_get_current (i_b0),
-			       (u8 *) vlib_buffer_get_current (o_b0) +
-			       ip_hdr_size + sizeof (esp_header_t) +
-			       IV_SIZE, BLOCK_SIZE * blocks,
-			       sa0->crypto_key, iv);
+	      /* encrypted with the rest of the frame once it is built */
+	      if (async0)
+		{
+		  op = esp_crypto_async_op_add (vm, ptd, sa0, 1, o_bi0,
+						im->esp_encrypt_post_next_index);
+		  if (PREDICT_FALSE (op == 0))
+		    {
+		      vlib_node_increment_counter (vm, esp_encrypt_node.index,
+						   ESP_ENCRYPT_ERROR_NO_CRYPTO_FRAME,
+						   1);
+		      vec_add1 (recycle, i_bi0);
+		      async0 = 0;
+		      next0 = ESP_ENCRYPT_NEXT_DROP;
+		      goto trace;
+		    }
+		  vnet_buffer2 (o_b0)->crypto.esp.src_bi = i_bi0;
+		}
+	      else
+		op = esp_crypto_op_add (ptd, sa0, 1);
+	      op->src = vlib_buffer_get_current (i_b0);
+	      op->iv = o_esp0->data;
+	      op->dst = op->iv + IV_SIZE;
+	      op->len = BLOCK_SIZE * blocks;
+
+	      if (a->icv_size)
+		{
+		  /* the sequence number is a unique IV for the key */
+		  u32 seq_hi = clib_host_to_net_u32 (seq0 >> 32);
+		  clib_memcpy (op->iv, &seq_hi, sizeof (seq_hi));
+		  clib_memcpy (op->iv + 4, &o_esp0->seq, sizeof (o_esp0->seq));
+		  esp_crypto_op_set_aad (op, sa0, o_esp0, seq0 >> 32);
+		  op->tag = op->dst + op->len;
+		  o_b0->current_length += a->icv_size;
+		}
 	    }
 
-	  o_b0->current_length += hmac_calc (sa0->integ_alg, sa0->integ_key,
-					     sa0->integ_key_len,
-					     (u8 *) o_esp0,
-					     o_b0->current_length -
-					     ip_hdr_size,
-					     vlib_buffer_get_current (o_b0) +
-					     o_b0->current_length,
-					     sa0->use_esn, sa0->seq_hi);
-
+	  if (async0)
+	    {
+	      vnet_buffer2 (o_b0)->crypto.esp.sa_index = sa_index0;
+	      vnet_buffer2 (o_b0)->crypto.esp.seq_hi = seq0 >> 32;
+	      vnet_buffer2 (o_b0)->crypto.esp.esp_offset =
+		(u8 *) o_esp0 - o_b0->data;
+	      vnet_buffer2 (o_b0)->crypto.esp.len =
+		o_b0->current_length - ip_hdr_size;
+	      if (sa0->integ_alg != IPSEC_INTEG_ALG_NONE)
+		o_b0->current_length +=
+		  em->ipsec_proto_main_integ_algs[sa0->integ_alg].trunc_size;
+	    }
+	  else if (sa0->integ_alg != IPSEC_INTEG_ALG_NONE)
+	    {
+	      esp_integ_op_t *iop;
+
+	      vec_add2 (ptd->integ_ops, iop, 1);
+	      iop->sa_index = sa_index0;
+	      iop->seq_hi = seq0 >> 32;
+	      iop->data = (u8 *) o_esp0;
+	      iop->len = o_b0->current_length - ip_hdr_size;
+	      iop->icv = vlib_buffer_get_current (o_b0) + o_b0->current_length;
+	      o_b0->current_length +=
+		em->ipsec_proto_main_integ_algs[sa0->integ_alg].trunc_size;
+	    }
 
 	  if (PREDICT_FALSE (is_ipv6))
 	    {
@@ -386,12 +474,21 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 		  esp_encrypt_trace_t *tr =
 		    vlib_add_trace (vm, node, o_b0, sizeof (*tr));
 		  tr->spi = sa0->spi;
-		  tr->seq = sa0->seq - 1;
+		  tr->seq = seq0;
 		  tr->crypto_alg = sa0->crypto_alg;
 		  tr->integ_alg = sa0->integ_alg;
 		}
 	    }
 
+	  /* continues in esp-encrypt-post */
+	  if (async0)
+	    {
+	      vnet_buffer2 (o_b0)->crypto.esp.next_index = next0;
+	      to_next -= 1;
+	      n_left_to_next += 1;
+	      continue;
+	    }
+
 	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
 					   to_next, n_left_to_next, o_bi0,
 					   next0);
@@ -402,6 +499,9 @@ esp_encrypt_node_fn (vlib_main_t * vm,
 			       ESP_ENCRYPT_ERROR_RX_PKTS,
 			       from_frame->n_vectors);
 
+  esp_encrypt_process_ops (vm, ptd);
+  esp_encrypt_submit_frames (vm, node, ptd);
+
 free_buffers_and_exit:
   if (recycle)
     vlib_buffer_free (vm, recycle, vec_len (recycle));
@@ -431,6 +531,99 @@ VLIB_REGISTER_NODE (esp_encrypt_node) = {
 /* *INDENT-ON* */
 
 VLIB_NODE_FUNCTION_MULTIARCH (esp_encrypt_node, esp_encrypt_node_fn)
+
+/* async mode, buffers of completed ops from crypto-dispatch: add the
+   ICV, free the plaintext buffer and continue to the output path */
+static uword
+esp_encrypt_post_node_fn (vlib_main_t * vm,
+			  vlib_node_runtime_t * node,
+			  vlib_frame_t * from_frame)
+{
+  u32 n_left_from, *from, *to_next = 0, next_index;
+  ipsec_main_t *im = &ipsec_main;
+  u32 src_bis[VLIB_FRAME_SIZE], n_src = 0;
+
+  from = vlib_frame_vector_args (from_frame);
+  n_left_from = from_frame->n_vectors;
+  next_index = node->cached_next_index;
+
+  while (n_left_from > 0)
+    {
+      u32 n_left_to_next;
+
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (n_left_from > 0 && n_left_to_next > 0)
+	{
+	  u32 bi0, next0;
+	  vlib_buffer_t *b0;
+	  ipsec_sa_t *sa0;
+	  u8 *esp0;
+
+	  bi0 = from[0];
+	  from += 1;
+	  n_left_from -= 1;
+	  to_next[0] = bi0;
+	  to_next += 1;
+	  n_left_to_next -= 1;
+
+	  b0 = vlib_get_buffer (vm, bi0);
+	  next0 = vnet_buffer2 (b0)->crypto.esp.next_index;
+	  src_bis[n_src++] = vnet_buffer2 (b0)->crypto.esp.src_bi;
+
+	  if (PREDICT_FALSE (vnet_buffer2 (b0)->crypto.status !=
+			     VNET_CRYPTO_OP_STATUS_COMPLETED))
+	    {
+	      vlib_node_increment_counter (vm, node->node_index,
+					   ESP_ENCRYPT_ERROR_DECRYPTION_FAILED,
+					   1);
+	      next0 = ESP_ENCRYPT_NEXT_DROP;
+	      goto enqueue;
+	    }
+
+	  sa0 = pool_elt_at_index (im->sad,
+				   vnet_buffer2 (b0)->crypto.esp.sa_index);
+	  if (sa0->integ_alg != IPSEC_INTEG_ALG_NONE)
+	    {
+	      u32 len = vnet_buffer2 (b0)->crypto.esp.len;
+
+	      esp0 = b0->data + vnet_buffer2 (b0)->crypto.esp.esp_offset;
+	      hmac_calc (sa0->integ_alg, sa0->integ_key, sa0->integ_key_len,
+			 esp0, len, esp0 + len, sa0->use_esn,
+			 vnet_buffer2 (b0)->crypto.esp.seq_hi);
+	    }
+
+	enqueue:
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
+					   to_next, n_left_to_next, bi0,
+					   next0);
+	}
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  vlib_buffer_free (vm, src_bis, n_src);
+  return from_frame->n_vectors;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (esp_encrypt_post_node) = {
+  .function = esp_encrypt_post_node_fn,
+  .name = "esp-encrypt-post",
+  .vector_size = sizeof (u32),
+  .format_trace = format_esp_encrypt_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+
+  .n_errors = ARRAY_LEN(esp_encrypt_error_strings),
+  .error_strings = esp_encrypt_error_strings,
+
+  .n_next_nodes = ESP_ENCRYPT_N_NEXT,
+  .next_nodes = {
+#define _(s,n) [ESP_ENCRYPT_NEXT_##s] = n,
+    foreach_esp_encrypt_next
+#undef _
+  },
+};
+/* *INDENT-ON* */
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -18,11 +18,13 @@
 #include <vnet/pg/pg.h>
 #include <vppinfra/error.h>
 #include <vppinfra/random.h>
+#include <vppinfra/fifo.h>
 #include <vnet/udp/udp.h>
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/ikev2.h>
 #include <vnet/ipsec/ikev2_priv.h>
 #include <openssl/sha.h>
+#include <signal.h>
 
 ikev2_main_t ikev2_main;
 
@@ -35,6 +37,30 @@ static int ikev2_delete_tunnel_interface (vnet_main_t * vnm,
     clib_warning("sa state changed to " #v); \
   } while(0);
 
+/* tunnel interface changes are installed by ikev2_flush_tunnel_ifs () */
+static void
+ikev2_queue_tunnel_if (ipsec_add_del_tunnel_args_t * a)
+{
+  ikev2_main_t *km = &ikev2_main;
+  u32 thread_index = vlib_get_thread_index ();
+
+  vec_add1 (km->per_thread_data[thread_index].tunnel_ifs, a[0]);
+}
+
+static void
+ikev2_flush_tunnel_ifs (void)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_main_per_thread_data_t *ptd =
+    km->per_thread_data + vlib_get_thread_index ();
+
+  if (vec_len (ptd->tunnel_ifs) == 0)
+    return;
+
+  ipsec_add_del_tunnel_if_batch (ptd->tunnel_ifs);
+  vec_reset_length (ptd->tunnel_ifs);
+}
+
 typedef struct
 {
   u32 next_index;
@@ -61,7 +87,8 @@ _(IKE_SA_INIT_RETRANSMIT, "IKE_SA_INIT retransmit ") \
 _(IKE_SA_INIT_IGNORE, "IKE_SA_INIT ignore (IKE SA already auth)") \
 _(IKE_REQ_RETRANSMIT, "IKE request retransmit") \
 _(IKE_REQ_IGNORE, "IKE request ignore (old msgid)") \
-_(NOT_IKEV2, "Non IKEv2 packets received")
+_(NOT_IKEV2, "Non IKEv2 packets received") \
+_(DH_OFFLOADED, "IKE_SA_INIT DH handed to crypto threads")
 
 typedef enum
 {
@@ -319,15 +346,19 @@ ikev2_delete_sa (ikev2_sa_t * sa)
     }
 }
 
-static void
-ikev2_generate_sa_init_data (ikev2_sa_t * sa)
+/*
+ * With defer_dh set the DH computation is left to the caller, which gets
+ * the transform to run it with; 0 means there is nothing left to compute.
+ */
+static ikev2_sa_transform_t *
+ikev2_generate_sa_init_data (ikev2_sa_t * sa, int defer_dh)
 {
   ikev2_sa_transform_t *t = 0, *t2;
   ikev2_main_t *km = &ikev2_main;
 
   if (sa->dh_group == IKEV2_TRANSFORM_DH_TYPE_NONE)
     {
-      return;
+      return 0;
     }
 
   /* check if received DH group is on our list of supported groups */
@@ -345,7 +376,7 @@ ikev2_generate_sa_init_data (ikev2_sa_t * sa)
       clib_warning ("unknown dh data group %u (data len %u)", sa->dh_group,
 		    vec_len (sa->i_dh_data));
       sa->dh_group = IKEV2_TRANSFORM_DH_TYPE_NONE;
-      return;
+      return 0;
     }
 
   if (sa->is_initiator)
@@ -367,13 +398,16 @@ ikev2_generate_sa_init_data (ikev2_sa_t * sa)
       RAND_bytes ((u8 *) sa->r_nonce, IKEV2_NONCE_SIZE);
     }
 
+  if (defer_dh)
+    return t;
+
   /* generate dh keys */
   ikev2_generate_dh (sa, t);
-
+  return 0;
 }
 
-static void
-ikev2_complete_sa_data (ikev2_sa_t * sa, ikev2_sa_t * sai)
+static ikev2_sa_transform_t *
+ikev2_complete_sa_data (ikev2_sa_t * sa, ikev2_sa_t * sai, int defer_dh)
 {
   ikev2_sa_transform_t *t = 0, *t2;
   ikev2_main_t *km = &ikev2_main;
@@ -401,7 +435,7 @@ ikev2_complete_sa_data (ikev2_sa_t * sa, ikev2_sa_t * sai)
 
   if (sa->dh_group == IKEV2_TRANSFORM_DH_TYPE_NONE)
     {
-      return;
+      return 0;
     }
 
   /* check if received DH group is on our list of supported groups */
@@ -419,13 +453,15 @@ ikev2_complete_sa_data (ikev2_sa_t * sa, ikev2_sa_t * sai)
       clib_warning ("unknown dh data group %u (data len %u)", sa->dh_group,
 		    vec_len (sa->i_dh_data));
       sa->dh_group = IKEV2_TRANSFORM_DH_TYPE_NONE;
-      return;
+      return 0;
     }
 
+  if (defer_dh)
+    return t;
 
   /* generate dh keys */
   ikev2_complete_dh (sa, t);
-
+  return 0;
 }
 
 static void
@@ -1611,7 +1647,7 @@ ikev2_create_tunnel_interface (vnet_main_t * vnm, ikev2_sa_t * sa,
 	}
     }
 
-  ipsec_add_del_tunnel_if (&a);
+  ikev2_queue_tunnel_if (&a);
 
   return 0;
 }
@@ -1645,7 +1681,7 @@ ikev2_delete_tunnel_interface (vnet_main_t * vnm, ikev2_sa_t * sa,
       a.remote_spi = child->r_proposals[0].spi;
     }
 
-  ipsec_add_del_tunnel_if (&a);
+  ikev2_queue_tunnel_if (&a);
   return 0;
 }
 
@@ -2043,6 +2079,384 @@ ikev2_retransmit_resp (ikev2_sa_t * sa, ike_header_t * ike)
     }
 }
 
+static void
+ikev2_rewrite_reply (vlib_buffer_t * b0, ikev2_sa_t * sa0, u32 len)
+{
+  ip4_header_t *ip40 = vlib_buffer_get_current (b0);
+  udp_header_t *udp0 = (udp_header_t *) (ip40 + 1);
+
+  if (sa0->is_initiator)
+    {
+      ip40->dst_address.as_u32 = sa0->raddr.as_u32;
+      ip40->src_address.as_u32 = sa0->iaddr.as_u32;
+    }
+  else
+    {
+      ip40->dst_address.as_u32 = sa0->iaddr.as_u32;
+      ip40->src_address.as_u32 = sa0->raddr.as_u32;
+    }
+  udp0->length = clib_host_to_net_u16 (len + sizeof (udp_header_t));
+  udp0->checksum = 0;
+  b0->current_length = len + sizeof (ip4_header_t) + sizeof (udp_header_t);
+  ip40->length = clib_host_to_net_u16 (b0->current_length);
+  ip40->checksum = ip4_header_checksum (ip40);
+}
+
+/*
+ * DH offload
+ *
+ * With "cpu { ikev2-crypto <n> }" the DH computations of IKE_SA_INIT are
+ * run by n crypto threads. The node parks the SA in DH_PENDING state and
+ * keeps the packet, the job carries copies of the DH inputs so the crypto
+ * threads never touch the SA pools. Finished jobs go back to the
+ * submitting thread, where ikev2-crypto-done continues the exchange and
+ * sends the reply.
+ */
+
+static vlib_node_registration_t ikev2_crypto_done_node;
+
+static_always_inline int
+ikev2_crypto_is_async (void)
+{
+  return ikev2_main.n_crypto_threads > 0;
+}
+
+static void
+ikev2_crypto_job_free (ikev2_crypto_job_t * job)
+{
+  vec_free (job->i_dh_data);
+  vec_free (job->r_dh_data);
+  vec_free (job->dh_private_key);
+  vec_free (job->dh_shared_key);
+  clib_mem_free (job);
+}
+
+static void
+ikev2_crypto_job_run (ikev2_crypto_job_t * job)
+{
+  ikev2_sa_t sa;
+
+  memset (&sa, 0, sizeof (sa));
+  sa.is_initiator = job->is_initiator;
+  sa.i_dh_data = job->i_dh_data;
+  sa.r_dh_data = job->r_dh_data;
+  sa.dh_private_key = job->dh_private_key;
+
+  if (job->is_initiator)
+    ikev2_complete_dh (&sa, job->dh);
+  else
+    ikev2_generate_dh (&sa, job->dh);
+
+  job->r_dh_data = sa.r_dh_data;
+  job->dh_shared_key = sa.dh_shared_key;
+}
+
+static void
+ikev2_crypto_job_submit (vlib_main_t * vm, ikev2_crypto_job_t * job)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_main_per_thread_data_t *ptd = km->per_thread_data + vm->thread_index;
+
+  job->thread_index = vm->thread_index;
+
+  pthread_mutex_lock (&km->crypto_lock);
+  clib_fifo_add1 (km->crypto_jobs, job);
+  pthread_cond_signal (&km->crypto_cond);
+  pthread_mutex_unlock (&km->crypto_lock);
+
+  if (ptd->n_crypto_pending++ == 0)
+    vlib_node_set_state (vm, ikev2_crypto_done_node.index,
+			 VLIB_NODE_STATE_POLLING);
+}
+
+static void
+ikev2_crypto_thread_fn (void *arg)
+{
+  ikev2_main_t *km = &ikev2_main;
+  vlib_worker_thread_t *w = (vlib_worker_thread_t *) arg;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  ikev2_crypto_job_t *job;
+
+  /* crypto threads want no signals */
+  {
+    sigset_t s;
+    sigfillset (&s);
+    pthread_sigmask (SIG_SETMASK, &s, 0);
+  }
+
+  if (vec_len (tm->thread_prefix))
+    vlib_set_thread_name ((char *)
+			  format (0, "%v_ikev2_%u%c", tm->thread_prefix,
+				  w->instance_id, '\0'));
+
+  clib_mem_set_heap (w->thread_mheap);
+
+  while (1)
+    {
+      pthread_mutex_lock (&km->crypto_lock);
+      while (clib_fifo_elts (km->crypto_jobs) == 0)
+	pthread_cond_wait (&km->crypto_cond, &km->crypto_lock);
+      clib_fifo_sub1 (km->crypto_jobs, job);
+      pthread_mutex_unlock (&km->crypto_lock);
+
+      ikev2_crypto_job_run (job);
+
+      pthread_mutex_lock (&km->crypto_lock);
+      vec_add1 (km->per_thread_data[job->thread_index].crypto_done, job);
+      pthread_mutex_unlock (&km->crypto_lock);
+    }
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_THREAD (ikev2_crypto_thread_reg, static) = {
+  .name = "ikev2-crypto",
+  .function = ikev2_crypto_thread_fn,
+  .no_data_structure_clone = 1,
+  .use_pthreads = 1,
+};
+/* *INDENT-ON* */
+
+static u32
+ikev2_sa_init_dh_done (vlib_main_t * vm, ikev2_crypto_job_t * job)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_main_per_thread_data_t *ptd = km->per_thread_data + vm->thread_index;
+  vlib_buffer_t *b0 = vlib_get_buffer (vm, job->bi);
+  ike_header_t *ike0;
+  ikev2_sa_t *sa0;
+  u32 len = 0;
+  uword *p;
+
+  /* the SA may have been deleted while the DH was computed */
+  p = hash_get (ptd->sa_by_rspi, job->rspi);
+  if (!p || p[0] != job->sa_index)
+    goto drop;
+
+  sa0 = pool_elt_at_index (ptd->sas, job->sa_index);
+  if (sa0->state != IKEV2_STATE_DH_PENDING)
+    goto drop;
+
+  vec_free (sa0->r_dh_data);
+  vec_free (sa0->dh_shared_key);
+  sa0->r_dh_data = job->r_dh_data;
+  sa0->dh_shared_key = job->dh_shared_key;
+  job->r_dh_data = job->dh_shared_key = 0;
+  ikev2_set_state (sa0, IKEV2_STATE_SA_INIT);
+
+  ike0 = vlib_buffer_get_current (b0) + sizeof (ip4_header_t) +
+    sizeof (udp_header_t);
+
+  if (sa0->is_initiator)
+    {
+      ikev2_calc_keys (sa0);
+      ikev2_sa_auth_init (sa0);
+    }
+  len = ikev2_generate_message (sa0, ike0, 0);
+  if (len)
+    ikev2_rewrite_reply (b0, sa0, len);
+
+  if (sa0->state == IKEV2_STATE_NOTIFY_AND_DELETE)
+    ikev2_delete_sa (sa0);
+
+  if (len)
+    return job->bi;
+
+drop:
+  vlib_buffer_free_one (vm, job->bi);
+  return ~0;
+}
+
+static void
+ikev2_crypto_submit_dh (vlib_main_t * vm, ikev2_sa_t * sa0,
+			ikev2_sa_transform_t * dh, u32 bi0)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_main_per_thread_data_t *ptd = km->per_thread_data + vm->thread_index;
+  ikev2_crypto_job_t *job;
+
+  job = clib_mem_alloc (sizeof (*job));
+  memset (job, 0, sizeof (*job));
+  job->done = ikev2_sa_init_dh_done;
+  job->dh = dh;
+  job->is_initiator = sa0->is_initiator;
+  job->sa_index = sa0 - ptd->sas;
+  job->rspi = sa0->rspi;
+  job->bi = bi0;
+  job->i_dh_data = vec_dup (sa0->i_dh_data);
+  if (sa0->is_initiator)
+    {
+      job->r_dh_data = vec_dup (sa0->r_dh_data);
+      job->dh_private_key = vec_dup (sa0->dh_private_key);
+    }
+
+  ikev2_set_state (sa0, IKEV2_STATE_DH_PENDING);
+  ikev2_crypto_job_submit (vm, job);
+}
+
+static uword
+ikev2_crypto_done_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
+			   vlib_frame_t * frame)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_main_per_thread_data_t *ptd = km->per_thread_data + vm->thread_index;
+  ikev2_crypto_job_t **jobs, **job;
+  vlib_frame_t *f = 0;
+  u32 *to_next = 0, bi, n_jobs;
+
+  pthread_mutex_lock (&km->crypto_lock);
+  jobs = ptd->crypto_done;
+  ptd->crypto_done = 0;
+  pthread_mutex_unlock (&km->crypto_lock);
+
+  n_jobs = vec_len (jobs);
+  if (n_jobs == 0)
+    return 0;
+
+  vec_foreach (job, jobs)
+  {
+    bi = job[0]->done (vm, job[0]);
+    ikev2_crypto_job_free (job[0]);
+
+    if (bi == ~0)
+      continue;
+
+    if (!f)
+      {
+	f = vlib_get_frame_to_node (vm, ip4_lookup_node.index);
+	to_next = vlib_frame_vector_args (f);
+      }
+    to_next[f->n_vectors++] = bi;
+    if (f->n_vectors == VLIB_FRAME_SIZE)
+      {
+	vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
+	f = 0;
+      }
+  }
+
+  if (f)
+    vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
+
+  vec_free (jobs);
+  ikev2_flush_tunnel_ifs ();
+
+  ptd->n_crypto_pending -= n_jobs;
+  if (ptd->n_crypto_pending == 0)
+    vlib_node_set_state (vm, node->node_index, VLIB_NODE_STATE_DISABLED);
+
+  return n_jobs;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (ikev2_crypto_done_node, static) = {
+  .function = ikev2_crypto_done_node_fn,
+  .name = "ikev2-crypto-done",
+  .type = VLIB_NODE_TYPE_INPUT,
+  .state = VLIB_NODE_STATE_DISABLED,
+};
+/* *INDENT-ON* */
+
+static u32 ikev2_crypto_benchmark_n_done;
+
+static u32
+ikev2_crypto_benchmark_done (vlib_main_t * vm, ikev2_crypto_job_t * job)
+{
+  ikev2_crypto_benchmark_n_done++;
+  return ~0;
+}
+
+/*
+ * Time n responder side DH computations, as the IKE_SA_INIT of n tunnels
+ * needs them, inline and through the crypto threads. Runs in a process.
+ */
+clib_error_t *
+ikev2_crypto_benchmark (vlib_main_t * vm, u32 n_exchanges,
+			ikev2_transform_dh_type_t dh_type, f64 * inline_time,
+			f64 * offload_time)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_sa_transform_t *t = 0, *t2;
+  ikev2_crypto_job_t *job;
+  ikev2_sa_t init, resp;
+  f64 t0, timeout = 60.0;
+  u32 i;
+
+  vec_foreach (t2, km->supported_transforms)
+  {
+    if (t2->type == IKEV2_TRANSFORM_TYPE_DH && t2->dh_type == dh_type)
+      {
+	t = t2;
+	break;
+      }
+  }
+  if (!t)
+    return clib_error_return (0, "unsupported dh group %U",
+			      format_ikev2_transform_dh_type, dh_type);
+
+  /* the initiator side KE all exchanges answer */
+  memset (&init, 0, sizeof (init));
+  init.is_initiator = 1;
+  ikev2_generate_dh (&init, t);
+
+  t0 = vlib_time_now (vm);
+  for (i = 0; i < n_exchanges; i++)
+    {
+      memset (&resp, 0, sizeof (resp));
+      resp.i_dh_data = init.i_dh_data;
+      ikev2_generate_dh (&resp, t);
+      vec_free (resp.r_dh_data);
+      vec_free (resp.dh_shared_key);
+    }
+  *inline_time = vlib_time_now (vm) - t0;
+  *offload_time = -1;
+
+  if (!ikev2_crypto_is_async ())
+    goto done;
+
+  ikev2_crypto_benchmark_n_done = 0;
+  t0 = vlib_time_now (vm);
+  for (i = 0; i < n_exchanges; i++)
+    {
+      job = clib_mem_alloc (sizeof (*job));
+      memset (job, 0, sizeof (*job));
+      job->done = ikev2_crypto_benchmark_done;
+      job->dh = t;
+      job->i_dh_data = vec_dup (init.i_dh_data);
+      ikev2_crypto_job_submit (vm, job);
+    }
+
+  while (ikev2_crypto_benchmark_n_done < n_exchanges)
+    {
+      if (vlib_time_now (vm) - t0 > timeout)
+	{
+	  vec_free (init.i_dh_data);
+	  vec_free (init.dh_private_key);
+	  return clib_error_return (0, "%u of %u exchanges done after %.0fs",
+				    ikev2_crypto_benchmark_n_done,
+				    n_exchanges, timeout);
+	}
+      vlib_process_suspend (vm, 1e-4);
+    }
+  *offload_time = vlib_time_now (vm) - t0;
+
+done:
+  vec_free (init.i_dh_data);
+  vec_free (init.dh_private_key);
+  return 0;
+}
+
+static ikev2_sa_t *
+ikev2_sa_add (u32 thread_index, ikev2_sa_t * sa)
+{
+  ikev2_main_t *km = &ikev2_main;
+  ikev2_main_per_thread_data_t *ptd = km->per_thread_data + thread_index;
+  ikev2_sa_t *sa0;
+
+  pool_get (ptd->sas, sa0);
+  clib_memcpy (sa0, sa, sizeof (*sa0));
+  hash_set (ptd->sa_by_rspi, sa0->rspi, sa0 - ptd->sas);
+  return sa0;
+}
+
 static uword
 ikev2_node_fn (vlib_main_t * vm,
 	       vlib_node_runtime_t * node, vlib_frame_t * frame)
@@ -2051,6 +2465,7 @@ ikev2_node_fn (vlib_main_t * vm,
   ikev2_next_t next_index;
   ikev2_main_t *km = &ikev2_main;
   u32 thread_index = vlib_get_thread_index ();
+  u32 n_held = 0;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -2073,6 +2488,7 @@ ikev2_node_fn (vlib_main_t * vm,
 	  ike_header_t *ike0;
 	  ikev2_sa_t *sa0 = 0;
 	  ikev2_sa_t sa;	/* temporary store for SA */
+	  ikev2_sa_transform_t *dh0 = 0;
 	  int len = 0;
 	  int r;
 
@@ -2136,7 +2552,17 @@ ikev2_node_fn (vlib_main_t * vm,
 			  sa0->r_proposals =
 			    ikev2_select_proposal (sa0->i_proposals,
 						   IKEV2_PROTOCOL_IKE);
-			  ikev2_generate_sa_init_data (sa0);
+			  dh0 = ikev2_generate_sa_init_data
+			    (sa0, ikev2_crypto_is_async () &&
+			     sa0->r_proposals != 0);
+			}
+
+		      if (dh0)
+			{
+			  /* reply once the crypto threads computed the DH */
+			  sa0 = ikev2_sa_add (thread_index, &sa);
+			  ikev2_crypto_submit_dh (vm, sa0, dh0, bi0);
+			  goto held0;
 			}
 
 		      if (sa0->state == IKEV2_STATE_SA_INIT
@@ -2176,7 +2602,15 @@ ikev2_node_fn (vlib_main_t * vm,
 			  ikev2_sa_t *sai =
 			    pool_elt_at_index (km->sais, p[0]);
 
-			  ikev2_complete_sa_data (sa0, sai);
+			  dh0 = ikev2_complete_sa_data (sa0, sai,
+							ikev2_crypto_is_async
+							());
+			  if (dh0)
+			    {
+			      sa0 = ikev2_sa_add (thread_index, &sa);
+			      ikev2_crypto_submit_dh (vm, sa0, dh0, bi0);
+			      goto held0;
+			    }
 			  ikev2_calc_keys (sa0);
 			  ikev2_sa_auth_init (sa0);
 			  len = ikev2_generate_message (sa0, ike0, 0);
@@ -2387,23 +2821,7 @@ ikev2_node_fn (vlib_main_t * vm,
 	  if (len)
 	    {
 	      next0 = IKEV2_NEXT_IP4_LOOKUP;
-	      if (sa0->is_initiator)
-		{
-		  ip40->dst_address.as_u32 = sa0->raddr.as_u32;
-		  ip40->src_address.as_u32 = sa0->iaddr.as_u32;
-		}
-	      else
-		{
-		  ip40->dst_address.as_u32 = sa0->iaddr.as_u32;
-		  ip40->src_address.as_u32 = sa0->raddr.as_u32;
-		}
-	      udp0->length =
-		clib_host_to_net_u16 (len + sizeof (udp_header_t));
-	      udp0->checksum = 0;
-	      b0->current_length =
-		len + sizeof (ip4_header_t) + sizeof (udp_header_t);
-	      ip40->length = clib_host_to_net_u16 (b0->current_length);
-	      ip40->checksum = ip4_header_checksum (ip40);
+	      ikev2_rewrite_reply (b0, sa0, len);
 	    }
 	  /* delete sa */
 	  if (sa0 && (sa0->state == IKEV2_STATE_DELETED ||
@@ -2428,13 +2846,24 @@ ikev2_node_fn (vlib_main_t * vm,
 
 	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
 					   n_left_to_next, bi0, next0);
+	  continue;
+
+	held0:
+	  /* b0 waits for its crypto job, undo the speculative enqueue */
+	  to_next -= 1;
+	  n_left_to_next += 1;
+	  n_held += 1;
 	}
 
       vlib_put_next_frame (vm, node, next_index, n_left_to_next);
     }
 
+  ikev2_flush_tunnel_ifs ();
+
   vlib_node_increment_counter (vm, ikev2_node.index,
 			       IKEV2_ERROR_PROCESSED, frame->n_vectors);
+  vlib_node_increment_counter (vm, ikev2_node.index,
+			       IKEV2_ERROR_DH_OFFLOADED, n_held);
   return frame->n_vectors;
 }
 
@@ -2956,7 +3385,7 @@ ikev2_initiate_sa_init (vlib_main_t * vm, u8 * name)
     sa.is_initiator = 1;
     sa.profile = p;
     sa.state = IKEV2_STATE_SA_INIT;
-    ikev2_generate_sa_init_data (&sa);
+    ikev2_generate_sa_init_data (&sa, 0);
     ikev2_payload_add_ke (chain, sa.dh_group, sa.i_dh_data);
     ikev2_payload_add_nonce (chain, sa.i_nonce);
 
@@ -3116,6 +3545,7 @@ ikev2_initiate_delete_child_sa (vlib_main_t * vm, u32 ispi)
   else
     {
       ikev2_delete_child_sa_internal (vm, fsa, fchild);
+      ikev2_flush_tunnel_ifs ();
     }
 
   return 0;
@@ -3185,6 +3615,7 @@ ikev2_initiate_delete_ike_sa (vlib_main_t * vm, u64 ispi)
     ikev2_delete_tunnel_interface (km->vnet_main, fsa, c);
     ikev2_sa_del_child_sa (fsa, c);
   }
+  ikev2_flush_tunnel_ifs ();
   ikev2_sa_free_all_vec (fsa);
   uword *p = hash_get (ftkm->sa_by_rspi, fsa->rspi);
   if (p)
@@ -3296,6 +3727,10 @@ ikev2_init (vlib_main_t * vm)
 
   km->sa_by_ispi = hash_create (0, sizeof (uword));
 
+  km->n_crypto_threads = ikev2_crypto_thread_reg.count;
+  pthread_mutex_init (&km->crypto_lock, NULL);
+  pthread_cond_init (&km->crypto_cond, NULL);
+
 
   if ((error = vlib_call_init_function (vm, ikev2_cli_init)))
     return error;
@@ -3426,6 +3861,8 @@ ikev2_mngr_process_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
       }));
       /* *INDENT-ON* */
 
+      ikev2_flush_tunnel_ifs ();
+
       if (req_sent)
 	{
 	  vlib_process_wait_for_event_or_clock (vm, 5);
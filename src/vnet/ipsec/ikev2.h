@@ -395,6 +395,9 @@ clib_error_t *ikev2_initiate_sa_init (vlib_main_t * vm, u8 * name);
 clib_error_t *ikev2_initiate_delete_child_sa (vlib_main_t * vm, u32 ispi);
 clib_error_t *ikev2_initiate_delete_ike_sa (vlib_main_t * vm, u64 ispi);
 clib_error_t *ikev2_initiate_rekey_child_sa (vlib_main_t * vm, u32 ispi);
+clib_error_t *ikev2_crypto_benchmark (vlib_main_t * vm, u32 n_exchanges,
+				      ikev2_transform_dh_type_t dh_type,
+				      f64 * inline_time, f64 * offload_time);
 
 /* ikev2_format.c */
 u8 *format_ikev2_auth_method (u8 * s, va_list * args);
@@ -584,6 +584,65 @@ VLIB_CLI_COMMAND (ikev2_initiate_command, static) = {
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+test_ikev2_crypto_command_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  ikev2_transform_dh_type_t dh_type = IKEV2_TRANSFORM_DH_TYPE_MODP_2048;
+  u32 count = 1000;
+  f64 inline_time, offload_time;
+  clib_error_t *r;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "count %u", &count))
+	;
+      else if (unformat (input, "dh %U", unformat_ikev2_transform_dh_type,
+			 &dh_type))
+	;
+      else
+	return clib_error_return (0, "parse error: '%U'",
+				  format_unformat_error, input);
+    }
+
+  if (count == 0)
+    return clib_error_return (0, "count must be non-zero");
+
+  r = ikev2_crypto_benchmark (vm, count, dh_type, &inline_time,
+			      &offload_time);
+  if (r)
+    return r;
+
+  vlib_cli_output (vm, "%u %U exchanges", count,
+		   format_ikev2_transform_dh_type, dh_type);
+  vlib_cli_output (vm, "  inline:  %.3fs, %.1f exchanges/s", inline_time,
+		   count / inline_time);
+  if (offload_time < 0)
+    vlib_cli_output (vm, "  offload: no ikev2-crypto threads configured");
+  else
+    vlib_cli_output (vm, "  offload: %.3fs, %.1f exchanges/s",
+		     offload_time, count / offload_time);
+  return 0;
+}
+
+/*?
+ * Measure the responder DH cost of bringing up <count> tunnels, inline
+ * and on the ikev2-crypto threads set with "cpu { ikev2-crypto <n> }".
+ * The elapsed time and exchange rate are printed for each mode; the
+ * offload figures depend on the number of ikev2-crypto threads and on
+ * the cores they run on.
+ *
+ * @cliexpar
+ * @cliexcmd{test ikev2 crypto count 1000 dh modp-2048}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_ikev2_crypto_command, static) = {
+    .path = "test ikev2 crypto",
+    .short_help = "test ikev2 crypto [count <n>] [dh <group>]",
+    .function = test_ikev2_crypto_command_fn,
+};
+/* *INDENT-ON* */
 
 clib_error_t *
 ikev2_cli_init (vlib_main_t * vm)
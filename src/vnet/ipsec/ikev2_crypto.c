@@ -450,10 +450,8 @@ ikev2_generate_dh (ikev2_sa_t * sa, ikev2_sa_transform_t * t)
   int r;
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
   BIGNUM *p = BN_new ();
-  BIGNUM *q = BN_new ();
   BIGNUM *g = BN_new ();
-  BIGNUM *pub_key = BN_new ();
-  BIGNUM *priv_key = BN_new ();
+  const BIGNUM *pub_key, *priv_key;
 #endif
 
   if (t->dh_group == IKEV2_DH_GROUP_MODP)
@@ -462,22 +460,25 @@ ikev2_generate_dh (ikev2_sa_t * sa, ikev2_sa_transform_t * t)
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
       BN_hex2bn (&p, t->dh_p);
       BN_hex2bn (&g, t->dh_g);
-      DH_set0_pqg (dh, p, q, g);
+      DH_set0_pqg (dh, p, NULL, g);
 #else
       BN_hex2bn (&dh->p, t->dh_p);
       BN_hex2bn (&dh->g, t->dh_g);
 #endif
       DH_generate_key (dh);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+      DH_get0_key (dh, &pub_key, &priv_key);
+#endif
 
       if (sa->is_initiator)
 	{
 	  sa->i_dh_data = vec_new (u8, t->key_len);
 	  sa->dh_private_key = vec_new (u8, t->key_len);
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	  r = BN_bn2bin (pub_key, sa->i_dh_data);
+	  r = BN_bn2binpad (pub_key, sa->i_dh_data, t->key_len);
 	  ASSERT (r == t->key_len);
 	  r = BN_bn2bin (priv_key, sa->dh_private_key);
-	  DH_set0_key (dh, pub_key, priv_key);
+	  _vec_len (sa->dh_private_key) = r;
 #else
 	  r = BN_bn2bin (dh->pub_key, sa->i_dh_data);
 	  ASSERT (r == t->key_len);
@@ -489,9 +490,8 @@ ikev2_generate_dh (ikev2_sa_t * sa, ikev2_sa_transform_t * t)
 	{
 	  sa->r_dh_data = vec_new (u8, t->key_len);
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	  r = BN_bn2bin (pub_key, sa->i_dh_data);
+	  r = BN_bn2binpad (pub_key, sa->r_dh_data, t->key_len);
 	  ASSERT (r == t->key_len);
-	  DH_set0_key (dh, pub_key, NULL);
 #else
 	  r = BN_bn2bin (dh->pub_key, sa->r_dh_data);
 	  ASSERT (r == t->key_len);
@@ -582,9 +582,8 @@ ikev2_complete_dh (ikev2_sa_t * sa, ikev2_sa_transform_t * t)
   int r;
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
   BIGNUM *p = BN_new ();
-  BIGNUM *q = BN_new ();
   BIGNUM *g = BN_new ();
-  BIGNUM *priv_key = BN_new ();
+  BIGNUM *priv_key;
 #endif
 
   if (t->dh_group == IKEV2_DH_GROUP_MODP)
@@ -593,7 +592,7 @@ ikev2_complete_dh (ikev2_sa_t * sa, ikev2_sa_transform_t * t)
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
       BN_hex2bn (&p, t->dh_p);
       BN_hex2bn (&g, t->dh_g);
-      DH_set0_pqg (dh, p, q, g);
+      DH_set0_pqg (dh, p, NULL, g);
 
       priv_key =
 	BN_bin2bn (sa->dh_private_key, vec_len (sa->dh_private_key), NULL);
@@ -20,6 +20,7 @@
 #include <vnet/ethernet/ethernet.h>
 
 #include <vnet/ipsec/ikev2.h>
+#include <vnet/ipsec/ipsec.h>
 
 #include <vppinfra/hash.h>
 #include <vppinfra/elog.h>
@@ -48,6 +49,7 @@ typedef enum
   IKEV2_STATE_NOTIFY_AND_DELETE,
   IKEV2_STATE_TS_UNACCEPTABLE,
   IKEV2_STATE_NO_PROPOSAL_CHOSEN,
+  IKEV2_STATE_DH_PENDING,
 } ikev2_state_t;
 
 typedef struct
@@ -256,6 +258,31 @@ typedef struct
 } ikev2_sa_t;
 
 
+typedef struct ikev2_crypto_job_t_ ikev2_crypto_job_t;
+
+/* runs on the submitting thread, returns a buffer for ip4-lookup or ~0 */
+typedef u32 (ikev2_crypto_job_done_fn_t) (vlib_main_t * vm,
+					  ikev2_crypto_job_t * job);
+
+/* DH computation run by an ikev2-crypto thread, owns its vectors */
+struct ikev2_crypto_job_t_
+{
+  ikev2_crypto_job_done_fn_t *done;
+  ikev2_sa_transform_t *dh;
+  u8 is_initiator;
+  u32 thread_index;
+
+  /* SA and packet waiting for the result */
+  u32 sa_index;
+  u64 rspi;
+  u32 bi;
+
+  u8 *i_dh_data;
+  u8 *r_dh_data;
+  u8 *dh_private_key;
+  u8 *dh_shared_key;
+};
+
 typedef struct
 {
   /* pool of IKEv2 Security Associations */
@@ -263,6 +290,13 @@ typedef struct
 
   /* hash */
   uword *sa_by_rspi;
+
+  /* crypto jobs finished by the crypto threads, under crypto_lock */
+  ikev2_crypto_job_t **crypto_done;
+  u32 n_crypto_pending;
+
+  /* tunnel interface changes installed in one go */
+  ipsec_add_del_tunnel_args_t *tunnel_ifs;
 } ikev2_main_per_thread_data_t;
 
 typedef struct
@@ -290,6 +324,12 @@ typedef struct
 
   ikev2_main_per_thread_data_t *per_thread_data;
 
+  /* fifo of jobs for the crypto threads */
+  ikev2_crypto_job_t **crypto_jobs;
+  pthread_mutex_t crypto_lock;
+  pthread_cond_t crypto_cond;
+  u32 n_crypto_threads;
+
 } ikev2_main_t;
 
 extern ikev2_main_t ikev2_main;
@@ -117,14 +117,29 @@ ipsec_add_del_spd (vlib_main_t * vm, u32 spd_id, int is_add)
       vec_free (spd->ipv6_outbound_policies);
       vec_free (spd->ipv4_inbound_protect_policy_indices);
       vec_free (spd->ipv4_inbound_policy_discard_and_bypass_indices);
+      vec_free (spd->ipv4_outbound_rules);
+      vec_free (spd->ipv4_inbound_protect_rules);
+      for (k = 0; k < vec_len (spd->flow_cache_by_thread); k++)
+	vec_free (spd->flow_cache_by_thread[k].entries);
+      vec_free (spd->flow_cache_by_thread);
       pool_put (im->spds, spd);
     }
   else				/* create new SPD */
     {
+      vlib_thread_main_t *tm = vlib_get_thread_main ();
+
       pool_get (im->spds, spd);
       memset (spd, 0, sizeof (*spd));
       spd_index = spd - im->spds;
       spd->id = spd_id;
+      /* zeroed cache entries carry generation 0 and never hit */
+      spd->generation = 1;
+      vec_validate_aligned (spd->flow_cache_by_thread, tm->n_vlib_mains - 1,
+			    CLIB_CACHE_LINE_BYTES);
+      for (k = 0; k < tm->n_vlib_mains; k++)
+	vec_validate_aligned (spd->flow_cache_by_thread[k].entries,
+			      IPSEC_SPD_FLOW_CACHE_SIZE - 1,
+			      CLIB_CACHE_LINE_BYTES);
       hash_set (im->spd_index_by_spd_id, spd_id, spd_index);
     }
   return 0;
@@ -151,6 +166,68 @@ ipsec_spd_entry_sort (void *a1, void *a2)
   return 0;
 }
 
+static void
+ipsec_spd_compile_rules4 (ipsec_spd_t * spd, u32 * policy_indices,
+			  ipsec_spd_rule4_t ** rules, int is_inbound_protect)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_rule4_t *r;
+  ipsec_policy_t *p;
+  ipsec_sa_t *sa;
+  u32 *i;
+
+  vec_reset_length (*rules);
+  vec_foreach (i, policy_indices)
+  {
+    p = pool_elt_at_index (spd->policies, *i);
+    vec_add2 (*rules, r, 1);
+    r->laddr_start = clib_net_to_host_u32 (p->laddr.start.ip4.as_u32);
+    r->laddr_stop = clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32);
+    r->raddr_start = clib_net_to_host_u32 (p->raddr.start.ip4.as_u32);
+    r->raddr_stop = clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32);
+    r->lport_start = p->lport.start;
+    r->lport_stop = p->lport.stop;
+    r->rport_start = p->rport.start;
+    r->rport_stop = p->rport.stop;
+    r->protocol = p->protocol;
+    r->policy_index = *i;
+    r->spi = 0;
+
+    if (!is_inbound_protect)
+      continue;
+
+    sa = pool_elt_at_index (im->sad, p->sa_index);
+    r->spi = sa->spi;
+    if (sa->is_tunnel)
+      {
+	r->laddr_start = r->laddr_stop =
+	  clib_net_to_host_u32 (sa->tunnel_dst_addr.ip4.as_u32);
+	r->raddr_start = r->raddr_stop =
+	  clib_net_to_host_u32 (sa->tunnel_src_addr.ip4.as_u32);
+      }
+  }
+}
+
+/* recompile the IPv4 rules and stale every cached lookup of the SPD */
+static void
+ipsec_spd_policies_changed (ipsec_spd_t * spd)
+{
+  ipsec_spd_flow_cache_t *fc;
+
+  ipsec_spd_compile_rules4 (spd, spd->ipv4_outbound_policies,
+			    &spd->ipv4_outbound_rules, 0);
+  ipsec_spd_compile_rules4 (spd, spd->ipv4_inbound_protect_policy_indices,
+			    &spd->ipv4_inbound_protect_rules, 1);
+
+  if (PREDICT_TRUE (++spd->generation != 0))
+    return;
+
+  /* wrapped, entries of the previous round could look current */
+  vec_foreach (fc, spd->flow_cache_by_thread)
+    memset (fc->entries, 0, vec_bytes (fc->entries));
+  spd->generation = 1;
+}
+
 int
 ipsec_add_del_policy (vlib_main_t * vm, ipsec_policy_t * policy, int is_add)
 {
@@ -377,6 +454,7 @@ ipsec_add_del_policy (vlib_main_t * vm, ipsec_policy_t * policy, int is_add)
       /* *INDENT-ON* */
     }
 
+  ipsec_spd_policies_changed (spd);
   return 0;
 }
 
@@ -450,6 +528,7 @@ ipsec_add_del_sa (vlib_main_t * vm, ipsec_sa_t * new_sa, int is_add)
       pool_get (im->sad, sa);
       clib_memcpy (sa, new_sa, sizeof (*sa));
       sa_index = sa - im->sad;
+      ipsec_sa_seq_blocks_reset (sa_index);
       hash_set (im->sa_index_by_sa_id, sa->id, sa_index);
       if (im->cb.add_del_sa_sess_cb)
 	{
@@ -500,6 +579,9 @@ ipsec_set_sa_key (vlib_main_t * vm, ipsec_sa_t * sa_update)
 	  err = im->cb.add_del_sa_sess_cb (sa_index, 0);
 	  if (err)
 	    return VNET_API_ERROR_SYSCALL_ERROR_1;
+	  err = im->cb.add_del_sa_sess_cb (sa_index, 1);
+	  if (err)
+	    return VNET_API_ERROR_SYSCALL_ERROR_1;
 	}
     }
 
@@ -526,14 +608,113 @@ ipsec_rand_seed (void)
 static clib_error_t *
 ipsec_check_support (ipsec_sa_t * sa)
 {
-  if (sa->crypto_alg == IPSEC_CRYPTO_ALG_AES_GCM_128)
-    return clib_error_return (0, "unsupported aes-gcm-128 crypto-alg");
+  switch (sa->crypto_alg)
+    {
+    case IPSEC_CRYPTO_ALG_AES_GCM_128:
+    case IPSEC_CRYPTO_ALG_AES_GCM_192:
+    case IPSEC_CRYPTO_ALG_AES_GCM_256:
+      /* the key is followed by the 4 byte salt, the ICV comes from GCM */
+      if (sa->crypto_key_len != 16 + 4 + 8 * (sa->crypto_alg -
+					      IPSEC_CRYPTO_ALG_AES_GCM_128))
+	return clib_error_return (0, "bad aes-gcm key length %u",
+				  sa->crypto_key_len);
+      if (sa->integ_alg != IPSEC_INTEG_ALG_NONE)
+	return clib_error_return (0, "aes-gcm takes no integ-alg");
+      return 0;
+    default:
+      break;
+    }
+
   if (sa->integ_alg == IPSEC_INTEG_ALG_NONE)
     return clib_error_return (0, "unsupported none integ-alg");
 
   return 0;
 }
 
+static clib_error_t *
+ipsec_add_del_sa_sess (u32 sa_index, u8 is_add)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_proto_main_t *em = &ipsec_proto_main;
+  ipsec_sa_t *sa = pool_elt_at_index (im->sad, sa_index);
+  ipsec_proto_main_crypto_alg_t *a =
+    em->ipsec_proto_main_crypto_algs + sa->crypto_alg;
+
+  if (a->alg == VNET_CRYPTO_ALG_NONE)
+    return 0;
+
+  if (!is_add)
+    {
+      vnet_crypto_key_del (im->vlib_main, sa->crypto_key_index);
+      return 0;
+    }
+
+  /* RFC 4106, the last 4 bytes of the key material are the salt */
+  if (a->icv_size)
+    clib_memcpy (&sa->salt, sa->crypto_key + sa->crypto_key_len - 4, 4);
+
+  sa->crypto_key_index = vnet_crypto_key_add (im->vlib_main, a->alg,
+					      sa->crypto_key,
+					      sa->crypto_key_len);
+  return 0;
+}
+
+int
+ipsec_set_async_mode (vlib_main_t * vm, int is_enable)
+{
+  ipsec_main_t *im = &ipsec_main;
+
+  is_enable = is_enable != 0;
+  if (im->async_mode == is_enable)
+    return 0;
+
+  /* not with the esp nodes of the dpdk plugin */
+  if (im->esp_encrypt_node_index != esp_encrypt_node.index)
+    return VNET_API_ERROR_UNSUPPORTED;
+
+  /* frames still in flight complete when async mode is enabled again */
+  im->async_mode = is_enable;
+  vnet_crypto_request_async_mode (is_enable);
+  return 0;
+}
+
+/* drop the sequence blocks the threads reserved from an earlier SA with
+   the same index, the workers are stopped while SAs are added */
+void
+ipsec_sa_seq_blocks_reset (u32 sa_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_sa_seq_block_t *blk;
+  u32 i;
+
+  for (i = 0; i < vec_len (im->seq_blocks_by_thread); i++)
+    {
+      vec_validate_aligned (im->seq_blocks_by_thread[i], sa_index,
+			    CLIB_CACHE_LINE_BYTES);
+      blk = vec_elt_at_index (im->seq_blocks_by_thread[i], sa_index);
+      blk->next = blk->end = 0;
+    }
+}
+
+/* the replay window as a bitmap of the ESP_WINDOW_SIZE sequence numbers
+   up to the last one received, bit 0 is the last one */
+u64
+ipsec_sa_replay_window (ipsec_sa_t * sa)
+{
+  u64 w = 0, seq, slot;
+  u32 i;
+
+  for (i = 0; i < ESP_WINDOW_SIZE && i <= sa->last_seq; i++)
+    {
+      seq = sa->last_seq - i;
+      slot = *esp_replay_slot (sa, seq);
+      if (esp_replay_block_cmp (slot, seq) == 0 && (slot >> (seq & 31)) & 1)
+	w |= 1ULL << i;
+    }
+
+  return w;
+}
+
 static clib_error_t *
 ipsec_init (vlib_main_t * vm)
 {
@@ -555,6 +736,16 @@ ipsec_init (vlib_main_t * vm)
 
   vec_validate_aligned (im->empty_buffers, tm->n_vlib_mains - 1,
 			CLIB_CACHE_LINE_BYTES);
+  vec_validate (im->seq_blocks_by_thread, tm->n_vlib_mains - 1);
+
+  /* the packets workers send on one SA are reordered by up to a block per
+     busy worker, keep that well inside the peer's replay window. Blocks
+     of idle workers falling behind it are dropped by esp_seq_advance */
+  if (vlib_num_workers ())
+    im->seq_block_size = clib_max (1, ESP_WINDOW_SIZE /
+				   (2 * vlib_num_workers ()));
+  else
+    im->seq_block_size = 1;
 
   node = vlib_get_node_by_name (vm, (u8 *) "error-drop");
   ASSERT (node);
@@ -581,7 +772,16 @@ ipsec_init (vlib_main_t * vm)
   im->ah_encrypt_next_index = IPSEC_OUTPUT_NEXT_AH_ENCRYPT;
   im->ah_decrypt_next_index = IPSEC_INPUT_NEXT_AH_DECRYPT;
 
+  if ((error = vlib_call_init_function (vm, vnet_crypto_init)))
+    return error;
+
+  im->esp_encrypt_post_next_index =
+    vnet_crypto_register_post_node (vm, "esp-encrypt-post");
+  im->esp_decrypt_post_next_index =
+    vnet_crypto_register_post_node (vm, "esp-decrypt-post");
+
   im->cb.check_support_cb = ipsec_check_support;
+  im->cb.add_del_sa_sess_cb = ipsec_add_del_sa_sess;
 
   if ((error = vlib_call_init_function (vm, ipsec_cli_init)))
     return error;
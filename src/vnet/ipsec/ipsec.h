@@ -17,6 +17,7 @@
 
 #include <vnet/ip/ip.h>
 #include <vnet/feature/feature.h>
+#include <vppinfra/xxhash.h>
 
 #define IPSEC_FLAG_IPSEC_GRE_TUNNEL (1 << 0)
 
@@ -108,6 +109,14 @@ typedef enum
   IPSEC_PROTOCOL_ESP = 1
 } ipsec_protocol_t;
 
+/*
+ * The anti-replay window is a ring of slots, each holding the bitmap of a
+ * block of 32 sequence numbers in its low half and the block number in its
+ * high half. Four slots cover the 64 packet window from any offset.
+ */
+#define IPSEC_SA_REPLAY_N_SLOTS		4
+#define IPSEC_SA_REPLAY_BLOCK_BITS	5
+
 typedef struct
 {
   u32 id;
@@ -132,12 +141,16 @@ typedef struct
 
   u32 salt;
 
+  /* cipher key registered with vnet crypto, set when the SA is added */
+  u32 crypto_key_index;
+
   /* runtime */
-  u32 seq;
-  u32 seq_hi;
-  u32 last_seq;
-  u32 last_seq_hi;
-  u64 replay_window;
+  /* outbound: highest sequence number reserved by a worker, the high
+     half is the ESN high bits */
+  u64 seq;
+  /* inbound: highest sequence number accepted and the window below it */
+  u64 last_seq;
+  u64 replay_window[IPSEC_SA_REPLAY_N_SLOTS];
 
   /*lifetime data */
   u64 total_data_size;
@@ -214,9 +227,51 @@ typedef struct
   vlib_counter_t counter;
 } ipsec_policy_t;
 
+/* IPv4 selector of a policy compiled to host byte order; inbound protect
+   rules carry the SA spi and, for tunnel SAs, the tunnel endpoints as
+   single address ranges */
+typedef struct
+{
+  u32 laddr_start;
+  u32 laddr_stop;
+  u32 raddr_start;
+  u32 raddr_stop;
+  u16 lport_start;
+  u16 lport_stop;
+  u16 rport_start;
+  u16 rport_stop;
+  u32 spi;
+  u32 policy_index;
+  u8 protocol;
+} ipsec_spd_rule4_t;
+
+#define IPSEC_SPD_FLOW_CACHE_LOG2_SIZE 10
+#define IPSEC_SPD_FLOW_CACHE_SIZE (1 << IPSEC_SPD_FLOW_CACHE_LOG2_SIZE)
+
+typedef struct
+{
+  /* addresses, then ports/spi, protocol and direction */
+  u64 key[2];
+  /* ~0 caches a miss */
+  u32 policy_index;
+  /* spd generation the entry was resolved at */
+  u32 generation;
+} ipsec_spd_flow_entry_t;
+
+/* direct mapped cache of resolved IPv4 lookups, one per thread */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  ipsec_spd_flow_entry_t *entries;
+  u64 hits;
+  u64 misses;
+} ipsec_spd_flow_cache_t;
+
 typedef struct
 {
   u32 id;
+  /* bumped whenever the policies change, stales the flow caches */
+  u32 generation;
   /* pool of policies */
   ipsec_policy_t *policies;
   /* vectors of policy indices */
@@ -226,6 +281,10 @@ typedef struct
   u32 *ipv4_inbound_policy_discard_and_bypass_indices;
   u32 *ipv6_inbound_protect_policy_indices;
   u32 *ipv6_inbound_policy_discard_and_bypass_indices;
+  /* priority sorted compiled rules, rebuilt with the vectors above */
+  ipsec_spd_rule4_t *ipv4_outbound_rules;
+  ipsec_spd_rule4_t *ipv4_inbound_protect_rules;
+  ipsec_spd_flow_cache_t *flow_cache_by_thread;
 } ipsec_spd_t;
 
 typedef struct
@@ -245,6 +304,13 @@ typedef struct
   u32 hw_if_index;
 } ipsec_tunnel_if_t;
 
+/* sequence numbers a worker reserved from an outbound SA */
+typedef struct
+{
+  u64 next;
+  u64 end;
+} ipsec_sa_seq_block_t;
+
 typedef struct
 {
   clib_error_t *(*add_del_sa_sess_cb) (u32 sa_index, u8 is_add);
@@ -290,6 +356,16 @@ typedef struct
   u32 ah_encrypt_next_index;
   u32 ah_decrypt_next_index;
 
+  /* per thread, indexed by sa index */
+  ipsec_sa_seq_block_t **seq_blocks_by_thread;
+  /* sequence numbers a worker reserves at a time */
+  u32 seq_block_size;
+
+  /* async crypto, esp ops go through crypto-dispatch to the post nodes */
+  u8 async_mode;
+  u16 esp_encrypt_post_next_index;
+  u16 esp_decrypt_post_next_index;
+
   /* callbacks */
   ipsec_main_callbacks_t cb;
 } ipsec_main_t;
@@ -314,6 +390,9 @@ int ipsec_add_del_policy (vlib_main_t * vm, ipsec_policy_t * policy,
 			  int is_add);
 int ipsec_add_del_sa (vlib_main_t * vm, ipsec_sa_t * new_sa, int is_add);
 int ipsec_set_sa_key (vlib_main_t * vm, ipsec_sa_t * sa_update);
+int ipsec_set_async_mode (vlib_main_t * vm, int is_enable);
+void ipsec_sa_seq_blocks_reset (u32 sa_index);
+u64 ipsec_sa_replay_window (ipsec_sa_t * sa);
 
 u32 ipsec_get_sa_index_by_sa_id (u32 sa_id);
 u8 ipsec_is_sa_used (u32 sa_index);
@@ -330,6 +409,7 @@ int ipsec_add_del_tunnel_if_internal (vnet_main_t * vnm,
 				      ipsec_add_del_tunnel_args_t * args,
 				      u32 * sw_if_index);
 int ipsec_add_del_tunnel_if (ipsec_add_del_tunnel_args_t * args);
+int ipsec_add_del_tunnel_if_batch (ipsec_add_del_tunnel_args_t * args);
 int ipsec_add_del_ipsec_gre_tunnel (vnet_main_t * vnm,
 				    ipsec_add_del_ipsec_gre_tunnel_args_t *
 				    args);
@@ -364,6 +444,46 @@ ipsec_alloc_empty_buffers (vlib_main_t * vm, ipsec_main_t * im)
     }
 }
 
+#define IPSEC_SPD_FLOW_KEY_OUTBOUND 1
+#define IPSEC_SPD_FLOW_KEY_INBOUND_PROTECT 2
+
+always_inline ipsec_spd_flow_entry_t *
+ipsec_spd_flow_cache_entry (ipsec_spd_t * spd, u32 thread_index, u64 * key)
+{
+  ipsec_spd_flow_cache_t *fc =
+    vec_elt_at_index (spd->flow_cache_by_thread, thread_index);
+  u64 h = clib_xxhash (key[0] ^ ((key[1] << 17) | (key[1] >> 47)));
+
+  return fc->entries + (h & (IPSEC_SPD_FLOW_CACHE_SIZE - 1));
+}
+
+/* true and counted as a hit if the slot holds a current result for key */
+always_inline int
+ipsec_spd_flow_cache_hit (ipsec_spd_t * spd, u32 thread_index,
+			  ipsec_spd_flow_entry_t * e, u64 * key)
+{
+  ipsec_spd_flow_cache_t *fc = spd->flow_cache_by_thread + thread_index;
+
+  if (PREDICT_TRUE (e->generation == spd->generation &&
+		    e->key[0] == key[0] && e->key[1] == key[1]))
+    {
+      fc->hits++;
+      return 1;
+    }
+  fc->misses++;
+  return 0;
+}
+
+always_inline void
+ipsec_spd_flow_cache_add (ipsec_spd_t * spd, ipsec_spd_flow_entry_t * e,
+			  u64 * key, u32 policy_index)
+{
+  e->key[0] = key[0];
+  e->key[1] = key[1];
+  e->policy_index = policy_index;
+  e->generation = spd->generation;
+}
+
 static_always_inline u32
 get_next_output_feature_node_index (vlib_buffer_t * b,
 				    vlib_node_runtime_t * nr)
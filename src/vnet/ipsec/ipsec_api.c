@@ -445,15 +445,19 @@ send_ipsec_sa_details (ipsec_sa_t * sa, vl_api_registration_t * reg,
     }
 
   mp->salt = clib_host_to_net_u32 (sa->salt);
-  mp->seq_outbound = clib_host_to_net_u64 (((u64) sa->seq));
-  mp->last_seq_inbound = clib_host_to_net_u64 (((u64) sa->last_seq));
   if (sa->use_esn)
     {
-      mp->seq_outbound |= (u64) (clib_host_to_net_u32 (sa->seq_hi));
-      mp->last_seq_inbound |= (u64) (clib_host_to_net_u32 (sa->last_seq_hi));
+      mp->seq_outbound = clib_host_to_net_u64 (sa->seq);
+      mp->last_seq_inbound = clib_host_to_net_u64 (sa->last_seq);
+    }
+  else
+    {
+      mp->seq_outbound = clib_host_to_net_u64 ((u32) sa->seq);
+      mp->last_seq_inbound = clib_host_to_net_u64 ((u32) sa->last_seq);
     }
   if (sa->use_anti_replay)
-    mp->replay_window = clib_host_to_net_u64 (sa->replay_window);
+    mp->replay_window =
+      clib_host_to_net_u64 (ipsec_sa_replay_window (sa));
   mp->total_data_size = clib_host_to_net_u64 (sa->total_data_size);
 
   vl_api_send_msg (reg, (u8 *) mp);
@@ -436,6 +436,57 @@ VLIB_CLI_COMMAND (set_ipsec_sa_key_command, static) = {
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+set_async_mode_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			   vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = NULL;
+  int async_enable = 0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return clib_error_return (0, "expected on|off");
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "on"))
+	async_enable = 1;
+      else if (unformat (line_input, "off"))
+	async_enable = 0;
+      else
+	{
+	  error = clib_error_return (0, "parse error: '%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  if (ipsec_set_async_mode (vm, async_enable))
+    error = clib_error_return (0, "async mode not supported");
+
+done:
+  unformat_free (line_input);
+
+  return error;
+}
+
+/*?
+ * Hand the ESP cipher work to the async crypto engine instead of running
+ * it in the esp-encrypt and esp-decrypt nodes. Packets continue in
+ * esp-encrypt-post and esp-decrypt-post once their ops completed.
+ *
+ * @cliexpar
+ * @cliexstart{set ipsec async mode on}
+ * @cliexend
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_async_mode_command, static) = {
+    .path = "set ipsec async mode",
+    .short_help = "set ipsec async mode on|off",
+    .function = set_async_mode_command_fn,
+};
+/* *INDENT-ON* */
+
 static clib_error_t *
 show_ipsec_command_fn (vlib_main_t * vm,
 		       unformat_input_t * input, vlib_cli_command_t * cmd)
@@ -447,6 +498,10 @@ show_ipsec_command_fn (vlib_main_t * vm,
   u32 *i;
   ipsec_tunnel_if_t *t;
   vnet_hw_interface_t *hi;
+  ipsec_spd_flow_cache_t *fc;
+  u64 hits, misses;
+
+  vlib_cli_output (vm, "esp crypto %s", im->async_mode ? "async" : "sync");
 
   /* *INDENT-OFF* */
   pool_foreach (sa, im->sad, ({
@@ -480,6 +535,14 @@ show_ipsec_command_fn (vlib_main_t * vm,
   pool_foreach (spd, im->spds, ({
     vlib_cli_output(vm, "spd %u", spd->id);
 
+    hits = misses = 0;
+    vec_foreach(fc, spd->flow_cache_by_thread)
+      {
+        hits += fc->hits;
+        misses += fc->misses;
+      }
+    vlib_cli_output(vm, " flow cache hits %llu misses %llu", hits, misses);
+
     vlib_cli_output(vm, " outbound policies");
     vec_foreach(i, spd->ipv4_outbound_policies)
       {
@@ -632,7 +695,8 @@ show_ipsec_command_fn (vlib_main_t * vm,
     vlib_cli_output(vm, "  %s seq", hi->name);
     sa = pool_elt_at_index(im->sad, t->output_sa_index);
     vlib_cli_output(vm, "   seq %u seq-hi %u esn %u anti-replay %u",
-                    sa->seq, sa->seq_hi, sa->use_esn, sa->use_anti_replay);
+                    (u32) sa->seq, (u32) (sa->seq >> 32), sa->use_esn,
+                    sa->use_anti_replay);
     vlib_cli_output(vm, "   local-spi %u local-ip %U", sa->spi,
                     format_ip4_address, &sa->tunnel_src_addr.ip4);
     vlib_cli_output(vm, "   local-crypto %U %U",
@@ -643,9 +707,10 @@ show_ipsec_command_fn (vlib_main_t * vm,
                     format_hex_bytes, sa->integ_key, sa->integ_key_len);
     sa = pool_elt_at_index(im->sad, t->input_sa_index);
     vlib_cli_output(vm, "   last-seq %u last-seq-hi %u esn %u anti-replay %u window %U",
-                    sa->last_seq, sa->last_seq_hi, sa->use_esn,
-                    sa->use_anti_replay,
-                    format_ipsec_replay_window, sa->replay_window);
+                    (u32) sa->last_seq, (u32) (sa->last_seq >> 32),
+                    sa->use_esn, sa->use_anti_replay,
+                    format_ipsec_replay_window,
+                    ipsec_sa_replay_window (sa));
     vlib_cli_output(vm, "   remote-spi %u remote-ip %U", sa->spi,
                     format_ip4_address, &sa->tunnel_src_addr.ip4);
     vlib_cli_output(vm, "   remote-crypto %U %U",
@@ -659,6 +724,19 @@ show_ipsec_command_fn (vlib_main_t * vm,
   return 0;
 }
 
+/*?
+ * Show the SPDs with their policies, the SAs and the tunnel interfaces.
+ *
+ * For each SPD the hits and misses of the per thread flow caches are
+ * shown. Only a hit skips the policy lookup. A miss still scans the
+ * compiled rules of the SPD one by one, in priority order, and every
+ * policy change invalidates the caches. A mix of mostly new flows, or
+ * SPDs that change often, see no gain from the cache, and the cost of a
+ * miss grows with the number of policies.
+ *
+ * @cliexpar
+ * @cliexcmd{show ipsec}
+?*/
 /* *INDENT-OFF* */
 VLIB_CLI_COMMAND (show_ipsec_command, static) = {
     .path = "show ipsec",
@@ -675,12 +753,15 @@ clear_ipsec_counters_command_fn (vlib_main_t * vm,
   ipsec_main_t *im = &ipsec_main;
   ipsec_spd_t *spd;
   ipsec_policy_t *p;
+  ipsec_spd_flow_cache_t *fc;
 
   /* *INDENT-OFF* */
   pool_foreach (spd, im->spds, ({
     pool_foreach(p, spd->policies, ({
       p->counter.packets = p->counter.bytes = 0;
     }));
+    vec_foreach(fc, spd->flow_cache_by_thread)
+      fc->hits = fc->misses = 0;
   }));
   /* *INDENT-ON* */
 
@@ -147,6 +147,51 @@ ipsec_add_del_tunnel_if (ipsec_add_del_tunnel_args_t * args)
   return 0;
 }
 
+#define IPSEC_TUNNEL_IF_BATCH_SIZE 64
+
+typedef struct
+{
+  u32 n_args;
+  ipsec_add_del_tunnel_args_t args[0];
+} ipsec_add_del_tunnel_if_batch_t;
+
+static void
+ipsec_add_del_tunnel_if_batch_rpc_callback (ipsec_add_del_tunnel_if_batch_t *
+					    b)
+{
+  vnet_main_t *vnm = vnet_get_main ();
+  u32 i;
+
+  ASSERT (vlib_get_thread_index () == 0);
+
+  for (i = 0; i < b->n_args; i++)
+    ipsec_add_del_tunnel_if_internal (vnm, b->args + i, NULL);
+}
+
+/*
+ * Apply a vector of tunnel changes in order, taking the worker barrier
+ * once per IPSEC_TUNNEL_IF_BATCH_SIZE changes instead of once per change.
+ */
+int
+ipsec_add_del_tunnel_if_batch (ipsec_add_del_tunnel_args_t * args)
+{
+  ipsec_add_del_tunnel_if_batch_t *b;
+  u32 i, n_args, n_bytes;
+
+  for (i = 0; i < vec_len (args); i += n_args)
+    {
+      n_args = clib_min (vec_len (args) - i, IPSEC_TUNNEL_IF_BATCH_SIZE);
+      n_bytes = sizeof (*b) + n_args * sizeof (args[0]);
+      b = clib_mem_alloc (n_bytes);
+      b->n_args = n_args;
+      clib_memcpy (b->args, args + i, n_args * sizeof (args[0]));
+      vl_api_rpc_call_main_thread (ipsec_add_del_tunnel_if_batch_rpc_callback,
+				   (u8 *) b, n_bytes);
+      clib_mem_free (b);
+    }
+  return 0;
+}
+
 int
 ipsec_add_del_tunnel_if_internal (vnet_main_t * vnm,
 				  ipsec_add_del_tunnel_args_t * args,
@@ -174,6 +219,7 @@ ipsec_add_del_tunnel_if_internal (vnet_main_t * vnm,
       pool_get (im->sad, sa);
       memset (sa, 0, sizeof (*sa));
       t->input_sa_index = sa - im->sad;
+      ipsec_sa_seq_blocks_reset (t->input_sa_index);
       sa->spi = args->remote_spi;
       sa->tunnel_src_addr.ip4.as_u32 = args->remote_ip.as_u32;
       sa->tunnel_dst_addr.ip4.as_u32 = args->local_ip.as_u32;
@@ -198,6 +244,7 @@ ipsec_add_del_tunnel_if_internal (vnet_main_t * vnm,
       pool_get (im->sad, sa);
       memset (sa, 0, sizeof (*sa));
       t->output_sa_index = sa - im->sad;
+      ipsec_sa_seq_blocks_reset (t->output_sa_index);
       sa->spi = args->local_spi;
       sa->tunnel_src_addr.ip4.as_u32 = args->local_ip.as_u32;
       sa->tunnel_dst_addr.ip4.as_u32 = args->remote_ip.as_u32;
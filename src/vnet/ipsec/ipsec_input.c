@@ -74,48 +74,51 @@ format_ipsec_input_trace (u8 * s, va_list * args)
   return s;
 }
 
-always_inline ipsec_policy_t *
-ipsec_input_protect_policy_match (ipsec_spd_t * spd, u32 sa, u32 da, u32 spi)
+always_inline u32
+ipsec_input_protect_rules4_match (ipsec_spd_rule4_t * rules, u32 sa, u32 da,
+				  u32 spi)
 {
-  ipsec_main_t *im = &ipsec_main;
-  ipsec_policy_t *p;
-  ipsec_sa_t *s;
-  u32 *i;
+  ipsec_spd_rule4_t *r;
 
-  vec_foreach (i, spd->ipv4_inbound_protect_policy_indices)
+  /* tunnel SAs are compiled to single address ranges */
+  vec_foreach (r, rules)
   {
-    p = pool_elt_at_index (spd->policies, *i);
-    s = pool_elt_at_index (im->sad, p->sa_index);
-
-    if (spi != s->spi)
+    if (spi != r->spi)
       continue;
 
-    if (s->is_tunnel)
-      {
-	if (da != clib_net_to_host_u32 (s->tunnel_dst_addr.ip4.as_u32))
-	  continue;
-
-	if (sa != clib_net_to_host_u32 (s->tunnel_src_addr.ip4.as_u32))
-	  continue;
-
-	return p;
-      }
-
-    if (da < clib_net_to_host_u32 (p->laddr.start.ip4.as_u32))
+    if (da < r->laddr_start || da > r->laddr_stop)
       continue;
 
-    if (da > clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32))
+    if (sa < r->raddr_start || sa > r->raddr_stop)
       continue;
 
-    if (sa < clib_net_to_host_u32 (p->raddr.start.ip4.as_u32))
-      continue;
+    return r->policy_index;
+  }
+  return ~0;
+}
 
-    if (sa > clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32))
-      continue;
+always_inline ipsec_policy_t *
+ipsec_input_protect_policy_match (ipsec_spd_t * spd, u32 thread_index,
+				  u32 sa, u32 da, u32 spi)
+{
+  ipsec_spd_flow_entry_t *e;
+  u64 key[2];
+  u32 pi;
 
-    return p;
-  }
-  return 0;
+  key[0] = (u64) sa << 32 | da;
+  key[1] = (u64) spi << 32 | IPSEC_SPD_FLOW_KEY_INBOUND_PROTECT;
+
+  e = ipsec_spd_flow_cache_entry (spd, thread_index, key);
+  if (ipsec_spd_flow_cache_hit (spd, thread_index, e, key))
+    pi = e->policy_index;
+  else
+    {
+      pi = ipsec_input_protect_rules4_match (spd->ipv4_inbound_protect_rules,
+					     sa, da, spi);
+      ipsec_spd_flow_cache_add (spd, e, key, pi);
+    }
+
+  return pi == ~0 ? 0 : pool_elt_at_index (spd->policies, pi);
 }
 
 always_inline uword
@@ -177,6 +180,7 @@ ipsec_input_ip4_node_fn (vlib_main_t * vm,
 {
   u32 n_left_from, *from, next_index, *to_next;
   ipsec_main_t *im = &ipsec_main;
+  u32 thread_index = vm->thread_index;
 
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
@@ -228,7 +232,7 @@ ipsec_input_ip4_node_fn (vlib_main_t * vm,
 #endif
 
 	      esp0 = (esp_header_t *) ((u8 *) ip0 + ip4_header_bytes (ip0));
-	      p0 = ipsec_input_protect_policy_match (spd0,
+	      p0 = ipsec_input_protect_policy_match (spd0, thread_index,
 						     clib_net_to_host_u32
 						     (ip0->src_address.
 						      as_u32),
@@ -270,7 +274,7 @@ ipsec_input_ip4_node_fn (vlib_main_t * vm,
 	  if (PREDICT_TRUE (ip0->protocol == IP_PROTOCOL_IPSEC_AH))
 	    {
 	      ah0 = (ah_header_t *) ((u8 *) ip0 + ip4_header_bytes (ip0));
-	      p0 = ipsec_input_protect_policy_match (spd0,
+	      p0 = ipsec_input_protect_policy_match (spd0, thread_index,
 						     clib_net_to_host_u32
 						     (ip0->src_address.
 						      as_u32),
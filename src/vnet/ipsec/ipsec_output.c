@@ -72,54 +72,70 @@ format_ipsec_output_trace (u8 * s, va_list * args)
   return s;
 }
 
-always_inline ipsec_policy_t *
-ipsec_output_policy_match (ipsec_spd_t * spd, u8 pr, u32 la, u32 ra, u16 lp,
-			   u16 rp)
+always_inline u32
+ipsec_output_rules4_match (ipsec_spd_rule4_t * rules, u8 pr, u32 la, u32 ra,
+			   u16 lp, u16 rp)
 {
-  ipsec_policy_t *p;
-  u32 *i;
+  ipsec_spd_rule4_t *r;
 
-  if (!spd)
-    return 0;
-
-  vec_foreach (i, spd->ipv4_outbound_policies)
+  vec_foreach (r, rules)
   {
-    p = pool_elt_at_index (spd->policies, *i);
-    if (PREDICT_FALSE (p->protocol && (p->protocol != pr)))
-      continue;
-
-    if (la < clib_net_to_host_u32 (p->laddr.start.ip4.as_u32))
-      continue;
-
-    if (la > clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32))
+    if (PREDICT_FALSE (r->protocol && (r->protocol != pr)))
       continue;
 
-    if (ra < clib_net_to_host_u32 (p->raddr.start.ip4.as_u32))
+    if (la < r->laddr_start || la > r->laddr_stop)
       continue;
 
-    if (ra > clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32))
+    if (ra < r->raddr_start || ra > r->raddr_stop)
       continue;
 
     if (PREDICT_FALSE
 	((pr != IP_PROTOCOL_TCP) && (pr != IP_PROTOCOL_UDP)
 	 && (pr != IP_PROTOCOL_SCTP)))
-      return p;
+      return r->policy_index;
 
-    if (lp < p->lport.start)
+    if (lp < r->lport_start || lp > r->lport_stop)
       continue;
 
-    if (lp > p->lport.stop)
+    if (rp < r->rport_start || rp > r->rport_stop)
       continue;
 
-    if (rp < p->rport.start)
-      continue;
+    return r->policy_index;
+  }
+  return ~0;
+}
 
-    if (rp > p->rport.stop)
-      continue;
+always_inline ipsec_policy_t *
+ipsec_output_policy_match (ipsec_spd_t * spd, u32 thread_index, u8 pr,
+			   u32 la, u32 ra, u16 lp, u16 rp)
+{
+  ipsec_spd_flow_entry_t *e;
+  u64 key[2];
+  u32 pi;
 
-    return p;
-  }
-  return 0;
+  if (!spd)
+    return 0;
+
+  /* ports only select for protocols that have them */
+  if ((pr != IP_PROTOCOL_TCP) && (pr != IP_PROTOCOL_UDP)
+      && (pr != IP_PROTOCOL_SCTP))
+    lp = rp = 0;
+
+  key[0] = (u64) la << 32 | ra;
+  key[1] = (u64) lp << 48 | (u64) rp << 32 | pr << 8 |
+    IPSEC_SPD_FLOW_KEY_OUTBOUND;
+
+  e = ipsec_spd_flow_cache_entry (spd, thread_index, key);
+  if (ipsec_spd_flow_cache_hit (spd, thread_index, e, key))
+    pi = e->policy_index;
+  else
+    {
+      pi = ipsec_output_rules4_match (spd->ipv4_outbound_rules, pr, la, ra,
+				      lp, rp);
+      ipsec_spd_flow_cache_add (spd, e, key, pi);
+    }
+
+  return pi == ~0 ? 0 : pool_elt_at_index (spd->policies, pi);
 }
 
 always_inline uword
@@ -191,6 +207,7 @@ ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   u32 spd_index0 = ~0;
   ipsec_spd_t *spd0 = 0;
   u64 nc_protect = 0, nc_bypass = 0, nc_discard = 0, nc_nomatch = 0;
+  u32 thread_index = vm->thread_index;
 
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
@@ -259,7 +276,7 @@ ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 			sw_if_index0, spd_index0, spd0->id);
 #endif
 
-	  p0 = ipsec_output_policy_match (spd0, ip0->protocol,
+	  p0 = ipsec_output_policy_match (spd0, thread_index, ip0->protocol,
 					  clib_net_to_host_u32
 					  (ip0->src_address.as_u32),
 					  clib_net_to_host_u32
@@ -107,6 +107,7 @@ bd_delete (bd_main_t * bdm, u32 bd_index)
   /* clear BD config for reuse: bd_id to -1 and clear feature_bitmap */
   bd->bd_id = ~0;
   bd->feature_bitmap = 0;
+  bd->learn_rate = 0;
 
   /* free BD tag */
   vec_free (bd->bd_tag);
@@ -291,6 +292,19 @@ bd_set_mac_age (vlib_main_t * vm, u32 bd_index, u8 age)
 			     L2_MAC_AGE_PROCESS_EVENT_STOP, 0);
 }
 
+/**
+    Set the learn rate limit for the bridge domain.
+*/
+void
+bd_set_learn_rate (vlib_main_t * vm, u32 bd_index, u32 rate)
+{
+  l2_bridge_domain_t *bd_config;
+
+  vec_validate (l2input_main.bd_configs, bd_index);
+  bd_config = vec_elt_at_index (l2input_main.bd_configs, bd_index);
+  bd_config->learn_rate = rate;
+}
+
 /**
     Set the tag for the bridge domain.
 */
@@ -689,6 +703,56 @@ VLIB_CLI_COMMAND (bd_mac_age_cli, static) = {
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+bd_learn_rate (vlib_main_t * vm,
+	       unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  bd_main_t *bdm = &bd_main;
+  u32 bd_id, rate;
+  uword *p;
+
+  if (!unformat (input, "%d", &bd_id))
+    return clib_error_return (0, "expecting bridge-domain id but got `%U'",
+			      format_unformat_error, input);
+
+  if (bd_id == 0)
+    return clib_error_return (0,
+			      "No operations on the default bridge domain are supported");
+
+  p = hash_get (bdm->bd_index_by_bd_id, bd_id);
+
+  if (p == 0)
+    return clib_error_return (0, "No such bridge domain %d", bd_id);
+
+  if (!unformat (input, "%u", &rate))
+    return clib_error_return (0, "expecting MACs per second but got `%U'",
+			      format_unformat_error, input);
+
+  bd_set_learn_rate (vm, p[0], rate);
+  return 0;
+}
+
+/*?
+ * Limit the number of MACs learned or moved per second in a
+ * bridge-domain, to protect the mac table from MAC churn. Refreshes of
+ * known MACs are not limited. Bursts of up to one second worth of MACs
+ * are allowed. There is no limit by default.
+ *
+ * @cliexpar
+ * Example of how to limit learning to 1000 MACs per second (where 200 is
+ * the bridge-domain-id):
+ * @cliexcmd{set bridge-domain learn-rate 200 1000}
+ * Example of how to remove the limit:
+ * @cliexcmd{set bridge-domain learn-rate 200 0}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (bd_learn_rate_cli, static) = {
+  .path = "set bridge-domain learn-rate",
+  .short_help = "set bridge-domain learn-rate <bridge-domain-id> <macs/sec>",
+  .function = bd_learn_rate,
+};
+/* *INDENT-ON* */
+
 /*?
  * Modify whether or not an existing bridge-domain should terminate and respond
  * to ARP Requests. ARP Termination is disabled by default.
@@ -1018,6 +1082,10 @@ bd_show (vlib_main_t * vm, unformat_input_t * input, vlib_cli_command_t * cmd)
 			   vnm, bd_config->bvi_sw_if_index);
 	  vec_reset_length (as);
 
+	  if (detail && bd_config->learn_rate)
+	    vlib_cli_output (vm, "\n  Learn rate: %u MACs/sec",
+			     bd_config->learn_rate);
+
 	  if (detail || intf)
 	    {
 	      /* Show all member interfaces */
@@ -121,6 +121,18 @@ l2fib_table_dump (u32 bd_index, l2fib_entry_key_t ** l2fe_key,
     }
 }
 
+static u8 *
+format_l2fib_age_scan_hist (u8 * s, va_list * args)
+{
+  l2fib_main_t *fm = &l2fib_main;
+  int i;
+
+  for (i = 0; i < L2FIB_AGE_SCAN_HIST_SIZE; i++)
+    if (fm->age_scan_hist[i])
+      s = format (s, " <%lluus:%u", 1ULL << i, fm->age_scan_hist[i]);
+  return s;
+}
+
 /** Display the contents of the l2fib. */
 static clib_error_t *
 show_l2fib (vlib_main_t * vm,
@@ -247,6 +259,8 @@ show_l2fib (vlib_main_t * vm,
 		       "Last scan time: %.4esec  Learn limit: %d ",
 		       total_entries, lm->global_learn_count,
 		       msm->age_scan_duration, lm->global_learn_limit);
+      vlib_cli_output (vm, "Age scan: last %u MACs, time histogram %U",
+		       msm->age_scan_n_macs, format_l2fib_age_scan_hist);
       if (lm->client_pid)
 	vlib_cli_output (vm, "L2MAC events client PID: %d  "
 			 "Last e-scan time: %.4esec  Delay: %.2esec  "
@@ -299,11 +313,24 @@ l2fib_clear_table (void)
 {
   l2fib_main_t *mp = &l2fib_main;
 
+  l2fib_bd_age_t **bap;
+  int i;
+
   /* Remove all entries */
   BV (clib_bihash_free) (&mp->mac_table);
   BV (clib_bihash_init) (&mp->mac_table, "l2fib mac table",
 			 L2FIB_NUM_BUCKETS, L2FIB_MEMORY_SIZE);
   l2learn_main.global_learn_count = 0;
+
+  /* and the ager wheels */
+  vec_foreach (bap, mp->age_by_bd)
+  {
+    if (!bap[0])
+      continue;
+    for (i = 0; i < L2FIB_AGE_WHEEL_SIZE; i++)
+      vec_reset_length (bap[0]->wheel[i]);
+    vec_reset_length (bap[0]->unaged);
+  }
 }
 
 /** Clear all entries in L2FIB.
@@ -767,7 +794,17 @@ l2fib_start_ager_scan (vlib_main_t * vm)
 void
 l2fib_flush_int_mac (vlib_main_t * vm, u32 sw_if_index)
 {
+  l2fib_main_t *fm = &l2fib_main;
+  l2_input_config_t *config = l2input_intf_config (sw_if_index);
+
   *l2fib_swif_seq_num (sw_if_index) += 1;
+
+  /* only the bd of the interface holds its MACs */
+  if (config->bridge)
+    fm->age_flush_bds = clib_bitmap_set (fm->age_flush_bds,
+					 config->bd_index, 1);
+  else
+    fm->age_flush_all = 1;
   l2fib_start_ager_scan (vm);
 }
 
@@ -777,8 +814,10 @@ l2fib_flush_int_mac (vlib_main_t * vm, u32 sw_if_index)
 void
 l2fib_flush_bd_mac (vlib_main_t * vm, u32 bd_index)
 {
+  l2fib_main_t *fm = &l2fib_main;
   l2_bridge_domain_t *bd_config = l2input_bd_config (bd_index);
   bd_config->seq_num += 1;
+  fm->age_flush_bds = clib_bitmap_set (fm->age_flush_bds, bd_index, 1);
   l2fib_start_ager_scan (vm);
 }
 
@@ -788,11 +827,13 @@ l2fib_flush_bd_mac (vlib_main_t * vm, u32 bd_index)
 void
 l2fib_flush_all_mac (vlib_main_t * vm)
 {
+  l2fib_main_t *fm = &l2fib_main;
   l2_bridge_domain_t *bd_config;
   vec_foreach (bd_config, l2input_main.bd_configs)
     if (bd_is_valid (bd_config))
     bd_config->seq_num += 1;
 
+  fm->age_flush_all = 1;
   l2fib_start_ager_scan (vm);
 }
 
@@ -934,6 +975,16 @@ BVT (clib_bihash) * get_mac_table (void)
   return &mp->mac_table;
 }
 
+/* L2 MAC event message being filled for the event client */
+typedef struct
+{
+  vl_api_l2_macs_event_t *mp;
+  vl_api_registration_t *reg;
+  u32 client;
+  u32 client_index;
+  u32 n_macs;
+} l2fib_mac_evt_t;
+
 static_always_inline void *
 allocate_mac_evt_buf (u32 client, u32 client_index)
 {
@@ -946,8 +997,313 @@ allocate_mac_evt_buf (u32 client, u32 client_index)
   return mp;
 }
 
+static void
+l2fib_mac_evt_init (l2fib_mac_evt_t * e)
+{
+  l2learn_main_t *lm = &l2learn_main;
+
+  memset (e, 0, sizeof (*e));
+  e->client = lm->client_pid;
+  e->client_index = lm->client_index;
+  if (e->client)
+    {
+      e->mp = allocate_mac_evt_buf (e->client, lm->client_index);
+      e->reg = vl_api_client_index_to_registration (lm->client_index);
+    }
+}
+
+static void
+l2fib_mac_evt_add (l2fib_mac_evt_t * e, l2fib_entry_key_t * key,
+		   u32 sw_if_index, u8 is_del)
+{
+  l2fib_main_t *fm = &l2fib_main;
+
+  if (PREDICT_FALSE (e->n_macs >= fm->max_macs_in_event))
+    {
+      /* event message full, send it and start a new one */
+      if (e->reg && vl_api_can_send_msg (e->reg))
+	{
+	  e->mp->n_macs = htonl (e->n_macs);
+	  vl_api_send_msg (e->reg, (u8 *) e->mp);
+	  e->mp = allocate_mac_evt_buf (e->client, e->client_index);
+	}
+      else
+	{
+	  if (e->reg)
+	    clib_warning ("MAC event to pid %d queue stuffed!"
+			  " %d MAC entries lost", e->client, e->n_macs);
+	}
+      e->n_macs = 0;
+    }
+
+  /* copy mac entry to event msg */
+  clib_memcpy (e->mp->mac[e->n_macs].mac_addr, key->fields.mac, 6);
+  e->mp->mac[e->n_macs].is_del = is_del;
+  e->mp->mac[e->n_macs].sw_if_index = htonl (sw_if_index);
+  e->n_macs++;
+}
+
+static void
+l2fib_mac_evt_send (l2fib_mac_evt_t * e)
+{
+  if (!e->mp)
+    return;
+
+  /*  send any outstanding mac event message else free message buffer */
+  if (e->n_macs)
+    {
+      if (e->reg && vl_api_can_send_msg (e->reg))
+	{
+	  e->mp->n_macs = htonl (e->n_macs);
+	  vl_api_send_msg (e->reg, (u8 *) e->mp);
+	  e->mp = 0;
+	}
+      else if (e->reg)
+	clib_warning ("MAC event to pid %d queue stuffed!"
+		      " %d MAC entries lost", e->client, e->n_macs);
+    }
+  if (e->mp)
+    vl_msg_api_free (e->mp);
+  e->mp = 0;
+}
+
+static void
+l2fib_age_scan_record (f64 duration)
+{
+  l2fib_main_t *fm = &l2fib_main;
+  u64 usec = duration * 1e6;
+  u32 i = usec ? min_log2 (usec) + 1 : 0;
+
+  fm->age_scan_duration = duration;
+  fm->age_scan_hist[clib_min (i, L2FIB_AGE_SCAN_HIST_SIZE - 1)]++;
+}
+
+static l2fib_bd_age_t *
+l2fib_bd_age (u32 bd_index)
+{
+  l2fib_main_t *fm = &l2fib_main;
+
+  vec_validate (fm->age_by_bd, bd_index);
+  if (PREDICT_FALSE (fm->age_by_bd[bd_index] == 0))
+    {
+      l2fib_bd_age_t *ba = clib_mem_alloc (sizeof (*ba));
+      memset (ba, 0, sizeof (*ba));
+      fm->age_by_bd[bd_index] = ba;
+    }
+  return fm->age_by_bd[bd_index];
+}
+
+/* File a learned MAC on the wheel of its bd, in the slot of the minute it
+   ages out, or on the unaged list if the bd does not age */
+static void
+l2fib_age_file (l2fib_entry_key_t * key, l2fib_entry_result_t * result,
+		u8 now)
+{
+  l2_bridge_domain_t *bd_config = l2input_bd_config (key->fields.bd_index);
+  l2fib_bd_age_t *ba = l2fib_bd_age (key->fields.bd_index);
+  u8 age = bd_config->mac_age;
+  u8 delta = now - result->fields.timestamp;
+
+  if (age == 0)
+    vec_add1 (ba->unaged, key->raw);
+  else if (delta >= age)
+    vec_add1 (ba->wheel[(u8) (now + 1)], key->raw);
+  else
+    vec_add1 (ba->wheel[(u8) (result->fields.timestamp + age)], key->raw);
+}
+
+/* Age out one learned MAC if it is due or stale, file it again otherwise */
+static void
+l2fib_age_one (l2fib_mac_evt_t * evt, u64 raw_key, u8 now)
+{
+  l2fib_main_t *fm = &l2fib_main;
+  l2fib_entry_key_t key = {.raw = raw_key };
+  l2fib_entry_result_t result;
+  l2_bridge_domain_t *bd_config;
+  BVT (clib_bihash_kv) kv;
+  u8 delta;
+
+  kv.key = raw_key;
+  if (BV (clib_bihash_search) (&fm->mac_table, &kv, &kv))
+    return;			/* deleted meanwhile */
+
+  result.raw = kv.value;
+  if (result.fields.age_not)
+    return;			/* provisioned meanwhile */
+
+  if (result.fields.sn.as_u16 !=
+      l2fib_cur_seq_num (key.fields.bd_index,
+			 result.fields.sw_if_index).as_u16)
+    goto age_out;		/* stale mac */
+
+  bd_config = l2input_bd_config (key.fields.bd_index);
+  delta = now - result.fields.timestamp;
+  if (bd_config->mac_age == 0 || delta < bd_config->mac_age)
+    {
+      l2fib_age_file (&key, &result, now);
+      return;
+    }
+
+age_out:
+  if (evt->client)
+    l2fib_mac_evt_add (evt, &key, result.fields.sw_if_index, 1);
+  BV (clib_bihash_add_del) (&fm->mac_table, &kv, 0);
+  if (l2learn_main.global_learn_count)
+    l2learn_main.global_learn_count--;
+}
+
+static int
+l2fib_key_cmp (void *a1, void *a2)
+{
+  u64 *k1 = a1, *k2 = a2;
+
+  return *k1 < *k2 ? -1 : *k1 > *k2;
+}
+
+/* Age the MACs of a wheel slot, or of the whole bd when flushing or when
+   its mac_age changed. Keys are sorted so copies filed twice collapse.
+   Returns the time spent, pausing 100us after every 20us of work. */
+static f64
+l2fib_age_sweep_bd (vlib_main_t * vm, l2fib_mac_evt_t * evt,
+		    l2fib_bd_age_t * ba, u32 slot, u8 now, u64 ** keysp)
+{
+  l2fib_main_t *fm = &l2fib_main;
+  f64 last_start = vlib_time_now (vm), accum_t = 0, delta_t;
+  u64 *keys = *keysp, *k, prev = ~0ULL;
+  int i;
+
+  vec_reset_length (keys);
+  if (slot == ~0)
+    {
+      for (i = 0; i < L2FIB_AGE_WHEEL_SIZE; i++)
+	{
+	  vec_append (keys, ba->wheel[i]);
+	  vec_reset_length (ba->wheel[i]);
+	}
+      vec_append (keys, ba->unaged);
+      vec_reset_length (ba->unaged);
+    }
+  else
+    {
+      keys = ba->wheel[slot];
+      ba->wheel[slot] = *keysp;
+      vec_reset_length (ba->wheel[slot]);
+    }
+
+  vec_sort_with_function (keys, l2fib_key_cmp);
+
+  vec_foreach (k, keys)
+  {
+    if (*k == prev)
+      continue;
+    prev = *k;
+    l2fib_age_one (evt, *k, now);
+    fm->age_scan_n_macs++;
+
+    if (((k - keys) & 15) == 0)
+      {
+	/* allow no more than 20us without a pause */
+	delta_t = vlib_time_now (vm) - last_start;
+	if (delta_t > 20e-6)
+	  {
+	    vlib_process_suspend (vm, 100e-6);	/* suspend for 100 us */
+	    last_start = vlib_time_now (vm);
+	    accum_t += delta_t;
+	  }
+      }
+  }
+
+  *keysp = keys;
+  return accum_t + vlib_time_now (vm) - last_start;
+}
+
+/* Move the MACs learned by all threads onto the wheels */
+static void
+l2fib_age_drain (u8 now)
+{
+  l2fib_main_t *fm = &l2fib_main;
+  l2fib_learned_ring_t *r;
+
+  vec_foreach (r, fm->learned_rings)
+  {
+    u32 head = __atomic_load_n (&r->head, __ATOMIC_ACQUIRE);
+    u32 tail = r->tail;
+
+    for (; tail != head; tail++)
+      {
+	l2fib_entry_key_t key;
+	l2fib_entry_result_t result;
+	BVT (clib_bihash_kv) kv;
+
+	key.raw = kv.key = r->keys[tail & (L2FIB_LEARNED_RING_SIZE - 1)];
+	if (BV (clib_bihash_search) (&fm->mac_table, &kv, &kv))
+	  continue;
+	result.raw = kv.value;
+	if (result.fields.age_not)
+	  continue;
+	l2fib_age_file (&key, &result, now);
+      }
+    __atomic_store_n (&r->tail, tail, __ATOMIC_RELEASE);
+
+    if (__atomic_exchange_n (&r->overflow, 0, __ATOMIC_ACQUIRE))
+      fm->age_reindex = 1;
+  }
+}
+
+/* Sweep the wheel slots due since the last run and the bds to flush */
+static f64
+l2fib_age_sweep (vlib_main_t * vm, u8 now)
+{
+  l2fib_main_t *fm = &l2fib_main;
+  l2fib_mac_evt_t evt;
+  u64 *keys = 0;
+  f64 t = 0;
+  u32 bd_index;
+  u8 minute, flush_all = fm->age_flush_all;
+
+  fm->age_flush_all = 0;
+  l2fib_mac_evt_init (&evt);
+  fm->age_scan_n_macs = 0;
+
+  for (bd_index = 0; bd_index < vec_len (fm->age_by_bd); bd_index++)
+    {
+      l2fib_bd_age_t *ba = fm->age_by_bd[bd_index];
+      l2_bridge_domain_t *bd_config;
+
+      if (!ba)
+	continue;
+
+      bd_config = l2input_bd_config (bd_index);
+      if (flush_all || clib_bitmap_get (fm->age_flush_bds, bd_index) ||
+	  ba->mac_age != bd_config->mac_age)
+	{
+	  fm->age_flush_bds = clib_bitmap_set (fm->age_flush_bds,
+					       bd_index, 0);
+	  ba->mac_age = bd_config->mac_age;
+	  t += l2fib_age_sweep_bd (vm, &evt, ba, ~0, now, &keys);
+	  continue;
+	}
+
+      if (bd_config->mac_age == 0)
+	continue;
+
+      /* slots of the minutes since the last sweep, the current one last */
+      minute = fm->age_minute;
+      while (minute != now)
+	{
+	  minute++;
+	  t += l2fib_age_sweep_bd (vm, &evt, ba, minute, now, &keys);
+	}
+    }
+
+  fm->age_minute = now;
+  l2fib_mac_evt_send (&evt);
+  vec_free (keys);
+  return t;
+}
+
 static_always_inline f64
-l2fib_scan (vlib_main_t * vm, f64 start_time, u8 event_only)
+l2fib_scan (vlib_main_t * vm, f64 start_time, u8 reindex)
 {
   l2fib_main_t *fm = &l2fib_main;
   l2learn_main_t *lm = &l2learn_main;
@@ -957,17 +1313,25 @@ l2fib_scan (vlib_main_t * vm, f64 start_time, u8 event_only)
   f64 last_start = start_time;
   f64 accum_t = 0;
   f64 delta_t = 0;
-  u32 evt_idx = 0;
   u32 learn_count = 0;
-  u32 client = lm->client_pid;
-  u32 cl_idx = lm->client_index;
-  vl_api_l2_macs_event_t *mp = 0;
-  vl_api_registration_t *reg = 0;
+  u8 now = (u8) (start_time / 60);
+  l2fib_mac_evt_t evt;
+
+  l2fib_mac_evt_init (&evt);
 
-  if (client)
+  if (reindex)
     {
-      mp = allocate_mac_evt_buf (client, cl_idx);
-      reg = vl_api_client_index_to_registration (lm->client_index);
+      l2fib_bd_age_t **bap;
+
+      vec_foreach (bap, fm->age_by_bd)
+      {
+	if (!bap[0])
+	  continue;
+	for (i = 0; i < L2FIB_AGE_WHEEL_SIZE; i++)
+	  vec_reset_length (bap[0]->wheel[i]);
+	vec_reset_length (bap[0]->unaged);
+      }
+      fm->age_reindex = 0;
     }
 
   for (i = 0; i < h->nbuckets; i++)
@@ -1008,121 +1372,50 @@ l2fib_scan (vlib_main_t * vm, f64 start_time, u8 event_only)
 	      l2fib_entry_key_t key = {.raw = v->kvp[k].key };
 	      l2fib_entry_result_t result = {.raw = v->kvp[k].value };
 
-	      if (result.fields.age_not == 0)
-		learn_count++;
-
-	      if (client)
-		{
-		  if (PREDICT_FALSE (evt_idx >= fm->max_macs_in_event))
-		    {
-		      /* event message full, send it and start a new one */
-		      if (reg && vl_api_can_send_msg (reg))
-			{
-			  mp->n_macs = htonl (evt_idx);
-			  vl_api_send_msg (reg, (u8 *) mp);
-			  mp = allocate_mac_evt_buf (client, cl_idx);
-			}
-		      else
-			{
-			  if (reg)
-			    clib_warning ("MAC event to pid %d queue stuffed!"
-					  " %d MAC entries lost", client,
-					  evt_idx);
-			}
-		      evt_idx = 0;
-		    }
-
-		  if (result.fields.lrn_evt)
-		    {
-		      /* copy mac entry to event msg */
-		      clib_memcpy (mp->mac[evt_idx].mac_addr, key.fields.mac,
-				   6);
-		      mp->mac[evt_idx].is_del = 0;
-		      mp->mac[evt_idx].sw_if_index =
-			htonl (result.fields.sw_if_index);
-		      /* clear event bit and update mac entry */
-		      result.fields.lrn_evt = 0;
-		      BVT (clib_bihash_kv) kv;
-		      kv.key = key.raw;
-		      kv.value = result.raw;
-		      BV (clib_bihash_add_del) (&fm->mac_table, &kv, 1);
-		      evt_idx++;
-		      continue;	/* skip aging */
-		    }
-		}
-
-	      if (event_only || result.fields.age_not)
-		continue;	/* skip aging - static_mac alsways age_not */
-
-	      /* start aging processing */
-	      u32 bd_index = key.fields.bd_index;
-	      u32 sw_if_index = result.fields.sw_if_index;
-	      u16 sn = l2fib_cur_seq_num (bd_index, sw_if_index).as_u16;
-	      if (result.fields.sn.as_u16 != sn)
-		goto age_out;	/* stale mac */
+	      if (result.fields.age_not)
+		continue;	/* static_mac alsways age_not */
 
-	      l2_bridge_domain_t *bd_config =
-		vec_elt_at_index (l2input_main.bd_configs, bd_index);
+	      learn_count++;
 
-	      if (bd_config->mac_age == 0)
-		continue;	/* skip aging */
+	      if (reindex)
+		l2fib_age_file (&key, &result, now);
 
-	      i16 delta = (u8) (start_time / 60) - result.fields.timestamp;
-	      delta += delta < 0 ? 256 : 0;
-
-	      if (delta < bd_config->mac_age)
-		continue;	/* still valid */
-
-	    age_out:
-	      if (client)
+	      if (evt.client && result.fields.lrn_evt)
 		{
-		  /* copy mac entry to event msg */
-		  clib_memcpy (mp->mac[evt_idx].mac_addr, key.fields.mac, 6);
-		  mp->mac[evt_idx].is_del = 1;
-		  mp->mac[evt_idx].sw_if_index =
-		    htonl (result.fields.sw_if_index);
-		  evt_idx++;
+		  l2fib_mac_evt_add (&evt, &key, result.fields.sw_if_index,
+				     0);
+		  /* clear event bit and update mac entry */
+		  result.fields.lrn_evt = 0;
+		  BVT (clib_bihash_kv) kv;
+		  kv.key = key.raw;
+		  kv.value = result.raw;
+		  BV (clib_bihash_add_del) (&fm->mac_table, &kv, 1);
 		}
-	      /* delete mac entry */
-	      BVT (clib_bihash_kv) kv;
-	      kv.key = key.raw;
-	      BV (clib_bihash_add_del) (&fm->mac_table, &kv, 0);
-	      learn_count--;
 	    }
 	  v++;
 	}
     }
 
   /* keep learn count consistent */
-  l2learn_main.global_learn_count = learn_count;
+  lm->global_learn_count = learn_count;
 
-  if (mp)
-    {
-      /*  send any outstanding mac event message else free message buffer */
-      if (evt_idx)
-	{
-	  if (reg && vl_api_can_send_msg (reg))
-	    {
-	      mp->n_macs = htonl (evt_idx);
-	      vl_api_send_msg (reg, (u8 *) mp);
-	    }
-	  else
-	    {
-	      if (reg)
-		clib_warning ("MAC event to pid %d queue stuffed!"
-			      " %d MAC entries lost", client, evt_idx);
-	      vl_msg_api_free (mp);
-	    }
-	}
-      else
-	vl_msg_api_free (mp);
-    }
+  l2fib_mac_evt_send (&evt);
   return delta_t + accum_t;
 }
 
-/* Maximum f64 value */
-#define TIME_MAX (1.7976931348623157e+308)
-
+/*
+ * MAC aging without walking the whole table.
+ *
+ * Threads queue the keys of the MACs they learn on per thread rings. The
+ * ager files them on the wheel of their bridge domain, in the slot of the
+ * minute they are due to age out. Every minute only the due slot of each
+ * bd is looked at: MACs seen since are filed again, the others deleted.
+ * A flush only sweeps the wheels of the bds concerned. If a ring
+ * overflowed the wheels are rebuilt from a full table scan.
+ *
+ * MAC learn events for the event client still come from a full scan
+ * every event_scan_delay.
+ */
 static uword
 l2fib_mac_age_scanner_process (vlib_main_t * vm, vlib_node_runtime_t * rt,
 			       vlib_frame_t * f)
@@ -1130,68 +1423,37 @@ l2fib_mac_age_scanner_process (vlib_main_t * vm, vlib_node_runtime_t * rt,
   uword event_type, *event_data = 0;
   l2fib_main_t *fm = &l2fib_main;
   l2learn_main_t *lm = &l2learn_main;
-  bool enabled = 0;
-  f64 start_time, next_age_scan_time = TIME_MAX;
+  f64 start_time, next_evt_scan_time = 0;
+  u8 now;
+
+  fm->age_minute = (u8) (vlib_time_now (vm) / 60);
 
   while (1)
     {
-      if (lm->client_pid)
-	vlib_process_wait_for_event_or_clock (vm, fm->event_scan_delay);
-      else if (enabled)
-	{
-	  f64 t = next_age_scan_time - vlib_time_now (vm);
-	  vlib_process_wait_for_event_or_clock (vm, t);
-	}
-      else
-	vlib_process_wait_for_event (vm);
+      vlib_process_wait_for_event_or_clock (vm, lm->client_pid ?
+					    fm->event_scan_delay :
+					    L2FIB_AGE_DRAIN_INTERVAL);
 
+      /* START, STOP and ONE_PASS all mean the aging or flush config
+         changed, which the sweep picks up from the bds */
       event_type = vlib_process_get_events (vm, &event_data);
       vec_reset_length (event_data);
 
       start_time = vlib_time_now (vm);
-      enum
-      { SCAN_MAC_AGE, SCAN_MAC_EVENT, SCAN_DISABLE } scan = SCAN_MAC_AGE;
+      now = (u8) (start_time / 60);
 
-      switch (event_type)
-	{
-	case ~0:		/* timer expired */
-	  if (lm->client_pid != 0 && start_time < next_age_scan_time)
-	    scan = SCAN_MAC_EVENT;
-	  break;
-
-	case L2_MAC_AGE_PROCESS_EVENT_START:
-	  enabled = 1;
-	  break;
-
-	case L2_MAC_AGE_PROCESS_EVENT_STOP:
-	  enabled = 0;
-	  scan = SCAN_DISABLE;
-	  break;
-
-	case L2_MAC_AGE_PROCESS_EVENT_ONE_PASS:
-	  break;
-
-	default:
-	  ASSERT (0);
-	}
+      l2fib_age_drain (now);
 
-      if (scan == SCAN_MAC_EVENT)
-	l2fib_main.evt_scan_duration = l2fib_scan (vm, start_time, 1);
-      else
+      if (fm->age_reindex)
+	l2fib_age_scan_record (l2fib_scan (vm, start_time, 1));
+      else if (lm->client_pid && start_time >= next_evt_scan_time)
 	{
-	  if (scan == SCAN_MAC_AGE)
-	    l2fib_main.age_scan_duration = l2fib_scan (vm, start_time, 0);
-	  if (scan == SCAN_DISABLE)
-	    {
-	      l2fib_main.age_scan_duration = 0;
-	      l2fib_main.evt_scan_duration = 0;
-	    }
-	  /* schedule next scan */
-	  if (enabled)
-	    next_age_scan_time = start_time + L2FIB_AGE_SCAN_INTERVAL;
-	  else
-	    next_age_scan_time = TIME_MAX;
+	  fm->evt_scan_duration = l2fib_scan (vm, start_time, 0);
+	  next_evt_scan_time = start_time + fm->event_scan_delay;
 	}
+
+      if (now != fm->age_minute || event_type != ~0)
+	l2fib_age_scan_record (l2fib_age_sweep (vm, now));
     }
   return 0;
 }
@@ -1214,6 +1476,10 @@ l2fib_init (vlib_main_t * vm)
   mp->vlib_main = vm;
   mp->vnet_main = vnet_get_main ();
 
+  vec_validate_aligned (mp->learned_rings,
+			vlib_get_thread_main ()->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+
   /* Create the hash table  */
   BV (clib_bihash_init) (&mp->mac_table, "l2fib mac table",
 			 L2FIB_NUM_BUCKETS, L2FIB_MEMORY_SIZE);
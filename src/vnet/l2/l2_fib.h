@@ -39,6 +39,48 @@
 /* MAC event learn limit is 1000 unless specified by MAC event client */
 #define L2FIB_EVENT_LEARN_LIMIT_DEFAULT	(1000)
 
+/* Ager wakes up every second to pick up newly learned MACs */
+#define L2FIB_AGE_DRAIN_INTERVAL	(1.0)
+
+/* Newly learned MACs a thread can queue for the ager, power of 2 */
+#define L2FIB_LEARNED_RING_SIZE		(8 << 10)
+
+/* One wheel slot per value of the minute timestamp of an entry */
+#define L2FIB_AGE_WHEEL_SIZE		(256)
+
+/* Buckets of the age scan time histogram, bucket i counts scans that
+   took less than 2^i usec */
+#define L2FIB_AGE_SCAN_HIST_SIZE	(24)
+
+/*
+ * Learned MACs of a bridge domain, filed by the minute they are due to
+ * age out. Only the ager process touches it.
+ */
+typedef struct
+{
+  u64 *wheel[L2FIB_AGE_WHEEL_SIZE];
+
+  /* MACs learned while aging is off */
+  u64 *unaged;
+
+  /* mac_age the wheel is filed for */
+  u8 mac_age;
+} l2fib_bd_age_t;
+
+/*
+ * Keys of MACs a thread learned, waiting for the ager. Single producer
+ * (the thread) and single consumer (the ager). When full, keys are
+ * dropped and the ager re-indexes from the whole table.
+ */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u32 head;
+  volatile u32 tail;
+  volatile u32 overflow;
+  u64 keys[L2FIB_LEARNED_RING_SIZE];
+} l2fib_learned_ring_t;
+
 typedef struct
 {
 
@@ -52,6 +94,28 @@ typedef struct
   f64 evt_scan_duration;
   f64 age_scan_duration;
 
+  /* per thread MACs learned since the last ager run */
+  l2fib_learned_ring_t *learned_rings;
+
+  /* per bd ager state, allocated with the first learned MAC */
+  l2fib_bd_age_t **age_by_bd;
+
+  /* bds to sweep for flushed MACs */
+  uword *age_flush_bds;
+  u8 age_flush_all;
+
+  /* rebuild the wheels from the whole table */
+  u8 age_reindex;
+
+  /* minute up to which the wheels were swept */
+  u8 age_minute;
+
+  /* MACs looked at by the last age scan */
+  u32 age_scan_n_macs;
+
+  /* age scan time histogram */
+  u32 age_scan_hist[L2FIB_AGE_SCAN_HIST_SIZE];
+
   /* delay between event scans, default to 100 msec */
   f64 event_scan_delay;
 
@@ -426,6 +490,25 @@ l2fib_valid_swif_seq_num (u32 sw_if_index)
 
 BVT (clib_bihash) * get_mac_table (void);
 
+/** Queue a newly learned MAC for the ager */
+static_always_inline void
+l2fib_learned_key (u32 thread_index, u64 key)
+{
+  l2fib_learned_ring_t *r =
+    vec_elt_at_index (l2fib_main.learned_rings, thread_index);
+  u32 head = r->head;
+
+  if (PREDICT_FALSE (head - __atomic_load_n (&r->tail, __ATOMIC_ACQUIRE) >=
+		     L2FIB_LEARNED_RING_SIZE))
+    {
+      r->overflow = 1;
+      return;
+    }
+
+  r->keys[head & (L2FIB_LEARNED_RING_SIZE - 1)] = key;
+  __atomic_store_n (&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
 #endif
 
 /*
@@ -155,6 +155,8 @@ l2_input_classify_node_fn (vlib_main_t * vm,
   u32 hits = 0;
   u32 misses = 0;
   u32 chain_hits = 0;
+  vnet_classify_entry_t *entries[VLIB_FRAME_SIZE], **e;
+  u32 table_indices[VLIB_FRAME_SIZE], *ti;
   f64 now;
   u32 n_next_nodes;
 
@@ -231,7 +233,7 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  t0 = pool_elt_at_index (vcm->tables, table_index0);
 
 	  vnet_buffer (b0)->l2_classify.hash = hash0 =
-	    vnet_classify_hash_packet (t0, (u8 *) h0);
+	    vnet_classify_hash_packet_inline (t0, (u8 *) h0);
 	  vnet_classify_prefetch_bucket (t0, hash0);
 	}
 
@@ -245,7 +247,7 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  t1 = pool_elt_at_index (vcm->tables, table_index1);
 
 	  vnet_buffer (b1)->l2_classify.hash = hash1 =
-	    vnet_classify_hash_packet (t1, (u8 *) h1);
+	    vnet_classify_hash_packet_inline (t1, (u8 *) h1);
 	  vnet_classify_prefetch_bucket (t1, hash1);
 	}
 
@@ -289,16 +291,25 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  t0 = pool_elt_at_index (vcm->tables, table_index0);
 
 	  vnet_buffer (b0)->l2_classify.hash = hash0 =
-	    vnet_classify_hash_packet (t0, (u8 *) h0);
+	    vnet_classify_hash_packet_inline (t0, (u8 *) h0);
 	  vnet_classify_prefetch_bucket (t0, hash0);
 	}
       from++;
       n_left_from--;
     }
 
-  next_index = node->cached_next_index;
+  /* Second pass: walk the table chains */
   from = vlib_frame_vector_args (frame);
+  chain_hits = vnet_classify_find_entries_chained (vm, vcm, from,
+						   frame->n_vectors, entries,
+						   table_indices, now,
+						   1 /* from_current_data */ ,
+						   0 /* honor_data_flag */ );
+
+  next_index = node->cached_next_index;
   n_left_from = frame->n_vectors;
+  e = entries;
+  ti = table_indices;
 
   while (n_left_from > 0)
     {
@@ -312,33 +323,10 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  u32 bi0;
 	  vlib_buffer_t *b0;
 	  u32 next0 = ~0;	/* next l2 input feature, please... */
-	  ethernet_header_t *h0;
 	  u32 table_index0;
-	  u64 hash0;
 	  vnet_classify_table_t *t0;
 	  vnet_classify_entry_t *e0;
 
-	  if (PREDICT_TRUE (n_left_from > 2))
-	    {
-	      vlib_buffer_t *p2 = vlib_get_buffer (vm, from[2]);
-	      u64 phash2;
-	      u32 table_index2;
-	      vnet_classify_table_t *tp2;
-
-	      /*
-	       * Prefetch table entry two ahead. Buffer / data
-	       * were prefetched above...
-	       */
-	      table_index2 = vnet_buffer (p2)->l2_classify.table_index;
-
-	      if (PREDICT_TRUE (table_index2 != ~0))
-		{
-		  tp2 = pool_elt_at_index (vcm->tables, table_index2);
-		  phash2 = vnet_buffer (p2)->l2_classify.hash;
-		  vnet_classify_prefetch_entry (tp2, phash2);
-		}
-	    }
-
 	  /* speculatively enqueue b0 to the current next frame */
 	  bi0 = from[0];
 	  to_next[0] = bi0;
@@ -348,17 +336,15 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 	  n_left_to_next -= 1;
 
 	  b0 = vlib_get_buffer (vm, bi0);
-	  h0 = vlib_buffer_get_current (b0);
 	  table_index0 = vnet_buffer (b0)->l2_classify.table_index;
-	  e0 = 0;
+	  e0 = e[0];
+	  t0 = 0;
 	  vnet_buffer (b0)->l2_classify.opaque_index = ~0;
 
 	  if (PREDICT_TRUE (table_index0 != ~0))
 	    {
-	      hash0 = vnet_buffer (b0)->l2_classify.hash;
-	      t0 = pool_elt_at_index (vcm->tables, table_index0);
+	      t0 = pool_elt_at_index (vcm->tables, ti[0]);
 
-	      e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
 	      if (e0)
 		{
 		  vnet_buffer (b0)->l2_classify.opaque_index
@@ -370,36 +356,13 @@ l2_input_classify_node_fn (vlib_main_t * vm,
 		}
 	      else
 		{
-		  while (1)
-		    {
-		      if (t0->next_table_index != ~0)
-			t0 = pool_elt_at_index (vcm->tables,
-						t0->next_table_index);
-		      else
-			{
-			  next0 = (t0->miss_next_index < n_next_nodes) ?
-			    t0->miss_next_index : next0;
-			  misses++;
-			  break;
-			}
-
-		      hash0 = vnet_classify_hash_packet (t0, (u8 *) h0);
-		      e0 =
-			vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-		      if (e0)
-			{
-			  vnet_buffer (b0)->l2_classify.opaque_index
-			    = e0->opaque_index;
-			  vlib_buffer_advance (b0, e0->advance);
-			  next0 = (e0->next_index < n_next_nodes) ?
-			    e0->next_index : next0;
-			  hits++;
-			  chain_hits++;
-			  break;
-			}
-		    }
+		  next0 = (t0->miss_next_index < n_next_nodes) ?
+		    t0->miss_next_index : next0;
+		  misses++;
 		}
 	    }
+	  ti += 1;
+	  e += 1;
 
 	  if (PREDICT_FALSE (next0 == 0))
 	    b0->error = node->errors[L2_INPUT_CLASSIFY_ERROR_DROP];
@@ -28,6 +28,7 @@
 
 #include <vppinfra/error.h>
 #include <vppinfra/hash.h>
+#include <vppinfra/random.h>
 
 l2learn_main_t l2learn_main;
 
@@ -45,6 +46,14 @@ l2learn_main_t l2learn_main;
  * differ in certain cases (mac move tests), but this not expected to cause
  * problems in real-world networks. It is much simpler to separate learning
  * and forwarding into separate nodes.
+ *
+ * Only the main thread writes the mac table. Workers queue their learn
+ * updates (new MACs, moves and refreshes) on a per worker ring, which the
+ * l2-learn-update process drains every 100us while there is work and
+ * every 10ms otherwise. A MAC already queued by a worker and not written
+ * yet is not queued again, and of the updates of one drain only the last
+ * one per MAC is written. New and moved MACs can be rate limited per
+ * bridge domain.
  */
 
 
@@ -81,7 +90,9 @@ _(MAC_MOVE,          "L2 mac moves")			\
 _(MAC_MOVE_VIOLATE,  "L2 mac move violations")		\
 _(LIMIT,             "L2 not learned due to limit")	\
 _(HIT_UPDATE,        "L2 learn hit updates")		\
-_(FILTER_DROP,       "L2 filter mac drops")
+_(FILTER_DROP,       "L2 filter mac drops")		\
+_(RATE_LIMIT,        "L2 not learned due to bd learn rate")	\
+_(QUEUE_FULL,        "L2 learn updates dropped, queue full")
 
 typedef enum
 {
@@ -105,6 +116,201 @@ typedef enum
 } l2learn_next_t;
 
 
+/** Take a token from the learn rate bucket of a bridge domain. The
+    bucket holds up to one second worth of learns. */
+static_always_inline int
+l2learn_rate_ok (l2learn_main_t * msm, u32 bd_index, f64 now)
+{
+  l2_bridge_domain_t *bd_config = l2input_bd_config (bd_index);
+  l2learn_bd_rate_t *r;
+
+  if (PREDICT_TRUE (bd_config->learn_rate == 0))
+    return 1;
+
+  vec_validate (msm->rate_by_bd, bd_index);
+  r = vec_elt_at_index (msm->rate_by_bd, bd_index);
+  r->tokens += (now - r->last_time) * bd_config->learn_rate;
+  r->last_time = now;
+  if (r->tokens > bd_config->learn_rate)
+    r->tokens = bd_config->learn_rate;
+  if (r->tokens < 1)
+    return 0;
+
+  r->tokens -= 1;
+  return 1;
+}
+
+/**
+ * Write a learn update to the mac table. Main thread only. The entry
+ * is looked up again since it may have changed since the update was
+ * queued. Returns the error to count, or L2LEARN_N_ERROR.
+ */
+static_always_inline l2learn_error_t
+l2learn_write (l2learn_main_t * msm, l2learn_update_t * u, f64 now)
+{
+  l2fib_entry_key_t key;
+  l2fib_entry_result_t result;
+  BVT (clib_bihash_kv) kv;
+  u8 learned = 0;
+
+  key.raw = kv.key = u->key;
+  if (BV (clib_bihash_search) (msm->mac_table, &kv, &kv))
+    {
+      /* New MAC */
+      if (msm->global_learn_count >= msm->global_learn_limit)
+	return L2LEARN_ERROR_LIMIT;
+      if (!l2learn_rate_ok (msm, key.fields.bd_index, now))
+	return L2LEARN_ERROR_RATE_LIMIT;
+
+      msm->global_learn_count++;
+      learned = 1;
+      result.raw = 0;		/* clear all fields */
+      result.fields.sw_if_index = u->sw_if_index;
+      result.fields.lrn_evt = u->lrn_evt;
+    }
+  else
+    {
+      result.raw = kv.value;
+
+      /* Configured meanwhile, leave it alone */
+      if (result.fields.filter || result.fields.static_mac)
+	return L2LEARN_N_ERROR;
+
+      if (result.fields.sw_if_index == u->sw_if_index)
+	{
+	  /* Refresh, provisioned MACs are never refreshed */
+	  if (result.fields.age_not)
+	    return L2LEARN_N_ERROR;
+	}
+      else
+	{
+	  /* MAC move */
+	  if (!l2learn_rate_ok (msm, key.fields.bd_index, now))
+	    return L2LEARN_ERROR_RATE_LIMIT;
+
+	  result.fields.sw_if_index = u->sw_if_index;
+	  if (result.fields.age_not)	/* The mac was provisioned */
+	    {
+	      msm->global_learn_count++;
+	      result.fields.age_not = 0;
+	      learned = 1;
+	    }
+	  result.fields.lrn_evt = u->lrn_evt;
+	}
+    }
+
+  result.fields.timestamp = u->timestamp;
+  result.fields.sn.as_u16 = u->sn;
+
+  kv.key = u->key;
+  kv.value = result.raw;
+  BV (clib_bihash_add_del) (msm->mac_table, &kv, 1 /* is_add */ );
+
+  /* Let the ager know about the new MAC, once it is in the table */
+  if (learned)
+    l2fib_learned_key (vlib_get_thread_index (), u->key);
+
+  return L2LEARN_N_ERROR;
+}
+
+static_always_inline u32
+l2learn_filter_slot (u64 key)
+{
+  return clib_xxhash (key) & (L2LEARN_QUEUED_FILTER_SIZE - 1);
+}
+
+/**
+ * Queue a learn update of a worker for the writer. Returns 1 if queued,
+ * 0 if the same update is queued already, -1 if the ring is full.
+ */
+static_always_inline int
+l2learn_queue (l2learn_update_ring_t * r, l2learn_update_t * u)
+{
+  u32 head = r->head;
+  u32 tail = __atomic_load_n (&r->tail, __ATOMIC_ACQUIRE);
+  u32 slot = l2learn_filter_slot (u->key);
+
+  if (r->filter_key[slot] == u->key &&
+      r->filter_sw_if_index[slot] == u->sw_if_index &&
+      (i32) (r->filter_pos[slot] - tail) >= 0)
+    return 0;
+
+  if (PREDICT_FALSE (head - tail >= L2LEARN_UPDATE_RING_SIZE))
+    return -1;
+
+  r->updates[head & (L2LEARN_UPDATE_RING_SIZE - 1)] = *u;
+  r->filter_key[slot] = u->key;
+  r->filter_sw_if_index[slot] = u->sw_if_index;
+  r->filter_pos[slot] = head;
+  __atomic_store_n (&r->head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+/**
+ * Drain the update rings of all threads and write the updates, the last
+ * one of each MAC only. Tails move once the table is written, so a worker
+ * does not queue again a MAC whose update is in flight. Returns the
+ * number of updates drained.
+ */
+static u32
+l2learn_write_updates (vlib_main_t * vm, f64 now)
+{
+  l2learn_main_t *msm = &l2learn_main;
+  u32 n_errors[L2LEARN_N_ERROR] = { 0 };
+  l2learn_update_ring_t *r;
+  l2learn_update_t *u;
+  u32 n_updates;
+  int i;
+
+  vec_reset_length (msm->updates);
+  vec_reset_length (msm->update_heads);
+  vec_foreach (r, msm->update_rings)
+  {
+    u32 head = __atomic_load_n (&r->head, __ATOMIC_ACQUIRE);
+    u32 tail;
+
+    for (tail = r->tail; tail != head; tail++)
+      {
+	l2learn_update_t *ru =
+	  &r->updates[tail & (L2LEARN_UPDATE_RING_SIZE - 1)];
+	u32 slot = clib_xxhash (ru->key) & (vec_len (msm->update_by_slot) - 1);
+	u32 ui = msm->update_by_slot[slot];
+
+	/* a slot may point at a stale or other MAC, then just append */
+	if (ui < vec_len (msm->updates) && msm->updates[ui].key == ru->key)
+	  msm->updates[ui] = *ru;
+	else
+	  {
+	    msm->update_by_slot[slot] = vec_len (msm->updates);
+	    vec_add1 (msm->updates, *ru);
+	  }
+      }
+    vec_add1 (msm->update_heads, head);
+  }
+
+  vec_foreach (u, msm->updates)
+  {
+    l2learn_error_t error = l2learn_write (msm, u, now);
+    if (error != L2LEARN_N_ERROR)
+      n_errors[error] += 1;
+  }
+
+  n_updates = 0;
+  vec_foreach_index (i, msm->update_rings)
+  {
+    r = vec_elt_at_index (msm->update_rings, i);
+    n_updates += msm->update_heads[i] - r->tail;
+    __atomic_store_n (&r->tail, msm->update_heads[i], __ATOMIC_RELEASE);
+  }
+
+  for (i = 0; i < L2LEARN_N_ERROR; i++)
+    if (n_errors[i])
+      vlib_node_increment_counter (vm, l2learn_node.index, i, n_errors[i]);
+
+  return n_updates;
+}
+
+
 /** Perform learning on one packet based on the mac table lookup result. */
 
 static_always_inline void
@@ -168,10 +374,6 @@ l2learn_process (vlib_node_runtime_t * node,
 	return;
 
       /* It is ok to learn */
-      msm->global_learn_count++;
-      result0->raw = 0;		/* clear all fields */
-      result0->fields.sw_if_index = sw_if_index0;
-      result0->fields.lrn_evt = (msm->client_pid != 0);
     }
   else
     {
@@ -196,28 +398,30 @@ l2learn_process (vlib_node_runtime_t * node,
 	  return;
 	}
 
-      /*
-       * TODO: may want to rate limit mac moves
-       * TODO: check global/bridge domain/interface learn limits
-       */
-      result0->fields.sw_if_index = sw_if_index0;
-      if (result0->fields.age_not)	/* The mac was provisioned */
-	{
-	  msm->global_learn_count++;
-	  result0->fields.age_not = 0;
-	}
-      result0->fields.lrn_evt = (msm->client_pid != 0);
+      /* TODO: check interface learn limits */
       counter_base[L2LEARN_ERROR_MAC_MOVE] += 1;
     }
 
   /* Update the entry */
-  result0->fields.timestamp = timestamp;
-  result0->fields.sn.as_u16 = vnet_buffer (b0)->l2.l2fib_sn;
-
-  BVT (clib_bihash_kv) kv;
-  kv.key = key0->raw;
-  kv.value = result0->raw;
-  BV (clib_bihash_add_del) (msm->mac_table, &kv, 1 /* is_add */ );
+  l2learn_update_t u = {
+    .key = key0->raw,
+    .sw_if_index = sw_if_index0,
+    .sn = vnet_buffer (b0)->l2.l2fib_sn,
+    .timestamp = timestamp,
+    .lrn_evt = (msm->client_pid != 0),
+  };
+  u32 thread_index = vlib_get_thread_index ();
+
+  if (thread_index == 0)
+    {
+      l2learn_error_t error = l2learn_write (msm, &u,
+					     vlib_time_now (msm->vlib_main));
+      if (error != L2LEARN_N_ERROR)
+	counter_base[error] += 1;
+    }
+  else if (l2learn_queue (vec_elt_at_index (msm->update_rings, thread_index),
+			  &u) < 0)
+    counter_base[L2LEARN_ERROR_QUEUE_FULL] += 1;
 
   /* Invalidate the cache */
   cached_key->raw = ~0;
@@ -488,6 +692,8 @@ VLIB_NODE_FUNCTION_MULTIARCH (l2learn_node, l2learn_node_fn)
      clib_error_t *l2learn_init (vlib_main_t * vm)
 {
   l2learn_main_t *mp = &l2learn_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  l2learn_update_ring_t *r;
 
   mp->vlib_main = vm;
   mp->vnet_main = vnet_get_main ();
@@ -508,11 +714,49 @@ VLIB_NODE_FUNCTION_MULTIARCH (l2learn_node, l2learn_node_fn)
    */
   mp->global_learn_limit = L2LEARN_DEFAULT_LIMIT;
 
+  vec_validate_aligned (mp->update_rings, tm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+  vec_foreach (r, mp->update_rings)
+    memset (r->filter_key, 0xff, sizeof (r->filter_key));
+  vec_validate_init_empty (mp->update_by_slot,
+			   L2LEARN_UPDATE_RING_SIZE - 1, ~0);
+
   return 0;
 }
 
 VLIB_INIT_FUNCTION (l2learn_init);
 
+static uword
+l2learn_update_process (vlib_main_t * vm, vlib_node_runtime_t * rt,
+			vlib_frame_t * f)
+{
+  f64 interval = L2LEARN_WRITER_IDLE_INTERVAL;
+
+  /* without workers the main thread writes its own updates */
+  if (vlib_num_workers () == 0)
+    while (1)
+      {
+	vlib_process_wait_for_event (vm);
+	vlib_process_get_events (vm, 0);
+      }
+
+  while (1)
+    {
+      vlib_process_suspend (vm, interval);
+      interval = l2learn_write_updates (vm, vlib_time_now (vm)) ?
+	L2LEARN_WRITER_INTERVAL : L2LEARN_WRITER_IDLE_INTERVAL;
+    }
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (l2learn_update_process_node, static) = {
+  .function = l2learn_update_process,
+  .type = VLIB_NODE_TYPE_PROCESS,
+  .name = "l2-learn-update-process",
+};
+/* *INDENT-ON* */
+
 
 /**
  * Set subinterface learn enable/disable.
@@ -567,6 +811,117 @@ VLIB_CLI_COMMAND (int_learn_cli, static) = {
 };
 /* *INDENT-ON* */
 
+/**
+ * MAC churn benchmark. Updates for random MACs on random members of a
+ * bridge domain go through the update ring of the main thread, which
+ * l2-learn does not use, and are written the way the update process
+ * does. The MACs are flushed afterwards.
+ */
+static clib_error_t *
+test_l2learn_churn (vlib_main_t * vm,
+		    unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  l2learn_main_t *msm = &l2learn_main;
+  l2learn_update_ring_t *r = vec_elt_at_index (msm->update_rings, 0);
+  u32 bd_id = ~0, n_macs = 100000, n_updates = 10000000, seed = 0xdeadbeef;
+  u32 bd_index, n_queued = 0, learn_count, i;
+  l2_bridge_domain_t *bd_config;
+  l2fib_entry_key_t key;
+  u8 timestamp;
+  f64 t0, dt;
+  uword *p;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "bd %u", &bd_id))
+	;
+      else if (unformat (input, "macs %u", &n_macs))
+	;
+      else if (unformat (input, "updates %u", &n_updates))
+	;
+      else if (unformat (input, "seed %u", &seed))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  if (bd_id == ~0)
+    return clib_error_return (0, "bridge domain id required");
+  p = hash_get (bd_main.bd_index_by_bd_id, bd_id);
+  if (p == 0)
+    return clib_error_return (0, "No such bridge domain %d", bd_id);
+  bd_index = p[0];
+  bd_config = l2input_bd_config (bd_index);
+  if (vec_len (bd_config->members) == 0)
+    return clib_error_return (0, "bridge domain %d has no members", bd_id);
+  if (n_macs == 0)
+    return clib_error_return (0, "macs must be at least 1");
+
+  key.raw = 0;
+  key.fields.bd_index = bd_index;
+  key.fields.mac[0] = 0x02;	/* locally administered */
+  timestamp = (u8) (vlib_time_now (vm) / 60);
+  learn_count = msm->global_learn_count;
+
+  t0 = vlib_time_now (vm);
+  for (i = 0; i < n_updates; i++)
+    {
+      /* low bits of the generator have short periods */
+      u32 mac = clib_host_to_net_u32 ((random_u32 (&seed) >> 8) % n_macs);
+      l2_flood_member_t *m = vec_elt_at_index
+	(bd_config->members,
+	 (random_u32 (&seed) >> 8) % vec_len (bd_config->members));
+      l2fib_seq_num_t sn = {
+	.swif = *l2fib_swif_seq_num (m->sw_if_index),
+	.bd = bd_config->seq_num,
+      };
+      l2learn_update_t u;
+      int rv;
+
+      clib_memcpy (&key.fields.mac[2], &mac, sizeof (mac));
+      u.key = key.raw;
+      u.sw_if_index = m->sw_if_index;
+      u.sn = sn.as_u16;
+      u.timestamp = timestamp;
+      u.lrn_evt = 0;
+
+      while ((rv = l2learn_queue (r, &u)) < 0)
+	l2learn_write_updates (vm, vlib_time_now (vm));
+      n_queued += rv;
+    }
+  l2learn_write_updates (vm, vlib_time_now (vm));
+  dt = vlib_time_now (vm) - t0;
+
+  vlib_cli_output (vm, "%u updates of %u MACs on %u interfaces in %.3f sec, "
+		   "%.2f M updates/sec", n_updates, n_macs,
+		   vec_len (bd_config->members), dt, n_updates / dt / 1e6);
+  vlib_cli_output (vm, "%u queued, %u learned", n_queued,
+		   msm->global_learn_count - learn_count);
+
+  l2fib_flush_bd_mac (vm, bd_index);
+  return 0;
+}
+
+/*?
+ * Benchmark the learning of MACs moving between the member interfaces of
+ * a bridge domain. The learned MACs are flushed once done, use a bridge
+ * domain of its own.
+ *
+ * The elapsed time and update rate are printed, with the number of
+ * updates queued to the writer and of MACs learned.
+ *
+ * @cliexpar
+ * @cliexcmd{test l2learn churn bd 1 macs 1000 updates 1000000}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_l2learn_churn_cli, static) = {
+  .path = "test l2learn churn",
+  .short_help = "test l2learn churn bd <bd-id> [macs <n>] [updates <n>] "
+    "[seed <n>]",
+  .function = test_l2learn_churn,
+};
+/* *INDENT-ON* */
 
 static clib_error_t *
 l2learn_config (vlib_main_t * vm, unformat_input_t * input)
@@ -21,6 +21,49 @@
 #include <vlib/vlib.h>
 #include <vnet/ethernet/ethernet.h>
 
+/* Learn updates a worker can queue for the main thread, power of 2 */
+#define L2LEARN_UPDATE_RING_SIZE	(16 << 10)
+
+/* Slots of the per worker filter of queued updates, power of 2 */
+#define L2LEARN_QUEUED_FILTER_SIZE	(512)
+
+/* Writer poll interval while workers learn, and once they are quiet */
+#define L2LEARN_WRITER_INTERVAL		(100e-6)
+#define L2LEARN_WRITER_IDLE_INTERVAL	(10e-3)
+
+/* A new, moved or refreshed MAC to write to the l2fib */
+typedef struct
+{
+  u64 key;
+  u32 sw_if_index;
+  u16 sn;
+  u8 timestamp;
+  u8 lrn_evt;
+} l2learn_update_t;
+
+/*
+ * Learn updates of a worker. Single producer (the worker) and single
+ * consumer (the writer process on the main thread). The filter remembers
+ * the ring position of the last update queued for a MAC, so a MAC seen
+ * again before the writer got to it is not queued twice.
+ */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u32 head;
+  volatile u32 tail;
+  u64 filter_key[L2LEARN_QUEUED_FILTER_SIZE];
+  u32 filter_sw_if_index[L2LEARN_QUEUED_FILTER_SIZE];
+  u32 filter_pos[L2LEARN_QUEUED_FILTER_SIZE];
+  l2learn_update_t updates[L2LEARN_UPDATE_RING_SIZE];
+} l2learn_update_ring_t;
+
+/* Learn rate token bucket of a bridge domain, writer only */
+typedef struct
+{
+  f64 tokens;
+  f64 last_time;
+} l2learn_bd_rate_t;
 
 typedef struct
 {
@@ -38,6 +81,18 @@ typedef struct
   u32 client_pid;
   u32 client_index;
 
+  /* per thread learn updates, the main thread writes its own directly */
+  l2learn_update_ring_t *update_rings;
+
+  /* writer scratch: updates of one pass, per slot the last update of
+     the pass for a MAC, ring heads the pass drained up to */
+  l2learn_update_t *updates;
+  u32 *update_by_slot;
+  u32 *update_heads;
+
+  /* per bd learn rate state */
+  l2learn_bd_rate_t *rate_by_bd;
+
   /* Next nodes for each feature */
   u32 feat_next_node_index[32];
 
@@ -522,6 +522,8 @@ policer_classify_inline (vlib_main_t * vm,
   u32 misses = 0;
   u32 chain_hits = 0;
   u32 drop = 0;
+  vnet_classify_entry_t *entries[VLIB_FRAME_SIZE], **e;
+  u32 table_indices[VLIB_FRAME_SIZE], *ti;
   u32 n_next_nodes;
   u64 time_in_policer_periods;
 
@@ -577,12 +579,12 @@ policer_classify_inline (vlib_main_t * vm,
       t1 = pool_elt_at_index (vcm->tables, table_index1);
 
       vnet_buffer (b0)->l2_classify.hash =
-	vnet_classify_hash_packet (t0, (u8 *) h0);
+	vnet_classify_hash_packet_inline (t0, (u8 *) h0);
 
       vnet_classify_prefetch_bucket (t0, vnet_buffer (b0)->l2_classify.hash);
 
       vnet_buffer (b1)->l2_classify.hash =
-	vnet_classify_hash_packet (t1, (u8 *) h1);
+	vnet_classify_hash_packet_inline (t1, (u8 *) h1);
 
       vnet_classify_prefetch_bucket (t1, vnet_buffer (b1)->l2_classify.hash);
 
@@ -613,7 +615,7 @@ policer_classify_inline (vlib_main_t * vm,
 
       t0 = pool_elt_at_index (vcm->tables, table_index0);
       vnet_buffer (b0)->l2_classify.hash =
-	vnet_classify_hash_packet (t0, (u8 *) h0);
+	vnet_classify_hash_packet_inline (t0, (u8 *) h0);
 
       vnet_buffer (b0)->l2_classify.table_index = table_index0;
       vnet_classify_prefetch_bucket (t0, vnet_buffer (b0)->l2_classify.hash);
@@ -622,9 +624,18 @@ policer_classify_inline (vlib_main_t * vm,
       n_left_from--;
     }
 
-  next_index = node->cached_next_index;
+  /* Second pass: walk the table chains */
   from = vlib_frame_vector_args (frame);
+  chain_hits = vnet_classify_find_entries_chained (vm, vcm, from,
+						   frame->n_vectors, entries,
+						   table_indices, now,
+						   0 /* from_current_data */ ,
+						   0 /* honor_data_flag */ );
+
+  next_index = node->cached_next_index;
   n_left_from = frame->n_vectors;
+  e = entries;
+  ti = table_indices;
 
   while (n_left_from > 0)
     {
@@ -641,28 +652,8 @@ policer_classify_inline (vlib_main_t * vm,
 	  u32 table_index0;
 	  vnet_classify_table_t *t0;
 	  vnet_classify_entry_t *e0;
-	  u64 hash0;
-	  u8 *h0;
 	  u8 act0;
 
-	  /* Stride 3 seems to work best */
-	  if (PREDICT_TRUE (n_left_from > 3))
-	    {
-	      vlib_buffer_t *p1 = vlib_get_buffer (vm, from[3]);
-	      vnet_classify_table_t *tp1;
-	      u32 table_index1;
-	      u64 phash1;
-
-	      table_index1 = vnet_buffer (p1)->l2_classify.table_index;
-
-	      if (PREDICT_TRUE (table_index1 != ~0))
-		{
-		  tp1 = pool_elt_at_index (vcm->tables, table_index1);
-		  phash1 = vnet_buffer (p1)->l2_classify.hash;
-		  vnet_classify_prefetch_entry (tp1, phash1);
-		}
-	    }
-
 	  /* Speculatively enqueue b0 to the current next frame */
 	  bi0 = from[0];
 	  to_next[0] = bi0;
@@ -672,10 +663,11 @@ policer_classify_inline (vlib_main_t * vm,
 	  n_left_to_next -= 1;
 
 	  b0 = vlib_get_buffer (vm, bi0);
-	  h0 = b0->data;
-	  table_index0 = vnet_buffer (b0)->l2_classify.table_index;
-	  e0 = 0;
+	  table_index0 = ti[0];
+	  e0 = e[0];
 	  t0 = 0;
+	  ti += 1;
+	  e += 1;
 
 	  if (tid == POLICER_CLASSIFY_TABLE_L2)
 	    {
@@ -692,9 +684,7 @@ policer_classify_inline (vlib_main_t * vm,
 
 	  if (PREDICT_TRUE (table_index0 != ~0))
 	    {
-	      hash0 = vnet_buffer (b0)->l2_classify.hash;
 	      t0 = pool_elt_at_index (vcm->tables, table_index0);
-	      e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
 
 	      if (e0)
 		{
@@ -713,43 +703,9 @@ policer_classify_inline (vlib_main_t * vm,
 		}
 	      else
 		{
-		  while (1)
-		    {
-		      if (PREDICT_TRUE (t0->next_table_index != ~0))
-			{
-			  t0 = pool_elt_at_index (vcm->tables,
-						  t0->next_table_index);
-			}
-		      else
-			{
-			  next0 = (t0->miss_next_index < n_next_nodes) ?
-			    t0->miss_next_index : next0;
-			  misses++;
-			  break;
-			}
-
-		      hash0 = vnet_classify_hash_packet (t0, (u8 *) h0);
-		      e0 =
-			vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-		      if (e0)
-			{
-			  act0 = vnet_policer_police (vm,
-						      b0,
-						      e0->next_index,
-						      time_in_policer_periods,
-						      e0->opaque_index);
-			  if (PREDICT_FALSE (act0 == SSE2_QOS_ACTION_DROP))
-			    {
-			      next0 = POLICER_CLASSIFY_NEXT_INDEX_DROP;
-			      b0->error =
-				node->errors[POLICER_CLASSIFY_ERROR_DROP];
-			      drop++;
-			    }
-			  hits++;
-			  chain_hits++;
-			  break;
-			}
-		    }
+		  next0 = (t0->miss_next_index < n_next_nodes) ?
+		    t0->miss_next_index : next0;
+		  misses++;
 		}
 	    }
 	  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
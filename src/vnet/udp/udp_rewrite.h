@@ -0,0 +1,184 @@
+/*
+ * udp_rewrite.h: precomputed outer headers of UDP based tunnels
+ *
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __included_udp_rewrite_h__
+#define __included_udp_rewrite_h__
+
+#include <vnet/ip/ip.h>
+#include <vnet/udp/udp_packet.h>
+
+/*
+ * Encap engine for the UDP tunnels (vxlan, vxlan-gpe, geneve, gtpu).
+ *
+ * The outer IP/UDP/tunnel header of a tunnel is the same for every packet
+ * except for the lengths, the UDP source port and the ip4 checksum. The
+ * template is stamped with 16 byte vector stores, the last one ending
+ * exactly at the end of the header so the payload is never touched, and
+ * the ip4 checksum is finished from the checksum of the template computed
+ * with a zero length. The x4 variant loads the template once for four
+ * packets of the same tunnel.
+ *
+ * Templates shorter than 16 or longer than IP_UDP_REWRITE_MAX_LEN bytes
+ * (e.g. geneve with large options) are refused by ip_udp_rewrite_init,
+ * such tunnels keep copying their rewrite string.
+ */
+
+#define IP_UDP_REWRITE_MAX_LEN 64
+
+typedef u8 ip_udp_rewrite_chunk_t __attribute__ ((vector_size (16)));
+
+typedef struct
+{
+  u8 data[IP_UDP_REWRITE_MAX_LEN];
+
+  /* template length in bytes */
+  u16 len;
+
+  /* ip4 header checksum of the template, the length being zero */
+  u16 ip4_checksum;
+} ip_udp_rewrite_t;
+
+#define ip_udp_rewrite_chunk(p) clib_mem_unaligned (p, ip_udp_rewrite_chunk_t)
+
+always_inline int
+ip_udp_rewrite_init (ip_udp_rewrite_t * rw, void *hdr, u16 len, u8 is_ip4)
+{
+  if (len < sizeof (ip_udp_rewrite_chunk_t) || len > IP_UDP_REWRITE_MAX_LEN)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  memset (rw, 0, sizeof (*rw));
+  clib_memcpy (rw->data, hdr, len);
+  rw->len = len;
+
+  if (is_ip4)
+    {
+      ip4_header_t *ip4 = (ip4_header_t *) rw->data;
+
+      ip4->length = 0;
+      ip4->checksum = ip4_header_checksum (ip4);
+      rw->ip4_checksum = ip4->checksum;
+    }
+  return 0;
+}
+
+/* Source port carrying the flow entropy, in the dynamic range as RFC 7348
+   recommends. */
+always_inline u16
+ip_udp_rewrite_src_port (u32 flow_hash)
+{
+  flow_hash ^= flow_hash >> 16;
+  return clib_host_to_net_u16 (0xc000 | (flow_hash & 0x3fff));
+}
+
+/* Write the template at dst: chunks at 0, 16 and 32 as far as they are
+   below the last chunk, which ends at rw->len. */
+always_inline void
+ip_udp_rewrite_stamp (ip_udp_rewrite_t * rw, u8 * dst)
+{
+  u16 len = rw->len;
+
+  ip_udp_rewrite_chunk (dst) = ip_udp_rewrite_chunk (rw->data);
+  if (len > 32)
+    ip_udp_rewrite_chunk (dst + 16) = ip_udp_rewrite_chunk (rw->data + 16);
+  if (len > 48)
+    ip_udp_rewrite_chunk (dst + 32) = ip_udp_rewrite_chunk (rw->data + 32);
+  ip_udp_rewrite_chunk (dst + len - 16) =
+    ip_udp_rewrite_chunk (rw->data + len - 16);
+}
+
+always_inline void
+ip_udp_rewrite_stamp_x4 (ip_udp_rewrite_t * rw, u8 * d0, u8 * d1, u8 * d2,
+			 u8 * d3)
+{
+  u16 len = rw->len, last = len - 16;
+  ip_udp_rewrite_chunk_t c0, c1, c2, cl;
+
+  c0 = ip_udp_rewrite_chunk (rw->data);
+  c1 = ip_udp_rewrite_chunk (rw->data + 16);
+  c2 = ip_udp_rewrite_chunk (rw->data + 32);
+  cl = ip_udp_rewrite_chunk (rw->data + last);
+
+  ip_udp_rewrite_chunk (d0) = c0;
+  ip_udp_rewrite_chunk (d1) = c0;
+  ip_udp_rewrite_chunk (d2) = c0;
+  ip_udp_rewrite_chunk (d3) = c0;
+  if (len > 32)
+    {
+      ip_udp_rewrite_chunk (d0 + 16) = c1;
+      ip_udp_rewrite_chunk (d1 + 16) = c1;
+      ip_udp_rewrite_chunk (d2 + 16) = c1;
+      ip_udp_rewrite_chunk (d3 + 16) = c1;
+    }
+  if (len > 48)
+    {
+      ip_udp_rewrite_chunk (d0 + 32) = c2;
+      ip_udp_rewrite_chunk (d1 + 32) = c2;
+      ip_udp_rewrite_chunk (d2 + 32) = c2;
+      ip_udp_rewrite_chunk (d3 + 32) = c2;
+    }
+  ip_udp_rewrite_chunk (d0 + last) = cl;
+  ip_udp_rewrite_chunk (d1 + last) = cl;
+  ip_udp_rewrite_chunk (d2 + last) = cl;
+  ip_udp_rewrite_chunk (d3 + last) = cl;
+}
+
+/* Fill in the per packet fields of a header stamped at the buffer current
+   data. The ip6 UDP checksum is left to the caller. Returns the UDP
+   header, *len is the length of the packet. */
+always_inline udp_header_t *
+ip_udp_rewrite_fixup (vlib_main_t * vm, vlib_buffer_t * b,
+		      ip_udp_rewrite_t * rw, u16 src_port, u32 * len,
+		      u8 is_ip4)
+{
+  udp_header_t *udp;
+  u32 l = vlib_buffer_length_in_chain (vm, b);
+
+  if (is_ip4)
+    {
+      ip4_header_t *ip4 = vlib_buffer_get_current (b);
+      ip_csum_t sum = rw->ip4_checksum;
+
+      ip4->length = clib_host_to_net_u16 (l);
+      sum = ip_csum_update (sum, 0, ip4->length, ip4_header_t,
+			    length /* changed member */ );
+      ip4->checksum = ip_csum_fold (sum);
+      udp = (udp_header_t *) (ip4 + 1);
+      udp->length = clib_host_to_net_u16 (l - sizeof (*ip4));
+    }
+  else
+    {
+      ip6_header_t *ip6 = vlib_buffer_get_current (b);
+
+      ip6->payload_length = clib_host_to_net_u16 (l - sizeof (*ip6));
+      udp = (udp_header_t *) (ip6 + 1);
+      udp->length = ip6->payload_length;
+    }
+
+  udp->src_port = src_port;
+  *len = l;
+  return udp;
+}
+
+#endif /* __included_udp_rewrite_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -59,6 +59,88 @@ u8 * format_vxlan_encap_trace (u8 * s, va_list * args)
   return s;
 }
 
+/* Tunnel of the packet, the tunnel of the previous packet is kept in
+   *sw_if_index and t since runs of packets usually share it. */
+always_inline vxlan_tunnel_t *
+vxlan_encap_tunnel (vnet_main_t * vnm, vxlan_main_t * vxm,
+                    vlib_buffer_t * b, u32 * sw_if_index, vxlan_tunnel_t * t)
+{
+  vnet_hw_interface_t * hi;
+
+  if (PREDICT_TRUE (vnet_buffer(b)->sw_if_index[VLIB_TX] == *sw_if_index))
+    return t;
+
+  *sw_if_index = vnet_buffer(b)->sw_if_index[VLIB_TX];
+  hi = vnet_get_sup_hw_interface (vnm, *sw_if_index);
+  return pool_elt_at_index (vxm->tunnels, hi->dev_instance);
+}
+
+/* Everything after the header stamp: lengths, source port, checksums,
+   tx counters and trace. Returns the next node. */
+always_inline u32
+vxlan_encap_one (vlib_main_t * vm, vlib_node_runtime_t * node,
+                 vlib_buffer_t * b, vxlan_tunnel_t * t, u32 flow_hash,
+                 vlib_combined_counter_main_t * tx_counter, u32 thread_index,
+                 u32 * stats_sw_if_index, u32 * stats_n_packets,
+                 u32 * stats_n_bytes, u8 is_ip4, u8 csum_offload)
+{
+  vxlan_main_t * vxm = &vxlan_main;
+  udp_header_t * udp;
+  u32 len;
+
+  udp = ip_udp_rewrite_fixup (vm, b, &t->rewrite,
+                              ip_udp_rewrite_src_port (flow_hash),
+                              &len, is_ip4);
+
+  if (csum_offload)
+    {
+      b->flags |= is_ip4 ?
+        VNET_BUFFER_F_OFFLOAD_IP_CKSUM | VNET_BUFFER_F_IS_IP4 |
+        VNET_BUFFER_F_OFFLOAD_UDP_CKSUM :
+        VNET_BUFFER_F_OFFLOAD_UDP_CKSUM;
+      vnet_buffer (b)->l3_hdr_offset = b->current_data;
+      vnet_buffer (b)->l4_hdr_offset = (u8 *) udp - b->data;
+    }
+  /* IPv6 UDP checksum is mandatory */
+  else if (!is_ip4)
+    {
+      int bogus = 0;
+
+      udp->checksum = ip6_tcp_udp_icmp_compute_checksum
+        (vm, b, vlib_buffer_get_current (b), &bogus);
+      ASSERT(bogus == 0);
+      if (udp->checksum == 0)
+        udp->checksum = 0xffff;
+    }
+
+  /* Batch stats increment on the same vxlan tunnel so counter is not
+     incremented per packet. Note stats are still incremented for deleted
+     and admin-down tunnel where packets are dropped. It is not worthwhile
+     to check for this rare case and affect normal path performance. */
+  if (PREDICT_FALSE (t->sw_if_index != *stats_sw_if_index))
+    {
+      if (*stats_n_packets)
+        vlib_increment_combined_counter (tx_counter, thread_index,
+            *stats_sw_if_index, *stats_n_packets, *stats_n_bytes);
+      *stats_sw_if_index = t->sw_if_index;
+      *stats_n_packets = *stats_n_bytes = 0;
+    }
+  *stats_n_packets += 1;
+  *stats_n_bytes += len;
+
+  if (PREDICT_FALSE(b->flags & VLIB_BUFFER_IS_TRACED)) 
+    {
+      vxlan_encap_trace_t *tr = 
+        vlib_add_trace (vm, node, b, sizeof (*tr));
+      tr->tunnel_index = t - vxm->tunnels;
+      tr->vni = t->vni;
+    }
+
+  /* Note: change to always set next if it may be set to drop */
+  vnet_buffer(b)->ip.adj_index[VLIB_TX] = t->next_dpo.dpoi_index;
+  return t->next_dpo.dpoi_next_node;
+}
+
 always_inline uword
 vxlan_encap_inline (vlib_main_t * vm,
 		    vlib_node_runtime_t * node,
@@ -70,13 +152,10 @@ vxlan_encap_inline (vlib_main_t * vm,
   vnet_main_t * vnm = vxm->vnet_main;
   vnet_interface_main_t * im = &vnm->interface_main;
   vlib_combined_counter_main_t * tx_counter = im->combined_sw_if_counters + VNET_INTERFACE_COUNTER_TX;
-  u32 pkts_encapsulated = 0;
   u32 thread_index = vlib_get_thread_index();
   u32 stats_sw_if_index, stats_n_packets, stats_n_bytes;
-  u32 sw_if_index0 = 0, sw_if_index1 = 0;
-  u32 next0 = 0, next1 = 0;
-  vnet_hw_interface_t * hi0, * hi1;
-  vxlan_tunnel_t * t0 = NULL, * t1 = NULL;
+  u32 sw_if_index = ~0;
+  vxlan_tunnel_t * t = NULL;
 
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
@@ -90,11 +169,6 @@ vxlan_encap_inline (vlib_main_t * vm,
 
   word const underlay_hdr_len = is_ip4 ?
     sizeof(ip4_vxlan_header_t) : sizeof(ip6_vxlan_header_t);
-  u16 const l3_len = is_ip4 ? sizeof(ip4_header_t) : sizeof(ip6_header_t);
-  u32 const csum_flags = is_ip4 ?
-    VNET_BUFFER_F_OFFLOAD_IP_CKSUM | VNET_BUFFER_F_IS_IP4 |
-    VNET_BUFFER_F_OFFLOAD_UDP_CKSUM :
-    VNET_BUFFER_F_OFFLOAD_UDP_CKSUM;
 
   while (n_left_from > 0)
     {
@@ -103,213 +177,112 @@ vxlan_encap_inline (vlib_main_t * vm,
       vlib_get_next_frame (vm, node, next_index,
 			   to_next, n_left_to_next);
 
-      while (n_left_from >= 4 && n_left_to_next >= 2)
+      while (n_left_from >= 8 && n_left_to_next >= 4)
 	{
+	  u32 bi0, bi1, bi2, bi3;
+	  u32 next0, next1, next2, next3;
+	  u32 flow_hash0, flow_hash1, flow_hash2, flow_hash3;
+	  vlib_buffer_t * b0, * b1, * b2, * b3;
+	  vxlan_tunnel_t * t0, * t1, * t2, * t3;
+
 	  /* Prefetch next iteration. */
 	  {
-	    vlib_buffer_t * p2, * p3;
-
-	    p2 = vlib_get_buffer (vm, from[2]);
-	    p3 = vlib_get_buffer (vm, from[3]);
-
-	    vlib_prefetch_buffer_header (p2, LOAD);
-	    vlib_prefetch_buffer_header (p3, LOAD);
-
-	    CLIB_PREFETCH (p2->data, 2*CLIB_CACHE_LINE_BYTES, LOAD);
-	    CLIB_PREFETCH (p3->data, 2*CLIB_CACHE_LINE_BYTES, LOAD);
+	    vlib_buffer_t * p4, * p5, * p6, * p7;
+
+	    p4 = vlib_get_buffer (vm, from[4]);
+	    p5 = vlib_get_buffer (vm, from[5]);
+	    p6 = vlib_get_buffer (vm, from[6]);
+	    p7 = vlib_get_buffer (vm, from[7]);
+
+	    vlib_prefetch_buffer_header (p4, LOAD);
+	    vlib_prefetch_buffer_header (p5, LOAD);
+	    vlib_prefetch_buffer_header (p6, LOAD);
+	    vlib_prefetch_buffer_header (p7, LOAD);
+
+	    CLIB_PREFETCH (p4->data, 2*CLIB_CACHE_LINE_BYTES, LOAD);
+	    CLIB_PREFETCH (p5->data, 2*CLIB_CACHE_LINE_BYTES, LOAD);
+	    CLIB_PREFETCH (p6->data, 2*CLIB_CACHE_LINE_BYTES, LOAD);
+	    CLIB_PREFETCH (p7->data, 2*CLIB_CACHE_LINE_BYTES, LOAD);
 	  }
 
-	  u32 bi0 = from[0];
-	  u32 bi1 = from[1];
-
-	  vlib_buffer_t * b0 = vlib_get_buffer (vm, bi0);
-	  vlib_buffer_t * b1 = vlib_get_buffer (vm, bi1);
-          u32 flow_hash0 = vnet_l2_compute_flow_hash (b0);
-          u32 flow_hash1 = vnet_l2_compute_flow_hash (b1);
-
-	  to_next[0] = bi0;
-	  to_next[1] = bi1;
-	  from += 2;
-	  to_next += 2;
-	  n_left_to_next -= 2;
-	  n_left_from -= 2;
-
-	  /* Get next node index and adj index from tunnel next_dpo */
-	  if (sw_if_index0 != vnet_buffer(b0)->sw_if_index[VLIB_TX])
-	    {
-	      sw_if_index0 = vnet_buffer(b0)->sw_if_index[VLIB_TX];
-	      hi0 = vnet_get_sup_hw_interface (vnm, sw_if_index0);
-	      t0 = &vxm->tunnels[hi0->dev_instance];
-	      /* Note: change to always set next0 if it may be set to drop */
-	      next0 = t0->next_dpo.dpoi_next_node;
-	    }
-          vnet_buffer(b0)->ip.adj_index[VLIB_TX] = t0->next_dpo.dpoi_index;
-
-	  /* Get next node index and adj index from tunnel next_dpo */
-	  if (sw_if_index1 != vnet_buffer(b1)->sw_if_index[VLIB_TX])
-	    {
-	      sw_if_index1 = vnet_buffer(b1)->sw_if_index[VLIB_TX];
-	      hi1 = vnet_get_sup_hw_interface (vnm, sw_if_index1); 
-	      t1 = &vxm->tunnels[hi1->dev_instance];
-	      /* Note: change to always set next1 if it may be set to drop */
-	      next1 = t1->next_dpo.dpoi_next_node;
-	    }
-          vnet_buffer(b1)->ip.adj_index[VLIB_TX] = t1->next_dpo.dpoi_index;
-
-          ASSERT(vec_len(t0->rewrite) == underlay_hdr_len);
-          ASSERT(vec_len(t1->rewrite) == underlay_hdr_len);
-
-          vlib_buffer_advance (b0, -underlay_hdr_len);
-          vlib_buffer_advance (b1, -underlay_hdr_len);
-
- 	  u32 len0 = vlib_buffer_length_in_chain (vm, b0);
- 	  u32 len1 = vlib_buffer_length_in_chain (vm, b1);
-          u16 payload_l0 = clib_host_to_net_u16 (len0 - l3_len);
-          u16 payload_l1 = clib_host_to_net_u16 (len1 - l3_len);
-
-          ip4_header_t * ip4_0, * ip4_1;
-          ip6_header_t * ip6_0, * ip6_1;
-          udp_header_t * udp0, * udp1;
-          u8 * l3_0, * l3_1;
-	  if (is_ip4)
-	    {
-              ip4_vxlan_header_t * hdr0 = vlib_buffer_get_current(b0);
-              ip4_vxlan_header_t * rewrite0 = (void *)t0->rewrite;
-              ip4_vxlan_header_t * hdr1 = vlib_buffer_get_current(b1);
-              ip4_vxlan_header_t * rewrite1 = (void *)t1->rewrite;
-              *hdr0 = *rewrite0;
-              *hdr1 = *rewrite1;
-
-	      /* Fix the IP4 checksum and length */
-	      ip4_0 = &hdr0->ip4;
-	      ip4_1 = &hdr1->ip4;
-              ip4_0->length = clib_host_to_net_u16 (len0);
-              ip4_1->length = clib_host_to_net_u16 (len1);
-
-              l3_0 = (u8 *)ip4_0;
-              l3_1 = (u8 *)ip4_1;
-	      udp0 = &hdr0->udp;
-	      udp1 = &hdr1->udp;
-	    }
-	  else /* ipv6 */
+	  bi0 = to_next[0] = from[0];
+	  bi1 = to_next[1] = from[1];
+	  bi2 = to_next[2] = from[2];
+	  bi3 = to_next[3] = from[3];
+	  from += 4;
+	  to_next += 4;
+	  n_left_to_next -= 4;
+	  n_left_from -= 4;
+
+	  b0 = vlib_get_buffer (vm, bi0);
+	  b1 = vlib_get_buffer (vm, bi1);
+	  b2 = vlib_get_buffer (vm, bi2);
+	  b3 = vlib_get_buffer (vm, bi3);
+
+	  /* hash the inner headers before they move */
+	  flow_hash0 = vnet_l2_compute_flow_hash (b0);
+	  flow_hash1 = vnet_l2_compute_flow_hash (b1);
+	  flow_hash2 = vnet_l2_compute_flow_hash (b2);
+	  flow_hash3 = vnet_l2_compute_flow_hash (b3);
+
+	  t0 = t = vxlan_encap_tunnel (vnm, vxm, b0, &sw_if_index, t);
+	  t1 = t = vxlan_encap_tunnel (vnm, vxm, b1, &sw_if_index, t);
+	  t2 = t = vxlan_encap_tunnel (vnm, vxm, b2, &sw_if_index, t);
+	  t3 = t = vxlan_encap_tunnel (vnm, vxm, b3, &sw_if_index, t);
+
+	  ASSERT(t0->rewrite.len == underlay_hdr_len);
+	  ASSERT(t1->rewrite.len == underlay_hdr_len);
+	  ASSERT(t2->rewrite.len == underlay_hdr_len);
+	  ASSERT(t3->rewrite.len == underlay_hdr_len);
+
+	  vlib_buffer_advance (b0, -underlay_hdr_len);
+	  vlib_buffer_advance (b1, -underlay_hdr_len);
+	  vlib_buffer_advance (b2, -underlay_hdr_len);
+	  vlib_buffer_advance (b3, -underlay_hdr_len);
+
+	  if (PREDICT_TRUE (t0 == t1 && t0 == t2 && t0 == t3))
+	    ip_udp_rewrite_stamp_x4 (&t0->rewrite,
+				     vlib_buffer_get_current (b0),
+				     vlib_buffer_get_current (b1),
+				     vlib_buffer_get_current (b2),
+				     vlib_buffer_get_current (b3));
+	  else
 	    {
-              ip6_vxlan_header_t * hdr0 = vlib_buffer_get_current(b0);
-              ip6_vxlan_header_t * rewrite0 = (void *) t0->rewrite;
-              ip6_vxlan_header_t * hdr1 = vlib_buffer_get_current(b0);
-              ip6_vxlan_header_t * rewrite1 = (void *) t1->rewrite;
-              *hdr0 = *rewrite0;
-              *hdr1 = *rewrite1;
-
-	      /* Fix IP6 payload length */
-              ip6_0 = &hdr0->ip6;
-              ip6_1 = &hdr1->ip6;
-	      ip6_0->payload_length = payload_l0;
-	      ip6_1->payload_length = payload_l1;
-
-              l3_0 = (u8 *)ip6_0;
-              l3_1 = (u8 *)ip6_1;
-              udp0 = &hdr0->udp;
-              udp1 = &hdr1->udp;
+	      ip_udp_rewrite_stamp (&t0->rewrite, vlib_buffer_get_current (b0));
+	      ip_udp_rewrite_stamp (&t1->rewrite, vlib_buffer_get_current (b1));
+	      ip_udp_rewrite_stamp (&t2->rewrite, vlib_buffer_get_current (b2));
+	      ip_udp_rewrite_stamp (&t3->rewrite, vlib_buffer_get_current (b3));
 	    }
 
-          /* Fix UDP length  and set source port */
-          udp0->length = payload_l0;
-          udp0->src_port = flow_hash0;
-          udp1->length = payload_l1;
-          udp1->src_port = flow_hash1;
-
-          if (csum_offload)
-            {
-              b0->flags |= csum_flags;
-              vnet_buffer (b0)->l3_hdr_offset = l3_0 - b0->data;
-              vnet_buffer (b0)->l4_hdr_offset = (u8 *) udp0 - b0->data;
-              b1->flags |= csum_flags;
-              vnet_buffer (b1)->l3_hdr_offset = l3_1 - b1->data;
-              vnet_buffer (b1)->l4_hdr_offset = (u8 *) udp1 - b1->data;
-            }
-          /* IPv4 UDP checksum only if checksum offload is used */
-          else if (is_ip4)
-            {
-              ip_csum_t sum0 = ip4_0->checksum;
-              sum0 = ip_csum_update (sum0, 0, ip4_0->length, ip4_header_t,
-                  length /* changed member */);
-              ip4_0->checksum = ip_csum_fold (sum0);
-              ip_csum_t sum1 = ip4_1->checksum;
-              sum1 = ip_csum_update (sum1, 0, ip4_1->length, ip4_header_t,
-                  length /* changed member */);
-              ip4_1->checksum = ip_csum_fold (sum1);
-            }
-          /* IPv6 UDP checksum is mandatory */
-          else
-            {
-              int bogus = 0;
-
-              udp0->checksum = ip6_tcp_udp_icmp_compute_checksum
-                (vm, b0, ip6_0, &bogus);
-              ASSERT(bogus == 0);
-              if (udp0->checksum == 0)
-                udp0->checksum = 0xffff;
-              udp1->checksum = ip6_tcp_udp_icmp_compute_checksum
-                (vm, b1, ip6_1, &bogus);
-              ASSERT(bogus == 0);
-              if (udp1->checksum == 0)
-                udp1->checksum = 0xffff;
-            }
-
-	  /* Batch stats increment on the same vxlan tunnel so counter is not
-	     incremented per packet. Note stats are still incremented for deleted
-	     and admin-down tunnel where packets are dropped. It is not worthwhile
-	     to check for this rare case and affect normal path performance. */
-          if (sw_if_index0 == sw_if_index1)
-            {
-              if (PREDICT_FALSE(sw_if_index0 != stats_sw_if_index))
-                {
-                  if (stats_n_packets) 
-                    {
-                      vlib_increment_combined_counter (tx_counter, thread_index,
-                          stats_sw_if_index, stats_n_packets, stats_n_bytes);
-                      stats_n_packets = stats_n_bytes = 0;
-                    }
-                  stats_sw_if_index = sw_if_index0;
-                }
-              stats_n_packets += 2;
-              stats_n_bytes += len0 + len1;
-            }
-          else
-            {
-              vlib_increment_combined_counter (tx_counter, thread_index,
-                  sw_if_index0, 1, len0);
-              vlib_increment_combined_counter (tx_counter, thread_index,
-                  sw_if_index1, 1, len1);
-            }
-          pkts_encapsulated += 2;
-
-	  if (PREDICT_FALSE(b0->flags & VLIB_BUFFER_IS_TRACED)) 
-            {
-              vxlan_encap_trace_t *tr = 
-                vlib_add_trace (vm, node, b0, sizeof (*tr));
-              tr->tunnel_index = t0 - vxm->tunnels;
-              tr->vni = t0->vni;
-           }
-
-          if (PREDICT_FALSE(b1->flags & VLIB_BUFFER_IS_TRACED)) 
-            {
-              vxlan_encap_trace_t *tr = 
-                vlib_add_trace (vm, node, b1, sizeof (*tr));
-              tr->tunnel_index = t1 - vxm->tunnels;
-              tr->vni = t1->vni;
-            }
-
-	  vlib_validate_buffer_enqueue_x2 (vm, node, next_index,
+	  next0 = vxlan_encap_one (vm, node, b0, t0, flow_hash0, tx_counter,
+				   thread_index, &stats_sw_if_index,
+				   &stats_n_packets, &stats_n_bytes,
+				   is_ip4, csum_offload);
+	  next1 = vxlan_encap_one (vm, node, b1, t1, flow_hash1, tx_counter,
+				   thread_index, &stats_sw_if_index,
+				   &stats_n_packets, &stats_n_bytes,
+				   is_ip4, csum_offload);
+	  next2 = vxlan_encap_one (vm, node, b2, t2, flow_hash2, tx_counter,
+				   thread_index, &stats_sw_if_index,
+				   &stats_n_packets, &stats_n_bytes,
+				   is_ip4, csum_offload);
+	  next3 = vxlan_encap_one (vm, node, b3, t3, flow_hash3, tx_counter,
+				   thread_index, &stats_sw_if_index,
+				   &stats_n_packets, &stats_n_bytes,
+				   is_ip4, csum_offload);
+
+	  vlib_validate_buffer_enqueue_x4 (vm, node, next_index,
 					   to_next, n_left_to_next,
-					   bi0, bi1, next0, next1);
+					   bi0, bi1, bi2, bi3,
+					   next0, next1, next2, next3);
 	}
 
       while (n_left_from > 0 && n_left_to_next > 0)
 	{
 	  u32 bi0 = from[0];
 	  vlib_buffer_t * b0 = vlib_get_buffer (vm, bi0);
-          u32 flow_hash0 = vnet_l2_compute_flow_hash(b0);
+	  u32 flow_hash0 = vnet_l2_compute_flow_hash(b0);
+	  u32 next0;
 
 	  to_next[0] = bi0;
 	  from += 1;
@@ -317,109 +290,17 @@ vxlan_encap_inline (vlib_main_t * vm,
 	  n_left_from -= 1;
 	  n_left_to_next -= 1;
 
-	  /* Get next node index and adj index from tunnel next_dpo */
-	  if (sw_if_index0 != vnet_buffer(b0)->sw_if_index[VLIB_TX])
-	    {
-	      sw_if_index0 = vnet_buffer(b0)->sw_if_index[VLIB_TX];
-	      hi0 = vnet_get_sup_hw_interface (vnm, sw_if_index0);
-	      t0 = &vxm->tunnels[hi0->dev_instance];
-	      /* Note: change to always set next0 if it may be set to drop */
-	      next0 = t0->next_dpo.dpoi_next_node;
-	    }
-	  vnet_buffer(b0)->ip.adj_index[VLIB_TX] = t0->next_dpo.dpoi_index;
-
-          ASSERT(vec_len(t0->rewrite) == underlay_hdr_len);
-          vlib_buffer_advance (b0, -underlay_hdr_len);
-
- 	  u32 len0 = vlib_buffer_length_in_chain (vm, b0);
-          u16 payload_l0 = clib_host_to_net_u16 (len0 - l3_len);
-
-          udp_header_t * udp0;
-          ip4_header_t * ip4_0;
-          ip6_header_t * ip6_0;
-          u8 * l3_0;
-	  if (is_ip4)
-	    {
-              ip4_vxlan_header_t * rewrite = (void *)t0->rewrite;
-              ip4_vxlan_header_t * hdr = vlib_buffer_get_current(b0);
-              *hdr = *rewrite;
-
-	      /* Fix the IP4 checksum and length */
-              ip4_0 = &hdr->ip4;
-              ip4_0->length = clib_host_to_net_u16 (len0);
+	  t = vxlan_encap_tunnel (vnm, vxm, b0, &sw_if_index, t);
 
-              l3_0 = (u8*)ip4_0;
-	      udp0 = &hdr->udp;
-	    }
-	  else /* ip6 path */
-	    {
-              ip6_vxlan_header_t * hdr = vlib_buffer_get_current(b0);
-              ip6_vxlan_header_t * rewrite = (void *) t0->rewrite;
-              *hdr = *rewrite;
+	  ASSERT(t->rewrite.len == underlay_hdr_len);
+	  vlib_buffer_advance (b0, -underlay_hdr_len);
+	  ip_udp_rewrite_stamp (&t->rewrite, vlib_buffer_get_current (b0));
 
-	      /* Fix IP6 payload length */
-              ip6_0 = &hdr->ip6;
-	      ip6_0->payload_length = payload_l0;
+	  next0 = vxlan_encap_one (vm, node, b0, t, flow_hash0, tx_counter,
+				   thread_index, &stats_sw_if_index,
+				   &stats_n_packets, &stats_n_bytes,
+				   is_ip4, csum_offload);
 
-              l3_0 = (u8 *)ip6_0;
-              udp0 = &hdr->udp;
-	    }
-
-          /* Fix UDP length  and set source port */
-          udp0->length = payload_l0;
-          udp0->src_port = flow_hash0;
-
-          if (csum_offload)
-            {
-              b0->flags |= csum_flags;
-              vnet_buffer (b0)->l3_hdr_offset = l3_0 - b0->data;
-              vnet_buffer (b0)->l4_hdr_offset = (u8 *) udp0 - b0->data;
-            }
-          /* IPv4 UDP checksum only if checksum offload is used */
-          else if (is_ip4)
-            {
-              ip_csum_t sum0 = ip4_0->checksum;
-              sum0 = ip_csum_update (sum0, 0, ip4_0->length, ip4_header_t,
-                  length /* changed member */);
-              ip4_0->checksum = ip_csum_fold (sum0);
-            }
-          /* IPv6 UDP checksum is mandatory */
-          else
-            {
-              int bogus = 0;
-
-              udp0->checksum = ip6_tcp_udp_icmp_compute_checksum
-                (vm, b0, ip6_0, &bogus);
-              ASSERT(bogus == 0);
-              if (udp0->checksum == 0)
-                udp0->checksum = 0xffff;
-            }
-
-	  /* Batch stats increment on the same vxlan tunnel so counter is not
-	     incremented per packet. Note stats are still incremented for deleted
-	     and admin-down tunnel where packets are dropped. It is not worthwhile
-	     to check for this rare case and affect normal path performance. */
-	  if (PREDICT_FALSE (sw_if_index0 != stats_sw_if_index)) 
-	    {
-	      if (stats_n_packets)
-                {
-                  vlib_increment_combined_counter (tx_counter, thread_index,
-                      stats_sw_if_index, stats_n_packets, stats_n_bytes);
-                  stats_n_bytes = stats_n_packets = 0;
-                }
-	      stats_sw_if_index = sw_if_index0;
-	    }
-	  stats_n_packets += 1;
-	  stats_n_bytes += len0;
-          pkts_encapsulated ++;
-
-          if (PREDICT_FALSE(b0->flags & VLIB_BUFFER_IS_TRACED)) 
-            {
-              vxlan_encap_trace_t *tr = 
-                vlib_add_trace (vm, node, b0, sizeof (*tr));
-              tr->tunnel_index = t0 - vxm->tunnels;
-              tr->vni = t0->vni;
-            }
 	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
 					   to_next, n_left_to_next,
 					   bi0, next0);
@@ -431,7 +312,7 @@ vxlan_encap_inline (vlib_main_t * vm,
   /* Do we still need this now that tunnel tx stats is kept? */
   vlib_node_increment_counter (vm, node->node_index, 
                                VXLAN_ENCAP_ERROR_ENCAPSULATED, 
-                               pkts_encapsulated);
+                               from_frame->n_vectors);
 
   /* Increment any remaining batch stats */
   if (stats_n_packets)
@@ -198,6 +198,7 @@ vxlan_rewrite (vxlan_tunnel_t * t, bool is_ip6)
     u8 *rw;
   } r = { .rw = 0 };
   int len = is_ip6 ? sizeof *r.h6 : sizeof *r.h4;
+  int rv;
 
   vec_validate_aligned (r.rw, len-1, CLIB_CACHE_LINE_BYTES);
 
@@ -206,8 +207,8 @@ vxlan_rewrite (vxlan_tunnel_t * t, bool is_ip6)
   /* Fixed portion of the (outer) ip header */
   if (!is_ip6) 
     {
-      ip4_header_t * ip = &r.h4->ip4;
-      udp = &r.h4->udp, vxlan = &r.h4->vxlan;
+      ip4_header_t * ip = (ip4_header_t *) r.rw;
+      udp = (udp_header_t *) (ip + 1), vxlan = (vxlan_header_t *) (udp + 1);
       ip->ip_version_and_header_length = 0x45;
       ip->ttl = 254;
       ip->protocol = IP_PROTOCOL_UDP;
@@ -215,13 +216,12 @@ vxlan_rewrite (vxlan_tunnel_t * t, bool is_ip6)
       ip->src_address = t->src.ip4;
       ip->dst_address = t->dst.ip4;
 
-      /* we fix up the ip4 header length and checksum after-the-fact */
-      ip->checksum = ip4_header_checksum (ip);
+      /* length and checksum are fixed up per packet, see udp_rewrite.h */
     }
   else
     {
-      ip6_header_t * ip = &r.h6->ip6;
-      udp = &r.h6->udp, vxlan = &r.h6->vxlan;
+      ip6_header_t * ip = (ip6_header_t *) r.rw;
+      udp = (udp_header_t *) (ip + 1), vxlan = (vxlan_header_t *) (udp + 1);
       ip->ip_version_traffic_class_and_flow_label = clib_host_to_net_u32(6 << 28);
       ip->hop_limit = 255;
       ip->protocol = IP_PROTOCOL_UDP;
@@ -230,15 +230,16 @@ vxlan_rewrite (vxlan_tunnel_t * t, bool is_ip6)
       ip->dst_address = t->dst.ip6;
     }
 
-  /* UDP header, randomize src port on something, maybe? */
+  /* UDP header, the src port is set from the flow hash on encap */
   udp->src_port = clib_host_to_net_u16 (4789);
   udp->dst_port = clib_host_to_net_u16 (UDP_DST_PORT_vxlan);
 
   /* VXLAN header */
   vnet_set_vni_and_flags(vxlan, t->vni);
 
-  t->rewrite = r.rw;
-  return (0);
+  rv = ip_udp_rewrite_init (&t->rewrite, r.rw, len, !is_ip6);
+  vec_free (r.rw);
+  return rv;
 }
 
 static bool
@@ -574,7 +575,6 @@ int vnet_vxlan_add_del_tunnel
         }
 
       fib_node_deinit(&t->node);
-      vec_free (t->rewrite);
       pool_put (vxm->tunnels, t);
     }
 
@@ -27,6 +27,7 @@
 #include <vnet/ip/ip4_packet.h>
 #include <vnet/ip/ip6_packet.h>
 #include <vnet/udp/udp.h>
+#include <vnet/udp/udp_rewrite.h>
 #include <vnet/dpo/dpo.h>
 #include <vnet/adj/adj_types.h>
 
@@ -66,8 +67,8 @@ typedef CLIB_PACKED(struct {
 }) vxlan6_tunnel_key_t;
 
 typedef struct {
-  /* Rewrite string. $$$$ embed vnet_rewrite header */
-  u8 * rewrite;
+  /* Outer ip/udp/vxlan header template */
+  ip_udp_rewrite_t rewrite;
 
   /* FIB DPO for IP forwarding of VXLAN encap packet */
   dpo_id_t next_dpo;  
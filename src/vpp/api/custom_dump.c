@@ -584,6 +584,10 @@ static void *vl_api_tap_create_v2_t_print
     s = format (s, "tx-ring-size %d ", mp->tx_ring_sz);
   if (mp->rx_ring_sz)
     s = format (s, "rx-ring-size %d ", mp->rx_ring_sz);
+  if (mp->num_rx_queues)
+    s = format (s, "num-rx-queues %d ", mp->num_rx_queues);
+  if (mp->gso_enabled)
+    s = format (s, "gso ");
   FINISH;
 }
 
@@ -1412,6 +1416,20 @@ static void *vl_api_classify_set_interface_l2_tables_t_print
   FINISH;
 }
 
+static void *vl_api_classify_set_parallel_lookup_t_print
+  (vl_api_classify_set_parallel_lookup_t * mp, void *handle)
+{
+  u8 *s;
+
+  s = format (0, "SCRIPT: classify_set_parallel_lookup ");
+
+  s = format (s, "table %d ", ntohl (mp->table_index));
+  if (mp->is_enable == 0)
+    s = format (s, "disable ");
+
+  FINISH;
+}
+
 static void *vl_api_add_node_next_t_print
   (vl_api_add_node_next_t * mp, void *handle)
 {
@@ -3367,6 +3385,7 @@ _(BRIDGE_DOMAIN_DUMP, bridge_domain_dump)                               \
 _(BRIDGE_DOMAIN_SET_MAC_AGE, bridge_domain_set_mac_age)                 \
 _(CLASSIFY_SET_INTERFACE_IP_TABLE, classify_set_interface_ip_table)	\
 _(CLASSIFY_SET_INTERFACE_L2_TABLES, classify_set_interface_l2_tables)	\
+_(CLASSIFY_SET_PARALLEL_LOOKUP, classify_set_parallel_lookup)		\
 _(ADD_NODE_NEXT, add_node_next)						\
 _(DHCP_CLIENT_CONFIG, dhcp_client_config)	                        \
 _(L2TPV3_CREATE_TUNNEL, l2tpv3_create_tunnel)                           \
@@ -52,15 +52,43 @@ char *vlib_default_runtime_dir = "vpp";
 char *vlib_plugin_path = "/usr/lib/vpp_plugins";
 char *vlib_plugin_app_version = VPP_BUILD_VER;
 
+/*
+ * Parse <nn>[mM][gG] into *size, returns non-zero on error.
+ */
+static int
+parse_memory_size (char *arg, uword * size)
+{
+  u8 *sizep = (u8 *) arg;
+  u32 n = 0;
+
+  while (*sizep >= '0' && *sizep <= '9')
+    {
+      n *= 10;
+      n += *sizep++ - '0';
+    }
+  if (n == 0)
+    return -1;
+
+  *size = n;
+
+  if (*sizep == 'g' || *sizep == 'G')
+    *size <<= 30;
+  else if (*sizep == 'm' || *sizep == 'M')
+    *size <<= 20;
+
+  return 0;
+}
+
 int
 main (int argc, char *argv[])
 {
   int i;
   vlib_main_t *vm = &vlib_global_main;
   void vl_msg_api_set_first_available_msg_id (u16);
+  void *heap;
   uword main_heap_size = (1ULL << 30);
-  u8 *sizep;
-  u32 size;
+  uword slab_arena_size = 0;
+  uword hugepage_threshold = 0, hugepage_page_size = 0;
 
 #if __x86_64__
   CLIB_UNUSED (const char *msg)
@@ -154,10 +182,14 @@ main (int argc, char *argv[])
     }
 
   /*
-   * Look for and parse the "heapsize" config parameter.
+   * Look for and parse the "heapsize", "slab-arena" and hugepage arena
+   * config parameters.
    * Manual since none of the clib infra has been bootstrapped yet.
    *
    * Format: heapsize <nn>[mM][gG]
+   *         slab-arena <nn>[mM][gG]
+   *         hugepage-threshold <nn>[mM][gG]
+   *         hugepage-page-size 2m | 1g
    */
 
   for (i = 1; i < (argc - 1); i++)
@@ -169,14 +201,7 @@ main (int argc, char *argv[])
 	}
       else if (!strncmp (argv[i], "heapsize", 8))
 	{
-	  sizep = (u8 *) argv[i + 1];
-	  size = 0;
-	  while (*sizep >= '0' && *sizep <= '9')
-	    {
-	      size *= 10;
-	      size += *sizep++ - '0';
-	    }
-	  if (size == 0)
+	  if (parse_memory_size (argv[i + 1], &main_heap_size))
 	    {
 	      fprintf
 		(stderr,
@@ -184,13 +209,27 @@ main (int argc, char *argv[])
 		 argv[i], (long long int) main_heap_size);
 	      goto defaulted;
 	    }
-
-	  main_heap_size = size;
-
-	  if (*sizep == 'g' || *sizep == 'G')
-	    main_heap_size <<= 30;
-	  else if (*sizep == 'm' || *sizep == 'M')
-	    main_heap_size <<= 20;
+	}
+      else if (!strncmp (argv[i], "slab-arena", 10))
+	{
+	  if (parse_memory_size (argv[i + 1], &slab_arena_size))
+	    fprintf (stderr,
+		     "warning: slab-arena parse error '%s', slab allocator "
+		     "disabled\n", argv[i + 1]);
+	}
+      else if (!strncmp (argv[i], "hugepage-threshold", 18))
+	{
+	  if (parse_memory_size (argv[i + 1], &hugepage_threshold))
+	    fprintf (stderr,
+		     "warning: hugepage-threshold parse error '%s', hugepage "
+		     "arena disabled\n", argv[i + 1]);
+	}
+      else if (!strncmp (argv[i], "hugepage-page-size", 18))
+	{
+	  if (parse_memory_size (argv[i + 1], &hugepage_page_size))
+	    fprintf (stderr,
+		     "warning: hugepage-page-size parse error '%s', using "
+		     "transparent hugepages\n", argv[i + 1]);
 	}
     }
 
@@ -200,8 +239,32 @@ defaulted:
   vl_msg_api_set_first_available_msg_id (VL_MSG_FIRST_AVAILABLE);
 
   /* Allocate main heap */
-  if (clib_mem_init (0, main_heap_size))
+  if ((heap = clib_mem_init (0, main_heap_size)))
     {
+      /* Serve small main heap objects from the slab allocator */
+      if (slab_arena_size)
+	{
+	  clib_error_t *err;
+	  err = clib_slab_init (heap, slab_arena_size, CLIB_SLAB_F_HUGETLB);
+	  if (err)
+	    clib_error_report (err);
+	}
+
+      /* Serve large ones (big vectors and pools) from hugepages, either
+         explicit hugetlb pages of the given size or transparent 2MB ones */
+      if (hugepage_threshold)
+	{
+	  clib_error_t *err;
+	  err = clib_hugemem_init (heap, hugepage_threshold,
+				   CLIB_HUGEMEM_DEFAULT_VA_BYTES,
+				   hugepage_page_size ?
+				   min_log2 (hugepage_page_size) : 21,
+				   hugepage_page_size ?
+				   CLIB_HUGEMEM_F_HUGETLB : 0);
+	  if (err)
+	    clib_error_report (err);
+	}
+
       vm->init_functions_called = hash_create (0, /* value bytes */ 0);
       vpe_main_init (vm);
       return vlib_unix_main (argc, argv);
@@ -236,6 +299,35 @@ heapsize_config (vlib_main_t * vm, unformat_input_t * input)
 
 VLIB_CONFIG_FUNCTION (heapsize_config, "heapsize");
 
+/*
+ * "slab-arena" is parsed in main (), before the heap exists. Validate
+ * the syntax here so the config parser does not reject it.
+ */
+static clib_error_t *
+slab_arena_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  return heapsize_config (vm, input);
+}
+
+VLIB_CONFIG_FUNCTION (slab_arena_config, "slab-arena");
+
+/* Hugepage arena parameters are parsed in main () as well. */
+static clib_error_t *
+hugepage_threshold_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  return heapsize_config (vm, input);
+}
+
+VLIB_CONFIG_FUNCTION (hugepage_threshold_config, "hugepage-threshold");
+
+static clib_error_t *
+hugepage_page_size_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  return heapsize_config (vm, input);
+}
+
+VLIB_CONFIG_FUNCTION (hugepage_page_size_config, "hugepage-page-size");
+
 static clib_error_t *
 plugin_path_config (vlib_main_t * vm, unformat_input_t * input)
 {
@@ -242,6 +242,19 @@ static inline uword BV (clib_bihash_get_offset) (BVT (clib_bihash) * h,
   return vp - hp;
 }
 
+/** Prefetch the bucket a key hashes to, ahead of its search
+    @param h - the bihash table
+    @param hash - the key hash, as returned by clib_bihash_hash
+*/
+static inline void BV (clib_bihash_prefetch_bucket)
+  (BVT (clib_bihash) * h, u64 hash)
+{
+  u32 bucket_index = hash & (h->nbuckets - 1);
+
+  CLIB_PREFETCH (&h->buckets[bucket_index],
+		 sizeof (BVT (clib_bihash_bucket)), READ);
+}
+
 void BV (clib_bihash_init)
   (BVT (clib_bihash) * h, char *name, u32 nbuckets, uword memory_size);
 
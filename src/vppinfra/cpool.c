@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vppinfra/cpool.h>
+#include <vppinfra/error.h>
+
+/**
+ * Initialize a concurrent pool.
+ *
+ * @param p pool
+ * @param elt_bytes element size, at least 4 bytes
+ * @param log2_segment_elts log2 number of elements per segment
+ * @param max_elts maximum number of elements, 0 for no limit other than
+ *        CLIB_CPOOL_MAX_SEGMENTS segments
+ * @param n_threads number of threads which will get and put elements,
+ *        callers pass their thread index
+ */
+void
+clib_cpool_init (clib_cpool_t * p, u32 elt_bytes, u32 log2_segment_elts,
+		 u32 max_elts, u32 n_threads)
+{
+  uword capacity;
+
+  ASSERT (elt_bytes >= sizeof (u32));
+  ASSERT (n_threads > 0);
+
+  memset (p, 0, sizeof (p[0]));
+
+  p->elt_bytes = elt_bytes;
+  p->log2_segment_elts = log2_segment_elts;
+  p->segment_header_bytes =
+    round_pow2 (((1 << log2_segment_elts) + 7) / 8, CLIB_CACHE_LINE_BYTES);
+
+  capacity = (uword) CLIB_CPOOL_MAX_SEGMENTS << log2_segment_elts;
+  if (max_elts == 0 || max_elts > capacity)
+    max_elts = clib_min (capacity, (u32) ~ 0 - 1);
+  p->max_elts = max_elts;
+
+  p->segments = clib_mem_alloc (CLIB_CPOOL_MAX_SEGMENTS * sizeof (u8 *));
+  memset ((void *) p->segments, 0, CLIB_CPOOL_MAX_SEGMENTS * sizeof (u8 *));
+
+  p->n_threads = n_threads;
+  p->threads = clib_mem_alloc_aligned (n_threads * sizeof (p->threads[0]),
+				       CLIB_CACHE_LINE_BYTES);
+  memset (p->threads, 0, n_threads * sizeof (p->threads[0]));
+
+  p->free_head = (u32) ~ 0;
+}
+
+void
+clib_cpool_free (clib_cpool_t * p)
+{
+  int i;
+
+  if (!p->segments)
+    return;
+
+  for (i = 0; i < CLIB_CPOOL_MAX_SEGMENTS; i++)
+    if (p->segments[i])
+      clib_mem_free (p->segments[i]);
+  clib_mem_free ((void *) p->segments);
+  clib_mem_free (p->threads);
+  memset (p, 0, sizeof (p[0]));
+}
+
+/* Make sure segment exists, racing other threads. */
+static void
+clib_cpool_validate_segment (clib_cpool_t * p, u32 si)
+{
+  uword bytes;
+  u8 *s;
+
+  if (PREDICT_TRUE (p->segments[si] != 0))
+    return;
+
+  bytes = p->segment_header_bytes +
+    ((uword) p->elt_bytes << p->log2_segment_elts);
+  s = clib_mem_alloc_aligned (bytes, CLIB_CACHE_LINE_BYTES);
+  memset (s, 0, p->segment_header_bytes);
+
+  /* Lost the race, someone else installed the segment. */
+  if (!__sync_bool_compare_and_swap (&p->segments[si], 0, s))
+    clib_mem_free (s);
+}
+
+/* Pop one index from the global free stack, ~0 if empty. */
+static u32
+clib_cpool_pop_free (clib_cpool_t * p)
+{
+  u64 old, new;
+  u32 index;
+
+  while (1)
+    {
+      old = p->free_head;
+      index = (u32) old;
+      if (index == ~0)
+	return index;
+      new = (((old >> 32) + 1) << 32) |
+	*(u32 *) clib_cpool_elt_at_index (p, index);
+      if (__sync_bool_compare_and_swap (&p->free_head, old, new))
+	return index;
+    }
+}
+
+/* Reserve up to n never used indices, returns first one. */
+static u32
+clib_cpool_bump (clib_cpool_t * p, u32 * n)
+{
+  u32 old, new;
+
+  do
+    {
+      old = p->high_water;
+      if (old >= p->max_elts)
+	return ~0;
+      new = clib_min (old + *n, p->max_elts);
+    }
+  while (!__sync_bool_compare_and_swap (&p->high_water, old, new));
+
+  *n = new - old;
+  return old;
+}
+
+u32
+clib_cpool_get_index_slow (clib_cpool_t * p, clib_cpool_thread_t * t)
+{
+  u32 i, index, n_wanted = CLIB_CPOOL_CACHE_SIZE / 2;
+
+  /* Refill cache from the global free stack first... */
+  while (t->n_cached < n_wanted)
+    {
+      index = clib_cpool_pop_free (p);
+      if (index == ~0)
+	break;
+      t->indices[t->n_cached++] = index;
+    }
+
+  /* ... then from never used indices. */
+  if (t->n_cached == 0)
+    {
+      index = clib_cpool_bump (p, &n_wanted);
+      if (index == ~0)
+	return ~0;
+
+      for (i = index >> p->log2_segment_elts;
+	   i <= (index + n_wanted - 1) >> p->log2_segment_elts; i++)
+	clib_cpool_validate_segment (p, i);
+
+      /* Hand out lowest index first */
+      for (i = n_wanted; i > 0; i--)
+	t->indices[t->n_cached++] = index + i - 1;
+    }
+
+  return t->indices[--t->n_cached];
+}
+
+void
+clib_cpool_put_index_slow (clib_cpool_t * p, clib_cpool_thread_t * t)
+{
+  u32 i, first, last, n_spill = CLIB_CPOOL_CACHE_SIZE / 2;
+  u64 old, new;
+
+  /* Link half the cache into a chain and push it in one go. */
+  t->n_cached -= n_spill;
+  first = t->indices[t->n_cached];
+  last = t->indices[t->n_cached + n_spill - 1];
+  for (i = 0; i < n_spill - 1; i++)
+    *(u32 *) clib_cpool_elt_at_index (p, t->indices[t->n_cached + i]) =
+      t->indices[t->n_cached + i + 1];
+
+  do
+    {
+      old = p->free_head;
+      *(u32 *) clib_cpool_elt_at_index (p, last) = (u32) old;
+      new = (((old >> 32) + 1) << 32) | first;
+    }
+  while (!__sync_bool_compare_and_swap (&p->free_head, old, new));
+}
+
+/** Number of allocated elements. Not a snapshot if other threads
+    are allocating or freeing. */
+uword
+clib_cpool_elts (clib_cpool_t * p)
+{
+  u32 si, n_segments, n_words;
+  uword *bitmap, n = 0;
+  int i;
+
+  n_segments = (p->high_water + pow2_mask (p->log2_segment_elts))
+    >> p->log2_segment_elts;
+  n_words = ((1 << p->log2_segment_elts) + BITS (uword) - 1) / BITS (uword);
+
+  for (si = 0; si < n_segments; si++)
+    {
+      bitmap = (uword *) p->segments[si];
+      if (!bitmap)
+	continue;
+      for (i = 0; i < n_words; i++)
+	n += count_set_bits (bitmap[i]);
+    }
+
+  return n;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
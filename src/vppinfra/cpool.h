@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_clib_cpool_h
+#define included_clib_cpool_h
+
+#include <vppinfra/clib.h>
+#include <vppinfra/cache.h>
+#include <vppinfra/mem.h>
+#include <vppinfra/bitops.h>
+
+/** @file
+ * Concurrent fixed-size element pool.
+ *
+ * Unlike pool.h pools, which are vectors and move when they grow, a
+ * concurrent pool stores its elements in fixed-size segments referenced
+ * from a segment table which is allocated once. Elements never move, so
+ * pointers obtained from clib_cpool_elt_at_index stay valid while other
+ * threads allocate. New segments are installed with compare-and-swap.
+ *
+ * Each thread keeps a small cache of free indices; get and put on the
+ * cache are thread-local. Caches are refilled from, and spill to, a
+ * lock-free global free index stack, and indices never used so far are
+ * handed out by atomically bumping a high water mark.
+ *
+ * Free elements are linked through their first u32, so elements must be
+ * at least 4 bytes. An allocated-element bitmap at the start of each
+ * segment supports iteration.
+ */
+
+#define CLIB_CPOOL_CACHE_SIZE 64
+#define CLIB_CPOOL_MAX_SEGMENTS 4096
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  u32 n_cached;
+  u32 indices[CLIB_CPOOL_CACHE_SIZE];
+} clib_cpool_thread_t;
+
+typedef struct
+{
+  /** Segment table, CLIB_CPOOL_MAX_SEGMENTS entries, never reallocated. */
+  u8 *volatile *segments;
+
+  /** Per-thread free index caches. */
+  clib_cpool_thread_t *threads;
+  u32 n_threads;
+
+  u32 elt_bytes;
+  u32 log2_segment_elts;
+
+  /** Bytes of allocated-element bitmap at start of each segment. */
+  u32 segment_header_bytes;
+
+  /** Maximum number of elements, 0 means as many as segments allow. */
+  u32 max_elts;
+
+  /** Next never allocated index. */
+  volatile u32 high_water;
+
+  /** Global free index stack: (ABA tag << 32) | first index. */
+  volatile u64 free_head;
+} clib_cpool_t;
+
+void clib_cpool_init (clib_cpool_t * p, u32 elt_bytes,
+		      u32 log2_segment_elts, u32 max_elts, u32 n_threads);
+void clib_cpool_free (clib_cpool_t * p);
+u32 clib_cpool_get_index_slow (clib_cpool_t * p, clib_cpool_thread_t * t);
+void clib_cpool_put_index_slow (clib_cpool_t * p, clib_cpool_thread_t * t);
+uword clib_cpool_elts (clib_cpool_t * p);
+
+always_inline uword *
+clib_cpool_segment_bitmap (clib_cpool_t * p, u32 index)
+{
+  return (uword *) p->segments[index >> p->log2_segment_elts];
+}
+
+always_inline void *
+clib_cpool_elt_at_index (clib_cpool_t * p, u32 index)
+{
+  u8 *s = p->segments[index >> p->log2_segment_elts];
+  u32 offset = index & pow2_mask (p->log2_segment_elts);
+  return s + p->segment_header_bytes + (uword) offset * p->elt_bytes;
+}
+
+always_inline uword
+clib_cpool_is_free_index (clib_cpool_t * p, u32 index)
+{
+  uword *bitmap;
+  u32 offset;
+
+  if (index >= p->high_water)
+    return 1;
+  /* Segment may not be installed yet. */
+  bitmap = clib_cpool_segment_bitmap (p, index);
+  if (!bitmap)
+    return 1;
+  offset = index & pow2_mask (p->log2_segment_elts);
+  return (bitmap[offset / BITS (uword)] &
+	  ((uword) 1 << (offset % BITS (uword)))) == 0;
+}
+
+always_inline void
+clib_cpool_mark (clib_cpool_t * p, u32 index, int is_alloc)
+{
+  uword *bitmap = clib_cpool_segment_bitmap (p, index);
+  u32 offset = index & pow2_mask (p->log2_segment_elts);
+  uword *w = bitmap + offset / BITS (uword);
+  uword bit = (uword) 1 << (offset % BITS (uword));
+
+  /* Neighbouring elements may be allocated by other threads. */
+  if (is_alloc)
+    __sync_fetch_and_or (w, bit);
+  else
+    __sync_fetch_and_and (w, ~bit);
+}
+
+/** Allocate an element index, ~0 if pool is full. */
+always_inline u32
+clib_cpool_get_index (clib_cpool_t * p, u32 thread_index)
+{
+  clib_cpool_thread_t *t = p->threads + thread_index;
+  u32 index;
+
+  ASSERT (thread_index < p->n_threads);
+
+  if (PREDICT_TRUE (t->n_cached > 0))
+    index = t->indices[--t->n_cached];
+  else
+    {
+      index = clib_cpool_get_index_slow (p, t);
+      if (index == ~0)
+	return index;
+    }
+
+  clib_cpool_mark (p, index, 1 /* is_alloc */ );
+  return index;
+}
+
+/** Allocate an element, 0 if pool is full. */
+always_inline void *
+clib_cpool_get (clib_cpool_t * p, u32 thread_index)
+{
+  u32 index = clib_cpool_get_index (p, thread_index);
+  return index == ~0 ? 0 : clib_cpool_elt_at_index (p, index);
+}
+
+/** Free an element index. Any thread may free any element. */
+always_inline void
+clib_cpool_put_index (clib_cpool_t * p, u32 thread_index, u32 index)
+{
+  clib_cpool_thread_t *t = p->threads + thread_index;
+
+  ASSERT (thread_index < p->n_threads);
+  ASSERT (!clib_cpool_is_free_index (p, index));
+
+  clib_cpool_mark (p, index, 0 /* is_alloc */ );
+
+  if (PREDICT_FALSE (t->n_cached == CLIB_CPOOL_CACHE_SIZE))
+    clib_cpool_put_index_slow (p, t);
+
+  t->indices[t->n_cached++] = index;
+}
+
+/** Iterate over allocated element indices. Concurrent allocations and
+    frees may or may not be seen. */
+#define clib_cpool_foreach_index(i,p,body)				\
+do {									\
+  u32 _cpool_hw = (p)->high_water;					\
+  for ((i) = 0; (i) < _cpool_hw; (i)++)				\
+    {									\
+      if (clib_cpool_is_free_index ((p), (i)))				\
+	continue;							\
+      do { body; } while (0);						\
+    }									\
+} while (0)
+
+#endif /* included_clib_cpool_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -67,7 +67,11 @@ _ (sse42,    1, ecx, 20)  \
 _ (avx,      1, ecx, 28)  \
 _ (avx2,     7, ebx, 5)   \
 _ (avx512f,  7, ebx, 16)  \
+_ (avx512bw, 7, ebx, 30)  \
 _ (x86_aes,  1, ecx, 25)  \
+_ (pclmulqdq, 1, ecx, 1)  \
+_ (vaes,     7, ecx, 9)   \
+_ (vpclmulqdq, 7, ecx, 10) \
 _ (sha,      7, ebx, 29)  \
 _ (invariant_tsc, 0x80000007, edx, 8)
 
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+
+#include <vppinfra/mem.h>
+#include <vppinfra/hugemem.h>
+#include <vppinfra/lock.h>
+#include <vppinfra/format.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+clib_hugemem_main_t clib_hugemem_main;
+
+#define CLIB_HUGEMEM_HEADER_BYTES STRUCT_OFFSET_OF (clib_hugemem_header_t, data)
+
+always_inline void
+clib_hugemem_lock (clib_hugemem_main_t * hm)
+{
+  while (__sync_lock_test_and_set (&hm->lock, 1))
+    CLIB_PAUSE ();
+}
+
+always_inline void
+clib_hugemem_unlock (clib_hugemem_main_t * hm)
+{
+  CLIB_MEMORY_BARRIER ();
+  hm->lock = 0;
+}
+
+/* Back part of the window with memory. */
+static int
+clib_hugemem_map (clib_hugemem_main_t * hm, u8 * start, uword n_bytes)
+{
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+  void *addr;
+
+  if (hm->flags & CLIB_HUGEMEM_F_HUGETLB)
+    flags |= MAP_HUGETLB | (hm->log2_page_bytes << MAP_HUGE_SHIFT);
+
+  addr = mmap (start, n_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (addr == MAP_FAILED)
+    {
+      hm->n_alloc_failures++;
+      return -1;
+    }
+
+  if (!(hm->flags & CLIB_HUGEMEM_F_HUGETLB))
+    madvise (start, n_bytes, MADV_HUGEPAGE);
+
+  return 0;
+}
+
+/* Give memory back, keeping the address range reserved. */
+static void
+clib_hugemem_unmap (u8 * start, uword n_bytes)
+{
+  mmap (start, n_bytes, PROT_NONE,
+	MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+}
+
+/* Carve n_bytes from the first free range big enough, lock held. */
+static u8 *
+clib_hugemem_get_range (clib_hugemem_main_t * hm, uword n_bytes)
+{
+  clib_hugemem_range_t *r;
+  u8 *start;
+
+  vec_foreach (r, hm->free_ranges)
+  {
+    if (r->n_bytes < n_bytes)
+      continue;
+    start = r->start;
+    r->start += n_bytes;
+    r->n_bytes -= n_bytes;
+    if (r->n_bytes == 0)
+      vec_delete (hm->free_ranges, 1, r - hm->free_ranges);
+    return start;
+  }
+
+  return 0;
+}
+
+/* Carve n_bytes starting exactly at start, lock held. */
+static int
+clib_hugemem_get_range_at (clib_hugemem_main_t * hm, u8 * start,
+			   uword n_bytes)
+{
+  clib_hugemem_range_t *r;
+
+  vec_foreach (r, hm->free_ranges)
+  {
+    if (r->start > start)
+      break;
+    if (r->start != start)
+      continue;
+    if (r->n_bytes < n_bytes)
+      break;
+    r->start += n_bytes;
+    r->n_bytes -= n_bytes;
+    if (r->n_bytes == 0)
+      vec_delete (hm->free_ranges, 1, r - hm->free_ranges);
+    return 0;
+  }
+
+  return -1;
+}
+
+/* Return range to the free list, merging neighbours, lock held. */
+static void
+clib_hugemem_put_range (clib_hugemem_main_t * hm, u8 * start, uword n_bytes)
+{
+  clib_hugemem_range_t *r, new;
+  uword i;
+
+  for (i = 0; i < vec_len (hm->free_ranges); i++)
+    if (hm->free_ranges[i].start > start)
+      break;
+
+  /* Merge with previous and / or next range. */
+  if (i > 0)
+    {
+      r = hm->free_ranges + i - 1;
+      if (r->start + r->n_bytes == start)
+	{
+	  r->n_bytes += n_bytes;
+	  if (i < vec_len (hm->free_ranges) && start + n_bytes == r[1].start)
+	    {
+	      r->n_bytes += r[1].n_bytes;
+	      vec_delete (hm->free_ranges, 1, i);
+	    }
+	  return;
+	}
+    }
+
+  if (i < vec_len (hm->free_ranges))
+    {
+      r = hm->free_ranges + i;
+      if (start + n_bytes == r->start)
+	{
+	  r->start = start;
+	  r->n_bytes += n_bytes;
+	  return;
+	}
+    }
+
+  new.start = start;
+  new.n_bytes = n_bytes;
+  vec_insert_elts (hm->free_ranges, &new, 1, i);
+}
+
+void *
+clib_hugemem_alloc_aligned_at_offset (uword size, uword align,
+				      uword align_offset)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  uword page_bytes = (uword) 1 << hm->log2_page_bytes;
+  clib_hugemem_header_t *h;
+  uword n_bytes, pad = 0;
+  void *oldheap;
+  u8 *start, *p;
+
+  /* Objects start on a page boundary plus header. */
+  if (align > 1)
+    {
+      if (align > page_bytes / 2)
+	return 0;
+      pad = align;
+    }
+
+  n_bytes = round_pow2 (CLIB_HUGEMEM_HEADER_BYTES + pad + size, page_bytes);
+
+  /* Free range vector lives on the heap we serve. */
+  oldheap = clib_mem_set_heap (hm->heap);
+  clib_hugemem_lock (hm);
+  start = clib_hugemem_get_range (hm, n_bytes);
+  if (start && clib_hugemem_map (hm, start, n_bytes))
+    {
+      clib_hugemem_put_range (hm, start, n_bytes);
+      start = 0;
+    }
+  if (start)
+    {
+      hm->n_objects++;
+      hm->n_bytes_mapped += n_bytes;
+    }
+  clib_hugemem_unlock (hm);
+  clib_mem_set_heap (oldheap);
+
+  if (!start)
+    return 0;
+
+  h = (clib_hugemem_header_t *) start;
+  h->n_bytes = n_bytes;
+
+  p = start + CLIB_HUGEMEM_HEADER_BYTES;
+  if (align > 1)
+    p += (align - (pointer_to_uword (p + align_offset) & (align - 1)))
+      & (align - 1);
+
+  return p;
+}
+
+/**
+ * Grow an arena object to at least new_size bytes from p, without
+ * copying. Returns 0 if that is not possible, the caller then falls
+ * back to allocate, copy and free.
+ */
+void *
+clib_hugemem_realloc (void *p, uword new_size)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  uword page_bytes = (uword) 1 << hm->log2_page_bytes;
+  clib_hugemem_header_t *h = clib_hugemem_header (p);
+  uword offset = (u8 *) p - (u8 *) h;
+  uword old_bytes = h->n_bytes, new_bytes;
+  void *oldheap, *moved;
+  u8 *start = (u8 *) h, *new_start;
+  int rv;
+
+  new_bytes = round_pow2 (offset + new_size, page_bytes);
+  if (new_bytes <= old_bytes)
+    return p;
+
+  oldheap = clib_mem_set_heap (hm->heap);
+  clib_hugemem_lock (hm);
+
+  /* Space right after the object is free: just map more pages. */
+  rv = clib_hugemem_get_range_at (hm, start + old_bytes,
+				  new_bytes - old_bytes);
+  if (rv == 0)
+    {
+      if (clib_hugemem_map (hm, start + old_bytes, new_bytes - old_bytes))
+	{
+	  clib_hugemem_put_range (hm, start + old_bytes,
+				  new_bytes - old_bytes);
+	  p = 0;
+	  goto done;
+	}
+      hm->n_grow_in_place++;
+      goto grown;
+    }
+
+  /* Otherwise move page tables to a bigger range. hugetlb mappings
+     may not support mremap, caller copies in that case. */
+  new_start = clib_hugemem_get_range (hm, new_bytes);
+  if (!new_start)
+    {
+      p = 0;
+      goto done;
+    }
+
+  moved = mremap (start, old_bytes, new_bytes,
+		  MREMAP_MAYMOVE | MREMAP_FIXED, new_start);
+  if (moved == MAP_FAILED)
+    {
+      clib_hugemem_put_range (hm, new_start, new_bytes);
+      p = 0;
+      goto done;
+    }
+
+  if (!(hm->flags & CLIB_HUGEMEM_F_HUGETLB))
+    madvise (new_start, new_bytes, MADV_HUGEPAGE);
+
+  /* mremap left a hole behind, reserve it again. */
+  clib_hugemem_unmap (start, old_bytes);
+  clib_hugemem_put_range (hm, start, old_bytes);
+  hm->n_grow_remap++;
+
+  start = new_start;
+  h = (clib_hugemem_header_t *) start;
+  p = start + offset;
+
+grown:
+  h->n_bytes = new_bytes;
+  hm->n_bytes_mapped += new_bytes - old_bytes;
+
+done:
+  clib_hugemem_unlock (hm);
+  clib_mem_set_heap (oldheap);
+  return p;
+}
+
+void
+clib_hugemem_free (void *p)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  clib_hugemem_header_t *h = clib_hugemem_header (p);
+  uword n_bytes = h->n_bytes;
+  void *oldheap;
+
+  clib_hugemem_unmap ((u8 *) h, n_bytes);
+
+  oldheap = clib_mem_set_heap (hm->heap);
+  clib_hugemem_lock (hm);
+  clib_hugemem_put_range (hm, (u8 *) h, n_bytes);
+  hm->n_objects--;
+  hm->n_bytes_mapped -= n_bytes;
+  clib_hugemem_unlock (hm);
+  clib_mem_set_heap (oldheap);
+}
+
+/**
+ * Serve allocations of at least threshold bytes from heap with
+ * hugepages.
+ *
+ * @param heap heap to serve, normally the main heap
+ * @param threshold minimum allocation size
+ * @param va_bytes size of the reserved address window
+ * @param log2_page_bytes 21 or 30, only 21 without CLIB_HUGEMEM_F_HUGETLB
+ * @param flags CLIB_HUGEMEM_F_HUGETLB for explicit hugetlb pages,
+ *        otherwise transparent hugepages
+ */
+clib_error_t *
+clib_hugemem_init (void *heap, uword threshold, uword va_bytes,
+		   u32 log2_page_bytes, u32 flags)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  uword page_bytes = (uword) 1 << log2_page_bytes;
+  clib_hugemem_range_t r;
+  void *oldheap;
+  u8 *va, *start;
+  uword slop;
+
+  if (hm->va_start)
+    return clib_error_return (0, "hugepage arena already initialized");
+
+  if (!heap)
+    return clib_error_return (0, "no heap to attach hugepage arena to");
+
+  if (log2_page_bytes != 21 && log2_page_bytes != 30)
+    return clib_error_return (0, "unsupported page size %U",
+			      format_memory_size, page_bytes);
+
+  if (log2_page_bytes != 21 && !(flags & CLIB_HUGEMEM_F_HUGETLB))
+    return clib_error_return (0, "transparent hugepages are 2MB");
+
+  va_bytes = round_pow2 (va_bytes, page_bytes);
+
+  /* Reserve window, aligned to page size. */
+  va = mmap (0, va_bytes + page_bytes, PROT_NONE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (va == MAP_FAILED)
+    return clib_error_return_unix (0, "reserve %U hugepage arena",
+				   format_memory_size, va_bytes);
+
+  start = (u8 *) round_pow2 (pointer_to_uword (va), page_bytes);
+  slop = start - va;
+  if (slop)
+    munmap (va, slop);
+  munmap (start + va_bytes, page_bytes - slop);
+
+  hm->log2_page_bytes = log2_page_bytes;
+  hm->flags = flags;
+  hm->threshold = clib_max (threshold, page_bytes / 2);
+
+  oldheap = clib_mem_set_heap (heap);
+  r.start = start;
+  r.n_bytes = va_bytes;
+  vec_add1 (hm->free_ranges, r);
+  clib_mem_set_heap (oldheap);
+
+  hm->va_start = start;
+  hm->va_end = start + va_bytes;
+
+  /* Publish heap last, it turns on large allocations. */
+  CLIB_MEMORY_BARRIER ();
+  hm->heap = heap;
+
+  return 0;
+}
+
+u8 *
+format_clib_hugemem (u8 * s, va_list * va)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  int verbose = va_arg (*va, int);
+  uword indent = format_get_indent (s);
+  clib_hugemem_range_t *r;
+
+  if (!hm->heap)
+    return format (s, "hugepage arena disabled");
+
+  s = format (s, "hugepage arena %U, %U %s pages, threshold %U",
+	      format_memory_size, hm->va_end - hm->va_start,
+	      format_memory_size, (uword) 1 << hm->log2_page_bytes,
+	      (hm->flags & CLIB_HUGEMEM_F_HUGETLB) ? "hugetlb" : "transparent",
+	      format_memory_size, hm->threshold);
+  s = format (s, "\n%U%wd objects, %U mapped", format_white_space, indent,
+	      hm->n_objects, format_memory_size, hm->n_bytes_mapped);
+  s = format (s, "\n%Ugrown in place %wd, remapped %wd, map failures %wd",
+	      format_white_space, indent, hm->n_grow_in_place,
+	      hm->n_grow_remap, hm->n_alloc_failures);
+
+  if (verbose)
+    vec_foreach (r, hm->free_ranges)
+      s = format (s, "\n%Ufree 0x%lx - 0x%lx (%U)", format_white_space,
+		  indent, r->start, r->start + r->n_bytes,
+		  format_memory_size, r->n_bytes);
+
+  return s;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_clib_hugemem_h
+#define included_clib_hugemem_h
+
+#include <stdarg.h>
+#include <vppinfra/clib.h>
+#include <vppinfra/cache.h>
+#include <vppinfra/clib_error.h>
+
+/** @file
+ * Hugepage arena for large heap objects.
+ *
+ * Allocations from the main heap at or above a size threshold (big
+ * vectors and pools: FIB, adjacency, session tables) are given their
+ * own mapping inside a reserved virtual address window, backed by
+ * transparent 2MB hugepages or by explicit 2MB / 1GB hugetlb pages.
+ *
+ * Each object mapping starts with a small header and is a whole number
+ * of pages, so the header of any object pointer is found by rounding
+ * down to the page size. Growing an object either maps the pages right
+ * after it, or moves its page tables to a larger free range with
+ * mremap, so vec_resize does not copy the data.
+ */
+
+/** Address space reserved for the arena, only backed as used. */
+#define CLIB_HUGEMEM_DEFAULT_VA_BYTES (1ULL << 38)
+
+typedef struct
+{
+  u8 *start;
+  uword n_bytes;
+} clib_hugemem_range_t;
+
+typedef struct
+{
+  /** Bytes mapped for this object, header included. */
+  uword n_bytes;
+  CLIB_CACHE_LINE_ALIGN_MARK (data);
+} clib_hugemem_header_t;
+
+typedef struct
+{
+  /** Reserved address window, zero when not in use. */
+  u8 *va_start;
+  u8 *va_end;
+
+  /** Heap the arena serves large allocations for. */
+  void *heap;
+
+  /** Allocations of at least this many bytes use the arena. */
+  uword threshold;
+
+  u8 log2_page_bytes;
+
+  u8 flags;
+#define CLIB_HUGEMEM_F_HUGETLB (1 << 0)
+
+  /** Protects free_ranges. */
+  volatile u32 lock;
+
+  /** Unused parts of the window, sorted by address. */
+  clib_hugemem_range_t *free_ranges;
+
+  /** Statistics. */
+  uword n_objects;
+  uword n_bytes_mapped;
+  uword n_grow_in_place;
+  uword n_grow_remap;
+  uword n_alloc_failures;
+} clib_hugemem_main_t;
+
+extern clib_hugemem_main_t clib_hugemem_main;
+
+clib_error_t *clib_hugemem_init (void *heap, uword threshold,
+				 uword va_bytes, u32 log2_page_bytes,
+				 u32 flags);
+void *clib_hugemem_alloc_aligned_at_offset (uword size, uword align,
+					    uword align_offset);
+void *clib_hugemem_realloc (void *p, uword new_size);
+void clib_hugemem_free (void *p);
+u8 *format_clib_hugemem (u8 * s, va_list * va);
+
+always_inline uword
+clib_hugemem_is_enabled (void *heap)
+{
+  return clib_hugemem_main.heap != 0 && heap == clib_hugemem_main.heap;
+}
+
+always_inline uword
+clib_hugemem_contains (void *p)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  return (u8 *) p >= hm->va_start && (u8 *) p < hm->va_end;
+}
+
+always_inline clib_hugemem_header_t *
+clib_hugemem_header (void *p)
+{
+  uword page_mask = ((uword) 1 << clib_hugemem_main.log2_page_bytes) - 1;
+  return uword_to_pointer (pointer_to_uword (p) & ~page_mask,
+			   clib_hugemem_header_t *);
+}
+
+/** Bytes available from p to the end of its object. */
+always_inline uword
+clib_hugemem_size (void *p)
+{
+  clib_hugemem_header_t *h = clib_hugemem_header (p);
+  return ((u8 *) h + h->n_bytes) - (u8 *) p;
+}
+
+#endif /* included_clib_hugemem_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
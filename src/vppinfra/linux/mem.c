@@ -14,6 +14,7 @@
  */
 
 #define _GNU_SOURCE
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -302,6 +303,107 @@ clib_mem_vm_ext_map (clib_mem_vm_map_t * a)
   return 0;
 }
 
+/* Add resident bytes of one smaps mapping, scaled to the part of it
+   which overlaps [start, end). The kernel merges adjacent anonymous
+   mappings, so a mapping may extend past the range we asked about. */
+static void
+clib_mem_page_stats_add (clib_mem_page_stats_t * stats, uword start,
+			 uword end, uword vma_start, uword vma_end,
+			 uword kernel_page_kb, uword rss_kb,
+			 uword anon_huge_kb, uword hugetlb_kb)
+{
+  uword lo = clib_max (start, vma_start), hi = clib_min (end, vma_end);
+  f64 fraction;
+
+  if (lo >= hi || kernel_page_kb == 0)
+    return;
+
+  fraction = (f64) (hi - lo) / (vma_end - vma_start);
+  stats->resident_bytes[min_log2 (kernel_page_kb << 10)] +=
+    fraction * ((rss_kb + hugetlb_kb) << 10);
+  stats->transparent_huge_bytes += fraction * (anon_huge_kb << 10);
+}
+
+/**
+ * Resident memory of [start, start + size) by backing page size,
+ * from /proc/self/smaps.
+ */
+void
+clib_mem_get_page_stats (void *start, uword size,
+			 clib_mem_page_stats_t * stats)
+{
+  uword lo = pointer_to_uword (start), hi = lo + size;
+  uword vma_start = 0, vma_end = 0, kernel_page_kb = 0;
+  uword rss_kb = 0, anon_huge_kb = 0, hugetlb_kb = 0;
+  unsigned long a, b, kb;
+  char line[256];
+  FILE *f;
+
+  memset (stats, 0, sizeof (stats[0]));
+
+  if ((f = fopen ("/proc/self/smaps", "r")) == 0)
+    return;
+
+  while (fgets (line, sizeof (line), f))
+    {
+      if (sscanf (line, "%lx-%lx ", &a, &b) == 2)
+	{
+	  clib_mem_page_stats_add (stats, lo, hi, vma_start, vma_end,
+				   kernel_page_kb, rss_kb, anon_huge_kb,
+				   hugetlb_kb);
+	  vma_start = a;
+	  vma_end = b;
+	  kernel_page_kb = rss_kb = anon_huge_kb = hugetlb_kb = 0;
+	}
+      else if (sscanf (line, "KernelPageSize: %lu kB", &kb) == 1)
+	kernel_page_kb = kb;
+      else if (sscanf (line, "Rss: %lu kB", &kb) == 1)
+	rss_kb = kb;
+      else if (sscanf (line, "AnonHugePages: %lu kB", &kb) == 1)
+	anon_huge_kb = kb;
+      /* hugetlb pages are not accounted in Rss */
+      else if (sscanf (line, "Shared_Hugetlb: %lu kB", &kb) == 1
+	       || sscanf (line, "Private_Hugetlb: %lu kB", &kb) == 1)
+	hugetlb_kb += kb;
+    }
+
+  clib_mem_page_stats_add (stats, lo, hi, vma_start, vma_end,
+			   kernel_page_kb, rss_kb, anon_huge_kb, hugetlb_kb);
+  fclose (f);
+}
+
+u8 *
+format_clib_mem_page_stats (u8 * s, va_list * va)
+{
+  clib_mem_page_stats_t *stats = va_arg (*va, clib_mem_page_stats_t *);
+  uword log2_default = min_log2 (clib_mem_get_page_size ());
+  int i, n = 0;
+
+  for (i = 0; i < ARRAY_LEN (stats->resident_bytes); i++)
+    {
+      uword bytes = stats->resident_bytes[i];
+
+      if (bytes == 0)
+	continue;
+      if (i == log2_default && stats->transparent_huge_bytes)
+	{
+	  bytes -= clib_min (bytes, stats->transparent_huge_bytes);
+	  s = format (s, "%s%U transparent huge pages %U", n++ ? ", " : "",
+		      format_memory_size, (uword) 1 << 21,
+		      format_memory_size, stats->transparent_huge_bytes);
+	}
+      if (bytes)
+	s = format (s, "%s%U pages %U", n++ ? ", " : "",
+		    format_memory_size, (uword) 1 << i,
+		    format_memory_size, bytes);
+    }
+
+  if (n == 0)
+    s = format (s, "nothing resident");
+
+  return s;
+}
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -44,8 +44,10 @@
 
 #include <vppinfra/clib.h>	/* uword, etc */
 #include <vppinfra/clib_error.h>
+#include <vppinfra/hugemem.h>
 #include <vppinfra/mheap_bootstrap.h>
 #include <vppinfra/os.h>
+#include <vppinfra/slab.h>
 #include <vppinfra/string.h>	/* memcpy, memset */
 #include <vppinfra/valgrind.h>
 
@@ -88,6 +90,24 @@ clib_mem_alloc_aligned_at_offset (uword size, uword align, uword align_offset,
 
   cpu = os_get_thread_index ();
   heap = clib_per_cpu_mheaps[cpu];
+
+  /* Small objects from the main heap come from the slab allocator,
+     if enabled. */
+  if (clib_slab_is_enabled (heap) && size <= CLIB_SLAB_MAX_OBJECT_BYTES)
+    {
+      p = clib_slab_alloc_aligned_at_offset (size, align, align_offset);
+      if (p)
+	return p;
+    }
+
+  /* Large ones from the hugepage arena, if enabled. */
+  if (clib_hugemem_is_enabled (heap) && size >= clib_hugemem_main.threshold)
+    {
+      p = clib_hugemem_alloc_aligned_at_offset (size, align, align_offset);
+      if (p)
+	return p;
+    }
+
   heap = mheap_get_aligned (heap, size, align, align_offset, &offset);
   clib_per_cpu_mheaps[cpu] = heap;
 
@@ -165,6 +185,12 @@ clib_mem_is_heap_object (void *p)
   uword offset = (uword) p - (uword) heap;
   mheap_elt_t *e, *n;
 
+  if (clib_slab_contains (p))
+    return clib_slab_is_object (p);
+
+  if (clib_hugemem_contains (p))
+    return 1;
+
   if (offset >= vec_len (heap))
     return 0;
 
@@ -180,6 +206,18 @@ clib_mem_free (void *p)
 {
   u8 *heap = clib_mem_get_per_cpu_heap ();
 
+  if (clib_slab_contains (p))
+    {
+      clib_slab_free (p);
+      return;
+    }
+
+  if (clib_hugemem_contains (p))
+    {
+      clib_hugemem_free (p);
+      return;
+    }
+
   /* Make sure object is in the correct heap. */
   ASSERT (clib_mem_is_heap_object (p));
 
@@ -193,8 +231,14 @@ clib_mem_free (void *p)
 always_inline void *
 clib_mem_realloc (void *p, uword new_size, uword old_size)
 {
+  void *q;
+
+  /* Hugepage arena objects grow by remapping, without a copy. */
+  if (clib_hugemem_contains (p) && (q = clib_hugemem_realloc (p, new_size)))
+    return q;
+
   /* By default use alloc, copy and free to emulate realloc. */
-  void *q = clib_mem_alloc (new_size);
+  q = clib_mem_alloc (new_size);
   if (q)
     {
       uword copy_size;
@@ -212,6 +256,10 @@ always_inline uword
 clib_mem_size (void *p)
 {
   ASSERT (clib_mem_is_heap_object (p));
+  if (clib_slab_contains (p))
+    return clib_slab_size (p);
+  if (clib_hugemem_contains (p))
+    return clib_hugemem_size (p);
   mheap_elt_t *e = mheap_user_pointer_to_elt (p);
   return mheap_elt_data_bytes (e);
 }
@@ -364,6 +412,20 @@ typedef struct
 clib_error_t *clib_mem_vm_ext_map (clib_mem_vm_map_t * a);
 void clib_mem_vm_randomize_va (uword * requested_va, u32 log2_page_size);
 
+typedef struct
+{
+  /** Resident bytes, by log2 of backing page size. */
+  uword resident_bytes[BITS (uword)];
+
+  /** Part of default page size resident bytes which is actually
+      backed by transparent hugepages. */
+  uword transparent_huge_bytes;
+} clib_mem_page_stats_t;
+
+void clib_mem_get_page_stats (void *start, uword size,
+			      clib_mem_page_stats_t * stats);
+u8 *format_clib_mem_page_stats (u8 * s, va_list * va);
+
 #include <vppinfra/error.h>	/* clib_panic */
 
 #endif /* _included_clib_mem_h */
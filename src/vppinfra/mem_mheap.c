@@ -126,13 +126,45 @@ u8 *
 format_clib_mem_usage (u8 * s, va_list * va)
 {
   int verbose = va_arg (*va, int);
-  return format (s, "%U", format_mheap, clib_mem_get_heap (), verbose);
+  void *heap = clib_mem_get_heap ();
+  uword indent = format_get_indent (s);
+
+  s = format (s, "%U", format_mheap, heap, verbose);
+  if (clib_slab_is_enabled (heap))
+    s = format (s, "\n%U%U", format_white_space, indent,
+		format_clib_slab, verbose);
+  if (clib_hugemem_is_enabled (heap))
+    s = format (s, "\n%U%U", format_white_space, indent,
+		format_clib_hugemem, verbose);
+  return s;
 }
 
 void
 clib_mem_usage (clib_mem_usage_t * u)
 {
-  mheap_usage (clib_mem_get_heap (), u);
+  void *heap = clib_mem_get_heap ();
+
+  mheap_usage (heap, u);
+
+  if (clib_slab_is_enabled (heap))
+    {
+      clib_slab_usage_t su;
+
+      clib_slab_usage (&su);
+      u->object_count += su.n_objects;
+      u->bytes_total += su.bytes_total;
+      u->bytes_used += su.bytes_used;
+      u->bytes_free += su.bytes_total - su.bytes_used;
+    }
+
+  if (clib_hugemem_is_enabled (heap))
+    {
+      clib_hugemem_main_t *hm = &clib_hugemem_main;
+
+      u->object_count += hm->n_objects;
+      u->bytes_total += hm->n_bytes_mapped;
+      u->bytes_used += hm->n_bytes_mapped;
+    }
 }
 
 /* Call serial number for debugger breakpoints. */
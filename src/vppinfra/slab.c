@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vppinfra/mem.h>
+#include <vppinfra/slab.h>
+#include <vppinfra/format.h>
+
+clib_slab_main_t clib_slab_main;
+
+/* Index of calling thread's slab state, assigned on first use. */
+static __thread u32 clib_slab_thread_index = ~0;
+
+#define CLIB_SLAB_BYTES (1 << CLIB_SLAB_LOG2_SLAB_BYTES)
+
+always_inline u8 *
+clib_slab_base (clib_slab_main_t * sm, u32 si)
+{
+  return sm->arena_start + ((uword) si << CLIB_SLAB_LOG2_SLAB_BYTES);
+}
+
+always_inline u32
+clib_slab_n_objects (clib_slab_t * s)
+{
+  return CLIB_SLAB_BYTES >> s->log2_object_bytes;
+}
+
+static clib_slab_thread_t *
+clib_slab_get_thread (clib_slab_main_t * sm, u32 * thread_index)
+{
+  u32 ti = clib_slab_thread_index;
+
+  if (PREDICT_FALSE (ti == ~0))
+    {
+      ti = __sync_fetch_and_add (&sm->n_threads, 1);
+      if (ti > CLIB_SLAB_MAX_THREADS)
+	ti = CLIB_SLAB_MAX_THREADS;
+      clib_slab_thread_index = ti;
+    }
+
+  /* Too many threads: caller falls back to mheap. */
+  if (PREDICT_FALSE (ti == CLIB_SLAB_MAX_THREADS))
+    return 0;
+
+  *thread_index = ti;
+  return sm->threads + ti;
+}
+
+static u32
+clib_slab_get_free_slab (clib_slab_main_t * sm)
+{
+  u64 old, new;
+  u32 si;
+
+  /* Reuse a released slab first. The tag in the upper half of
+     free_slabs is bumped on every change to avoid ABA. */
+  while (1)
+    {
+      old = sm->free_slabs;
+      si = (u32) old;
+      if (si == ~0)
+	break;
+      new = (((old >> 32) + 1) << 32) | sm->slabs[si].next;
+      if (__sync_bool_compare_and_swap (&sm->free_slabs, old, new))
+	return si;
+    }
+
+  if (sm->n_slabs_carved >= sm->n_slabs)
+    return ~0;
+
+  si = __sync_fetch_and_add (&sm->n_slabs_carved, 1);
+  if (si >= sm->n_slabs)
+    return ~0;
+
+  return si;
+}
+
+static void
+clib_slab_put_free_slab (clib_slab_main_t * sm, u32 si)
+{
+  clib_slab_t *s = sm->slabs + si;
+  u64 old, new;
+
+  do
+    {
+      old = sm->free_slabs;
+      s->next = (u32) old;
+      new = (((old >> 32) + 1) << 32) | si;
+    }
+  while (!__sync_bool_compare_and_swap (&sm->free_slabs, old, new));
+}
+
+always_inline void
+clib_slab_partial_add (clib_slab_main_t * sm, clib_slab_thread_t * t,
+		       u32 si, u32 c)
+{
+  clib_slab_t *s = sm->slabs + si;
+
+  s->prev = ~0;
+  s->next = t->partial_slabs[c];
+  if (s->next != ~0)
+    sm->slabs[s->next].prev = si;
+  t->partial_slabs[c] = si;
+  s->flags |= CLIB_SLAB_F_ON_PARTIAL_LIST;
+}
+
+always_inline void
+clib_slab_partial_remove (clib_slab_main_t * sm, clib_slab_thread_t * t,
+			  u32 si, u32 c)
+{
+  clib_slab_t *s = sm->slabs + si;
+
+  if (s->prev != ~0)
+    sm->slabs[s->prev].next = s->next;
+  else
+    t->partial_slabs[c] = s->next;
+  if (s->next != ~0)
+    sm->slabs[s->next].prev = s->prev;
+  s->flags &= ~CLIB_SLAB_F_ON_PARTIAL_LIST;
+}
+
+/* Free object owned by the calling thread. */
+static void
+clib_slab_free_local (clib_slab_main_t * sm, clib_slab_thread_t * t,
+		      u8 * object)
+{
+  u32 si = (object - sm->arena_start) >> CLIB_SLAB_LOG2_SLAB_BYTES;
+  clib_slab_t *s = sm->slabs + si;
+  u32 c = s->log2_object_bytes - CLIB_SLAB_MIN_LOG2_OBJECT_BYTES;
+
+  *(u32 *) object = s->free_offset;
+  s->free_offset = object - clib_slab_base (sm, si);
+  s->n_used--;
+  t->n_frees++;
+
+  if (si == t->current_slab[c])
+    return;
+
+  if (s->n_used == 0)
+    {
+      if (s->flags & CLIB_SLAB_F_ON_PARTIAL_LIST)
+	clib_slab_partial_remove (sm, t, si, c);
+      s->flags = 0;
+      clib_slab_put_free_slab (sm, si);
+    }
+  else if (!(s->flags & CLIB_SLAB_F_ON_PARTIAL_LIST))
+    clib_slab_partial_add (sm, t, si, c);
+}
+
+static void
+clib_slab_drain_remote_frees (clib_slab_main_t * sm, clib_slab_thread_t * t)
+{
+  void *p, *next;
+
+  if (t->remote_free == 0)
+    return;
+
+  p = __sync_lock_test_and_set (&t->remote_free, 0);
+  while (p)
+    {
+      next = *(void **) p;
+      clib_slab_free_local (sm, t, p);
+      p = next;
+    }
+}
+
+always_inline u8 *
+clib_slab_get_object_from_slab (clib_slab_main_t * sm, u32 si)
+{
+  clib_slab_t *s = sm->slabs + si;
+  u8 *base = clib_slab_base (sm, si);
+  u8 *p;
+
+  if (s->free_offset != ~0)
+    {
+      p = base + s->free_offset;
+      s->free_offset = *(u32 *) p;
+    }
+  else if (s->n_bumped < clib_slab_n_objects (s))
+    p = base + ((uword) s->n_bumped++ << s->log2_object_bytes);
+  else
+    return 0;
+
+  s->n_used++;
+  return p;
+}
+
+static never_inline u8 *
+clib_slab_refill (clib_slab_main_t * sm, clib_slab_thread_t * t,
+		  u32 thread_index, u32 c)
+{
+  clib_slab_t *s;
+  u32 si;
+  u8 *p;
+
+  t->n_slab_refills++;
+
+  /* Remote frees may have refilled the current slab. */
+  clib_slab_drain_remote_frees (sm, t);
+  si = t->current_slab[c];
+  if (si != ~0 && (p = clib_slab_get_object_from_slab (sm, si)))
+    return p;
+
+  /* Current slab is full and stays off the partial list until
+     one of its objects is freed. */
+  si = t->partial_slabs[c];
+  if (si != ~0)
+    clib_slab_partial_remove (sm, t, si, c);
+  else
+    {
+      si = clib_slab_get_free_slab (sm);
+      if (si == ~0)
+	return 0;
+      s = sm->slabs + si;
+      s->free_offset = ~0;
+      s->n_bumped = 0;
+      s->n_used = 0;
+      s->owner_thread = thread_index;
+      s->log2_object_bytes = c + CLIB_SLAB_MIN_LOG2_OBJECT_BYTES;
+      s->flags = CLIB_SLAB_F_IN_USE;
+    }
+
+  t->current_slab[c] = si;
+  return clib_slab_get_object_from_slab (sm, si);
+}
+
+void *
+clib_slab_alloc_aligned_at_offset (uword size, uword align,
+				   uword align_offset)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  clib_slab_thread_t *t;
+  uword pad = 0, log2_bytes;
+  u32 thread_index, si, c;
+  u8 *p;
+
+  t = clib_slab_get_thread (sm, &thread_index);
+  if (PREDICT_FALSE (t == 0))
+    return 0;
+
+  /* Objects are aligned to their size class, so an aligned request is
+     served from a class at least as big as the alignment, with the
+     returned pointer moved forward to satisfy align_offset. */
+  if (align > 1)
+    {
+      pad = (align - (align_offset & (align - 1))) & (align - 1);
+      size += pad;
+      if (size < align)
+	size = align;
+    }
+
+  log2_bytes = size > 0 ? max_log2 (size) : 0;
+  if (log2_bytes < CLIB_SLAB_MIN_LOG2_OBJECT_BYTES)
+    log2_bytes = CLIB_SLAB_MIN_LOG2_OBJECT_BYTES;
+  if (log2_bytes > CLIB_SLAB_MAX_LOG2_OBJECT_BYTES)
+    return 0;
+
+  c = log2_bytes - CLIB_SLAB_MIN_LOG2_OBJECT_BYTES;
+  si = t->current_slab[c];
+
+  if (PREDICT_FALSE (si == ~0 ||
+		     !(p = clib_slab_get_object_from_slab (sm, si))))
+    {
+      p = clib_slab_refill (sm, t, thread_index, c);
+      if (!p)
+	return 0;
+    }
+
+  t->n_allocs++;
+  return p + pad;
+}
+
+void
+clib_slab_free (void *p)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  clib_slab_t *s = clib_slab_for_pointer (p);
+  clib_slab_thread_t *t, *owner;
+  uword object_bytes = (uword) 1 << s->log2_object_bytes;
+  u8 *object = uword_to_pointer (pointer_to_uword (p) & ~(object_bytes - 1),
+				 u8 *);
+  u32 thread_index = ~0;
+  void *old;
+
+  ASSERT (s->flags & CLIB_SLAB_F_IN_USE);
+
+  t = clib_slab_get_thread (sm, &thread_index);
+  if (PREDICT_TRUE (t && thread_index == s->owner_thread))
+    {
+      clib_slab_free_local (sm, t, object);
+      return;
+    }
+
+  /* Hand object back to the owning thread. */
+  owner = sm->threads + s->owner_thread;
+  do
+    {
+      old = owner->remote_free;
+      *(void **) object = old;
+    }
+  while (!__sync_bool_compare_and_swap (&owner->remote_free, old, object));
+
+  if (t)
+    t->n_remote_frees++;
+}
+
+clib_error_t *
+clib_slab_init (void *heap, uword arena_bytes, u32 flags)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  uword slab_bytes = CLIB_SLAB_BYTES;
+  uword header_bytes, thread_bytes, page_bytes;
+  u8 *arena = 0;
+  int i, j;
+
+  if (sm->arena_start)
+    return clib_error_return (0, "slab allocator already initialized");
+
+  if (!heap)
+    return clib_error_return (0, "no heap to attach slab allocator to");
+
+  /* Hugepage backed arenas are sized in 2MB pages. */
+  arena_bytes = round_pow2 (arena_bytes, 1ULL << 21);
+
+  if (flags & CLIB_SLAB_F_HUGETLB)
+    {
+      clib_mem_vm_alloc_t alloc = { 0 };
+      clib_error_t *err;
+
+      alloc.name = "slab arena";
+      alloc.size = arena_bytes;
+      alloc.flags = CLIB_MEM_VM_F_HUGETLB;
+      err = clib_mem_vm_ext_alloc (&alloc);
+      if (err)
+	{
+	  clib_warning ("hugepage slab arena: %U, using default page size",
+			format_clib_error, err);
+	  clib_error_free (err);
+	}
+      else
+	{
+	  arena = alloc.addr;
+	  sm->log2_page_bytes = alloc.log2_page_size;
+	}
+    }
+
+  if (!arena)
+    {
+      u8 *va;
+      uword slop;
+
+      /* Over-allocate so arena can be aligned to slab size, then give
+         the unaligned head and tail back. */
+      va = clib_mem_vm_alloc (arena_bytes + slab_bytes);
+      if (!va)
+	return clib_error_return_unix (0, "mmap slab arena");
+      arena = (u8 *) round_pow2 (pointer_to_uword (va), slab_bytes);
+      slop = arena - va;
+      if (slop)
+	clib_mem_vm_free (va, slop);
+      clib_mem_vm_free (arena + arena_bytes, slab_bytes - slop);
+      sm->log2_page_bytes = min_log2 (clib_mem_get_page_size ());
+    }
+
+  page_bytes = clib_mem_get_page_size ();
+  sm->n_slabs = arena_bytes >> CLIB_SLAB_LOG2_SLAB_BYTES;
+  header_bytes = round_pow2 (sm->n_slabs * sizeof (clib_slab_t), page_bytes);
+  thread_bytes = round_pow2 (CLIB_SLAB_MAX_THREADS *
+			     sizeof (clib_slab_thread_t), page_bytes);
+
+  /* Allocator state must not come from the heap it is serving. */
+  sm->slabs = clib_mem_vm_alloc (header_bytes);
+  sm->threads = clib_mem_vm_alloc (thread_bytes);
+  if (!sm->slabs || !sm->threads)
+    return clib_error_return_unix (0, "mmap slab allocator state");
+
+  for (i = 0; i < CLIB_SLAB_MAX_THREADS; i++)
+    for (j = 0; j < CLIB_SLAB_N_SIZE_CLASSES; j++)
+      {
+	sm->threads[i].current_slab[j] = ~0;
+	sm->threads[i].partial_slabs[j] = ~0;
+      }
+
+  sm->free_slabs = (u32) ~ 0;
+  sm->n_slabs_carved = 0;
+  sm->arena_start = arena;
+  sm->arena_end = arena + arena_bytes;
+
+  /* Publish heap last, it turns on slab allocation. */
+  CLIB_MEMORY_BARRIER ();
+  sm->heap = heap;
+
+  return 0;
+}
+
+void
+clib_slab_usage (clib_slab_usage_t * u)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  u32 si, n_carved;
+  clib_slab_t *s;
+
+  memset (u, 0, sizeof (u[0]));
+  n_carved = clib_min (sm->n_slabs_carved, sm->n_slabs);
+
+  for (si = 0; si < n_carved; si++)
+    {
+      s = sm->slabs + si;
+      if (!(s->flags & CLIB_SLAB_F_IN_USE))
+	continue;
+      u->n_objects += s->n_used;
+      u->bytes_used += (uword) s->n_used << s->log2_object_bytes;
+      u->bytes_total += CLIB_SLAB_BYTES;
+    }
+}
+
+u8 *
+format_clib_slab (u8 * s, va_list * va)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  int verbose = va_arg (*va, int);
+  uword n_slabs[CLIB_SLAB_N_SIZE_CLASSES] = { 0 };
+  uword n_objects[CLIB_SLAB_N_SIZE_CLASSES] = { 0 };
+  u64 n_allocs = 0, n_frees = 0, n_remote_frees = 0, n_refills = 0;
+  uword indent = format_get_indent (s);
+  u32 si, n_carved, n_threads, c;
+  clib_slab_thread_t *t;
+  clib_slab_usage_t u;
+  clib_slab_t *slab;
+
+  if (!sm->heap)
+    return format (s, "slab allocator disabled");
+
+  clib_slab_usage (&u);
+  n_carved = clib_min (sm->n_slabs_carved, sm->n_slabs);
+  n_threads = clib_min (sm->n_threads, CLIB_SLAB_MAX_THREADS);
+
+  s = format (s, "slab arena %U, %uk pages, %u of %u slabs carved",
+	      format_memory_size, sm->arena_end - sm->arena_start,
+	      1 << (sm->log2_page_bytes - 10), n_carved, sm->n_slabs);
+  s = format (s, "\n%U%u objects, used %U, slabs in use %U",
+	      format_white_space, indent, u.n_objects,
+	      format_memory_size, u.bytes_used,
+	      format_memory_size, u.bytes_total);
+
+  for (t = sm->threads; t < sm->threads + n_threads; t++)
+    {
+      n_allocs += t->n_allocs;
+      n_frees += t->n_frees;
+      n_remote_frees += t->n_remote_frees;
+      n_refills += t->n_slab_refills;
+    }
+  s = format (s, "\n%U%u threads, %Lu allocs, %Lu frees, %Lu remote frees, "
+	      "%Lu refills", format_white_space, indent, n_threads,
+	      n_allocs, n_frees, n_remote_frees, n_refills);
+
+  if (!verbose)
+    return s;
+
+  for (si = 0; si < n_carved; si++)
+    {
+      slab = sm->slabs + si;
+      if (!(slab->flags & CLIB_SLAB_F_IN_USE))
+	continue;
+      c = slab->log2_object_bytes - CLIB_SLAB_MIN_LOG2_OBJECT_BYTES;
+      n_slabs[c]++;
+      n_objects[c] += slab->n_used;
+    }
+
+  s = format (s, "\n%U%=12s%=12s%=12s", format_white_space, indent,
+	      "Size", "Slabs", "Objects");
+  for (c = 0; c < CLIB_SLAB_N_SIZE_CLASSES; c++)
+    if (n_slabs[c])
+      s = format (s, "\n%U%=12U%=12wd%=12wd", format_white_space, indent,
+		  format_memory_size,
+		  (uword) 1 << (c + CLIB_SLAB_MIN_LOG2_OBJECT_BYTES),
+		  n_slabs[c], n_objects[c]);
+
+  return s;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
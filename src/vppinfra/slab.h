@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_clib_slab_h
+#define included_clib_slab_h
+
+#include <stdarg.h>
+#include <vppinfra/clib.h>
+#include <vppinfra/cache.h>
+#include <vppinfra/clib_error.h>
+
+/** @file
+ * Size-class slab allocator.
+ *
+ * Small objects (up to CLIB_SLAB_MAX_OBJECT_BYTES) allocated from the
+ * main heap are served from a single contiguous arena, optionally backed
+ * by hugepages.  The arena is carved into fixed-size slabs, each slab
+ * holding objects of a single power-of-2 size class and owned by a
+ * single thread.  Allocation and same-thread free never take a lock.
+ * Objects freed by a thread other than the owner are pushed onto the
+ * owner's lock-free remote free queue and reclaimed by the owner the next
+ * time it runs out of objects.  Empty slabs go back to a global free
+ * slab stack and can be reused for any size class by any thread.
+ *
+ * Slab headers live out of line, so objects are naturally aligned to
+ * their size class and the containing object of any pointer is found by
+ * masking.  Allocations which cannot be served (too large, alignment
+ * bigger than the largest class, arena exhausted) fall back to mheap.
+ */
+
+#define CLIB_SLAB_MIN_LOG2_OBJECT_BYTES 4
+#define CLIB_SLAB_MAX_LOG2_OBJECT_BYTES 14
+#define CLIB_SLAB_MAX_OBJECT_BYTES (1 << CLIB_SLAB_MAX_LOG2_OBJECT_BYTES)
+#define CLIB_SLAB_N_SIZE_CLASSES \
+  (CLIB_SLAB_MAX_LOG2_OBJECT_BYTES - CLIB_SLAB_MIN_LOG2_OBJECT_BYTES + 1)
+
+#define CLIB_SLAB_LOG2_SLAB_BYTES 16
+#define CLIB_SLAB_MAX_THREADS 256
+
+typedef struct
+{
+  /** Offset of first free object in slab, ~0 if none. Free objects
+      are linked through their first u32. */
+  u32 free_offset;
+
+  /** Number of objects carved so far from the untouched slab tail. */
+  u32 n_bumped;
+
+  /** Number of objects currently allocated. */
+  u32 n_used;
+
+  /** Partial slab list or global free slab stack linkage. */
+  u32 next, prev;
+
+  /** Index of owning thread state. */
+  u16 owner_thread;
+
+  u8 log2_object_bytes;
+
+  u8 flags;
+#define CLIB_SLAB_F_IN_USE (1 << 0)
+#define CLIB_SLAB_F_ON_PARTIAL_LIST (1 << 1)
+} clib_slab_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+
+  /** Slab objects are currently taken from, per size class. */
+  u32 current_slab[CLIB_SLAB_N_SIZE_CLASSES];
+
+  /** Head of list of partially used slabs, per size class. */
+  u32 partial_slabs[CLIB_SLAB_N_SIZE_CLASSES];
+
+  /** Statistics. */
+  u64 n_allocs;
+  u64 n_frees;
+  u64 n_remote_frees;
+  u64 n_slab_refills;
+
+  /** Objects freed by other threads, linked through their first word.
+      Written by remote threads, so kept on its own cache line. */
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
+  void *volatile remote_free;
+} clib_slab_thread_t;
+
+typedef struct
+{
+  /** Arena boundaries, zero when the slab allocator is not in use. */
+  u8 *arena_start;
+  u8 *arena_end;
+
+  /** Heap the slab allocator serves small allocations for. */
+  void *heap;
+
+  /** Slab headers, one per slab in the arena. */
+  clib_slab_t *slabs;
+  u32 n_slabs;
+
+  /** Number of slabs carved from the arena so far. */
+  volatile u32 n_slabs_carved;
+
+  /** Released slabs: (ABA tag << 32) | first slab index. */
+  volatile u64 free_slabs;
+
+  /** Per-thread state, assigned on first use. */
+  clib_slab_thread_t *threads;
+  volatile u32 n_threads;
+
+  /** Log2 page size backing the arena. */
+  u8 log2_page_bytes;
+} clib_slab_main_t;
+
+extern clib_slab_main_t clib_slab_main;
+
+typedef struct
+{
+  uword n_objects;
+  uword bytes_used;
+  uword bytes_total;
+} clib_slab_usage_t;
+
+/** clib_slab_init flags */
+#define CLIB_SLAB_F_HUGETLB (1 << 0)
+
+clib_error_t *clib_slab_init (void *heap, uword arena_bytes, u32 flags);
+void *clib_slab_alloc_aligned_at_offset (uword size, uword align,
+					 uword align_offset);
+void clib_slab_free (void *p);
+void clib_slab_usage (clib_slab_usage_t * u);
+u8 *format_clib_slab (u8 * s, va_list * va);
+
+always_inline uword
+clib_slab_is_enabled (void *heap)
+{
+  return clib_slab_main.heap != 0 && heap == clib_slab_main.heap;
+}
+
+always_inline uword
+clib_slab_contains (void *p)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  return (u8 *) p >= sm->arena_start && (u8 *) p < sm->arena_end;
+}
+
+always_inline clib_slab_t *
+clib_slab_for_pointer (void *p)
+{
+  clib_slab_main_t *sm = &clib_slab_main;
+  uword offset = (u8 *) p - sm->arena_start;
+  return sm->slabs + (offset >> CLIB_SLAB_LOG2_SLAB_BYTES);
+}
+
+/** Bytes available from p to the end of its slab object. */
+always_inline uword
+clib_slab_size (void *p)
+{
+  clib_slab_t *s = clib_slab_for_pointer (p);
+  uword object_bytes = (uword) 1 << s->log2_object_bytes;
+  return object_bytes - (pointer_to_uword (p) & (object_bytes - 1));
+}
+
+always_inline uword
+clib_slab_is_object (void *p)
+{
+  clib_slab_t *s = clib_slab_for_pointer (p);
+  return (s->flags & CLIB_SLAB_F_IN_USE) != 0;
+}
+
+#endif /* included_clib_slab_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
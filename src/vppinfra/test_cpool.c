@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <vppinfra/cpool.h>
+#include <vppinfra/mheap.h>
+#include <vppinfra/format.h>
+#include <vppinfra/random.h>
+#include <vppinfra/time.h>
+
+typedef struct
+{
+  u32 owner;
+  u32 serial;
+  u64 pad;
+} test_elt_t;
+
+typedef struct
+{
+  clib_cpool_t pool;
+  u32 n_threads;
+  u32 n_objects;
+  u32 n_iterations;
+  u32 seed;
+  u32 verbose;
+  volatile u32 n_errors;
+} test_main_t;
+
+test_main_t test_main;
+
+typedef struct
+{
+  u32 thread_index;
+  u32 *indices;
+  f64 clocks_per_op;
+} test_thread_t;
+
+static void *
+test_cpool_thread (void *arg)
+{
+  test_main_t *tm = &test_main;
+  test_thread_t *tt = arg;
+  u32 ti = tt->thread_index, seed = tt->thread_index + tm->seed;
+  test_elt_t *e;
+  u32 i, j, index;
+  u64 t0;
+
+  vec_validate_init_empty (tt->indices, tm->n_objects - 1, ~0);
+
+  t0 = clib_cpu_time_now ();
+  for (i = 0; i < tm->n_iterations; i++)
+    {
+      j = random_u32 (&seed) % tm->n_objects;
+      index = tt->indices[j];
+
+      if (index != ~0)
+	{
+	  /* Nobody else touched our element */
+	  e = clib_cpool_elt_at_index (&tm->pool, index);
+	  if (e->owner != ti || e->serial != j)
+	    __sync_fetch_and_add (&tm->n_errors, 1);
+	  clib_cpool_put_index (&tm->pool, ti, index);
+	  tt->indices[j] = ~0;
+	}
+      else
+	{
+	  index = clib_cpool_get_index (&tm->pool, ti);
+	  if (index == ~0)
+	    continue;
+	  e = clib_cpool_elt_at_index (&tm->pool, index);
+	  e->owner = ti;
+	  e->serial = j;
+	  tt->indices[j] = index;
+	}
+    }
+  tt->clocks_per_op = (f64) (clib_cpu_time_now () - t0) / tm->n_iterations;
+
+  return 0;
+}
+
+static clib_error_t *
+test_cpool (test_main_t * tm)
+{
+  test_thread_t *threads = 0, *tt;
+  pthread_t *tids = 0;
+  uword n_expected = 0, n_seen = 0;
+  u32 i, j;
+
+  clib_cpool_init (&tm->pool, sizeof (test_elt_t), 10 /* 1k per segment */ ,
+		   0 /* no max */ , tm->n_threads);
+
+  vec_validate (threads, tm->n_threads - 1);
+  vec_validate (tids, tm->n_threads - 1);
+
+  for (i = 0; i < tm->n_threads; i++)
+    {
+      threads[i].thread_index = i;
+      if (pthread_create (&tids[i], 0, test_cpool_thread, &threads[i]))
+	return clib_error_return_unix (0, "pthread_create");
+    }
+
+  for (i = 0; i < tm->n_threads; i++)
+    pthread_join (tids[i], 0);
+
+  vec_foreach (tt, threads)
+  {
+    for (j = 0; j < tm->n_objects; j++)
+      n_expected += tt->indices[j] != ~0;
+    if (tm->verbose)
+      fformat (stdout, "thread %d: %.2f clocks/op\n", tt->thread_index,
+	       tt->clocks_per_op);
+  }
+
+  clib_cpool_foreach_index (i, &tm->pool, (
+					    {
+					    n_seen++;
+					    }
+			    ));
+
+  fformat (stdout, "%d threads, %d elts allocated, high water %d\n",
+	   tm->n_threads, clib_cpool_elts (&tm->pool), tm->pool.high_water);
+
+  if (tm->n_errors)
+    return clib_error_return (0, "%d corrupted elements", tm->n_errors);
+  if (n_expected != clib_cpool_elts (&tm->pool) || n_expected != n_seen)
+    return clib_error_return (0, "expected %d elts, counted %d, iterated %d",
+			      n_expected, clib_cpool_elts (&tm->pool),
+			      n_seen);
+
+  vec_foreach (tt, threads)
+  {
+    for (j = 0; j < tm->n_objects; j++)
+      if (tt->indices[j] != ~0)
+	clib_cpool_put_index (&tm->pool, tt->thread_index, tt->indices[j]);
+    vec_free (tt->indices);
+  }
+
+  if (clib_cpool_elts (&tm->pool))
+    return clib_error_return (0, "%d elts leaked",
+			      clib_cpool_elts (&tm->pool));
+
+  clib_cpool_free (&tm->pool);
+  vec_free (threads);
+  vec_free (tids);
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  test_main_t *tm = &test_main;
+  unformat_input_t i;
+  clib_error_t *error;
+
+  /* Segments are allocated from several threads */
+  mheap_header (clib_mem_init (0, 256ULL << 20))->flags |=
+    MHEAP_FLAG_THREAD_SAFE;
+
+  tm->n_threads = 4;
+  tm->n_objects = 10000;
+  tm->n_iterations = 1000000;
+  tm->seed = 0xdeadbeef;
+
+  unformat_init_command_line (&i, argv);
+  while (unformat_check_input (&i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (&i, "threads %d", &tm->n_threads))
+	;
+      else if (unformat (&i, "objects %d", &tm->n_objects))
+	;
+      else if (unformat (&i, "iter %d", &tm->n_iterations))
+	;
+      else if (unformat (&i, "seed %d", &tm->seed))
+	;
+      else if (unformat (&i, "verbose"))
+	tm->verbose = 1;
+      else
+	{
+	  clib_warning ("unknown input '%U'", format_unformat_error, &i);
+	  return 1;
+	}
+    }
+  unformat_free (&i);
+
+  error = test_cpool (tm);
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2018 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vppinfra/mem.h>
+#include <vppinfra/vec.h>
+#include <vppinfra/pool.h>
+#include <vppinfra/format.h>
+#include <vppinfra/error.h>
+
+typedef struct
+{
+  u32 n_elts;
+  u32 n_vectors;
+  u32 log2_page_bytes;
+  u32 flags;
+  u32 verbose;
+} test_main_t;
+
+test_main_t test_main;
+
+typedef struct
+{
+  u64 index;
+  u64 pad[3];
+} test_elt_t;
+
+static clib_error_t *
+test_hugemem (test_main_t * tm)
+{
+  clib_hugemem_main_t *hm = &clib_hugemem_main;
+  clib_mem_page_stats_t stats;
+  test_elt_t **vecs = 0, *pool = 0, *e;
+  clib_error_t *error;
+  u32 i, j;
+
+  error = clib_hugemem_init (clib_mem_get_heap (), 1 << 20,
+			     64ULL << 30, tm->log2_page_bytes, tm->flags);
+  if (error)
+    return error;
+
+  /* Grow several vectors in turn so they get in each other's way,
+     forcing both in place growth and remapping. */
+  vec_validate (vecs, tm->n_vectors - 1);
+  for (i = 0; i < tm->n_elts; i++)
+    for (j = 0; j < tm->n_vectors; j++)
+      {
+	vec_add2 (vecs[j], e, 1);
+	if (e->index != 0)
+	  return clib_error_return (0, "vector %d elt %d not zeroed", j, i);
+	e->index = i;
+      }
+
+  for (j = 0; j < tm->n_vectors; j++)
+    {
+      if (!clib_hugemem_contains (vec_header (vecs[j], 0)))
+	return clib_error_return (0, "vector %d not in arena", j);
+      vec_foreach (e, vecs[j])
+	if (e->index != e - vecs[j])
+	  return clib_error_return (0, "vector %d elt %d corrupted", j,
+				    e - vecs[j]);
+    }
+
+  for (i = 0; i < tm->n_elts; i++)
+    {
+      pool_get (pool, e);
+      e->index = e - pool;
+    }
+  for (i = 0; i < tm->n_elts; i += 2)
+    pool_put_index (pool, i);
+  /* *INDENT-OFF* */
+  pool_foreach (e, pool,
+  ({
+    if (e->index != e - pool)
+      return clib_error_return (0, "pool elt %d corrupted", e - pool);
+  }));
+  /* *INDENT-ON* */
+
+  clib_mem_get_page_stats (hm->va_start, hm->va_end - hm->va_start, &stats);
+  fformat (stdout, "%U\n%U\n", format_clib_hugemem, tm->verbose,
+	   format_clib_mem_page_stats, &stats);
+
+  if (hm->n_grow_in_place + hm->n_grow_remap == 0)
+    return clib_error_return (0, "vectors never grown without copy");
+
+  for (j = 0; j < tm->n_vectors; j++)
+    vec_free (vecs[j]);
+  vec_free (vecs);
+  pool_free (pool);
+
+  if (hm->n_objects)
+    return clib_error_return (0, "%d objects leaked", hm->n_objects);
+  if (vec_len (hm->free_ranges) != 1)
+    return clib_error_return (0, "free ranges not coalesced");
+
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  test_main_t *tm = &test_main;
+  unformat_input_t i;
+  clib_error_t *error;
+  uword page_size;
+
+  clib_mem_init (0, 64ULL << 20);
+
+  tm->n_elts = 1 << 20;
+  tm->n_vectors = 3;
+  tm->log2_page_bytes = 21;
+
+  unformat_init_command_line (&i, argv);
+  while (unformat_check_input (&i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (&i, "elts %d", &tm->n_elts))
+	;
+      else if (unformat (&i, "vectors %d", &tm->n_vectors))
+	;
+      else if (unformat (&i, "hugetlb %U", unformat_memory_size, &page_size))
+	{
+	  tm->log2_page_bytes = min_log2 (page_size);
+	  tm->flags |= CLIB_HUGEMEM_F_HUGETLB;
+	}
+      else if (unformat (&i, "verbose"))
+	tm->verbose = 1;
+      else
+	{
+	  clib_warning ("unknown input '%U'", format_unformat_error, &i);
+	  return 1;
+	}
+    }
+  unformat_free (&i);
+
+  error = test_hugemem (tm);
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -46,13 +46,303 @@
 #endif
 
 #include <vppinfra/mheap.h>
+#include <vppinfra/slab.h>
 #include <vppinfra/format.h>
 #include <vppinfra/random.h>
+#include <vppinfra/time.h>
+
+#ifdef CLIB_UNIX
+#include <pthread.h>
+#endif
 
 static int verbose = 0;
 #define if_verbose(format,args...) \
   if (verbose) { clib_warning(format, ## args); }
 
+static clib_error_t *
+test_slab_init (uword arena_bytes, u32 slab_flags)
+{
+  /* The slab allocator is set up once per process. */
+  if (clib_slab_main.arena_start)
+    return 0;
+  return clib_slab_init (clib_mem_get_heap (), arena_bytes, slab_flags);
+}
+
+/*
+ * Allocation churn benchmark, mheap vs. slab allocator. Fills a table
+ * of n_objects random sized objects, then replaces random entries
+ * n_iterations times and finally frees everything.
+ */
+static void
+test_mheap_bench (u32 n_objects, u32 max_object_size, u32 n_iterations,
+		  u32 seed, u32 slab_flags)
+{
+  void **objects = 0;
+  uword *offsets = 0;
+  u32 *sizes = 0;
+  void *h;
+  u64 t[2];
+  f64 mheap_clocks, slab_clocks;
+  uword heap_size, n_ops;
+  clib_error_t *err;
+  u32 i, j;
+
+  /* Bigger objects never come from the slab allocator. */
+  if (max_object_size > CLIB_SLAB_MAX_OBJECT_BYTES)
+    {
+      clib_warning ("max. size %d above slab object limit %d",
+		    max_object_size, CLIB_SLAB_MAX_OBJECT_BYTES);
+      return;
+    }
+
+  vec_validate (sizes, n_objects - 1);
+  vec_validate (objects, n_objects - 1);
+  vec_validate_init_empty (offsets, n_objects - 1, ~0);
+  for (i = 0; i < n_objects; i++)
+    sizes[i] = 1 + random_u32 (&seed) % max_object_size;
+
+  n_ops = 2 * n_objects + 2 * n_iterations;
+  heap_size = max_pow2 (4 * (uword) n_objects * max_object_size);
+
+  h = mheap_alloc (0, heap_size);
+  if (!h)
+    {
+      clib_warning ("mheap_alloc %U failed", format_memory_size, heap_size);
+      goto done;
+    }
+
+  t[0] = clib_cpu_time_now ();
+  for (i = 0; i < n_objects; i++)
+    h = mheap_get_aligned (h, sizes[i], 0, 0, &offsets[i]);
+  for (i = 0; i < n_iterations; i++)
+    {
+      j = random_u32 (&seed) % n_objects;
+      mheap_put (h, offsets[j]);
+      h = mheap_get_aligned (h, sizes[i % n_objects], 0, 0, &offsets[j]);
+    }
+  for (i = 0; i < n_objects; i++)
+    mheap_put (h, offsets[i]);
+  t[1] = clib_cpu_time_now ();
+  mheap_clocks = (f64) (t[1] - t[0]) / n_ops;
+  mheap_free (h);
+
+  err = test_slab_init (heap_size, slab_flags);
+  if (err)
+    {
+      clib_error_report (err);
+      goto done;
+    }
+
+  t[0] = clib_cpu_time_now ();
+  for (i = 0; i < n_objects; i++)
+    {
+      objects[i] = clib_slab_alloc_aligned_at_offset (sizes[i], 0, 0);
+      ASSERT (objects[i] != 0);
+    }
+  for (i = 0; i < n_iterations; i++)
+    {
+      j = random_u32 (&seed) % n_objects;
+      clib_slab_free (objects[j]);
+      objects[j] = clib_slab_alloc_aligned_at_offset (sizes[i % n_objects],
+						      0, 0);
+      ASSERT (objects[j] != 0);
+    }
+  for (i = 0; i < n_objects; i++)
+    clib_slab_free (objects[i]);
+  t[1] = clib_cpu_time_now ();
+  slab_clocks = (f64) (t[1] - t[0]) / n_ops;
+
+  fformat (stdout, "%d objects, max. size %d, %d iterations\n",
+	   n_objects, max_object_size, n_iterations);
+  fformat (stdout, "mheap: %.2f clocks/op\n", mheap_clocks);
+  fformat (stdout, "slab:  %.2f clocks/op\n", slab_clocks);
+  if (verbose)
+    fformat (stdout, "%U\n", format_clib_slab, 1);
+
+done:
+  vec_free (sizes);
+  vec_free (objects);
+  vec_free (offsets);
+}
+
+typedef struct
+{
+  uword start, end;
+} test_slab_range_t;
+
+static int
+test_slab_range_cmp (void *a1, void *a2)
+{
+  test_slab_range_t *r1 = a1, *r2 = a2;
+  return r1->start < r2->start ? -1 : r1->start > r2->start;
+}
+
+static void
+test_slab_fill (u8 * p, u32 size, u32 tag)
+{
+  u32 k;
+  for (k = 0; k < size; k++)
+    p[k] = tag + k;
+}
+
+static void
+test_slab_check (u8 * p, u32 size, u32 tag)
+{
+  u32 k;
+  for (k = 0; k < size; k++)
+    ASSERT (p[k] == (u8) (tag + k));
+}
+
+static u64
+test_slab_n_objects (void)
+{
+  clib_slab_usage_t u;
+  clib_slab_usage (&u);
+  return u.n_objects;
+}
+
+#ifdef CLIB_UNIX
+static void *
+test_slab_remote_free (void *arg)
+{
+  void **objects = arg;
+  void **p;
+
+  vec_foreach (p, objects) clib_slab_free (p[0]);
+  return 0;
+}
+#endif
+
+/*
+ * Slab allocator correctness. Objects are filled with a per object
+ * pattern which must survive random replacement of the other objects,
+ * and the live objects must never overlap. Half of the objects are then
+ * freed by another thread and must be handed back to this thread, the
+ * owner, on its next slab refill.
+ */
+static void
+test_slab_validate (u32 n_objects, u32 max_object_size, u32 n_iterations,
+		    u32 seed, u32 slab_flags)
+{
+  u8 **objects = 0;
+  u32 *sizes = 0, *tags = 0;
+  test_slab_range_t *ranges = 0;
+  uword arena_bytes;
+  clib_error_t *err;
+  u32 i, j;
+
+  max_object_size = clib_min (max_object_size, CLIB_SLAB_MAX_OBJECT_BYTES);
+  arena_bytes = max_pow2 (4 * (uword) n_objects * max_object_size);
+
+  err = test_slab_init (arena_bytes, slab_flags);
+  if (err)
+    {
+      clib_error_report (err);
+      return;
+    }
+
+  /* Oversized requests are left to mheap. */
+  ASSERT (clib_slab_alloc_aligned_at_offset
+	  (CLIB_SLAB_MAX_OBJECT_BYTES + 1, 0, 0) == 0);
+
+  vec_validate (objects, n_objects - 1);
+  vec_validate (sizes, n_objects - 1);
+  vec_validate (tags, n_objects - 1);
+  vec_validate (ranges, n_objects - 1);
+
+  for (i = 0; i < n_objects + n_iterations; i++)
+    {
+      j = i < n_objects ? i : random_u32 (&seed) % n_objects;
+      if (objects[j])
+	{
+	  test_slab_check (objects[j], sizes[j], tags[j]);
+	  clib_slab_free (objects[j]);
+	}
+
+      sizes[j] = 1 + random_u32 (&seed) % max_object_size;
+      tags[j] = random_u32 (&seed);
+      objects[j] = clib_slab_alloc_aligned_at_offset (sizes[j], 0, 0);
+      ASSERT (objects[j] != 0);
+      ASSERT (clib_slab_contains (objects[j]));
+      ASSERT (clib_slab_size (objects[j]) >= sizes[j]);
+      test_slab_fill (objects[j], sizes[j], tags[j]);
+    }
+
+  for (i = 0; i < n_objects; i++)
+    {
+      test_slab_check (objects[i], sizes[i], tags[i]);
+      ranges[i].start = pointer_to_uword (objects[i]);
+      ranges[i].end = ranges[i].start + sizes[i];
+    }
+  vec_sort_with_function (ranges, test_slab_range_cmp);
+  for (i = 1; i < n_objects; i++)
+    ASSERT (ranges[i - 1].end <= ranges[i].start);
+
+#ifdef CLIB_UNIX
+  {
+    void **remote = 0, **extra = 0;
+    pthread_t tid;
+    u64 n_before;
+    u32 n_extra;
+
+    for (i = 0; i < n_objects; i += 2)
+      vec_add1 (remote, objects[i]);
+    /* One slab worth of the largest class, plus the refill. */
+    vec_validate (extra, 1 << (CLIB_SLAB_LOG2_SLAB_BYTES -
+			       CLIB_SLAB_MAX_LOG2_OBJECT_BYTES));
+
+    n_before = test_slab_n_objects ();
+    if (pthread_create (&tid, 0, test_slab_remote_free, remote))
+      clib_panic ("pthread_create");
+    pthread_join (tid, 0);
+
+    /* Remote frees stay accounted to the owner until it drains them. */
+    ASSERT (test_slab_n_objects () == n_before);
+
+    /* A slab of the largest class runs out after a few allocations,
+       the refill drains the remote frees. */
+    for (j = 0; j < vec_len (extra); j++)
+      {
+	extra[j] =
+	  clib_slab_alloc_aligned_at_offset (CLIB_SLAB_MAX_OBJECT_BYTES, 0,
+					     0);
+	ASSERT (extra[j] != 0);
+	if (test_slab_n_objects () != n_before + j + 1)
+	  break;
+      }
+    ASSERT (j < vec_len (extra));
+    n_extra = j + 1;
+    ASSERT (test_slab_n_objects () ==
+	    n_before + n_extra - vec_len (remote));
+
+    for (i = 1; i < n_objects; i += 2)
+      test_slab_check (objects[i], sizes[i], tags[i]);
+
+    for (j = 0; j < n_extra; j++)
+      clib_slab_free (extra[j]);
+    for (i = 1; i < n_objects; i += 2)
+      clib_slab_free (objects[i]);
+    ASSERT (test_slab_n_objects () == n_before - n_objects);
+
+    vec_free (remote);
+    vec_free (extra);
+  }
+#else
+  for (i = 0; i < n_objects; i++)
+    clib_slab_free (objects[i]);
+#endif
+
+  fformat (stdout, "slab: %d objects, max. size %d, %d iterations ok\n",
+	   n_objects, max_object_size, n_iterations);
+  if (verbose)
+    fformat (stdout, "%U\n", format_clib_slab, 1);
+
+  vec_free (objects);
+  vec_free (sizes);
+  vec_free (tags);
+  vec_free (ranges);
+}
+
 int
 test_mheap_main (unformat_input_t * input)
 {
@@ -60,7 +350,7 @@ test_mheap_main (unformat_input_t * input)
   void *h, *h_mem;
   uword *objects = 0;
   u32 objects_used, really_verbose, n_objects, max_object_size;
-  u32 check_mask, seed, trace, use_vm;
+  u32 check_mask, seed, trace, use_vm, bench, slab, slab_flags;
   u32 print_every = 0;
   u32 *data;
   mheap_t *mh;
@@ -78,6 +368,9 @@ test_mheap_main (unformat_input_t * input)
   trace = 0;
   really_verbose = 0;
   use_vm = 0;
+  bench = 0;
+  slab = 0;
+  slab_flags = 0;
 
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
@@ -93,6 +386,10 @@ test_mheap_main (unformat_input_t * input)
 	  && 0 == unformat (input, "verbose %=", &really_verbose, 1)
 	  && 0 == unformat (input, "trace %=", &trace, 1)
 	  && 0 == unformat (input, "vm %=", &use_vm, 1)
+	  && 0 == unformat (input, "bench %=", &bench, 1)
+	  && 0 == unformat (input, "slab %=", &slab, 1)
+	  && 0 == unformat (input, "hugepages %=", &slab_flags,
+			    CLIB_SLAB_F_HUGETLB)
 	  && 0 == unformat (input, "align %|", &check_mask, CHECK_ALIGN))
 	{
 	  clib_warning ("unknown input `%U'", format_unformat_error, input);
@@ -104,6 +401,20 @@ test_mheap_main (unformat_input_t * input)
   if (!seed)
     seed = random_default_seed ();
 
+  if (bench)
+    {
+      test_mheap_bench (n_objects, max_object_size, n_iterations, seed,
+			slab_flags);
+      return 0;
+    }
+
+  if (slab)
+    {
+      test_slab_validate (n_objects, max_object_size, n_iterations, seed,
+			  slab_flags);
+      return 0;
+    }
+
   if_verbose
     ("testing %d iterations, %d %saligned objects, max. size %d, seed %d",
      n_iterations, n_objects, (check_mask & CHECK_ALIGN) ? "randomly " : "un",
@@ -81,6 +81,12 @@ vec_resize_allocate_memory (void *v,
   if (new_alloc_bytes < data_bytes)
     new_alloc_bytes = data_bytes;
 
+  /* Hugepage arena objects grow by remapping. New pages come from the
+     kernel zeroed, and are left untouched until used. */
+  if (clib_hugemem_contains (old)
+      && (new = clib_hugemem_realloc (old, new_alloc_bytes)))
+    return new + header_bytes;
+
   new =
     clib_mem_alloc_aligned_at_offset (new_alloc_bytes, data_align,
 				      header_bytes,
@@ -221,7 +221,8 @@ class TestClassifier(VppTestCase):
         return ('{:0>12}{:0>12}{:0>4}'.format(dst_mac, src_mac,
                                               ether_type)).rstrip('0')
 
-    def create_classify_table(self, key, mask, data_offset=0, is_add=1):
+    def create_classify_table(self, key, mask, data_offset=0, is_add=1,
+                              next_table_index=0xFFFFFFFF):
         """Create Classify Table
 
         :param str key: key for classify table (ex, ACL name).
@@ -229,11 +230,13 @@ class TestClassifier(VppTestCase):
         :param int match_n_vectors:
         :param int is_add: option to configure classify table.
             - create(1) or delete(0)
+        :param int next_table_index: table looked up on a miss.
         """
         r = self.vapi.classify_add_del_table(
             is_add,
             binascii.unhexlify(mask),
             match_n_vectors=(len(mask) - 1) // 32 + 1,
+            next_table_index=next_table_index,
             miss_next_index=0,
             current_data_flag=1,
             current_data_offset=data_offset)
@@ -275,6 +278,18 @@ class TestClassifier(VppTestCase):
             ip4_table_index=table_index)
         self.assertIsNotNone(r, msg='No response msg for acl_set_interface')
 
+    def get_inacl_counters(self):
+        """Read the ip4-inacl error counters
+
+        :return: dict of counter reason to count.
+        """
+        counters = {}
+        for line in self.vapi.cli("show errors").splitlines():
+            fields = line.split(None, 2)
+            if len(fields) == 3 and fields[1] == "ip4-inacl":
+                counters[fields[2].strip()] = int(fields[0])
+        return counters
+
     def test_acl_ip(self):
         """ IP ACL test
 
@@ -335,6 +350,64 @@ class TestClassifier(VppTestCase):
         self.pg1.assert_nothing_captured(remark="packets forwarded")
         self.pg3.assert_nothing_captured(remark="packets forwarded")
 
+    def test_acl_ip_chain_parallel(self):
+        """ IP ACL chained tables, serial and parallel lookup
+
+        Test scenario for IP ACL with two chained tables
+            - Create ACL table on source IP chained to a table on
+              destination IP, only the second one matches pg1.
+            - Send pg0 -> pg1 and pg0 -> pg2 streams with serial lookup.
+            - Enable parallel lookup on the first table and send the
+              same streams again.
+            - Verify the same packets pass and the hit and miss counters
+              are identical.
+        """
+
+        self.create_classify_table(
+            'ip_dst', self.build_ip_mask(dst_ip='ffffffff'))
+        self.create_classify_session(
+            self.pg0, self.acl_tbl_idx.get('ip_dst'),
+            self.build_ip_match(dst_ip=self.pg1.remote_ip4))
+        self.create_classify_table(
+            'ip_src', self.build_ip_mask(src_ip='ffffffff'),
+            next_table_index=self.acl_tbl_idx.get('ip_dst'))
+        self.create_classify_session(
+            self.pg0, self.acl_tbl_idx.get('ip_src'),
+            self.build_ip_match(src_ip=self.pg3.remote_ip4))
+        self.input_acl_set_interface(self.pg0, self.acl_tbl_idx.get('ip_src'))
+
+        pkts = self.create_stream(self.pg0, self.pg1, self.pg_if_packet_sizes)
+        pkts += self.create_stream(self.pg0, self.pg2,
+                                   self.pg_if_packet_sizes)
+        n_pass = len(self.pg_if_packet_sizes)
+
+        counters = []
+        for parallel in (0, 1):
+            self.vapi.classify_set_parallel_lookup(
+                self.acl_tbl_idx.get('ip_src'), parallel)
+            tables = self.vapi.cli("show classify tables")
+            self.assertEqual("parallel chain lookup" in tables,
+                             bool(parallel))
+            self.vapi.cli("clear errors")
+
+            self.pg0.add_stream(pkts)
+            self.pg_enable_capture(self.pg_interfaces)
+            self.pg_start()
+
+            rx = self.pg1.get_capture(n_pass)
+            self.verify_capture(self.pg1, rx)
+            self.pg2.assert_nothing_captured(remark="packets forwarded")
+            counters.append(self.get_inacl_counters())
+
+        self.assertEqual(counters[0], counters[1])
+        self.assertEqual(
+            counters[0].get("input ACL hits after chain walk"), n_pass)
+        self.assertEqual(counters[0].get("input ACL misses"), n_pass)
+        self.assertEqual(counters[0].get("input ACL hits"), n_pass)
+
+        self.input_acl_set_interface(
+            self.pg0, self.acl_tbl_idx.get('ip_src'), 0)
+
     def test_acl_pbr(self):
         """ IP PBR test
 
@@ -1,5 +1,9 @@
 import socket
+import struct
+import hmac
+import hashlib
 
+from scapy.packet import Raw
 from scapy.layers.inet import IP, ICMP
 from scapy.layers.l2 import Ether
 from scapy.layers.ipsec import *
@@ -46,10 +50,21 @@ class TestIpsecEsp(VppTestCase):
     remote_pg0_lb_addr = '1.1.1.1'
     remote_pg1_lb_addr = '2.2.2.2'
 
+    # algorithms as numbered in ipsec.h, and as named by scapy
+    vpp_crypto_algo = 1
+    vpp_integ_algo = 2
+    crypt_algo = 'AES-CBC'
+    crypt_key = 'JPjyOWBeVEQiMe7h'
+    auth_algo = 'HMAC-SHA1-96'
+    auth_key = 'C91KUR9GYMm5GfkEvNjX'
+    async_mode = False
+
     @classmethod
     def setUpClass(cls):
         super(TestIpsecEsp, cls).setUpClass()
         try:
+            if cls.async_mode:
+                cls.vapi.cli("set ipsec async mode on")
             cls.create_pg_interfaces(range(3))
             cls.interfaces = list(cls.pg_interfaces)
             for i in cls.interfaces:
@@ -82,16 +97,24 @@ class TestIpsecEsp(VppTestCase):
                 remote_tun_spi,
                 cls.pg0.local_ip4n,
                 cls.pg0.remote_ip4n,
-                integrity_key_length=20,
-                crypto_key_length=16,
+                integrity_algorithm=cls.vpp_integ_algo,
+                integrity_key_length=len(cls.auth_key or ''),
+                integrity_key=cls.auth_key or '',
+                crypto_algorithm=cls.vpp_crypto_algo,
+                crypto_key_length=len(cls.crypt_key),
+                crypto_key=cls.crypt_key,
                 protocol=1)
             cls.vapi.ipsec_sad_add_del_entry(
                 local_sa_id,
                 local_tun_spi,
                 cls.pg0.remote_ip4n,
                 cls.pg0.local_ip4n,
-                integrity_key_length=20,
-                crypto_key_length=16,
+                integrity_algorithm=cls.vpp_integ_algo,
+                integrity_key_length=len(cls.auth_key or ''),
+                integrity_key=cls.auth_key or '',
+                crypto_algorithm=cls.vpp_crypto_algo,
+                crypto_key_length=len(cls.crypt_key),
+                crypto_key=cls.crypt_key,
                 protocol=1)
             cls.vapi.ipsec_spd_add_del(spd_id)
             cls.vapi.ipsec_interface_add_del_spd(spd_id, cls.pg0.sw_if_index)
@@ -151,15 +174,23 @@ class TestIpsecEsp(VppTestCase):
             cls.vapi.ipsec_sad_add_del_entry(
                 remote_sa_id,
                 remote_tra_spi,
-                integrity_key_length=20,
-                crypto_key_length=16,
+                integrity_algorithm=cls.vpp_integ_algo,
+                integrity_key_length=len(cls.auth_key or ''),
+                integrity_key=cls.auth_key or '',
+                crypto_algorithm=cls.vpp_crypto_algo,
+                crypto_key_length=len(cls.crypt_key),
+                crypto_key=cls.crypt_key,
                 protocol=1,
                 is_tunnel=0)
             cls.vapi.ipsec_sad_add_del_entry(
                 local_sa_id,
                 local_tra_spi,
-                integrity_key_length=20,
-                crypto_key_length=16,
+                integrity_algorithm=cls.vpp_integ_algo,
+                integrity_key_length=len(cls.auth_key or ''),
+                integrity_key=cls.auth_key or '',
+                crypto_algorithm=cls.vpp_crypto_algo,
+                crypto_key_length=len(cls.crypt_key),
+                crypto_key=cls.crypt_key,
                 protocol=1,
                 is_tunnel=0)
             cls.vapi.ipsec_spd_add_del(spd_id)
@@ -212,20 +243,20 @@ class TestIpsecEsp(VppTestCase):
             self.remote_tun_sa = SecurityAssociation(
                 ESP,
                 spi=0x000003e8,
-                crypt_algo='AES-CBC',
-                crypt_key='JPjyOWBeVEQiMe7h',
-                auth_algo='HMAC-SHA1-96',
-                auth_key='C91KUR9GYMm5GfkEvNjX',
+                crypt_algo=self.crypt_algo,
+                crypt_key=self.crypt_key,
+                auth_algo=self.auth_algo,
+                auth_key=self.auth_key,
                 tunnel_header=IP(
                     src=self.pg0.remote_ip4,
                     dst=self.pg0.local_ip4))
             self.local_tun_sa = SecurityAssociation(
                 ESP,
                 spi=0x000003e9,
-                crypt_algo='AES-CBC',
-                crypt_key='JPjyOWBeVEQiMe7h',
-                auth_algo='HMAC-SHA1-96',
-                auth_key='C91KUR9GYMm5GfkEvNjX',
+                crypt_algo=self.crypt_algo,
+                crypt_key=self.crypt_key,
+                auth_algo=self.auth_algo,
+                auth_key=self.auth_key,
                 tunnel_header=IP(
                     dst=self.pg0.remote_ip4,
                     src=self.pg0.local_ip4))
@@ -233,17 +264,17 @@ class TestIpsecEsp(VppTestCase):
             self.remote_tra_sa = SecurityAssociation(
                 ESP,
                 spi=0x000007d0,
-                crypt_algo='AES-CBC',
-                crypt_key='JPjyOWBeVEQiMe7h',
-                auth_algo='HMAC-SHA1-96',
-                auth_key='C91KUR9GYMm5GfkEvNjX')
+                crypt_algo=self.crypt_algo,
+                crypt_key=self.crypt_key,
+                auth_algo=self.auth_algo,
+                auth_key=self.auth_key)
             self.local_tra_sa = SecurityAssociation(
                 ESP,
                 spi=0x000007d1,
-                crypt_algo='AES-CBC',
-                crypt_key='JPjyOWBeVEQiMe7h',
-                auth_algo='HMAC-SHA1-96',
-                auth_key='C91KUR9GYMm5GfkEvNjX')
+                crypt_algo=self.crypt_algo,
+                crypt_key=self.crypt_key,
+                auth_algo=self.auth_algo,
+                auth_key=self.auth_key)
 
     def tearDown(self):
         super(TestIpsecEsp, self).tearDown()
@@ -337,5 +368,204 @@ class TestIpsecEsp(VppTestCase):
             self.logger.info(self.vapi.ppcli("show ipsec"))
 
 
+class TestIpsecEspGcm(TestIpsecEsp):
+    """
+    The ipsec esp sanity tests with AES-GCM-128, RFC 4106 - the 16 byte
+    key is followed by the 4 byte salt and there is no integrity algorithm
+    """
+
+    vpp_crypto_algo = 7
+    vpp_integ_algo = 0
+    crypt_algo = 'AES-GCM'
+    crypt_key = 'JPjyOWBeVEQiMe7hSALT'
+    auth_algo = None
+    auth_key = None
+
+
+class TestIpsecEspAsync(TestIpsecEsp):
+    """
+    The ipsec esp sanity tests with the ciphers run by the async crypto
+    engine and completed through crypto-dispatch
+    """
+
+    async_mode = True
+
+
+class TestIpsecEspGcmAsync(TestIpsecEspGcm):
+    """ The ipsec esp AES-GCM-128 sanity tests in async crypto mode """
+
+    async_mode = True
+
+
+class TestIpsecEspReplay(VppTestCase):
+    """
+    ipsec esp anti-replay and extended sequence number tests
+
+    The inbound transport mode SA on pg0 has anti-replay and extended
+    sequence numbers enabled. The ICV covers the high 32 bits of the
+    sequence number (RFC 4303 2.2.1), so the test appends it itself. An
+    echo request that passes the replay check is answered through the
+    outbound SA, one that fails it is dropped.
+
+    Each test takes its sequence numbers above the ones used so far, so
+    the tests do not depend on the order they run in.
+    """
+
+    crypt_key = 'JPjyOWBeVEQiMe7h'
+    auth_key = 'C91KUR9GYMm5GfkEvNjX'
+    # the first sequence number not used by a test yet
+    next_seq = 1
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestIpsecEspReplay, cls).setUpClass()
+        try:
+            cls.create_pg_interfaces(range(1))
+            for i in cls.pg_interfaces:
+                i.admin_up()
+                i.config_ip4()
+                i.resolve_arp()
+            cls.configEspTra()
+            cls.logger.info(cls.vapi.ppcli("show ipsec"))
+        except Exception:
+            super(TestIpsecEspReplay, cls).tearDownClass()
+            raise
+
+    @classmethod
+    def configEspTra(cls):
+        spd_id = 1
+        remote_sa_id = 10
+        local_sa_id = 20
+        cls.vapi.ipsec_sad_add_del_entry(
+            remote_sa_id,
+            3001,
+            integrity_key_length=len(cls.auth_key),
+            integrity_key=cls.auth_key,
+            crypto_key_length=len(cls.crypt_key),
+            crypto_key=cls.crypt_key,
+            protocol=1,
+            is_tunnel=0)
+        cls.vapi.ipsec_sad_add_del_entry(
+            local_sa_id,
+            3000,
+            integrity_key_length=len(cls.auth_key),
+            integrity_key=cls.auth_key,
+            crypto_key_length=len(cls.crypt_key),
+            crypto_key=cls.crypt_key,
+            protocol=1,
+            is_tunnel=0,
+            use_anti_replay=1,
+            use_extended_sequence_number=1)
+        cls.vapi.ipsec_spd_add_del(spd_id)
+        cls.vapi.ipsec_interface_add_del_spd(spd_id, cls.pg0.sw_if_index)
+        l_startaddr = r_startaddr = socket.inet_pton(
+            socket.AF_INET, "0.0.0.0")
+        l_stopaddr = r_stopaddr = socket.inet_pton(
+            socket.AF_INET, "255.255.255.255")
+        cls.vapi.ipsec_spd_add_del_entry(
+            spd_id, l_startaddr, l_stopaddr, r_startaddr, r_stopaddr,
+            protocol=50)
+        cls.vapi.ipsec_spd_add_del_entry(
+            spd_id, l_startaddr, l_stopaddr, r_startaddr, r_stopaddr,
+            protocol=50, is_outbound=0)
+        l_startaddr = l_stopaddr = cls.pg0.local_ip4n
+        r_startaddr = r_stopaddr = cls.pg0.remote_ip4n
+        cls.vapi.ipsec_spd_add_del_entry(
+            spd_id, l_startaddr, l_stopaddr, r_startaddr, r_stopaddr,
+            priority=10, policy=3, is_outbound=0, sa_id=local_sa_id)
+        cls.vapi.ipsec_spd_add_del_entry(
+            spd_id, l_startaddr, l_stopaddr, r_startaddr, r_stopaddr,
+            priority=10, policy=3, sa_id=remote_sa_id)
+
+    def setUp(self):
+        super(TestIpsecEspReplay, self).setUp()
+        # the ICV is computed below, the SA only encrypts
+        self.sa = SecurityAssociation(ESP, spi=3000, crypt_algo='AES-CBC',
+                                      crypt_key=self.crypt_key)
+
+    def tearDown(self):
+        super(TestIpsecEspReplay, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.ppcli("show error"))
+            self.logger.info(self.vapi.ppcli("show ipsec"))
+
+    def take_seq(self, count, below_wrap=0):
+        """ reserve count sequence numbers above the ones used so far,
+        the first below_wrap of them below the next 2^32 boundary """
+        cls = self.__class__
+        seq = cls.next_seq
+        if below_wrap:
+            seq = (((seq + below_wrap) >> 32) + 1 << 32) - below_wrap
+        cls.next_seq = seq + count
+        return seq
+
+    def gen_pkt(self, seq):
+        """ an echo request with the 64 bit sequence number seq """
+        p = self.sa.encrypt(IP(src=self.pg0.remote_ip4,
+                               dst=self.pg0.local_ip4) / ICMP() /
+                            "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX",
+                            seq_num=seq & 0xffffffff)
+        esp = str(p[ESP])
+        icv = hmac.new(self.auth_key, esp + struct.pack('!I', seq >> 32),
+                       hashlib.sha1).digest()[:12]
+        return (Ether(src=self.pg0.remote_mac, dst=self.pg0.local_mac) /
+                IP(src=self.pg0.remote_ip4, dst=self.pg0.local_ip4,
+                   proto=50) / Raw(esp + icv))
+
+    def send_seq(self, seq, accepted=True):
+        """ send seq and check it passes or fails the replay check """
+        self.pg0.add_stream([self.gen_pkt(seq)])
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        if accepted:
+            self.pg0.get_capture(1, remark="seq %x" % seq)
+        else:
+            self.pg0.assert_nothing_captured(remark="seq %x" % seq)
+
+    def test_ipsec_esp_replay_duplicate(self):
+        """ ipsec esp anti-replay drops duplicates """
+        seq = self.take_seq(2)
+        self.send_seq(seq)
+        self.send_seq(seq, accepted=False)
+        self.send_seq(seq + 1)
+        self.send_seq(seq + 1, accepted=False)
+
+    def test_ipsec_esp_replay_old(self):
+        """ ipsec esp anti-replay drops packets behind the window """
+        seq = self.take_seq(101)
+        self.send_seq(seq + 100)
+        # 64 behind the last one received, just outside the window
+        self.send_seq(seq + 36, accepted=False)
+        self.send_seq(seq, accepted=False)
+        # 63 behind, the oldest one in the window
+        self.send_seq(seq + 37)
+
+    def test_ipsec_esp_replay_out_of_order(self):
+        """ ipsec esp anti-replay accepts out of order in the window """
+        seq = self.take_seq(40)
+        self.send_seq(seq + 39)
+        for i in (5, 38, 1, 33, 0):
+            self.send_seq(seq + i)
+        for i in (5, 38, 39, 0):
+            self.send_seq(seq + i, accepted=False)
+        self.send_seq(seq + 2)
+
+    def test_ipsec_esp_replay_esn_wrap(self):
+        """ ipsec esp extended sequence numbers across a 32 bit wrap """
+        seq = self.take_seq(32, below_wrap=16)
+        self.send_seq(seq)
+        # past the wrap, the high bits are inferred from the window
+        self.send_seq(seq + 21)
+        # before the wrap and still in the window
+        self.send_seq(seq + 5)
+        self.send_seq(seq + 15)
+        self.send_seq(seq + 16)
+        # replays on both sides of the wrap
+        self.send_seq(seq, accepted=False)
+        self.send_seq(seq + 16, accepted=False)
+        self.send_seq(seq + 21, accepted=False)
+        self.send_seq(seq + 31)
+
+
 if __name__ == '__main__':
     unittest.main(testRunner=VppTestRunner)
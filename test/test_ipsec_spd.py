@@ -0,0 +1,183 @@
+#!/usr/bin/env python
+import socket
+import unittest
+
+from scapy.layers.inet import IP, ICMP
+from scapy.layers.l2 import Ether
+from scapy.layers.ipsec import SecurityAssociation, ESP
+
+from framework import VppTestCase, VppTestRunner
+
+
+class TestIpsecSpdChange(VppTestCase):
+    """
+    ipsec SPD changes with flows already in the SPD flow cache
+
+    Traffic from pg1 to the host behind pg0 is protected by a tunnel mode
+    SA. Each test first sends the flow so that its lookup is cached, then
+    changes the SPD and checks the next packets of the same flow follow
+    the new policies.
+
+     ---   encrypt   ---   plain   ---
+    |pg0| <-------  |VPP| <------ |pg1|
+     ---             ---           ---
+    """
+
+    remote_pg0_lb_addr = '1.1.1.1'
+    remote_pg1_lb_addr = '2.2.2.2'
+    crypt_key = 'JPjyOWBeVEQiMe7h'
+    auth_key = 'C91KUR9GYMm5GfkEvNjX'
+    spd_id = 1
+    remote_sa_id = 10
+    local_sa_id = 20
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestIpsecSpdChange, cls).setUpClass()
+        try:
+            cls.create_pg_interfaces(range(2))
+            for i in cls.pg_interfaces:
+                i.admin_up()
+                i.config_ip4()
+                i.resolve_arp()
+            cls.configEspTun()
+            cls.logger.info(cls.vapi.ppcli("show ipsec"))
+        except Exception:
+            super(TestIpsecSpdChange, cls).tearDownClass()
+            raise
+
+    @classmethod
+    def configEspTun(cls):
+        src4 = socket.inet_pton(socket.AF_INET, cls.remote_pg0_lb_addr)
+        cls.vapi.ip_add_del_route(src4, 32, cls.pg0.remote_ip4n)
+        dst4 = socket.inet_pton(socket.AF_INET, cls.remote_pg1_lb_addr)
+        cls.vapi.ip_add_del_route(dst4, 32, cls.pg1.remote_ip4n)
+        cls.vapi.ipsec_sad_add_del_entry(
+            cls.remote_sa_id, 1001,
+            cls.pg0.local_ip4n, cls.pg0.remote_ip4n,
+            integrity_key_length=len(cls.auth_key),
+            integrity_key=cls.auth_key,
+            crypto_key_length=len(cls.crypt_key),
+            crypto_key=cls.crypt_key,
+            protocol=1)
+        cls.vapi.ipsec_sad_add_del_entry(
+            cls.local_sa_id, 1000,
+            cls.pg0.remote_ip4n, cls.pg0.local_ip4n,
+            integrity_key_length=len(cls.auth_key),
+            integrity_key=cls.auth_key,
+            crypto_key_length=len(cls.crypt_key),
+            crypto_key=cls.crypt_key,
+            protocol=1)
+        cls.vapi.ipsec_spd_add_del(cls.spd_id)
+        cls.vapi.ipsec_interface_add_del_spd(cls.spd_id,
+                                             cls.pg0.sw_if_index)
+        l_startaddr = r_startaddr = socket.inet_pton(
+            socket.AF_INET, "0.0.0.0")
+        l_stopaddr = r_stopaddr = socket.inet_pton(
+            socket.AF_INET, "255.255.255.255")
+        cls.vapi.ipsec_spd_add_del_entry(
+            cls.spd_id, l_startaddr, l_stopaddr, r_startaddr, r_stopaddr,
+            protocol=50)
+        cls.vapi.ipsec_spd_add_del_entry(
+            cls.spd_id, l_startaddr, l_stopaddr, r_startaddr, r_stopaddr,
+            protocol=50, is_outbound=0)
+        cls.vapi.ipsec_spd_add_del_entry(
+            cls.spd_id, *cls.flow_range(is_outbound=0),
+            priority=10, policy=3, is_outbound=0, sa_id=cls.local_sa_id)
+        cls.vapi.ipsec_spd_add_del_entry(
+            cls.spd_id, *cls.flow_range(),
+            priority=10, policy=3, sa_id=cls.remote_sa_id)
+
+    @classmethod
+    def flow_range(cls, is_outbound=1):
+        """ the local and remote address ranges of the tunnelled flow """
+        pg0_lb = socket.inet_pton(socket.AF_INET, cls.remote_pg0_lb_addr)
+        pg1_lb = socket.inet_pton(socket.AF_INET, cls.remote_pg1_lb_addr)
+        if is_outbound:
+            return (pg1_lb, pg1_lb, pg0_lb, pg0_lb)
+        return (pg0_lb, pg0_lb, pg1_lb, pg1_lb)
+
+    def setUp(self):
+        super(TestIpsecSpdChange, self).setUp()
+        self.local_tun_sa = SecurityAssociation(
+            ESP, spi=1001, crypt_algo='AES-CBC', crypt_key=self.crypt_key,
+            auth_algo='HMAC-SHA1-96', auth_key=self.auth_key,
+            tunnel_header=IP(dst=self.pg0.remote_ip4,
+                             src=self.pg0.local_ip4))
+
+    def tearDown(self):
+        super(TestIpsecSpdChange, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.ppcli("show error"))
+            self.logger.info(self.vapi.ppcli("show ipsec"))
+
+    def add_del_policy(self, priority, policy, is_add=1):
+        """ add or delete an outbound policy for the tunnelled flow """
+        self.vapi.ipsec_spd_add_del_entry(
+            self.spd_id, *self.flow_range(),
+            priority=priority, policy=policy, is_add=is_add)
+
+    def send_flow(self, count=3):
+        """ send count packets of the flow from pg1 """
+        pkts = [Ether(src=self.pg1.remote_mac, dst=self.pg1.local_mac) /
+                IP(src=self.remote_pg1_lb_addr, dst=self.remote_pg0_lb_addr) /
+                ICMP() / "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+                for i in range(count)]
+        self.pg1.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+    def verify_protected(self, count=3):
+        self.send_flow(count)
+        for p in self.pg0.get_capture(count):
+            self.assertEqual(p[IP].proto, 50)
+            decrypted = self.local_tun_sa.decrypt(p[IP])
+            self.assert_equal(decrypted.src, self.remote_pg1_lb_addr)
+            self.assert_equal(decrypted.dst, self.remote_pg0_lb_addr)
+
+    def verify_bypassed(self, count=3):
+        self.send_flow(count)
+        for p in self.pg0.get_capture(count):
+            self.assertNotIn(ESP, p)
+            self.assert_equal(p[IP].src, self.remote_pg1_lb_addr)
+            self.assert_equal(p[IP].dst, self.remote_pg0_lb_addr)
+
+    def verify_discarded(self, count=3):
+        self.send_flow(count)
+        self.pg0.assert_nothing_captured()
+
+    def test_ipsec_spd_change_add_del(self):
+        """ ipsec SPD policy add and delete with a cached flow """
+        self.verify_protected()
+
+        # a discard policy above the protect one takes over the flow
+        self.add_del_policy(priority=20, policy=1)
+        self.verify_discarded()
+
+        # and the flow is protected again once it is deleted
+        self.add_del_policy(priority=20, policy=1, is_add=0)
+        self.verify_protected()
+
+    def test_ipsec_spd_change_priority(self):
+        """ ipsec SPD policy priority change with a cached flow """
+        self.verify_protected()
+
+        # a bypass policy below the protect one does not match the flow
+        self.add_del_policy(priority=5, policy=0)
+        self.verify_protected()
+
+        # raised above the protect one, it does
+        self.add_del_policy(priority=5, policy=0, is_add=0)
+        self.add_del_policy(priority=20, policy=0)
+        self.verify_bypassed()
+
+        # lowered again, the protect policy matches again
+        self.add_del_policy(priority=20, policy=0, is_add=0)
+        self.add_del_policy(priority=5, policy=0)
+        self.verify_protected()
+
+        self.add_del_policy(priority=5, policy=0, is_add=0)
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
@@ -205,3 +205,43 @@ class TestKP(VppTestCase):
                 self.vapi.cli("ku pod 2001::/16 2002::%u del" % (podid))
             self.vapi.cli("ku vip 2001::/16 nat6 del")
             self.vapi.cli("test kube-proxy flowtable flush")
+
+    def getStickyBuckets(self):
+        return [int(l.split(":")[1]) for l in
+                self.vapi.cli("show kube-proxy").splitlines()
+                if l.strip().startswith("buckets:")]
+
+    def sendFlows(self, flows):
+        self.packets = flows
+        self.pg0.add_stream(self.generatePackets(self.pg0, isv4=True))
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.checkCapture(nat4=True, isv4=True)
+
+    def test_kp_sticky_table_growth(self):
+        """ Kube-proxy sticky table growth """
+        try:
+            # 16 buckets of 4 flows each, too small for 300 flows
+            self.vapi.cli("ku conf buckets 16")
+            self.vapi.cli("ku vip 90.0.0.0/8 port 3306 target_port 3307 nat4")
+            for podid in self.pods:
+                self.vapi.cli("ku pod 90.0.0.0/8 10.0.0.%u" % (podid))
+
+            self.sendFlows(range(300))
+            self.logger.info(self.vapi.cli("show kube-proxy"))
+            grown = max(self.getStickyBuckets())
+            self.assertGreater(grown, 16)
+
+            # a larger configured size does not shrink the grown table,
+            # the few flows sent next apply it without growing it again
+            self.vapi.cli("ku conf buckets 32")
+            self.sendFlows(range(300, 305))
+            self.logger.info(self.vapi.cli("show kube-proxy"))
+            self.assertGreaterEqual(max(self.getStickyBuckets()), grown)
+        finally:
+            self.packets = range(5)
+            for podid in self.pods:
+                self.vapi.cli("ku pod 90.0.0.0/8 10.0.0.%u del" % (podid))
+            self.vapi.cli("ku vip 90.0.0.0/8 nat4 del")
+            self.vapi.cli("test kube-proxy flowtable flush")
+            self.vapi.cli("ku conf buckets 1024 max-buckets 1048576")
@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+"""L2BD MAC learn rate Test Case HLD:
+
+**config**
+    - add 2 pg-l2 interfaces
+    - configure them into l2bd with MAC learning enabled
+    - limit the bd to 50 new MACs per second
+
+**test 1**
+    - send broadcast frames from 200 new MACs in one burst
+
+**verify 1**
+    - the learned MAC count is within the bucket of one second of learns
+    - the other MACs are counted as not learned due to the rate
+
+**test 2**
+    - remove the rate limit and send the same frames again
+
+**verify 2**
+    - all MACs are learned
+"""
+
+import re
+import time
+import unittest
+
+from scapy.layers.l2 import Ether
+
+from framework import VppTestCase, VppTestRunner
+from util import Host
+
+
+class TestL2bdLearnRate(VppTestCase):
+    """ L2BD MAC learn rate Test Case """
+
+    @classmethod
+    def setUpClass(cls):
+        """
+        Perform standard class setup (defined by class method setUpClass in
+        class VppTestCase) before running the test case, set test case related
+        variables and configure VPP.
+        """
+        super(TestL2bdLearnRate, cls).setUpClass()
+
+        try:
+            cls.bd_id = 1
+            cls.learn_rate = 50
+            cls.create_pg_interfaces(range(2))
+
+            cls.vapi.bridge_domain_add_del(bd_id=cls.bd_id, learn=1)
+            for pg_if in cls.pg_interfaces:
+                cls.vapi.sw_interface_set_l2_bridge(pg_if.sw_if_index,
+                                                    bd_id=cls.bd_id)
+                pg_if.admin_up()
+        except Exception:
+            super(TestL2bdLearnRate, cls).tearDownClass()
+            raise
+
+    def tearDown(self):
+        """
+        Show various debug prints after each test.
+        """
+        super(TestL2bdLearnRate, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.ppcli("show l2fib"))
+            self.logger.info(self.vapi.ppcli("show bridge-domain %s detail"
+                                             % self.bd_id))
+
+    def create_hosts(self, n_hosts, subnet):
+        """
+        Create required number of host MAC addresses.
+
+        :param int n_hosts: Number of hosts to create MAC addresses for.
+        :param int subnet: Subnet byte keeping the MACs of tests apart.
+        """
+        return [Host("00:00:%02x:ff:%02x:%02x" % (subnet, j >> 8, j & 0xff))
+                for j in range(n_hosts)]
+
+    def learn_hosts(self, pg_if, hosts):
+        """
+        Send L2 MAC broadcast packets from the hosts on an interface to
+        let the bridge domain learn their MAC addresses.
+
+        :param VppInterface pg_if: Interface the hosts are behind.
+        :param list hosts: Hosts to learn.
+        """
+        packets = [Ether(dst="ff:ff:ff:ff:ff:ff", src=host.mac)
+                   for host in hosts]
+        pg_if.add_stream(packets)
+        self.logger.info("Sending broadcast eth frames for MAC learning")
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+    def get_learned_count(self):
+        """
+        Return the number of learned MACs from "show l2fib".
+        """
+        m = re.search(r"total/learned entries: \d+/(\d+)",
+                      self.vapi.cli("show l2fib"))
+        return int(m.group(1)) if m else 0
+
+    def get_rate_limited_count(self):
+        """
+        Return the count of MACs not learned due to the bd learn rate.
+        """
+        for line in self.vapi.cli("show errors").splitlines():
+            if line.endswith("L2 not learned due to bd learn rate"):
+                return int(line.split()[0])
+        return 0
+
+    def test_l2bd_learn_rate(self):
+        """ L2BD MAC learn rate limit
+        """
+        hosts = self.create_hosts(200, subnet=17)
+
+        self.vapi.cli("set bridge-domain learn-rate %u %u" %
+                      (self.bd_id, self.learn_rate))
+        self.vapi.cli("clear errors")
+
+        start = time.time()
+        self.learn_hosts(self.pg0, hosts)
+        elapsed = time.time() - start
+
+        # a full bucket of one second of learns, plus the refill while the
+        # burst was sent
+        learned = self.get_learned_count()
+        self.assertGreaterEqual(learned, self.learn_rate)
+        self.assertLessEqual(learned,
+                             self.learn_rate * (1 + elapsed) + 1)
+        self.assertEqual(self.get_rate_limited_count(),
+                         len(hosts) - learned)
+
+        self.vapi.cli("set bridge-domain learn-rate %u 0" % self.bd_id)
+        self.learn_hosts(self.pg0, hosts)
+        self.assertEqual(self.get_learned_count(), len(hosts))
+
+        self.vapi.l2fib_flush_bd(self.bd_id)
+
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
@@ -15,6 +15,9 @@ from util import ppp
   - IP4 to GRE6 encap
   - IP6 to GRE4 encap
   - IP6 to GRE6 encap
+  - IP4 L2 DSR
+  - IP4 NAT4
+  - AS weights, AS draining and sticky table growth, with IP4 to GRE4
 
  As stated in comments below, GRE has issues with IPv6.
  All test cases involving IPv6 are executed, but
@@ -59,8 +62,8 @@ class TestLB(VppTestCase):
         if not self.vpp_dead:
             self.logger.info(self.vapi.cli("show lb vip verbose"))
 
-    def getIPv4Flow(self, id):
-        return (IP(dst="90.0.%u.%u" % (id / 255, id % 255),
+    def getIPv4Flow(self, id, dst=None):
+        return (IP(dst=dst or "90.0.%u.%u" % (id / 255, id % 255),
                    src="40.0.%u.%u" % (id / 255, id % 255)) /
                 UDP(sport=10000 + id, dport=20000 + id))
 
@@ -68,13 +71,14 @@ class TestLB(VppTestCase):
         return (IPv6(dst="2001::%u" % (id), src="fd00:f00d:ffff::%u" % (id)) /
                 UDP(sport=10000 + id, dport=20000 + id))
 
-    def generatePackets(self, src_if, isv4):
+    def generatePackets(self, src_if, isv4, dst=None):
         self.reset_packet_infos()
         pkts = []
         for pktid in self.packets:
             info = self.create_packet_info(src_if, self.pg1)
             payload = self.info_to_payload(info)
-            ip = self.getIPv4Flow(pktid) if isv4 else self.getIPv6Flow(pktid)
+            ip = (self.getIPv4Flow(pktid, dst) if isv4 else
+                  self.getIPv6Flow(pktid))
             packet = (Ether(dst=src_if.local_mac, src=src_if.remote_mac) /
                       ip /
                       Raw(payload))
@@ -94,7 +98,7 @@ class TestLB(VppTestCase):
         self.assertEqual(payload_info.src, self.pg0.sw_if_index)
         self.assertEqual(str(inner), str(self.info.data[IPver]))
 
-    def checkCapture(self, gre4, isv4):
+    def checkCapture(self, gre4, isv4, balanced=True):
         self.pg0.assert_nothing_captured()
         out = self.pg1.get_capture(len(self.packets))
 
@@ -140,12 +144,73 @@ class TestLB(VppTestCase):
 
         # This is just to roughly check that the balancing algorithm
         # is not completly biased.
-        for asid in self.ass:
+        for asid in self.ass if balanced else []:
             if load[asid] < len(self.packets) / (len(self.ass) * 2):
                 self.logger.error(
                     "ASS is not balanced: load[%d] = %d" % (asid, load[asid]))
                 raise Exception("Load Balancer algorithm is biased")
 
+        return load
+
+    def getFlowsAS(self, out):
+        """ map the flows of GRE4 encapsulated IP4 packets to their AS """
+        flows = {}
+        for p in out:
+            inner = IP(str(p[GRE].payload))
+            flows[inner[UDP].sport] = int(p[IP].dst.split(".")[3])
+        return flows
+
+    def sendFlows(self, packets):
+        self.packets = packets
+        self.pg0.add_stream(self.generatePackets(self.pg0, isv4=True))
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg0.assert_nothing_captured()
+        return self.pg1.get_capture(len(self.packets))
+
+    def checkCaptureNoEncap(self, nat):
+        self.pg0.assert_nothing_captured()
+        out = self.pg1.get_capture(len(self.packets))
+
+        load = [0] * len(self.ass)
+        for p in out:
+            try:
+                ip = p[IP]
+                payload_info = self.payload_to_info(str(p[Raw]))
+                self.info = self.packet_infos[payload_info.index]
+                self.assertEqual(payload_info.src, self.pg0.sw_if_index)
+                sent = self.info.data[IP]
+                self.assertEqual(ip.src, sent.src)
+                self.assertEqual(ip.ttl, sent.ttl - 1)
+                self.assertEqual(p[UDP].sport, sent[UDP].sport)
+                self.assertEqual(p[UDP].dport, sent[UDP].dport)
+                if nat:
+                    ass = ["10.0.0.%u" % asid for asid in self.ass]
+                    self.assertIn(ip.dst, ass)
+                    asid = ass.index(ip.dst)
+                    # checksums were updated for the new destination
+                    chk = ip.copy()
+                    del chk.chksum
+                    del chk[UDP].chksum
+                    chk = IP(str(chk))
+                    self.assertEqual(ip.chksum, chk.chksum)
+                    self.assertEqual(ip[UDP].chksum, chk[UDP].chksum)
+                    load[asid] += 1
+                else:
+                    self.assertEqual(ip.dst, sent.dst)
+                    self.assertEqual(p[Ether].dst, self.pg1.remote_mac)
+            except:
+                self.logger.error(ppp("Unexpected or invalid packet:", p))
+                raise
+
+        if nat:
+            for asid in self.ass:
+                if load[asid] < len(self.packets) / (len(self.ass) * 2):
+                    self.logger.error(
+                        "ASS is not balanced: load[%d] = %d" %
+                        (asid, load[asid]))
+                    raise Exception("Load Balancer algorithm is biased")
+
     def test_lb_ip4_gre4(self):
         """ Load Balancer IP4 GRE4 """
         try:
@@ -218,3 +283,148 @@ class TestLB(VppTestCase):
                 self.vapi.cli("lb as 2001::/16 2002::%u del" % (asid))
             self.vapi.cli("lb vip 2001::/16 encap gre6 del")
             self.vapi.cli("test lb flowtable flush")
+
+    def test_lb_ip4_l2dsr(self):
+        """ Load Balancer IP4 L2 DSR """
+        try:
+            self.vapi.cli("lb vip 90.0.0.0/8 encap l2dsr")
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u" % (asid))
+
+            self.pg0.add_stream(self.generatePackets(self.pg0, isv4=True))
+            self.pg_enable_capture(self.pg_interfaces)
+            self.pg_start()
+
+            self.checkCaptureNoEncap(nat=False)
+        finally:
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u del" % (asid))
+            self.vapi.cli("lb vip 90.0.0.0/8 encap l2dsr del")
+            self.vapi.cli("test lb flowtable flush")
+
+    def test_lb_ip4_nat4(self):
+        """ Load Balancer IP4 NAT4 """
+        try:
+            self.vapi.cli("lb vip 90.0.0.1/32 encap nat")
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.1/32 10.0.0.%u" % (asid))
+            self.vapi.cli("lb set interface nat4 in pg1")
+
+            self.pg0.add_stream(self.generatePackets(self.pg0, isv4=True,
+                                                     dst="90.0.0.1"))
+            self.pg_enable_capture(self.pg_interfaces)
+            self.pg_start()
+
+            self.checkCaptureNoEncap(nat=True)
+
+            # replies of the ASs get the VIP as source again
+            reply = (Ether(dst=self.pg1.local_mac, src=self.pg1.remote_mac) /
+                     IP(src="10.0.0.1", dst=self.pg0.remote_ip4) /
+                     UDP(sport=20000, dport=10000) /
+                     Raw('\xa5' * 100))
+            self.pg1.add_stream([reply])
+            self.pg_enable_capture(self.pg_interfaces)
+            self.pg_start()
+
+            p = self.pg0.get_capture(1)[0]
+            self.assertEqual(p[IP].src, "90.0.0.1")
+            self.assertEqual(p[IP].dst, self.pg0.remote_ip4)
+            chk = p[IP].copy()
+            del chk.chksum
+            del chk[UDP].chksum
+            chk = IP(str(chk))
+            self.assertEqual(p[IP].chksum, chk.chksum)
+            self.assertEqual(p[UDP].chksum, chk[UDP].chksum)
+        finally:
+            self.vapi.cli("lb set interface nat4 in pg1 del")
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.1/32 10.0.0.%u del" % (asid))
+            self.vapi.cli("lb vip 90.0.0.1/32 encap nat del")
+            self.vapi.cli("test lb flowtable flush")
+
+    def test_lb_as_weight(self):
+        """ Load Balancer AS weights """
+        try:
+            self.vapi.cli("lb vip 90.0.0.0/8 encap gre4")
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u weight %u" %
+                              (asid, asid))
+
+            self.pg0.add_stream(self.generatePackets(self.pg0, isv4=True))
+            self.pg_enable_capture(self.pg_interfaces)
+            self.pg_start()
+            load = self.checkCapture(gre4=True, isv4=True, balanced=False)
+
+            # new flows are shared in proportion to the weights, 1:4
+            # between the first and last AS which are expected to get 10
+            # and 40 of the 100 flows
+            self.assertEqual(load[0], 0)
+            self.assertGreater(load[4], 2 * load[1])
+        finally:
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u del" % (asid))
+            self.vapi.cli("lb vip 90.0.0.0/8 encap gre4 del")
+            self.vapi.cli("test lb flowtable flush")
+
+    def test_lb_as_drain(self):
+        """ Load Balancer AS drain """
+        try:
+            self.vapi.cli("lb vip 90.0.0.0/8 encap gre4")
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u" % (asid))
+
+            before = self.getFlowsAS(self.sendFlows(range(100)))
+            self.assertIn(0, before.values())
+
+            # established flows stay on the draining AS
+            self.vapi.cli("lb as 90.0.0.0/8 10.0.0.0 drain")
+            self.logger.info(self.vapi.cli("show lb vips verbose"))
+            after = self.getFlowsAS(self.sendFlows(range(100)))
+            self.assertEqual(after, before)
+
+            # new flows do not go to the draining AS
+            new = self.getFlowsAS(self.sendFlows(range(100, 200)))
+            self.assertNotIn(0, new.values())
+
+            # until it is undrained
+            self.vapi.cli("lb as 90.0.0.0/8 10.0.0.0 undrain")
+            new = self.getFlowsAS(self.sendFlows(range(200, 300)))
+            self.assertIn(0, new.values())
+        finally:
+            self.packets = range(100)
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u del" % (asid))
+            self.vapi.cli("lb vip 90.0.0.0/8 encap gre4 del")
+            self.vapi.cli("test lb flowtable flush")
+
+    def getStickyBuckets(self):
+        return [int(l.split(":")[1]) for l in
+                self.vapi.cli("show lb").splitlines()
+                if l.strip().startswith("buckets:")]
+
+    def test_lb_sticky_table_growth(self):
+        """ Load Balancer sticky table growth """
+        try:
+            # 16 buckets of 4 flows each, too small for 300 flows
+            self.vapi.cli("lb conf buckets 16")
+            self.vapi.cli("lb vip 90.0.0.0/8 encap gre4")
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u" % (asid))
+
+            self.sendFlows(range(300))
+            self.logger.info(self.vapi.cli("show lb"))
+            self.assertGreater(max(self.getStickyBuckets()), 16)
+
+            # the table does not grow beyond the maximum
+            self.vapi.cli("test lb flowtable flush")
+            self.vapi.cli("lb conf buckets 16 max-buckets 32")
+            self.sendFlows(range(300, 600))
+            self.logger.info(self.vapi.cli("show lb"))
+            self.assertLessEqual(max(self.getStickyBuckets()), 32)
+        finally:
+            self.packets = range(100)
+            for asid in self.ass:
+                self.vapi.cli("lb as 90.0.0.0/8 10.0.0.%u del" % (asid))
+            self.vapi.cli("lb vip 90.0.0.0/8 encap gre4 del")
+            self.vapi.cli("test lb flowtable flush")
+            self.vapi.cli("lb conf buckets 1024 max-buckets 1048576")
@@ -4814,6 +4814,39 @@ class TestNAT64(MethodHolder):
         ses_num_after_timeout = self.nat64_get_ses_num()
         self.assertNotEqual(ses_num_before_timeout, ses_num_after_timeout)
 
+    @unittest.skipUnless(running_extended_tests(), "part of extended tests")
+    def test_session_timeout_refresh(self):
+        """ NAT64 session refreshed before its expiration check """
+        self.icmp_id_in = 1235
+        self.vapi.nat64_add_del_pool_addr_range(self.nat_addr_n,
+                                                self.nat_addr_n)
+        self.vapi.nat64_add_del_interface(self.pg0.sw_if_index)
+        self.vapi.nat64_add_del_interface(self.pg1.sw_if_index, is_inside=0)
+        self.vapi.nat64_set_timeouts(icmp=8)
+
+        pkts = self.create_stream_in_ip6(self.pg0, self.pg1)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(len(pkts))
+        self.assertEqual(len(self.vapi.nat64_st_dump(IP_PROTOS.icmp)), 1)
+
+        # refresh the session before its timeout and before its timer
+        # fires for the first check, 10 seconds after it was created
+        sleep(6)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(len(pkts))
+
+        # the first check found it not expired and rescheduled it
+        sleep(6)
+        self.assertEqual(len(self.vapi.nat64_st_dump(IP_PROTOS.icmp)), 1)
+
+        # and the rescheduled check frees it
+        sleep(8)
+        self.assertEqual(len(self.vapi.nat64_st_dump(IP_PROTOS.icmp)), 0)
+
     def test_icmp_error(self):
         """ NAT64 ICMP Error message translation """
         self.tcp_port_in = 6303
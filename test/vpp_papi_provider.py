@@ -2045,6 +2045,17 @@ class VppPapiProvider(object):
              'metadata': metadata,
              'match': match})
 
+    def classify_set_parallel_lookup(self, table_index, is_enable=1):
+        """
+        :param table_index: first table of the chain
+        :param is_enable:  (Default value = 1)
+        """
+
+        return self.api(
+            self.papi.classify_set_parallel_lookup,
+            {'table_index': table_index,
+             'is_enable': is_enable})
+
     def input_acl_set_interface(
             self,
             is_add,
@@ -2912,7 +2923,9 @@ class VppPapiProvider(object):
                                 crypto_key_length=0,
                                 crypto_key='JPjyOWBeVEQiMe7h',
                                 is_add=1,
-                                is_tunnel=1):
+                                is_tunnel=1,
+                                use_anti_replay=0,
+                                use_extended_sequence_number=0):
         """ IPSEC SA add/del
         Sample CLI : 'ipsec sa add 10 spi 1001 esp \
             crypto-key 4a506a794f574265564551694d653768 \
@@ -2947,6 +2960,10 @@ class VppPapiProvider(object):
              optional
         :param is_tunnel - tunnel mode (1) or transport mode(0) \
              (Default 1 - tunnel). optional
+        :param use_anti_replay - anti-replay check of inbound packets \
+             (Default 0 - disabled). optional
+        :param use_extended_sequence_number - 64 bit sequence numbers \
+             (Default 0 - disabled). optional
         :returns: reply from the API
         :** reference /vpp/src/vnet/ipsec/ipsec.h file for enum values of
              crypto and ipsec algorithms
@@ -2965,7 +2982,9 @@ class VppPapiProvider(object):
              'crypto_key_length': crypto_key_length,
              'crypto_key': crypto_key,
              'is_add': is_add,
-             'is_tunnel': is_tunnel})
+             'is_tunnel': is_tunnel,
+             'use_anti_replay': use_anti_replay,
+             'use_extended_sequence_number': use_extended_sequence_number})
 
     def ipsec_spd_add_del_entry(self,
                                 spd_id,